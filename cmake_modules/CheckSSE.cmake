@@ -2,6 +2,37 @@ macro(FindSSEFlags)
   include(CheckCXXSourceRuns)
   set(SSE_FLAGS)
  
+  set(CMAKE_REQUIRED_FLAGS "-mavx512f")
+  CHECK_CXX_SOURCE_RUNS("
+    #include <immintrin.h>
+    int main () {
+      int a[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+      __m512i index = _mm512_set1_epi32(1);
+      __m512i b = _mm512_i32gather_epi32(index, a, 4);
+      return _mm512_reduce_add_epi32(b) == 16 ? 0 : 1;
+    }"
+    HAVE_AVX512F_EXTENSIONS)
+
+  set(CMAKE_REQUIRED_FLAGS "-mavx512f -mavx512vpopcntdq")
+  CHECK_CXX_SOURCE_RUNS("
+    #include <immintrin.h>
+    int main () {
+      __m512i a = _mm512_set1_epi64(3);
+      return _mm512_reduce_add_epi64(_mm512_popcnt_epi64(a)) == 16 ? 0 : 1;
+    }"
+    HAVE_AVX512VPOPCNTDQ_EXTENSIONS)
+
+  set(CMAKE_REQUIRED_FLAGS "-mavx2")
+  CHECK_CXX_SOURCE_RUNS("
+    #include <immintrin.h>
+    int main () {
+      int a[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+      __m256i index = _mm256_set1_epi32(1);
+      __m256i b = _mm256_i32gather_epi32(a, index, 4);
+      return _mm256_movemask_epi8(_mm256_cmpeq_epi32(b, index)) == -1 ? 0 : 1;
+    }"
+    HAVE_AVX2_EXTENSIONS)
+
   set(CMAKE_REQUIRED_FLAGS "-mavx")
   CHECK_CXX_SOURCE_RUNS("
     #include <immintrin.h>
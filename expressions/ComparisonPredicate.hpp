@@ -6,7 +6,10 @@
 #ifndef QUICKFOIL_EXPRESSIONS_COMPARISONPREDICATE_HPP_
 #define QUICKFOIL_EXPRESSIONS_COMPARISONPREDICATE_HPP_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <type_traits>
 
 #include "expressions/AttributeReference.hpp"
 #include "expressions/OperatorTraits.hpp"
@@ -16,6 +19,14 @@
 #include "utility/BitVector.hpp"
 #include "utility/BitVectorBuilder.hpp"
 #include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 
 namespace quickfoil {
 
@@ -46,43 +57,76 @@ class ComparisonPredicate {
 
   void EvaluateForJoin(const Vector<ConstBufferPtr>& probe_columns,
                        const Vector<ConstBufferPtr>& build_columns,
-                       const Vector<size_type>& probe_tids,
-                       const Vector<size_type>& build_tids,
-                       BitVector* output) {
-    ConstBufferPtr probe_buffer;
-    probe_attribute_->Evaluate(probe_columns, &probe_buffer);
-
-    ConstBufferPtr build_buffer;
-    build_attribute_->Evaluate(build_columns, &build_buffer);
-
-    const cpp_type* __restrict__ probe_values =
-        probe_buffer->as_type<cpp_type>();
-    const cpp_type* __restrict__ build_values =
-        build_buffer->as_type<cpp_type>();
-
-    output->clear();
-    output->resize(probe_tids.size());
-    BitVectorBuilder result_builder(output);
-    BitVectorBuilder::buffer_type::iterator raw_bit_vector_iterator =
-        result_builder.bit_vector()->begin();
-
-    Vector<size_type>::const_iterator probe_tids_it = probe_tids.begin();
-    Vector<size_type>::const_iterator build_tids_it = build_tids.begin();
-    for (std::size_t block_id = 0; block_id < result_builder.num_blocks(); ++block_id) {
-      for (unsigned bit = 0; bit < 64; ++bit) {
-        *raw_bit_vector_iterator |= (static_cast<BitVectorBuilder::block_type>(
-            operator_(probe_values[*probe_tids_it], build_values[*build_tids_it])) << bit);
-        ++probe_tids_it;
-        ++build_tids_it;
+                       const SelectionVector& probe_tids,
+                       const SelectionVector& build_tids,
+                       BitVector* output) const {
+    EvaluateGroupForJoin(this,
+                         1,
+                         probe_columns,
+                         build_columns,
+                         probe_tids,
+                         build_tids,
+                         output);
+  }
+
+  // Evaluates the <num_predicates> predicates starting at <predicates> on the
+  // join results, and writes the result of the i-th one to <outputs>[i]. The
+  // predicates are evaluated together in one pass over the tids, a block of
+  // 64 join results at a time, so that the tids are loaded once per block for
+  // all of them.
+  static void EvaluateGroupForJoin(const ComparisonPredicate* predicates,
+                                   std::size_t num_predicates,
+                                   const Vector<ConstBufferPtr>& probe_columns,
+                                   const Vector<ConstBufferPtr>& build_columns,
+                                   const SelectionVector& probe_tids,
+                                   const SelectionVector& build_tids,
+                                   BitVector* outputs) {
+    DCHECK_EQ(probe_tids.size(), build_tids.size());
+    for (std::size_t first = 0; first < num_predicates; first += kMaxNumFusedPredicates) {
+      const std::size_t num_fused =
+          (num_predicates - first < kMaxNumFusedPredicates ? num_predicates - first
+                                                           : kMaxNumFusedPredicates);
+      const cpp_type* probe_values[kMaxNumFusedPredicates];
+      const cpp_type* build_values[kMaxNumFusedPredicates];
+      BitVectorBuilder::block_type* output_blocks[kMaxNumFusedPredicates];
+      for (std::size_t i = 0; i < num_fused; ++i) {
+        const ComparisonPredicate& predicate = predicates[first + i];
+        ConstBufferPtr probe_buffer;
+        predicate.probe_attribute_->Evaluate(probe_columns, &probe_buffer);
+        ConstBufferPtr build_buffer;
+        predicate.build_attribute_->Evaluate(build_columns, &build_buffer);
+        probe_values[i] = probe_buffer->as_type<cpp_type>();
+        build_values[i] = build_buffer->as_type<cpp_type>();
+
+        BitVector* output = &outputs[first + i];
+        output->resize(probe_tids.size());
+        output_blocks[i] = BitVectorBuilder(output).bit_vector()->data();
       }
-      ++raw_bit_vector_iterator;
-    }
 
-    for (unsigned bit = 0; bit < result_builder.bits_in_last_block(); ++bit) {
-      *raw_bit_vector_iterator |= (static_cast<BitVectorBuilder::block_type>(
-          operator_(probe_values[*probe_tids_it], build_values[*build_tids_it])) << bit);
-      ++probe_tids_it;
-      ++build_tids_it;
+      const size_type* __restrict__ probe_tids_it = probe_tids.data();
+      const size_type* __restrict__ build_tids_it = build_tids.data();
+      const std::size_t num_full_blocks = probe_tids.size() / BitVector::bits_per_block;
+      for (std::size_t block_id = 0; block_id < num_full_blocks; ++block_id) {
+        for (std::size_t i = 0; i < num_fused; ++i) {
+          output_blocks[i][block_id] = EvaluateFullBlock(probe_values[i],
+                                                         build_values[i],
+                                                         probe_tids_it,
+                                                         build_tids_it);
+        }
+        probe_tids_it += BitVector::bits_per_block;
+        build_tids_it += BitVector::bits_per_block;
+      }
+
+      const unsigned num_extra_bits = probe_tids.size() % BitVector::bits_per_block;
+      if (num_extra_bits > 0) {
+        for (std::size_t i = 0; i < num_fused; ++i) {
+          output_blocks[i][num_full_blocks] = EvaluatePartialBlock(probe_values[i],
+                                                                   build_values[i],
+                                                                   probe_tids_it,
+                                                                   build_tids_it,
+                                                                   num_extra_bits);
+        }
+      }
     }
   }
 
@@ -95,6 +139,76 @@ class ComparisonPredicate {
   }
 
  private:
+  typedef BitVectorBuilder::block_type block_type;
+
+  static constexpr std::size_t kMaxNumFusedPredicates = 8;
+
+  // True if the predicate is evaluated with SIMD gathers.
+  static constexpr bool kUseGather =
+      operator_type == OperatorType::kEqual &&
+      std::is_integral<cpp_type>::value &&
+      sizeof(cpp_type) == sizeof(int);
+
+  static inline block_type EvaluatePartialBlock(const cpp_type* __restrict__ probe_values,
+                                                const cpp_type* __restrict__ build_values,
+                                                const size_type* __restrict__ probe_tids,
+                                                const size_type* __restrict__ build_tids,
+                                                unsigned num_bits) {
+    op comparator;
+    block_type block = 0;
+    for (unsigned bit = 0; bit < num_bits; ++bit) {
+      block |= static_cast<block_type>(
+          comparator(probe_values[probe_tids[bit]], build_values[build_tids[bit]])) << bit;
+    }
+    return block;
+  }
+
+  static inline block_type EvaluateFullBlock(const cpp_type* __restrict__ probe_values,
+                                             const cpp_type* __restrict__ build_values,
+                                             const size_type* __restrict__ probe_tids,
+                                             const size_type* __restrict__ build_tids) {
+#if defined(__AVX512F__)
+    if (kUseGather) {
+      const int* probe_base = reinterpret_cast<const int*>(probe_values);
+      const int* build_base = reinterpret_cast<const int*>(build_values);
+      block_type block = 0;
+      for (unsigned bit = 0; bit < BitVector::bits_per_block; bit += 16) {
+        const __m512i probe_gathered =
+            _mm512_i32gather_epi32(_mm512_loadu_si512(probe_tids + bit), probe_base, 4);
+        const __m512i build_gathered =
+            _mm512_i32gather_epi32(_mm512_loadu_si512(build_tids + bit), build_base, 4);
+        block |= static_cast<block_type>(
+            _mm512_cmpeq_epi32_mask(probe_gathered, build_gathered)) << bit;
+      }
+      return block;
+    }
+#elif defined(__AVX2__)
+    if (kUseGather) {
+      const int* probe_base = reinterpret_cast<const int*>(probe_values);
+      const int* build_base = reinterpret_cast<const int*>(build_values);
+      block_type block = 0;
+      for (unsigned bit = 0; bit < BitVector::bits_per_block; bit += 8) {
+        const __m256i probe_gathered = _mm256_i32gather_epi32(
+            probe_base,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(probe_tids + bit)),
+            4);
+        const __m256i build_gathered = _mm256_i32gather_epi32(
+            build_base,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(build_tids + bit)),
+            4);
+        block |= static_cast<block_type>(static_cast<std::uint32_t>(_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(probe_gathered, build_gathered))))) << bit;
+      }
+      return block;
+    }
+#endif
+    return EvaluatePartialBlock(probe_values,
+                                build_values,
+                                probe_tids,
+                                build_tids,
+                                BitVector::bits_per_block);
+  }
+
   op operator_;
   std::unique_ptr<AttributeReference> probe_attribute_;
   std::unique_ptr<AttributeReference> build_attribute_;
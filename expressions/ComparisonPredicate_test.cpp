@@ -0,0 +1,155 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "expressions/ComparisonPredicate.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <random>
+
+#include "expressions/AttributeReference.hpp"
+#include "expressions/OperatorTraits.hpp"
+#include "memory/Buffer.hpp"
+#include "schema/TypeDefs.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class ComparisonPredicateTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+  static constexpr int kNumColumns = 9;
+  static constexpr size_type kNumProbeTuples = 300;
+  static constexpr size_type kNumBuildTuples = 200;
+
+  ComparisonPredicateTest()
+      : generator_(29) {
+    // The values are in a small range, so that about a quarter of the pairs
+    // are equal.
+    std::uniform_int_distribution<cpp_type> value_distribution(0, 3);
+    for (int column_id = 0; column_id < kNumColumns; ++column_id) {
+      probe_columns_.emplace_back(CreateColumn(kNumProbeTuples, &value_distribution));
+      build_columns_.emplace_back(CreateColumn(kNumBuildTuples, &value_distribution));
+    }
+  }
+
+  ConstBufferPtr CreateColumn(size_type num_tuples,
+                              std::uniform_int_distribution<cpp_type>* value_distribution) {
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+    for (size_type i = 0; i < num_tuples; ++i) {
+      column->mutable_as_type<cpp_type>()[i] = (*value_distribution)(generator_);
+    }
+    return std::make_shared<const ConstBuffer>(column);
+  }
+
+  void FillTids(std::size_t num_tids, size_type num_tuples, SelectionVector* tids) {
+    std::uniform_int_distribution<size_type> tid_distribution(0, num_tuples - 1);
+    tids->Reserve(num_tids);
+    for (std::size_t i = 0; i < num_tids; ++i) {
+      tids->mutable_data()[i] = tid_distribution(generator_);
+    }
+    tids->set_size(num_tids);
+  }
+
+  // Checks EvaluateGroupForJoin() on groups of <num_predicates> predicates,
+  // where the i-th one compares the column i % kNumColumns of both sides,
+  // against comparing the values of each join result one at a time.
+  template <OperatorType operator_type>
+  void CheckGroup(std::size_t num_predicates) {
+    typedef ComparisonPredicate<operator_type, kQuickFoilDefaultDataType> Predicate;
+    Vector<Predicate> predicates;
+    for (std::size_t i = 0; i < num_predicates; ++i) {
+      predicates.emplace_back(new AttributeReference(i % kNumColumns),
+                              new AttributeReference(i % kNumColumns));
+    }
+
+    typename OperatorTraits<operator_type>::op comparator;
+    for (const std::size_t num_tids : {0, 1, 63, 64, 65, 130, 8 * 64 + 1}) {
+      SelectionVector probe_tids;
+      SelectionVector build_tids;
+      FillTids(num_tids, kNumProbeTuples, &probe_tids);
+      FillTids(num_tids, kNumBuildTuples, &build_tids);
+
+      // The outputs are reused from a larger size.
+      Vector<BitVector> outputs(num_predicates, BitVector(1000, true));
+      Predicate::EvaluateGroupForJoin(predicates.data(),
+                                      num_predicates,
+                                      probe_columns_,
+                                      build_columns_,
+                                      probe_tids,
+                                      build_tids,
+                                      outputs.data());
+
+      for (std::size_t i = 0; i < num_predicates; ++i) {
+        const cpp_type* probe_values = probe_columns_[i % kNumColumns]->as_type<cpp_type>();
+        const cpp_type* build_values = build_columns_[i % kNumColumns]->as_type<cpp_type>();
+        BitVector expected(num_tids);
+        for (std::size_t j = 0; j < num_tids; ++j) {
+          expected[j] = comparator(probe_values[probe_tids[j]], build_values[build_tids[j]]);
+        }
+        EXPECT_TRUE(expected == outputs[i])
+            << "predicate " << i << " of " << num_predicates << " on " << num_tids << " tids";
+      }
+    }
+  }
+
+  std::mt19937 generator_;
+  Vector<ConstBufferPtr> probe_columns_;
+  Vector<ConstBufferPtr> build_columns_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ComparisonPredicateTest);
+};
+
+constexpr int ComparisonPredicateTest::kNumColumns;
+constexpr size_type ComparisonPredicateTest::kNumProbeTuples;
+constexpr size_type ComparisonPredicateTest::kNumBuildTuples;
+
+TEST_F(ComparisonPredicateTest, EvaluateForJoin) {
+  const FoilFilterPredicate predicate(new AttributeReference(2), new AttributeReference(5));
+  SelectionVector probe_tids;
+  SelectionVector build_tids;
+  FillTids(100, kNumProbeTuples, &probe_tids);
+  FillTids(100, kNumBuildTuples, &build_tids);
+  BitVector output;
+  predicate.EvaluateForJoin(probe_columns_, build_columns_, probe_tids, build_tids, &output);
+
+  ASSERT_EQ(100u, output.size());
+  for (std::size_t i = 0; i < 100; ++i) {
+    EXPECT_EQ(probe_columns_[2]->as_type<cpp_type>()[probe_tids[i]] ==
+                  build_columns_[5]->as_type<cpp_type>()[build_tids[i]],
+              output[i]) << i;
+  }
+}
+
+// The equality predicates are evaluated with SIMD gathers if the build has
+// AVX2 or AVX-512, and the groups of more than eight predicates in several
+// passes.
+TEST_F(ComparisonPredicateTest, EqualGroupOfOne) {
+  CheckGroup<OperatorType::kEqual>(1);
+}
+
+TEST_F(ComparisonPredicateTest, EqualGroupOfEight) {
+  CheckGroup<OperatorType::kEqual>(8);
+}
+
+TEST_F(ComparisonPredicateTest, EqualGroupOfNine) {
+  CheckGroup<OperatorType::kEqual>(9);
+}
+
+// The other comparisons are always evaluated one join result at a time.
+TEST_F(ComparisonPredicateTest, GreaterGroupOfNine) {
+  CheckGroup<OperatorType::kGreater>(9);
+}
+
+}  // namespace quickfoil
@@ -0,0 +1,185 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_LEARNER_CANDIDATE_LITERAL_CACHE_HPP_
+#define QUICKFOIL_LEARNER_CANDIDATE_LITERAL_CACHE_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/TableView.hpp"
+#include "utility/Hash.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+// Caches the counts of the candidate literals evaluated on the building
+// clauses across the iterations of QuickFoil::Learn(), keyed by the body
+// literals of the clause and the candidate literal.
+//
+// Every building clause starts from all the negative examples, so the
+// negative bindings of a clause only depend on its body literals, and the
+// negative counts stay valid for the whole learning process. The positive
+// bindings also depend on the uncovered positive examples that the clause
+// starts from, so the positive counts are only valid for one set of uncovered
+// positive examples at a time, and are dropped when it changes (e.g. shrinks
+// after a new rule is learnt).
+class CandidateLiteralCache {
+ public:
+  enum class LookupResult {
+    kMiss,
+    // Only the negative counts are cached.
+    kNegativeHit,
+    kHit
+  };
+
+  // The cached counts of the candidate literals of one building clause.
+  class ClauseCache {
+   public:
+    ClauseCache() {}
+
+    // Copies the cached counts of the candidate literal <literal_info>->literal
+    // into <literal_info>.
+    LookupResult Lookup(CandidateLiteralInfo* literal_info) const {
+      const LiteralEntries::const_iterator entry_it = entries_.find(*literal_info->literal);
+      if (entry_it == entries_.end()) {
+        return LookupResult::kMiss;
+      }
+      literal_info->num_covered_negative = entry_it->second.num_covered_negative;
+      literal_info->num_binding_negative = entry_it->second.num_binding_negative;
+      if (entry_it->second.positive_epoch != positive_epoch_) {
+        return LookupResult::kNegativeHit;
+      }
+      literal_info->num_covered_positive = entry_it->second.num_covered_positive;
+      literal_info->num_binding_positive = entry_it->second.num_binding_positive;
+      return LookupResult::kHit;
+    }
+
+    // Caches the counts of <literal_info>, unless it is pruned and its
+    // counts are incomplete.
+    void Insert(const CandidateLiteralInfo& literal_info) {
+      if (literal_info.pruned) {
+        return;
+      }
+      Entry& entry = entries_[*literal_info.literal];
+      entry.positive_epoch = positive_epoch_;
+      entry.num_covered_positive = literal_info.num_covered_positive;
+      entry.num_covered_negative = literal_info.num_covered_negative;
+      entry.num_binding_positive = literal_info.num_binding_positive;
+      entry.num_binding_negative = literal_info.num_binding_negative;
+    }
+
+   private:
+    friend class CandidateLiteralCache;
+
+    struct Entry {
+      int positive_epoch;
+      size_type num_covered_positive;
+      size_type num_covered_negative;
+      size_type num_binding_positive;
+      size_type num_binding_negative;
+    };
+
+    typedef std::unordered_map<FoilLiteral, Entry, FoilLiteralHash, FoilLiteralEqual> LiteralEntries;
+
+    LiteralEntries entries_;
+    // The epoch of the uncovered positive examples of the current lookups.
+    int positive_epoch_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(ClauseCache);
+  };
+
+  CandidateLiteralCache() {}
+
+  // Returns the cache of the candidate literals of <clause>, whose bindings
+  // start from <uncovered_positive_data>.
+  ClauseCache* GetClauseCache(const FoilClause& clause,
+                              const std::shared_ptr<TableView>& uncovered_positive_data) {
+    if (uncovered_positive_data != uncovered_positive_data_) {
+      // Holds the examples, so that the address cannot be reused by other
+      // examples while the positive counts are cached for it.
+      uncovered_positive_data_ = uncovered_positive_data;
+      ++positive_epoch_;
+    }
+    ClauseCache* clause_cache = &clause_caches_[clause.body_literals()];
+    clause_cache->positive_epoch_ = positive_epoch_;
+    return clause_cache;
+  }
+
+  // Moves the counts cached in <other>, which was filled after this cache
+  // (e.g. by a learner exploring a tied literal on its own), into this cache
+  // as if they had been cached here. The uncovered positive examples of the
+  // last lookups of <other> become the current ones, so the positive counts
+  // of <other> stay valid and those cached here for other examples do not.
+  void MergeFrom(CandidateLiteralCache* other) {
+    if (other->uncovered_positive_data_ == nullptr) {
+      return;
+    }
+    if (other->uncovered_positive_data_ != uncovered_positive_data_) {
+      uncovered_positive_data_ = other->uncovered_positive_data_;
+      ++positive_epoch_;
+    }
+    for (auto& other_clause_cache : other->clause_caches_) {
+      ClauseCache::LiteralEntries& entries = clause_caches_[other_clause_cache.first].entries_;
+      for (const auto& other_entry : other_clause_cache.second.entries_) {
+        const bool has_positive_counts =
+            (other_entry.second.positive_epoch == other->positive_epoch_);
+        const auto inserted = entries.emplace(other_entry.first, other_entry.second);
+        if (has_positive_counts) {
+          inserted.first->second = other_entry.second;
+          inserted.first->second.positive_epoch = positive_epoch_;
+        } else if (inserted.second) {
+          // The epochs start from 0, so -1 never matches.
+          inserted.first->second.positive_epoch = -1;
+        }
+      }
+    }
+    other->clause_caches_.clear();
+  }
+
+ private:
+  struct BodyLiteralsHash {
+    std::size_t operator()(const Vector<FoilLiteral>& body_literals) const {
+      std::size_t seed = Hash(body_literals.size());
+      for (const FoilLiteral& body_literal : body_literals) {
+        seed = HashCombine(seed, FoilLiteralHash()(body_literal));
+      }
+      return seed;
+    }
+  };
+
+  struct BodyLiteralsEqual {
+    bool operator()(const Vector<FoilLiteral>& lhs, const Vector<FoilLiteral>& rhs) const {
+      if (lhs.size() != rhs.size()) {
+        return false;
+      }
+      for (std::size_t i = 0; i < lhs.size(); ++i) {
+        if (!lhs[i].Equals(rhs[i])) {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+
+  std::unordered_map<Vector<FoilLiteral>, ClauseCache, BodyLiteralsHash, BodyLiteralsEqual> clause_caches_;
+
+  std::shared_ptr<TableView> uncovered_positive_data_;
+  int positive_epoch_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(CandidateLiteralCache);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_LEARNER_CANDIDATE_LITERAL_CACHE_HPP_ */
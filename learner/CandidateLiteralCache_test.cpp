@@ -0,0 +1,234 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/CandidateLiteralCache.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "memory/Buffer.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/FoilParser.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class CandidateLiteralCacheTest : public ::testing::Test {
+ protected:
+  typedef CandidateLiteralCache::LookupResult LookupResult;
+
+  CandidateLiteralCacheTest()
+      : unary_predicate_(0, "p_0", 0, {0}, {nullptr}),
+        binary_predicate_(1, "p_1", 1, {0, 0}, {nullptr, nullptr}),
+        predicate_catalog_{{"p_0", &unary_predicate_}, {"p_1", &binary_predicate_}},
+        clause_(FoilParser::CreateClauseFromString(predicate_catalog_, "p_1(0, 1) :- p_0(0)")),
+        extended_clause_(FoilParser::CreateClauseFromString(predicate_catalog_,
+                                                            "p_1(0, 1) :- p_0(0), p_1(1, 2)")),
+        literal_(FoilParser::CreateLiteralFromString(predicate_catalog_, "p_0(1)")),
+        other_literal_(FoilParser::CreateLiteralFromString(predicate_catalog_, "p_1(1, 0)")),
+        uncovered_positive_data_(CreateData()) {}
+
+  // Returns a table of examples.
+  static std::shared_ptr<TableView> CreateData() {
+    typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type), 1));
+    column->mutable_as_type<cpp_type>()[0] = 0;
+    Vector<ConstBufferPtr> columns(2, std::make_shared<const ConstBuffer>(column));
+    return std::make_shared<TableView>(std::move(columns));
+  }
+
+  // Returns the counts of <literal> as evaluated on some bindings.
+  static CandidateLiteralInfo CreateLiteralInfo(const FoilLiteral& literal, size_type seed) {
+    CandidateLiteralInfo literal_info(&literal);
+    literal_info.num_covered_positive = seed + 1;
+    literal_info.num_covered_negative = seed + 2;
+    literal_info.num_binding_positive = seed + 3;
+    literal_info.num_binding_negative = seed + 4;
+    return literal_info;
+  }
+
+  static void ExpectNegativeCounts(const CandidateLiteralInfo& expected,
+                                   const CandidateLiteralInfo& actual) {
+    EXPECT_EQ(expected.num_covered_negative, actual.num_covered_negative);
+    EXPECT_EQ(expected.num_binding_negative, actual.num_binding_negative);
+  }
+
+  static void ExpectCounts(const CandidateLiteralInfo& expected,
+                           const CandidateLiteralInfo& actual) {
+    ExpectNegativeCounts(expected, actual);
+    EXPECT_EQ(expected.num_covered_positive, actual.num_covered_positive);
+    EXPECT_EQ(expected.num_binding_positive, actual.num_binding_positive);
+  }
+
+  FoilPredicate unary_predicate_;
+  FoilPredicate binary_predicate_;
+  std::unordered_map<std::string, const FoilPredicate*> predicate_catalog_;
+  std::unique_ptr<FoilClause> clause_;
+  std::unique_ptr<FoilClause> extended_clause_;
+  const FoilLiteral literal_;
+  const FoilLiteral other_literal_;
+  std::shared_ptr<TableView> uncovered_positive_data_;
+
+  CandidateLiteralCache cache_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CandidateLiteralCacheTest);
+};
+
+TEST_F(CandidateLiteralCacheTest, MissThenHit) {
+  CandidateLiteralCache::ClauseCache* clause_cache =
+      cache_.GetClauseCache(*clause_, uncovered_positive_data_);
+  CandidateLiteralInfo literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kMiss, clause_cache->Lookup(&literal_info));
+
+  const CandidateLiteralInfo evaluated_literal_info = CreateLiteralInfo(literal_, 10);
+  clause_cache->Insert(evaluated_literal_info);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&literal_info));
+  ExpectCounts(evaluated_literal_info, literal_info);
+
+  // Other literals of the clause are not cached.
+  CandidateLiteralInfo other_literal_info(&other_literal_);
+  EXPECT_EQ(LookupResult::kMiss, clause_cache->Lookup(&other_literal_info));
+
+  // The same clause and examples in a later iteration.
+  clause_cache = cache_.GetClauseCache(*clause_, uncovered_positive_data_);
+  CandidateLiteralInfo later_literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&later_literal_info));
+  ExpectCounts(evaluated_literal_info, later_literal_info);
+}
+
+TEST_F(CandidateLiteralCacheTest, KeyedByBodyLiterals) {
+  cache_.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(
+      CreateLiteralInfo(literal_, 10));
+
+  CandidateLiteralInfo literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kMiss,
+            cache_.GetClauseCache(*extended_clause_, uncovered_positive_data_)->Lookup(&literal_info));
+
+  // A different clause object with the same body literals.
+  std::unique_ptr<FoilClause> same_clause(
+      FoilParser::CreateClauseFromString(predicate_catalog_, "p_1(0, 1) :- p_0(0)"));
+  EXPECT_EQ(LookupResult::kHit,
+            cache_.GetClauseCache(*same_clause, uncovered_positive_data_)->Lookup(&literal_info));
+}
+
+TEST_F(CandidateLiteralCacheTest, InvalidatePositiveCounts) {
+  const CandidateLiteralInfo evaluated_literal_info = CreateLiteralInfo(literal_, 10);
+  cache_.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(evaluated_literal_info);
+
+  // The uncovered positive examples change after a rule is learnt, even if
+  // they have the same content.
+  const std::shared_ptr<TableView> new_uncovered_positive_data = CreateData();
+  CandidateLiteralCache::ClauseCache* clause_cache =
+      cache_.GetClauseCache(*clause_, new_uncovered_positive_data);
+  CandidateLiteralInfo literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kNegativeHit, clause_cache->Lookup(&literal_info));
+  ExpectNegativeCounts(evaluated_literal_info, literal_info);
+  EXPECT_EQ(0u, literal_info.num_covered_positive);
+  EXPECT_EQ(0u, literal_info.num_binding_positive);
+
+  // The positive counts on the new examples.
+  CandidateLiteralInfo reevaluated_literal_info = evaluated_literal_info;
+  reevaluated_literal_info.num_covered_positive = 1;
+  reevaluated_literal_info.num_binding_positive = 2;
+  clause_cache->Insert(reevaluated_literal_info);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&literal_info));
+  ExpectCounts(reevaluated_literal_info, literal_info);
+
+  // The positive counts of the other clauses are invalidated too.
+  cache_.GetClauseCache(*extended_clause_, new_uncovered_positive_data)->Insert(
+      CreateLiteralInfo(literal_, 20));
+  CandidateLiteralInfo extended_literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kNegativeHit,
+            cache_.GetClauseCache(*extended_clause_, uncovered_positive_data_)
+                ->Lookup(&extended_literal_info));
+
+  // Going back to the previous examples does not revive their counts.
+  CandidateLiteralInfo old_literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kNegativeHit,
+            cache_.GetClauseCache(*clause_, uncovered_positive_data_)->Lookup(&old_literal_info));
+}
+
+TEST_F(CandidateLiteralCacheTest, PrunedLiteralsAreNotCached) {
+  CandidateLiteralCache::ClauseCache* clause_cache =
+      cache_.GetClauseCache(*clause_, uncovered_positive_data_);
+  CandidateLiteralInfo pruned_literal_info = CreateLiteralInfo(literal_, 10);
+  pruned_literal_info.pruned = true;
+  clause_cache->Insert(pruned_literal_info);
+
+  CandidateLiteralInfo literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kMiss, clause_cache->Lookup(&literal_info));
+
+  // Nor do they overwrite the complete counts.
+  const CandidateLiteralInfo evaluated_literal_info = CreateLiteralInfo(literal_, 20);
+  clause_cache->Insert(evaluated_literal_info);
+  clause_cache->Insert(pruned_literal_info);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&literal_info));
+  ExpectCounts(evaluated_literal_info, literal_info);
+}
+
+TEST_F(CandidateLiteralCacheTest, MergeFrom) {
+  const CandidateLiteralInfo evaluated_literal_info = CreateLiteralInfo(literal_, 10);
+  const CandidateLiteralInfo other_evaluated_literal_info = CreateLiteralInfo(other_literal_, 20);
+  cache_.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(evaluated_literal_info);
+  cache_.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(other_evaluated_literal_info);
+
+  // A cache on the same examples overwrites the counts and keeps the others.
+  CandidateLiteralCache same_data_cache;
+  const CandidateLiteralInfo reevaluated_literal_info = CreateLiteralInfo(literal_, 30);
+  same_data_cache.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(reevaluated_literal_info);
+  same_data_cache.GetClauseCache(*extended_clause_, uncovered_positive_data_)->Insert(
+      evaluated_literal_info);
+  cache_.MergeFrom(&same_data_cache);
+
+  CandidateLiteralCache::ClauseCache* clause_cache =
+      cache_.GetClauseCache(*clause_, uncovered_positive_data_);
+  CandidateLiteralInfo literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&literal_info));
+  ExpectCounts(reevaluated_literal_info, literal_info);
+  CandidateLiteralInfo other_literal_info(&other_literal_);
+  EXPECT_EQ(LookupResult::kHit, clause_cache->Lookup(&other_literal_info));
+  ExpectCounts(other_evaluated_literal_info, other_literal_info);
+  CandidateLiteralInfo extended_literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kHit,
+            cache_.GetClauseCache(*extended_clause_, uncovered_positive_data_)
+                ->Lookup(&extended_literal_info));
+  ExpectCounts(evaluated_literal_info, extended_literal_info);
+
+  // A cache whose last lookups were on new examples only keeps the positive
+  // counts cached for the new examples.
+  const std::shared_ptr<TableView> new_uncovered_positive_data = CreateData();
+  CandidateLiteralCache new_data_cache;
+  new_data_cache.GetClauseCache(*clause_, uncovered_positive_data_)->Insert(
+      CreateLiteralInfo(literal_, 40));
+  const CandidateLiteralInfo new_evaluated_literal_info = CreateLiteralInfo(other_literal_, 50);
+  new_data_cache.GetClauseCache(*extended_clause_, new_uncovered_positive_data)->Insert(
+      new_evaluated_literal_info);
+  cache_.MergeFrom(&new_data_cache);
+
+  clause_cache = cache_.GetClauseCache(*clause_, new_uncovered_positive_data);
+  CandidateLiteralInfo stale_literal_info(&literal_);
+  EXPECT_EQ(LookupResult::kNegativeHit, clause_cache->Lookup(&stale_literal_info));
+  ExpectNegativeCounts(reevaluated_literal_info, stale_literal_info);
+  CandidateLiteralInfo stale_other_literal_info(&other_literal_);
+  EXPECT_EQ(LookupResult::kNegativeHit, clause_cache->Lookup(&stale_other_literal_info));
+  CandidateLiteralInfo new_literal_info(&other_literal_);
+  EXPECT_EQ(LookupResult::kHit,
+            cache_.GetClauseCache(*extended_clause_, new_uncovered_positive_data)
+                ->Lookup(&new_literal_info));
+  ExpectCounts(new_evaluated_literal_info, new_literal_info);
+}
+
+}  // namespace quickfoil
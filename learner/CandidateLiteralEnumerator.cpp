@@ -6,6 +6,7 @@
 #include "learner/CandidateLiteralEnumerator.hpp"
 
 #include <unordered_map>
+#include <utility>
 
 #include "learner/CandidateLiteralInfo.hpp"
 #include "learner/LiteralSearchStats.hpp"
@@ -14,6 +15,7 @@
 #include "schema/FoilPredicate.hpp"
 #include "schema/FoilVariable.hpp"
 #include "utility/StringUtil.hpp"
+#include "utility/ThreadPool.hpp"
 #include "utility/Vector.hpp"
 
 #include "glog/logging.h"
@@ -106,8 +108,9 @@ void CandidateLiteralEnumerator::GenerateAndPruneCandidateLiteralForPredicate(
     const FoilPredicate* background_predicate,
     const std::unordered_map<int, Vector<FoilVariable>>& variable_type_to_variable_map,
     const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
-    std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>* entire_generated_literals,
-    std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>* pruned_generated_literals) {
+    CanonicalDatabases* canonical_databases,
+    Vector<FoilLiteral>* candidate_literals,
+    Vector<int>* pruned_literal_ids) const {
   DCHECK_LT(background_predicate->id(), static_cast<int>(background_predicates_.size()));
   DCHECK(!has_key || background_predicate->key() >= 0);
 
@@ -150,11 +153,8 @@ void CandidateLiteralEnumerator::GenerateAndPruneCandidateLiteralForPredicate(
   DCHECK(literals_with_new_vars_only.back().AreAllVariablesUnBound());
   literals_with_new_vars_only.pop_back();  // Remove the literal with all variables unbound.
 
-  auto emplace_result = entire_generated_literals->emplace(std::piecewise_construct,
-                                                          std::forward_as_tuple(background_predicate),
-                                                          std::forward_as_tuple(std::move(literals_with_new_vars_only)));
-  Vector<FoilLiteral>* entire_candidate_literals_for_predicate =
-      &emplace_result.first->second;
+  *candidate_literals = std::move(literals_with_new_vars_only);
+  Vector<FoilLiteral>* entire_candidate_literals_for_predicate = candidate_literals;
 
   DCHECK(last_run_stats.generated_candidate_literals != nullptr);
   DCHECK(last_run_stats.pruned_literals_by_covered_results != nullptr);
@@ -184,16 +184,15 @@ void CandidateLiteralEnumerator::GenerateAndPruneCandidateLiteralForPredicate(
     }
   }
 
-  Vector<const FoilLiteral*>* pruned_cadidate_literals_for_predicate = &(*pruned_generated_literals)[background_predicate];
-  if (body_literals_with_predicate == nullptr) {
-    for (const FoilLiteral& literal : *entire_candidate_literals_for_predicate) {
-      pruned_cadidate_literals_for_predicate->emplace_back(&literal);
-    }
-  } else {
-    for (const FoilLiteral& candidate_literal : *entire_candidate_literals_for_predicate) {
-      if (!CheckReplaceableDuplicate(building_clause, candidate_literal, predicate_to_body_literals_map)) {
-        pruned_cadidate_literals_for_predicate->emplace_back(&candidate_literal);
-      }
+  const int num_candidate_literals = entire_candidate_literals_for_predicate->size();
+  pruned_literal_ids->reserve(num_candidate_literals);
+  for (int i = 0; i < num_candidate_literals; ++i) {
+    if (body_literals_with_predicate == nullptr ||
+        !CheckReplaceableDuplicate(building_clause,
+                                   (*entire_candidate_literals_for_predicate)[i],
+                                   predicate_to_body_literals_map,
+                                   canonical_databases)) {
+      pruned_literal_ids->emplace_back(i);
     }
   }
 }
@@ -205,7 +204,6 @@ void CandidateLiteralEnumerator::EnumerateForNonMostGeneralClause(
     std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>* entire_generated_literals,
     std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>* pruned_generated_literals) {
   DCHECK(!building_clause.body_literals().empty());
-  canonical_databases_.reserve(background_predicates_.size());
 
   int num_variables;
   if (last_run_stats.generated_candidate_literals == nullptr) {
@@ -229,29 +227,55 @@ void CandidateLiteralEnumerator::EnumerateForNonMostGeneralClause(
     predicate_to_body_literals_map[body_literal.predicate()->id()].push_back(&body_literal);
   }
 
-  for (const FoilPredicate* background_predicate : background_predicates_) {
-    if (background_predicate->key() >= 0) {
-      GenerateAndPruneCandidateLiteralForPredicate<true>(
-          building_clause,
-          last_run_stats,
-          background_predicate,
-          variable_type_to_variable_map,
-          predicate_to_body_literals_map,
-          entire_generated_literals,
-          pruned_generated_literals);
-    } else {
-      GenerateAndPruneCandidateLiteralForPredicate<false>(
-          building_clause,
-          last_run_stats,
-          background_predicate,
-          variable_type_to_variable_map,
-          predicate_to_body_literals_map,
-          entire_generated_literals,
-          pruned_generated_literals);
+  // The predicates are enumerated in parallel. A canonical database is only
+  // used for the candidate literals of its own predicate, so every task keeps
+  // its own. The results are merged in the order of the predicates.
+  const int num_background_predicates = background_predicates_.size();
+  Vector<Vector<FoilLiteral>> candidate_literals_per_predicate(num_background_predicates);
+  Vector<Vector<int>> pruned_literal_ids_per_predicate(num_background_predicates);
+  ThreadPool::GetInstance()->Run(
+      num_background_predicates,
+      [&](int predicate_index) {
+        const FoilPredicate* background_predicate = background_predicates_[predicate_index];
+        CanonicalDatabases canonical_databases;
+        if (background_predicate->key() >= 0) {
+          GenerateAndPruneCandidateLiteralForPredicate<true>(
+              building_clause,
+              last_run_stats,
+              background_predicate,
+              variable_type_to_variable_map,
+              predicate_to_body_literals_map,
+              &canonical_databases,
+              &candidate_literals_per_predicate[predicate_index],
+              &pruned_literal_ids_per_predicate[predicate_index]);
+        } else {
+          GenerateAndPruneCandidateLiteralForPredicate<false>(
+              building_clause,
+              last_run_stats,
+              background_predicate,
+              variable_type_to_variable_map,
+              predicate_to_body_literals_map,
+              &canonical_databases,
+              &candidate_literals_per_predicate[predicate_index],
+              &pruned_literal_ids_per_predicate[predicate_index]);
+        }
+      });
+
+  for (int predicate_index = 0; predicate_index < num_background_predicates; ++predicate_index) {
+    const FoilPredicate* background_predicate = background_predicates_[predicate_index];
+    auto emplace_result = entire_generated_literals->emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(background_predicate),
+        std::forward_as_tuple(std::move(candidate_literals_per_predicate[predicate_index])));
+    const Vector<FoilLiteral>& entire_candidate_literals_for_predicate =
+        emplace_result.first->second;
+    Vector<const FoilLiteral*>* pruned_cadidate_literals_for_predicate =
+        &(*pruned_generated_literals)[background_predicate];
+    for (int literal_id : pruned_literal_ids_per_predicate[predicate_index]) {
+      pruned_cadidate_literals_for_predicate->emplace_back(
+          &entire_candidate_literals_for_predicate[literal_id]);
     }
   }
-
-  canonical_databases_.clear();
 }
 
 // FIXME(qzeng): Unbound variables are currently all considered as distinct.
@@ -364,81 +388,97 @@ void CandidateLiteralEnumerator::GenerateCandidateLiterals(
 bool CandidateLiteralEnumerator::CheckReplaceableDuplicate(
     const FoilClause& clause,
     const FoilLiteral& literal,
-    const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map) {
+    const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
+    CanonicalDatabases* canonical_databases) const {
   const auto literal_vec_it = predicate_to_body_literals_map.find(literal.predicate()->id());
   DCHECK(literal_vec_it != predicate_to_body_literals_map.end());
 
-  if (!literal_vec_it->second.empty()) {
-    std::unordered_map<int, Vector<Vector<int>>>::const_iterator canonical_db_it =
-        canonical_databases_.find(literal.predicate()->id());
-    if (canonical_db_it == canonical_databases_.end()) {
+  const Vector<const FoilLiteral*>& existing_literals = literal_vec_it->second;
+  if (!existing_literals.empty()) {
+    const auto canonical_db_it =
+        canonical_databases->databases.find(literal.predicate()->id());
+    const CanonicalRelation* canonical_db;
+    if (canonical_db_it == canonical_databases->databases.end()) {
 #ifdef ENUMERATOR_VERBOSE
       DVLOG(4) << "Create a canonical database for predicate " << literal.predicate()->name();
 #endif
-      canonical_db_it = CreateCanonicalDatabase(clause,
-                                                *literal.predicate(),
-                                                predicate_to_body_literals_map);
+      canonical_db = &CreateCanonicalDatabase(clause,
+                                              *literal.predicate(),
+                                              predicate_to_body_literals_map,
+                                              canonical_databases);
+    } else {
+      canonical_db = &canonical_db_it->second;
     }
 #ifdef ENUMERATOR_VERBOSE
     DVLOG(4) << "\nClause: " << clause.ToString() << "\n"
              << "Predicate excluded: "<< literal.predicate()->name() << "\n"
              << "Canonical db without the predicate: "
-             << VectorOfVectorToString(canonical_db_it->second);
+             << canonical_db->ToString();
 #endif
 
-    Vector<Vector<int>> canonical_predicate_relation_without_new_literal;
-    for (const FoilLiteral* existing_literal : literal_vec_it->second) {
+    CanonicalRelation* canonical_predicate_relation_without_new_literal =
+        &canonical_databases->predicate_relation_without_new_literal;
+    canonical_predicate_relation_without_new_literal->Reset(literal.num_variables());
+    for (const FoilLiteral* existing_literal : existing_literals) {
       AddRowToCanonicalRelationForExistingLiteral(
-          *existing_literal, &canonical_predicate_relation_without_new_literal);
+          *existing_literal, canonical_predicate_relation_without_new_literal);
     }
 #ifdef ENUMERATOR_VERBOSE
     DVLOG(4) << "Canonical relation without new literal: "
-             << VectorOfVectorToString(canonical_predicate_relation_without_new_literal);
+             << canonical_predicate_relation_without_new_literal->ToString();
 #endif
-    for (size_t literal_index = 0;
-         literal_index < literal_vec_it->second.size();
-         ++literal_index) {
-      Vector<Vector<int>> canonical_joined_relation =
-          canonical_db_it->second;
-      for (size_t i = 0; i < literal_vec_it->second.size(); ++i) {
+    const int num_existing_literals = existing_literals.size();
+    for (int literal_index = 0; literal_index < num_existing_literals; ++literal_index) {
+      // The first join reads the canonical database in place, and the others
+      // go back and forth between the scratch relations.
+      const CanonicalRelation* canonical_joined_relation = canonical_db;
+      for (int i = 0; i < num_existing_literals; ++i) {
         if (i != literal_index) {
-          NestedLoopsJoin<false, false>(*literal_vec_it->second[i],
-                                        canonical_predicate_relation_without_new_literal,
-                                        &canonical_joined_relation);
+          canonical_joined_relation =
+              &JoinIntoScratchRelation(*existing_literals[i],
+                                       *canonical_predicate_relation_without_new_literal,
+                                       *canonical_joined_relation,
+                                       canonical_databases);
         }
       }
       if (NestedLoopsJoin<true, true>(literal,
-                                      canonical_predicate_relation_without_new_literal,
-                                      &canonical_joined_relation)) {
-        Vector<Vector<int>> canonical_predicate_relation_with_new_literal(
-            canonical_predicate_relation_without_new_literal.begin(),
-            canonical_predicate_relation_without_new_literal.begin() + literal_index);
-        canonical_predicate_relation_with_new_literal.insert(
-            canonical_predicate_relation_with_new_literal.end(),
-            canonical_predicate_relation_without_new_literal.begin() + literal_index + 1,
-            canonical_predicate_relation_without_new_literal.end());
+                                      *canonical_predicate_relation_without_new_literal,
+                                      *canonical_joined_relation,
+                                      nullptr)) {
+        CanonicalRelation* canonical_predicate_relation_with_new_literal =
+            &canonical_databases->predicate_relation_with_new_literal;
+        canonical_predicate_relation_with_new_literal->Reset(literal.num_variables());
+        canonical_predicate_relation_with_new_literal->AppendRows(
+            *canonical_predicate_relation_without_new_literal, 0, literal_index);
+        canonical_predicate_relation_with_new_literal->AppendRows(
+            *canonical_predicate_relation_without_new_literal,
+            literal_index + 1,
+            num_existing_literals);
 
         AddRowToCanonicalRelationForNewLiteral(literal,
                                                clause.num_variables(),
-                                               &canonical_predicate_relation_with_new_literal);
+                                               canonical_predicate_relation_with_new_literal);
 #ifdef ENUMERATOR_VERBOSE
         DVLOG(4) << "Canonical relation with new literal and without existing literal "
-                 << literal_vec_it->second[literal_index]->ToString() << ": "
-                 << VectorOfVectorToString(canonical_predicate_relation_with_new_literal);
+                 << existing_literals[literal_index]->ToString() << ": "
+                 << canonical_predicate_relation_with_new_literal->ToString();
 #endif
 
-        canonical_joined_relation = canonical_db_it->second;
-        for (size_t i = 0; i < literal_vec_it->second.size() - 1; ++i) {
-          NestedLoopsJoin<false, false>(*literal_vec_it->second[i],
-                                        canonical_predicate_relation_with_new_literal,
-                                        &canonical_joined_relation);
+        canonical_joined_relation = canonical_db;
+        for (int i = 0; i < num_existing_literals - 1; ++i) {
+          canonical_joined_relation =
+              &JoinIntoScratchRelation(*existing_literals[i],
+                                       *canonical_predicate_relation_with_new_literal,
+                                       *canonical_joined_relation,
+                                       canonical_databases);
         }
-        if (NestedLoopsJoin<false, true>(*literal_vec_it->second.back(),
-                                         canonical_predicate_relation_with_new_literal,
-                                          &canonical_joined_relation)) {
+        if (NestedLoopsJoin<false, true>(*existing_literals.back(),
+                                         *canonical_predicate_relation_with_new_literal,
+                                         *canonical_joined_relation,
+                                         nullptr)) {
 #ifdef ENUMERATOR_VERBOSE
           DVLOG(3) << "Literal " << literal.ToString() << " is a replaceable duplicate of "
-                   << literal_vec_it->second[literal_index]->ToString() << " in the clause "
+                   << existing_literals[literal_index]->ToString() << " in the clause "
                    << clause.ToString();
 #endif
           return true;
@@ -451,18 +491,20 @@ bool CandidateLiteralEnumerator::CheckReplaceableDuplicate(
   return false;
 }
 
-std::unordered_map<int, Vector<Vector<int>>>::const_iterator
-CandidateLiteralEnumerator::CreateCanonicalDatabase(
+const CanonicalRelation& CandidateLiteralEnumerator::CreateCanonicalDatabase(
     const FoilClause& clause,
     const FoilPredicate& predicate,
-    const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map) {
-  Vector<Vector<int>> canonical_joined_relation;
+    const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
+    CanonicalDatabases* canonical_databases) const {
   const int num_variables = clause.num_variables();
+  CanonicalRelation canonical_joined_relation(num_variables);
+  CanonicalRelation new_canonical_joined_relation(num_variables);
+  CanonicalRelation canonical_predicate_relation;
   bool has_joined_head_literal = false;
 
-  for (const auto map_pair : predicate_to_body_literals_map) {
+  for (const auto& map_pair : predicate_to_body_literals_map) {
     if (map_pair.first != predicate.id()) {
-      Vector<Vector<int>> canonical_predicate_relation;
+      canonical_predicate_relation.Reset(map_pair.second[0]->num_variables());
       for (const FoilLiteral* body_literal : map_pair.second) {
         AddRowToCanonicalRelationForExistingLiteral(
             *body_literal,
@@ -477,122 +519,150 @@ CandidateLiteralEnumerator::CreateCanonicalDatabase(
             &canonical_predicate_relation);
       }
       DCHECK(!canonical_predicate_relation.empty());
+      size_t first_join_literal_index = 0;
       if (canonical_joined_relation.empty()) {
         const FoilLiteral& first_literal = *map_pair.second[0];
-        for (const Vector<int>& row : canonical_predicate_relation) {
-          canonical_joined_relation.emplace_back(num_variables, -1);
-          for (size_t i = 0; i < row.size(); ++i) {
-            canonical_joined_relation.back()[first_literal.variable_at(i).variable_id()] = row[i];
+        for (int row_id = 0; row_id < canonical_predicate_relation.num_rows(); ++row_id) {
+          const int* row = canonical_predicate_relation.row_at(row_id);
+          int* joined_row = canonical_joined_relation.AppendRow(-1);
+          for (int i = 0; i < canonical_predicate_relation.num_columns(); ++i) {
+            joined_row[first_literal.variable_at(i).variable_id()] = row[i];
           }
         }
-        for (size_t i = 1; i < map_pair.second.size(); ++i) {
-          NestedLoopsJoin<false, false>(
-              *map_pair.second[i],
-              canonical_predicate_relation,
-              &canonical_joined_relation);
-        }
-      } else {
-        for (const FoilLiteral* literal : map_pair.second) {
-          NestedLoopsJoin<false, false>(
-              *literal,
-              canonical_predicate_relation,
-              &canonical_joined_relation);
-        }
+        first_join_literal_index = 1;
+      }
+      for (size_t i = first_join_literal_index; i < map_pair.second.size(); ++i) {
+        NestedLoopsJoin<false, false>(
+            *map_pair.second[i],
+            canonical_predicate_relation,
+            canonical_joined_relation,
+            &new_canonical_joined_relation);
+        std::swap(canonical_joined_relation, new_canonical_joined_relation);
       }
     }
   }
 
   if (!has_joined_head_literal) {
     if (canonical_joined_relation.empty()) {
-      canonical_joined_relation.emplace_back(num_variables, -1);
+      int* joined_row = canonical_joined_relation.AppendRow(-1);
       for (int i = 0; i < clause.head_literal().num_variables(); ++i) {
         const int vid = clause.head_literal().variable_at(i).variable_id();
-        canonical_joined_relation.back()[vid] = vid;
+        joined_row[vid] = vid;
       }
     } else {
-      Vector<Vector<int>> canonical_predicate_relation;
+      canonical_predicate_relation.Reset(clause.head_literal().num_variables());
       AddRowToCanonicalRelationForExistingLiteral(
           clause.head_literal(),
           &canonical_predicate_relation);
       NestedLoopsJoin<false, false>(
           clause.head_literal(),
           canonical_predicate_relation,
-          &canonical_joined_relation);
+          canonical_joined_relation,
+          &new_canonical_joined_relation);
+      std::swap(canonical_joined_relation, new_canonical_joined_relation);
     }
   }
 
-  return canonical_databases_.emplace(
+  return canonical_databases->databases.emplace(
       std::piecewise_construct,
       std::forward_as_tuple(predicate.id()),
-      std::forward_as_tuple(std::move(canonical_joined_relation))).first;
+      std::forward_as_tuple(std::move(canonical_joined_relation))).first->second;
 }
 
 template <bool check_bound_variable, bool return_if_any>
 bool CandidateLiteralEnumerator::NestedLoopsJoin(
     const FoilLiteral& literal,
-    const Vector<Vector<int>>& canonical_predicate_rel,
-    Vector<Vector<int>>* canonical_joined_rel) const {
-  Vector<Vector<int>> new_canonical_joined_rel;
-  for (const Vector<int>& predicate_row : canonical_predicate_rel) {
-    for (const Vector<int>& joined_row : *canonical_joined_rel) {
-      size_t i;
-      for (i = 0; i < predicate_row.size(); ++i) {
+    const CanonicalRelation& canonical_predicate_rel,
+    const CanonicalRelation& canonical_joined_rel,
+    CanonicalRelation* output_rel) const {
+  DCHECK(&canonical_joined_rel != output_rel);
+  const int num_arguments = canonical_predicate_rel.num_columns();
+  DCHECK_EQ(num_arguments, literal.num_variables());
+  if (!return_if_any) {
+    output_rel->Reset(canonical_joined_rel.num_columns());
+  }
+  for (int predicate_row_id = 0;
+       predicate_row_id < canonical_predicate_rel.num_rows();
+       ++predicate_row_id) {
+    const int* predicate_row = canonical_predicate_rel.row_at(predicate_row_id);
+    for (int joined_row_id = 0;
+         joined_row_id < canonical_joined_rel.num_rows();
+         ++joined_row_id) {
+      const int* joined_row = canonical_joined_rel.row_at(joined_row_id);
+      int i;
+      for (i = 0; i < num_arguments; ++i) {
         if (check_bound_variable) {
           if (!literal.variable_at(i).IsBound()) {
             continue;
           }
         }
-        if (joined_row[literal.variable_at(i).variable_id()] != -1 &&
-            joined_row[literal.variable_at(i).variable_id()] != predicate_row[i]) {
+        const int column_id = literal.variable_at(i).variable_id();
+        if (joined_row[column_id] != -1 &&
+            joined_row[column_id] != predicate_row[i]) {
           break;
         }
       }
-      if (i == predicate_row.size()) {
+      if (i == num_arguments) {
         if (return_if_any) {
           return true;
         }
 
-        Vector<int> new_row = joined_row;
-        for (i = 0; i < predicate_row.size(); ++i) {
-          if (new_row[literal.variable_at(i).variable_id()] == -1) {
-            new_row[literal.variable_at(i).variable_id()] = predicate_row[i];
+        int* new_row = output_rel->AppendRow(joined_row);
+        for (i = 0; i < num_arguments; ++i) {
+          const int column_id = literal.variable_at(i).variable_id();
+          if (new_row[column_id] == -1) {
+            new_row[column_id] = predicate_row[i];
           }
         }
-        new_canonical_joined_rel.emplace_back(std::move(new_row));
       }
     }
   }
+  if (return_if_any) {
+    return false;
+  }
 #ifdef ENUMERATOR_VERBOSE
   DVLOG(5) << "Literal: " << literal.ToString() << "\n"
-           << "Joined rel: " << VectorOfVectorToString(*canonical_joined_rel) << "\n"
-           << "Predicate rel: " << VectorOfVectorToString(canonical_predicate_rel) << "\n"
-           << "Result: " << VectorOfVectorToString(new_canonical_joined_rel);
+           << "Joined rel: " << canonical_joined_rel.ToString() << "\n"
+           << "Predicate rel: " << canonical_predicate_rel.ToString() << "\n"
+           << "Result: " << output_rel->ToString();
 #endif
-  *canonical_joined_rel = std::move(new_canonical_joined_rel);
-  return !canonical_joined_rel->empty();
+  return !output_rel->empty();
+}
+
+const CanonicalRelation& CandidateLiteralEnumerator::JoinIntoScratchRelation(
+    const FoilLiteral& literal,
+    const CanonicalRelation& canonical_predicate_rel,
+    const CanonicalRelation& canonical_joined_rel,
+    CanonicalDatabases* canonical_databases) const {
+  CanonicalRelation* output_rel =
+      (&canonical_joined_rel == &canonical_databases->joined_relations[0]
+           ? &canonical_databases->joined_relations[1]
+           : &canonical_databases->joined_relations[0]);
+  NestedLoopsJoin<false, false>(literal, canonical_predicate_rel, canonical_joined_rel, output_rel);
+  return *output_rel;
 }
 
 void CandidateLiteralEnumerator::AddRowToCanonicalRelationForExistingLiteral(
     const FoilLiteral& literal,
-    Vector<Vector<int>>* canonical_rel) const {
-  canonical_rel->emplace_back();
-  Vector<int>& row = canonical_rel->back();
+    CanonicalRelation* canonical_rel) const {
+  DCHECK_EQ(literal.num_variables(), canonical_rel->num_columns());
+  int* row = canonical_rel->AppendRow(-1);
   for (const FoilVariable& variable : literal.variables()) {
-      row.emplace_back(variable.variable_id());
+    *row++ = variable.variable_id();
   }
 }
 
 void CandidateLiteralEnumerator::AddRowToCanonicalRelationForNewLiteral(
     const FoilLiteral& literal,
     int new_variable_start_id,
-    Vector<Vector<int>>* canonical_rel) const {
-  canonical_rel->emplace_back();
-  Vector<int>& row = canonical_rel->back();
+    CanonicalRelation* canonical_rel) const {
+  DCHECK_EQ(literal.num_variables(), canonical_rel->num_columns());
+  int* row = canonical_rel->AppendRow(-1);
   for (const FoilVariable& variable : literal.variables()) {
     if (variable.IsBound()) {
-      row.emplace_back(variable.variable_id());
+      *row++ = variable.variable_id();
     } else {
-      row.emplace_back(new_variable_start_id++);
+      *row++ = new_variable_start_id++;
     }
   }
 }
@@ -9,6 +9,7 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "learner/CanonicalRelation.hpp"
 #include "schema/FoilClause.hpp"
 #include "schema/FoilLiteral.hpp"
 #include "schema/FoilVariable.hpp"
@@ -57,6 +58,25 @@ class CandidateLiteralEnumerator {
       std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>* entire_generated_literals,
       std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>* pruned_generated_literals);
 
+  // The canonical databases of a clause and the scratch relations of the
+  // duplicate checks against them. The scratch relations keep their memory
+  // across the checks, so that the joins do not allocate per row or per
+  // candidate literal.
+  struct CanonicalDatabases {
+    // Keyed by the predicate ID: the joined result on the canonical database
+    // of the clause after the literals of the predicate are all removed.
+    std::unordered_map<int, CanonicalRelation> databases;
+
+    CanonicalRelation predicate_relation_without_new_literal;
+    CanonicalRelation predicate_relation_with_new_literal;
+    // The inputs and outputs of a chain of joins, used alternately.
+    CanonicalRelation joined_relations[2];
+  };
+
+  // Generates the candidate literals of <background_predicate> into
+  // <candidate_literals>, and the positions of those that are not pruned
+  // into <pruned_literal_ids>. Only touches <canonical_databases> among the
+  // mutable states, so that the predicates can be processed in parallel.
   template <bool has_key>
   void GenerateAndPruneCandidateLiteralForPredicate(
       const FoilClause& building_clause,
@@ -64,8 +84,9 @@ class CandidateLiteralEnumerator {
       const FoilPredicate* background_predicate,
       const std::unordered_map<int, Vector<FoilVariable>>& variable_type_to_variable_map,
       const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
-      std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>* entire_generated_literals,
-      std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>* pruned_generated_literals);
+      CanonicalDatabases* canonical_databases,
+      Vector<FoilLiteral>* candidate_literals,
+      Vector<int>* pruned_literal_ids) const;
 
   void PruneLiteralsByKey(const FoilPredicate& background_predicate,
                           const Vector<const FoilLiteral*>& body_literals,
@@ -74,7 +95,8 @@ class CandidateLiteralEnumerator {
   bool CheckReplaceableDuplicate(
       const FoilClause& clause,
       const FoilLiteral& literal,
-      const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map);
+      const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
+      CanonicalDatabases* canonical_databases) const;
 
   void GenerateCandidateLiterals(
       int num_arguments_filled,
@@ -94,28 +116,39 @@ class CandidateLiteralEnumerator {
       const Vector<Vector<FoilVariable>>& variables_per_argument,
       Vector<FoilLiteral>* candidate_literals) const;
 
-  std::unordered_map<int, Vector<Vector<int>>>::const_iterator CreateCanonicalDatabase(
+  const CanonicalRelation& CreateCanonicalDatabase(
       const FoilClause& clause,
       const FoilPredicate& predicate,
-      const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map);
+      const std::unordered_map<int, Vector<const FoilLiteral*>>& predicate_to_body_literals_map,
+      CanonicalDatabases* canonical_databases) const;
 
   void AddRowToCanonicalRelationForExistingLiteral(
       const FoilLiteral& literal,
-      Vector<Vector<int>>* canonical_rel) const;
+      CanonicalRelation* canonical_rel) const;
 
   void AddRowToCanonicalRelationForNewLiteral(
       const FoilLiteral& literal,
       int new_variable_start_id,
-      Vector<Vector<int>>* canonical_rel) const;
+      CanonicalRelation* canonical_rel) const;
 
+  // Joins <canonical_joined_rel> with <canonical_predicate_rel> on the
+  // variables of <literal> into <output_rel>. If <return_if_any> is true,
+  // only returns whether the result is non-empty and leaves <output_rel>
+  // (which can be null) untouched.
   template <bool check_bound_variable, bool return_if_any>
   bool NestedLoopsJoin(const FoilLiteral& literal,
-                       const Vector<Vector<int>>& canonical_predicate_rel,
-                       Vector<Vector<int>>* canonical_joined_rel) const;
-
-  // The joined result on the canonical database of the clause after the literals
-  // of one predicate are all removed.
-  std::unordered_map<int, Vector<Vector<int>>> canonical_databases_;  // row-wise.
+                       const CanonicalRelation& canonical_predicate_rel,
+                       const CanonicalRelation& canonical_joined_rel,
+                       CanonicalRelation* output_rel) const;
+
+  // Joins <canonical_joined_rel> with <canonical_predicate_rel> on the
+  // variables of <literal> into the scratch joined relation of
+  // <canonical_databases> that is not <canonical_joined_rel>, and returns it.
+  const CanonicalRelation& JoinIntoScratchRelation(
+      const FoilLiteral& literal,
+      const CanonicalRelation& canonical_predicate_rel,
+      const CanonicalRelation& canonical_joined_rel,
+      CanonicalDatabases* canonical_databases) const;
 
   const Vector<const FoilPredicate*>& background_predicates_;
 
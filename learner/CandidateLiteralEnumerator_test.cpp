@@ -165,8 +165,11 @@ class CandidateLiteralEnumeratorTest : public ::testing::Test {
 
   bool IsReplaceableDuplicateLiteralToClause(const FoilLiteral& literal) {
     VLOG(3) << "Check " << literal.ToString();
-    enumerator_->canonical_databases_.clear();
-    return enumerator_->CheckReplaceableDuplicate(*clause_, literal, predicate_to_body_literals_map_);
+    CandidateLiteralEnumerator::CanonicalDatabases canonical_databases;
+    return enumerator_->CheckReplaceableDuplicate(*clause_,
+                                                  literal,
+                                                  predicate_to_body_literals_map_,
+                                                  &canonical_databases);
   }
 
   static const FoilLiteral* FindDuplicateLiteral(const Vector<FoilLiteral>& literals);
@@ -5,25 +5,35 @@
 
 #include "learner/CandidateLiteralEvaluator.hpp"
 
+#include <cstddef>
 #include <map>
 #include <memory>
+#include <queue>
 #include <sstream>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 
 #include "learner/CandidateLiteralInfo.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
 #include "learner/PredicateEvaluationPlan.hpp"
 #include "learner/QuickFoilTimer.hpp"
+#include "memory/Buffer.hpp"
 #include "operations/BuildHashTable.hpp"
 #include "operations/CountAggregator.hpp"
 #include "operations/Filter.hpp"
 #include "operations/HashJoin.hpp"
 #include "operations/PartitionAssigner.hpp"
+#include "operations/PartitionChunkScheduler.hpp"
 #include "operations/RadixPartition.hpp"
+#include "operations/SemiBitVectorMerger.hpp"
 #include "schema/FoilClause.hpp"
 #include "schema/FoilLiteral.hpp"
 #include "schema/FoilPredicate.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/TableView.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/BitVectorKernels.hpp"
+#include "utility/ThreadPool.hpp"
 #include "utility/Vector.hpp"
 
 #include "glog/logging.h"
@@ -31,75 +41,328 @@
 namespace quickfoil {
 namespace {
 
-  struct PredicateInfo {
-    PredicateInfo(int left_predicate_id_in,
-                  int right_predicate_id_in)
-        : literal(nullptr),
-          left_predicate_id(left_predicate_id_in),
-          right_predicate_id(right_predicate_id_in),
-          reference_count(0) {}
-
-    PredicateInfo(const PredicateTreeNodePtr& plan_node_in)
-        : literal(nullptr),
-          plan_node(plan_node_in),
-          left_predicate_id(-1),
-          right_predicate_id(-1),
-          reference_count(0) {}
-
-    std::unordered_set<int> predicate_atoms;
-    std::unordered_set<int> literal_ids;
-    // The IDs of predicate tree nodes that have no common predicate with this one.
-    std::unordered_set<int> mergeable_nodes;
-    CandidateLiteralInfo* literal;
-    PredicateTreeNodePtr plan_node;
-
-    int left_predicate_id;
-    int right_predicate_id;
-    int reference_count;
-  };
-
-  struct LiteralInfo {
-    std::unordered_set<int> predicate_atoms;
-  };
-
-  inline bool HasNoCommonPredicatesImpl(const std::unordered_set<int>& smaller_set,
-                                        const std::unordered_set<int>& larger_set) {
-    for (const int element : smaller_set) {
-      if (larger_set.find(element) != larger_set.end()) {
-        return false;
+struct PredicateInfo {
+  PredicateInfo(int left_predicate_id_in,
+                int right_predicate_id_in)
+      : literal(nullptr),
+        left_predicate_id(left_predicate_id_in),
+        right_predicate_id(right_predicate_id_in),
+        reference_count(0) {}
+
+  PredicateInfo(const PredicateTreeNodePtr& plan_node_in)
+      : literal(nullptr),
+        plan_node(plan_node_in),
+        left_predicate_id(-1),
+        right_predicate_id(-1),
+        reference_count(0) {}
+
+  // Bitsets on the predicate atom IDs and on the IDs of the remaining
+  // literals (those with at least two predicate atoms) respectively.
+  BitVector predicate_atoms;
+  BitVector literal_ids;
+  CandidateLiteralInfo* literal;
+  PredicateTreeNodePtr plan_node;
+
+  int left_predicate_id;
+  int right_predicate_id;
+  int reference_count;
+};
+
+// A pair of predicate tree nodes with no common predicate atom, and the
+// number of the remaining literals that both of them are part of at the
+// time it is created. The pairs are ordered by the number of the shared
+// literals and then by the node IDs, so that the top of a priority queue
+// is the one with the most shared literals and the smallest node IDs.
+struct MergeCandidate {
+  MergeCandidate(std::size_t num_shared_literals_in,
+                 int first_node_id_in,
+                 int second_node_id_in)
+      : num_shared_literals(num_shared_literals_in),
+        first_node_id(first_node_id_in),
+        second_node_id(second_node_id_in) {}
+
+  bool operator<(const MergeCandidate& other) const {
+    if (num_shared_literals != other.num_shared_literals) {
+      return num_shared_literals < other.num_shared_literals;
+    }
+    if (first_node_id != other.first_node_id) {
+      return first_node_id > other.first_node_id;
+    }
+    return second_node_id > other.second_node_id;
+  }
+
+  std::size_t num_shared_literals;
+  int first_node_id;
+  int second_node_id;
+};
+
+// Pushes the pair of <first_node_id> and <second_node_id> into
+// <merge_candidates> if the two nodes share any remaining literal.
+void AddMergeCandidate(const Vector<PredicateInfo>& predicate_tree_nodes,
+                       int first_node_id,
+                       int second_node_id,
+                       std::priority_queue<MergeCandidate>* merge_candidates) {
+  const std::size_t num_shared_literals =
+      BitVectorKernels::AndCount(predicate_tree_nodes[first_node_id].literal_ids,
+                                 predicate_tree_nodes[second_node_id].literal_ids);
+  if (num_shared_literals > 0) {
+    merge_candidates->emplace(num_shared_literals, first_node_id, second_node_id);
+  }
+}
+
+// Deep-copies <plan_groups>, where every candidate literal referenced by the
+// copy is replaced by its substitute in <literal_substitutions>.
+void ClonePredicateEvaluationPlanGroups(
+    const Vector<Vector<PredicateEvaluationPlan>>& plan_groups,
+    const std::unordered_map<const CandidateLiteralInfo*, CandidateLiteralInfo*>& literal_substitutions,
+    Vector<Vector<PredicateEvaluationPlan>>* plan_group_clones) {
+  for (const Vector<PredicateEvaluationPlan>& plan_group : plan_groups) {
+    plan_group_clones->emplace_back();
+    for (const PredicateEvaluationPlan& plan : plan_group) {
+      std::unique_ptr<PredicateEvaluationPlan> clone(plan.Clone());
+      if (clone->literal != nullptr) {
+        clone->literal = literal_substitutions.at(clone->literal);
+      }
+      for (const PredicateTreeNodePtr& tree_node : clone->tree_nodes) {
+        if (tree_node->literal != nullptr) {
+          tree_node->literal = literal_substitutions.at(tree_node->literal);
+        }
       }
+      plan_group_clones->back().emplace_back(std::move(*clone));
     }
-    return true;
   }
+}
 
-  bool HasNoCommonPredicates(const std::unordered_set<int>& left,
-                             const std::unordered_set<int>& right) {
-    if (left.size() > right.size()) {
-      return HasNoCommonPredicatesImpl(right, left);
+// Sets <num_unseen_positive_bindings>[i] to the number of the positive
+// bindings (the first <num_positive> ones) in the partitions i, i + 1, ...
+// of <binding_table> on the column <column_id>.
+void CountUnseenPositiveBindings(const TableView& binding_table,
+                                 int column_id,
+                                 size_type num_positive,
+                                 Vector<size_type>* num_unseen_positive_bindings) {
+  typedef PartitionAssigner::partition_tuple_type partition_tuple_type;
+  const Vector<ConstBufferPtr>& partitions = binding_table.partitions_at(column_id);
+  num_unseen_positive_bindings->resize(partitions.size() + 1);
+  num_unseen_positive_bindings->back() = 0;
+  for (int partition_id = static_cast<int>(partitions.size()) - 1; partition_id >= 0; --partition_id) {
+    const partition_tuple_type* tuples = partitions[partition_id]->as_type<partition_tuple_type>();
+    const std::size_t num_tuples = partitions[partition_id]->num_tuples();
+    size_type num_positive_tuples = 0;
+    for (std::size_t i = 0; i < num_tuples; ++i) {
+      num_positive_tuples += (tuples[i].tuple_id < num_positive);
     }
-    return HasNoCommonPredicatesImpl(left, right);
+    (*num_unseen_positive_bindings)[partition_id] =
+        (*num_unseen_positive_bindings)[partition_id + 1] + num_positive_tuples;
+  }
+}
+
+// Sets the partitions of <binding_table>, a view on the bindings of <clause>
+// with <label>, and the hash tables on them on the column <column_id>. They
+// are shared from the ones cached with <clause> if any, or built and cached.
+void PartitionBindingTable(const FoilClause& clause,
+                           FoilClause::BindingLabel label,
+                           int column_id,
+                           TableView* binding_table) {
+  const std::shared_ptr<const TableView> cached_table =
+      clause.GetPartitionedBindings(label, column_id);
+  if (cached_table != nullptr) {
+    binding_table->SharePartitionsAt(column_id, *cached_table);
+    return;
   }
 
-  void SetIntersectionImpl(const std::unordered_set<int>& small,
-                           const std::unordered_set<int>& large,
-                           std::unordered_set<int>* result) {
-    for (const int element : small) {
-      if (large.find(element) != large.end()) {
-        result->emplace(element);
+  RadixPartition(column_id,
+                 binding_table);
+  BuildHashTableOnPartitions(column_id,
+                             binding_table);
+  std::shared_ptr<TableView> table_to_cache(binding_table->Clone());
+  table_to_cache->SharePartitionsAt(column_id, *binding_table);
+  clause.CachePartitionedBindings(label, column_id, table_to_cache);
+}
+
+// The literals of an evaluation on one join group.
+struct JoinGroupLiterals {
+  JoinGroupLiterals(int table_id_in,
+                    int join_group_id_in,
+                    Vector<CandidateLiteralInfo*>&& literals_in)
+      : table_id(table_id_in),
+        join_group_id(join_group_id_in),
+        literals(std::move(literals_in)) {}
+
+  int table_id;
+  int join_group_id;
+  Vector<CandidateLiteralInfo*> literals;
+};
+
+// The bindings and the plans of one CandidateLiteralEvaluation. The predicate
+// groups and the plans are indexed by the table and join group IDs shared by
+// all the evaluations that are probed together, and are empty for the join
+// groups on which the evaluation has no literal.
+struct EvaluationState {
+  std::unique_ptr<TableView> binding_table;
+  int clause_join_key_id = 0;
+  size_type num_positive = 0;
+  const CandidateLiteralPruner* pruner = nullptr;
+  Vector<Vector<bool>> has_join_group;
+  Vector<Vector<Vector<FoilFilterPredicate>>> predicate_groups;
+  Vector<Vector<PredicateEvaluationPlan>> plan_groups;
+  Vector<size_type> num_unseen_positive_bindings;
+  // The results created for the literals of the evaluation.
+  Vector<CandidateLiteralInfo*> literals;
+};
+
+// The pipeline counting the literals of one evaluation on the chunks relayed
+// to it.
+struct RelayedPipeline {
+  RelayedPipeline(const EvaluationState* evaluation_in,
+                  const Vector<const TableView*>& background_tables,
+                  SemiBitVectorMerger* merger,
+                  Vector<Vector<PredicateEvaluationPlan>>&& plan_groups)
+      : evaluation(evaluation_in),
+        relay(new PartitionAssigner(background_tables)) {
+    std::unique_ptr<HashJoin> hash_join(
+        new HashJoin(*evaluation->binding_table,
+                     evaluation->clause_join_key_id,
+                     relay));
+    std::unique_ptr<Filter> filter(
+        new Filter(evaluation->predicate_groups,
+                   hash_join.release()));
+    aggregator.reset(new CountAggregator(filter.release(),
+                                         std::move(plan_groups),
+                                         merger));
+  }
+
+  const EvaluationState* evaluation;
+  // Owned by the HashJoin of the aggregator.
+  PartitionAssigner* relay;
+  std::unique_ptr<CountAggregator> aggregator;
+};
+
+// Streams the chunks handed out by <assigner> once. Every chunk is relayed to
+// each of <pipelines> whose evaluation has literals on its join group and has
+// not skipped it, and is counted on the positive bindings only if
+// <positives_only>. A join group skipped by all of them is skipped by
+// <assigner>.
+void ProbeTogether(bool positives_only,
+                   PartitionAssigner* assigner,
+                   Vector<RelayedPipeline>* pipelines) {
+  PartitionChunk chunk;
+  while (assigner->Next(&chunk)) {
+    bool skipped_by_all = true;
+    for (RelayedPipeline& pipeline : *pipelines) {
+      if (!pipeline.evaluation->has_join_group[chunk.table_id][chunk.join_group_id] ||
+          pipeline.relay->IsJoinGroupSkipped(chunk.table_id, chunk.join_group_id)) {
+        continue;
       }
+      pipeline.relay->Relay(chunk);
+      if (positives_only) {
+        pipeline.aggregator->CountOnPositives();
+      } else {
+        pipeline.aggregator->Count(pipeline.evaluation->num_positive);
+      }
+      skipped_by_all = skipped_by_all &&
+                       pipeline.relay->IsJoinGroupSkipped(chunk.table_id, chunk.join_group_id);
+    }
+    if (skipped_by_all) {
+      assigner->SkipJoinGroup(chunk.table_id, chunk.join_group_id);
     }
   }
 
-  void SetIntersection(const std::unordered_set<int>& left,
-                       const std::unordered_set<int>& right,
-                       std::unordered_set<int>* result) {
-    if (left.size() > right.size()) {
-      SetIntersectionImpl(right, left, result);
-      return;
+  for (RelayedPipeline& pipeline : *pipelines) {
+    pipeline.aggregator->Finish();
+  }
+}
+
+// Runs ProbeTogether() on <num_workers> workers of the thread pool. The
+// background chunks are distributed by a PartitionChunkScheduler. Each worker
+// has its own copy of the plans of every evaluation (and thus its own
+// semi-bitvectors) and of the counters of its literals, and what it adds to
+// them is added to the literals at the end. The copies start from the counts
+// of the previous passes, which the pruning relies on. A literal pruned by
+// any worker is pruned. The semi-bitvectors of the partitions shared by
+// several workers are merged by a SemiBitVectorMerger per evaluation.
+void ProbeTogetherInParallel(int num_workers,
+                             bool positives_only,
+                             const Vector<const TableView*>& background_tables,
+                             const Vector<Vector<int>>& literal_join_keys,
+                             Vector<EvaluationState>* evaluations) {
+  DCHECK_GT(num_workers, 1);
+  PartitionChunkScheduler scheduler(background_tables,
+                                    literal_join_keys,
+                                    num_workers);
+  Vector<std::unique_ptr<SemiBitVectorMerger>> mergers;
+  Vector<Vector<RelayedPipeline>> worker_pipelines(num_workers);
+  // Indexed by the evaluation and then by the worker.
+  Vector<Vector<Vector<std::unique_ptr<CandidateLiteralInfo>>>> worker_literals(evaluations->size());
+  Vector<Vector<CandidateLiteralInfo>> initial_literals(evaluations->size());
+  for (std::size_t evaluation_id = 0; evaluation_id < evaluations->size(); ++evaluation_id) {
+    EvaluationState* evaluation = &(*evaluations)[evaluation_id];
+    mergers.emplace_back(new SemiBitVectorMerger(scheduler));
+    for (const CandidateLiteralInfo* literal : evaluation->literals) {
+      initial_literals[evaluation_id].emplace_back(*literal);
     }
-    SetIntersectionImpl(left, right, result);
+
+    worker_literals[evaluation_id].resize(num_workers);
+    for (int worker_id = 1; worker_id < num_workers; ++worker_id) {
+      std::unordered_map<const CandidateLiteralInfo*, CandidateLiteralInfo*> literal_substitutions;
+      for (const CandidateLiteralInfo* literal : evaluation->literals) {
+        worker_literals[evaluation_id][worker_id].emplace_back(new CandidateLiteralInfo(*literal));
+        literal_substitutions.emplace(literal, worker_literals[evaluation_id][worker_id].back().get());
+      }
+
+      Vector<Vector<PredicateEvaluationPlan>> plan_group_clones;
+      ClonePredicateEvaluationPlanGroups(evaluation->plan_groups,
+                                         literal_substitutions,
+                                         &plan_group_clones);
+      worker_pipelines[worker_id].emplace_back(evaluation,
+                                               background_tables,
+                                               mergers.back().get(),
+                                               std::move(plan_group_clones));
+      worker_pipelines[worker_id].back().aggregator->set_pruner(evaluation->pruner);
+    }
+    // The first worker uses the original plans and counters.
+    worker_pipelines[0].emplace_back(evaluation,
+                                     background_tables,
+                                     mergers.back().get(),
+                                     std::move(evaluation->plan_groups));
+    worker_pipelines[0].back().aggregator->set_pruner(evaluation->pruner);
   }
 
+  Vector<std::unique_ptr<PartitionAssigner>> assigners;
+  for (int worker_id = 0; worker_id < num_workers; ++worker_id) {
+    assigners.emplace_back(new PartitionAssigner(&scheduler, worker_id));
+  }
+  ThreadPool::GetInstance()->Run(
+      num_workers,
+      [positives_only, &assigners, &worker_pipelines](int worker_id) {
+        ProbeTogether(positives_only,
+                      assigners[worker_id].get(),
+                      &worker_pipelines[worker_id]);
+      });
+  for (const std::unique_ptr<SemiBitVectorMerger>& merger : mergers) {
+    merger->Finalize();
+  }
+
+  for (std::size_t evaluation_id = 0; evaluation_id < evaluations->size(); ++evaluation_id) {
+    const Vector<CandidateLiteralInfo*>& literals = (*evaluations)[evaluation_id].literals;
+    for (int worker_id = 1; worker_id < num_workers; ++worker_id) {
+      for (std::size_t i = 0; i < literals.size(); ++i) {
+        const CandidateLiteralInfo& initial_literal = initial_literals[evaluation_id][i];
+        const CandidateLiteralInfo& worker_literal = *worker_literals[evaluation_id][worker_id][i];
+        CandidateLiteralInfo* literal = literals[i];
+        literal->num_covered_positive +=
+            worker_literal.num_covered_positive - initial_literal.num_covered_positive;
+        literal->num_covered_negative +=
+            worker_literal.num_covered_negative - initial_literal.num_covered_negative;
+        literal->num_binding_positive +=
+            worker_literal.num_binding_positive - initial_literal.num_binding_positive;
+        literal->num_binding_negative +=
+            worker_literal.num_binding_negative - initial_literal.num_binding_negative;
+        literal->pruned = literal->pruned || worker_literal.pruned;
+      }
+    }
+  }
+}
+
 }  // namespace
 
 void CandidateLiteralEvaluator::GeneratePredicateEvaluationPlan(
@@ -110,11 +373,14 @@ void CandidateLiteralEvaluator::GeneratePredicateEvaluationPlan(
   const int join_key = literals[0]->literal->join_key();
 
   Vector<PredicateInfo> predicate_tree_nodes;
-  Vector<LiteralInfo> literal_info_vec(literals.size());
   std::map<std::pair<int, int>, int> attr_pair_id_map;
-  std::unordered_set<int> remaining_literal_ids;
-  int literal_id = 0;
+  // The predicate atom IDs of the literals with at least two predicate atoms,
+  // which are the ones left to be assigned to the conjunctive nodes.
+  Vector<CandidateLiteralInfo*> remaining_literals;
+  Vector<Vector<int>> remaining_literal_atoms;
+  Vector<int> literal_atoms;
   for (CandidateLiteralInfo* literal : literals) {
+    literal_atoms.clear();
     int vid = 0;
     for (const FoilVariable& variable : literal->literal->variables()) {
       if (variable.IsBound() && vid != join_key) {
@@ -126,108 +392,112 @@ void CandidateLiteralEvaluator::GeneratePredicateEvaluationPlan(
           literal_evaluation_tree->tree_nodes.emplace_back(
               new PredicateTreeNode());
           predicate_tree_nodes.emplace_back(literal_evaluation_tree->tree_nodes.back());
-          predicate_tree_nodes.back().predicate_atoms.emplace(attr_pair_id_map.size());
           predicates->emplace_back(new AttributeReference(predicate_attr_pair.first),
                                    new AttributeReference(predicate_attr_pair.second));
           it = attr_pair_id_map.emplace(std::piecewise_construct,
                                         std::forward_as_tuple(std::move(predicate_attr_pair)),
                                         std::forward_as_tuple(attr_pair_id_map.size())).first;
         }
-
-        predicate_tree_nodes[it->second].literal_ids.emplace(literal_id);
-        literal_info_vec[literal_id].predicate_atoms.emplace(it->second);
+        literal_atoms.emplace_back(it->second);
       }
       ++vid;
     }
-    if (literal_info_vec[literal_id].predicate_atoms.empty()) {
+    if (literal_atoms.empty()) {
       literal_evaluation_tree->literal = literal;
-    } else if (literal_info_vec[literal_id].predicate_atoms.size() == 1u) {
-      const int predicate_id = *literal_info_vec[literal_id].predicate_atoms.begin();
-      literal_evaluation_tree->tree_nodes[predicate_id]->literal = literal;
-      predicate_tree_nodes[predicate_id].literal_ids.erase(literal_id);
+    } else if (literal_atoms.size() == 1u) {
+      literal_evaluation_tree->tree_nodes[literal_atoms[0]]->literal = literal;
     } else {
-      remaining_literal_ids.emplace(literal_id);
+      remaining_literals.emplace_back(literal);
+      remaining_literal_atoms.emplace_back(literal_atoms);
     }
-    ++literal_id;
   }
 
   const int num_predicate_atoms = literal_evaluation_tree->tree_nodes.size();
   literal_evaluation_tree->num_atom_tree_nodes = num_predicate_atoms;
+  const int num_remaining_literals = remaining_literals.size();
+
+  Vector<BitVector> remaining_literal_atom_sets(num_remaining_literals,
+                                                BitVector(num_predicate_atoms));
+  for (int node_id = 0; node_id < num_predicate_atoms; ++node_id) {
+    predicate_tree_nodes[node_id].predicate_atoms.resize(num_predicate_atoms);
+    predicate_tree_nodes[node_id].predicate_atoms.set(node_id);
+    predicate_tree_nodes[node_id].literal_ids.resize(num_remaining_literals);
+  }
+  for (int literal_id = 0; literal_id < num_remaining_literals; ++literal_id) {
+    for (const int atom_id : remaining_literal_atoms[literal_id]) {
+      remaining_literal_atom_sets[literal_id].set(atom_id);
+      predicate_tree_nodes[atom_id].literal_ids.set(literal_id);
+    }
+  }
 
-  for (int node_id = 0; node_id < static_cast<int>(predicate_tree_nodes.size()); ++node_id) {
-    for (int i = 0; i < static_cast<int>(predicate_tree_nodes.size()); ++i) {
-      if (i != node_id) {
-        predicate_tree_nodes[node_id].mergeable_nodes.emplace(i);
+  // Greedily merges the pair of nodes that share the most remaining literals.
+  // The numbers of the shared literals only decrease, so a popped pair whose
+  // number is out of date is pushed back with the new number, and a popped
+  // pair whose number is current has the most shared literals. A pair is
+  // merged at most once.
+  std::priority_queue<MergeCandidate> merge_candidates;
+  if (num_remaining_literals > 0) {
+    for (int first_node_id = 0; first_node_id < num_predicate_atoms - 1; ++first_node_id) {
+      for (int second_node_id = first_node_id + 1;
+           second_node_id < num_predicate_atoms;
+           ++second_node_id) {
+        AddMergeCandidate(predicate_tree_nodes,
+                          first_node_id,
+                          second_node_id,
+                          &merge_candidates);
       }
     }
   }
 
-  while (!remaining_literal_ids.empty()) {
-    int max_intersection_size = 0;
-    int best_first_node_id = -1;
-    int best_second_node_id = -1;
-    for (int first_node_id = 0;
-         first_node_id < static_cast<int>(predicate_tree_nodes.size()) - 1;
-         ++first_node_id) {
-      const std::unordered_set<int>& literal_set =
-          predicate_tree_nodes[first_node_id].literal_ids;
-      for (int second_node_id : predicate_tree_nodes[first_node_id].mergeable_nodes) {
-        int intersection_size = 0;
-        for (int literal_id : predicate_tree_nodes[second_node_id].literal_ids) {
-          if (literal_set.find(literal_id) != literal_set.end()) {
-            ++intersection_size;
-          }
-        }
-        if (intersection_size > max_intersection_size) {
-          best_first_node_id = first_node_id;
-          best_second_node_id = second_node_id;
-          max_intersection_size = intersection_size;
-        }
+  int num_unassigned_literals = num_remaining_literals;
+  while (num_unassigned_literals > 0) {
+    DCHECK(!merge_candidates.empty());
+    const MergeCandidate candidate = merge_candidates.top();
+    merge_candidates.pop();
+    const std::size_t num_shared_literals =
+        BitVectorKernels::AndCount(predicate_tree_nodes[candidate.first_node_id].literal_ids,
+                                   predicate_tree_nodes[candidate.second_node_id].literal_ids);
+    if (num_shared_literals != candidate.num_shared_literals) {
+      if (num_shared_literals > 0) {
+        merge_candidates.emplace(num_shared_literals,
+                                 candidate.first_node_id,
+                                 candidate.second_node_id);
       }
+      continue;
     }
 
-    DCHECK_GT(max_intersection_size, 0);
-    PredicateInfo* left_predicate_info =
-        &predicate_tree_nodes[best_first_node_id];
-    PredicateInfo* right_predicate_info =
-        &predicate_tree_nodes[best_second_node_id];
-    ++left_predicate_info->reference_count;
-    ++right_predicate_info->reference_count;
-
     const int new_node_id = predicate_tree_nodes.size();
-    predicate_tree_nodes.emplace_back(best_first_node_id, best_second_node_id);
-
+    predicate_tree_nodes.emplace_back(candidate.first_node_id, candidate.second_node_id);
     PredicateInfo* predicate_info = &predicate_tree_nodes.back();
-    predicate_info->predicate_atoms = left_predicate_info->predicate_atoms;
-    predicate_info->predicate_atoms.insert(right_predicate_info->predicate_atoms.begin(),
-                                           right_predicate_info->predicate_atoms.end());
-    SetIntersection(left_predicate_info->literal_ids,
-                    right_predicate_info->literal_ids,
-                    &predicate_info->literal_ids);
-
-    for (std::unordered_set<int>::iterator check_literal_id_it = predicate_info->literal_ids.begin();
-        check_literal_id_it != predicate_info->literal_ids.end();) {
-      DCHECK(!(predicate_info->literal != nullptr &&
-          literal_info_vec[*check_literal_id_it].predicate_atoms == predicate_info->predicate_atoms));
-      if (predicate_info->literal == nullptr &&
-          literal_info_vec[*check_literal_id_it].predicate_atoms == predicate_info->predicate_atoms) {
-        predicate_info->literal = literals[*check_literal_id_it];
-        remaining_literal_ids.erase(*check_literal_id_it);
-        for (int i = 0; i < new_node_id; ++i) {
-          predicate_tree_nodes[i].literal_ids.erase(*check_literal_id_it);
+    const PredicateInfo& left_predicate_info = predicate_tree_nodes[candidate.first_node_id];
+    const PredicateInfo& right_predicate_info = predicate_tree_nodes[candidate.second_node_id];
+    predicate_info->predicate_atoms = left_predicate_info.predicate_atoms;
+    predicate_info->predicate_atoms |= right_predicate_info.predicate_atoms;
+    BitVectorKernels::And(left_predicate_info.literal_ids,
+                          right_predicate_info.literal_ids,
+                          &predicate_info->literal_ids);
+    ++predicate_tree_nodes[candidate.first_node_id].reference_count;
+    ++predicate_tree_nodes[candidate.second_node_id].reference_count;
+
+    for (std::size_t literal_id = predicate_info->literal_ids.find_first();
+         literal_id != BitVector::npos;
+         literal_id = predicate_info->literal_ids.find_next(literal_id)) {
+      if (remaining_literal_atom_sets[literal_id] == predicate_info->predicate_atoms) {
+        DCHECK(predicate_info->literal == nullptr);
+        predicate_info->literal = remaining_literals[literal_id];
+        --num_unassigned_literals;
+        for (PredicateInfo& tree_node : predicate_tree_nodes) {
+          tree_node.literal_ids.reset(literal_id);
         }
-        check_literal_id_it = predicate_info->literal_ids.erase(check_literal_id_it);
-      } else {
-        ++check_literal_id_it;
       }
     }
 
     for (int i = 0; i < new_node_id; ++i) {
-      if (i != best_first_node_id &&
-          i != best_second_node_id &&
-          HasNoCommonPredicates(predicate_info->predicate_atoms,
-                                predicate_tree_nodes[i].predicate_atoms)) {
-        predicate_tree_nodes[i].mergeable_nodes.emplace(new_node_id);
+      if (i != candidate.first_node_id &&
+          i != candidate.second_node_id &&
+          !predicate_tree_nodes[i].predicate_atoms.intersects(
+              predicate_tree_nodes[new_node_id].predicate_atoms)) {
+        AddMergeCandidate(predicate_tree_nodes, i, new_node_id, &merge_candidates);
       }
     }
   }
@@ -261,147 +531,152 @@ void CandidateLiteralEvaluator::GeneratePredicateEvaluationPlan(
                                             *literal_evaluation_tree);
 }
 
-void CandidateLiteralEvaluator::Evaluate(
-    int clause_join_key_id,
-    const std::unordered_map<const FoilPredicate*,
-                             Vector<const FoilLiteral*>>& literal_groups,
-    Vector<CandidateLiteralInfo*>* results) {
-
+void CandidateLiteralEvaluator::EvaluateTogether(
+    bool positives_only,
+    const Vector<CandidateLiteralEvaluation>& evaluations) {
+  // The background tables and their join keys are shared by the evaluations,
+  // and the literals of every evaluation are grouped by them.
   Vector<const TableView*> background_tables;
-  Vector<Vector<Vector<FoilFilterPredicate>>> predicate_groups(literal_groups.size());
-  Vector<Vector<PredicateEvaluationPlan>> predicate_plan_groups(literal_groups.size());
-  Vector<Vector<int>> literal_join_keys(literal_groups.size());
-
-  Vector<Vector<Vector<FoilFilterPredicate>>>::iterator predicate_groups_it =
-      predicate_groups.begin();
-  Vector<Vector<PredicateEvaluationPlan>>::iterator predicate_plan_groups_it =
-      predicate_plan_groups.begin();
-  Vector<Vector<int>>::iterator literal_join_keys_it = literal_join_keys.begin();
-
-  for (auto& literal_group : literal_groups) {
-    background_tables.emplace_back(&literal_group.first->fact_table());
-
-    std::unordered_map<int, Vector<CandidateLiteralInfo*>> join_key_to_literals;
-    for (const FoilLiteral* literal : literal_group.second) {
-      results->emplace_back(new CandidateLiteralInfo(literal));
-      join_key_to_literals[literal->join_key()].emplace_back(
-          results->back());
-    }
+  Vector<Vector<int>> literal_join_keys;
+  std::unordered_map<const FoilPredicate*, int> table_ids;
+  Vector<std::unordered_map<int, int>> join_group_ids;
+  Vector<Vector<JoinGroupLiterals>> evaluation_join_groups(evaluations.size());
+  Vector<EvaluationState> states(evaluations.size());
+
+  for (std::size_t evaluation_id = 0; evaluation_id < evaluations.size(); ++evaluation_id) {
+    const CandidateLiteralEvaluation& evaluation = evaluations[evaluation_id];
+    const std::size_t first_result_id = evaluation.results->size();
+    for (const auto& literal_group : *evaluation.literal_groups) {
+      const auto table_it = table_ids.emplace(literal_group.first, background_tables.size());
+      if (table_it.second) {
+        background_tables.emplace_back(&literal_group.first->fact_table());
+        literal_join_keys.emplace_back();
+        join_group_ids.emplace_back();
+      }
+      const int table_id = table_it.first->second;
 
-    for (auto& join_key_and_literals : join_key_to_literals) {
-      const FoilLiteral* candidate_literal =
-          join_key_and_literals.second[0]->literal;
-      const TableView& fact_table =
-          candidate_literal->predicate()->fact_table();
-      if (fact_table.partitions_at(candidate_literal->join_key()).empty()) {
-        RadixPartition(candidate_literal->join_key(),
-                       const_cast<TableView*>(&fact_table));
+      std::unordered_map<int, Vector<CandidateLiteralInfo*>> join_key_to_literals;
+      for (const FoilLiteral* literal : literal_group.second) {
+        evaluation.results->emplace_back(new CandidateLiteralInfo(literal));
+        join_key_to_literals[literal->join_key()].emplace_back(
+            evaluation.results->back());
       }
 
-      literal_join_keys_it->emplace_back(candidate_literal->join_key());
-      predicate_groups_it->emplace_back();
-      predicate_plan_groups_it->emplace_back();
-      START_TIMER(QuickFoilTimer::kGeneratePlans);
-      GeneratePredicateEvaluationPlan(join_key_and_literals.second,
-                                      &predicate_groups_it->back(),
-                                      &predicate_plan_groups_it->back());
-      STOP_TIMER(QuickFoilTimer::kGeneratePlans);
+      for (auto& join_key_and_literals : join_key_to_literals) {
+        const int join_key = join_key_and_literals.first;
+        const auto join_group_it =
+            join_group_ids[table_id].emplace(join_key, literal_join_keys[table_id].size());
+        if (join_group_it.second) {
+          literal_group.first->GetPartitionedFactTable(
+              join_key,
+              [](int column_id, TableView* fact_table) {
+                RadixPartition(column_id, fact_table);
+              });
+          literal_join_keys[table_id].emplace_back(join_key);
+        }
+        evaluation_join_groups[evaluation_id].emplace_back(table_id,
+                                                           join_group_it.first->second,
+                                                           std::move(join_key_and_literals.second));
+      }
     }
-
-    ++predicate_groups_it;
-    ++predicate_plan_groups_it;
-    ++literal_join_keys_it;
+    states[evaluation_id].literals.assign(evaluation.results->begin() + first_result_id,
+                                          evaluation.results->end());
   }
 
-  if (building_clause_->IsBindingDataConseuctive()) {
-    TableView binding_table(building_clause_->integral_blocks());
-    START_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
-    RadixPartition(clause_join_key_id,
-                   &binding_table);
-    BuildHashTableOnPartitions(clause_join_key_id,
-                               &binding_table);
-    STOP_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
-
-    std::unique_ptr<PartitionAssigner> assigner(
-        new PartitionAssigner(std::move(background_tables),
-                              std::move(literal_join_keys)));
-    std::unique_ptr<HashJoin> hash_join(
-        new HashJoin(binding_table,
-                     clause_join_key_id,
-                     assigner.release()));
-    std::unique_ptr<Filter> filter(
-        new Filter(std::move(predicate_groups),
-                   hash_join.release()));
-    std::unique_ptr<CountAggregator> aggregator(
-        new CountAggregator(filter.release(),
-                            std::move(predicate_plan_groups)));
-
-    START_TIMER(QuickFoilTimer::kEvaluateLiterals);
-    aggregator->Execute(building_clause_->GetNumPositiveBindings());
-    STOP_TIMER(QuickFoilTimer::kEvaluateLiterals);
+  if (background_tables.empty()) {
     return;
   }
 
-  {
-    TableView positive_table(std::move(building_clause_->positive_blocks()));
-    START_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
-    RadixPartition(clause_join_key_id,
-                   &positive_table);
-    BuildHashTableOnPartitions(clause_join_key_id,
-                               &positive_table);
-    STOP_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
-
-    std::unique_ptr<PartitionAssigner> assigner(
-        new PartitionAssigner(background_tables,
-                              literal_join_keys));
-    std::unique_ptr<HashJoin> hash_join(
-        new HashJoin(positive_table,
-                     clause_join_key_id,
-                     assigner.release()));
-    std::unique_ptr<Filter> filter(
-        new Filter(predicate_groups,
-                   hash_join.release()));
+  for (std::size_t evaluation_id = 0; evaluation_id < evaluations.size(); ++evaluation_id) {
+    const CandidateLiteralEvaluation& evaluation = evaluations[evaluation_id];
+    const FoilClause& building_clause = *evaluation.evaluator->building_clause_;
+    EvaluationState* state = &states[evaluation_id];
+    for (const Vector<int>& join_keys : literal_join_keys) {
+      state->has_join_group.emplace_back(join_keys.size(), false);
+      state->predicate_groups.emplace_back(join_keys.size());
+      state->plan_groups.emplace_back(join_keys.size());
+    }
+    for (const JoinGroupLiterals& join_group : evaluation_join_groups[evaluation_id]) {
+      state->has_join_group[join_group.table_id][join_group.join_group_id] = true;
+      START_TIMER(QuickFoilTimer::kGeneratePlans);
+      evaluation.evaluator->GeneratePredicateEvaluationPlan(
+          join_group.literals,
+          &state->predicate_groups[join_group.table_id][join_group.join_group_id],
+          &state->plan_groups[join_group.table_id][join_group.join_group_id]);
+      STOP_TIMER(QuickFoilTimer::kGeneratePlans);
+    }
 
-    Vector<Vector<PredicateEvaluationPlan>> predicate_plan_groups_clone;;
-    for (const Vector<PredicateEvaluationPlan>& predicate_plan_group : predicate_plan_groups) {
-      predicate_plan_groups_clone.emplace_back();
-      for (const PredicateEvaluationPlan& predicate_plan : predicate_plan_group) {
-        std::unique_ptr<PredicateEvaluationPlan> clone(predicate_plan.Clone());
-        predicate_plan_groups_clone.back().emplace_back(std::move(*clone));
+    // Only the binding columns referenced by the literals are materialized.
+    Vector<int> used_column_ids;
+    used_column_ids.emplace_back(evaluation.clause_join_key_id);
+    for (const auto& literal_group : *evaluation.literal_groups) {
+      for (const FoilLiteral* literal : literal_group.second) {
+        for (const FoilVariable& variable : literal->variables()) {
+          if (variable.IsBound()) {
+            used_column_ids.emplace_back(variable.variable_id());
+          }
+        }
       }
     }
 
-    std::unique_ptr<CountAggregator> aggregator(
-        new CountAggregator(filter.release(),
-                            std::move(predicate_plan_groups_clone)));
+    state->clause_join_key_id = evaluation.clause_join_key_id;
+    state->num_positive = building_clause.GetNumPositiveBindings();
+    START_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
+    if (positives_only) {
+      state->binding_table.reset(
+          new TableView(building_clause.IsBindingDataConseuctive()
+                            ? building_clause.CreatePositiveBlocks(used_column_ids)
+                            : building_clause.positive_blocks()));
+      PartitionBindingTable(building_clause,
+                            FoilClause::BindingLabel::kPositive,
+                            evaluation.clause_join_key_id,
+                            state->binding_table.get());
+    } else {
+      // The positive and negative bindings are probed in one pass over the
+      // background partitions, where a binding is positive iff its tuple ID
+      // is less than the number of the positive bindings.
+      state->binding_table.reset(
+          new TableView(building_clause.GetBindingBlocks(used_column_ids)));
+      PartitionBindingTable(building_clause,
+                            FoilClause::BindingLabel::kAll,
+                            evaluation.clause_join_key_id,
+                            state->binding_table.get());
+      state->pruner = evaluation.evaluator->pruner_;
+    }
+    STOP_TIMER(QuickFoilTimer::kPartitionAndBuildBindings);
+  }
 
+  const int num_workers = ThreadPool::GetInstance()->num_threads();
+  if (num_workers > 1) {
     START_TIMER(QuickFoilTimer::kEvaluateLiterals);
-    aggregator->ExecuteOnPositives();
+    ProbeTogetherInParallel(num_workers,
+                            positives_only,
+                            background_tables,
+                            literal_join_keys,
+                            &states);
     STOP_TIMER(QuickFoilTimer::kEvaluateLiterals);
+    return;
   }
 
-  TableView negative_table(std::move(building_clause_->negative_blocks()));
-  RadixPartition(clause_join_key_id,
-                 &negative_table);
-  BuildHashTableOnPartitions(clause_join_key_id,
-                             &negative_table);
-
-  std::unique_ptr<PartitionAssigner> assigner(
-      new PartitionAssigner(std::move(background_tables),
-                            std::move(literal_join_keys)));
-  std::unique_ptr<HashJoin> hash_join(
-      new HashJoin(negative_table,
-                   clause_join_key_id,
-                   assigner.release()));
-  std::unique_ptr<Filter> filter(
-      new Filter(std::move(predicate_groups),
-                 hash_join.release()));
-  std::unique_ptr<CountAggregator> aggregator(
-      new CountAggregator(filter.release(),
-                          std::move(predicate_plan_groups)));
+  PartitionAssigner assigner(background_tables, literal_join_keys);
+  Vector<RelayedPipeline> pipelines;
+  for (EvaluationState& state : states) {
+    pipelines.emplace_back(&state,
+                           background_tables,
+                           nullptr,
+                           std::move(state.plan_groups));
+    if (state.pruner != nullptr) {
+      CountUnseenPositiveBindings(*state.binding_table,
+                                  state.clause_join_key_id,
+                                  state.num_positive,
+                                  &state.num_unseen_positive_bindings);
+      pipelines.back().aggregator->set_pruner(state.pruner,
+                                              &state.num_unseen_positive_bindings);
+    }
+  }
 
   START_TIMER(QuickFoilTimer::kEvaluateLiterals);
-  aggregator->ExecuteOnNegatives();
+  ProbeTogether(positives_only, &assigner, &pipelines);
   STOP_TIMER(QuickFoilTimer::kEvaluateLiterals);
 }
 
@@ -17,20 +17,73 @@
 namespace quickfoil {
 
 class CandidateLiteralInfo;
+class CandidateLiteralPruner;
 class FoilLiteral;
 class PredicateEvaluationPlan;
+class CandidateLiteralEvaluator;
+
+// The candidate literals of the building clause of <evaluator> joined on the
+// binding column <clause_join_key_id>, to be evaluated into <results> by
+// CandidateLiteralEvaluator::EvaluateTogether().
+struct CandidateLiteralEvaluation {
+  CandidateLiteralEvaluation(CandidateLiteralEvaluator* evaluator_in,
+                             int clause_join_key_id_in,
+                             const std::unordered_map<const FoilPredicate*,
+                                                      Vector<const FoilLiteral*>>* literal_groups_in,
+                             Vector<CandidateLiteralInfo*>* results_in)
+      : evaluator(evaluator_in),
+        clause_join_key_id(clause_join_key_id_in),
+        literal_groups(literal_groups_in),
+        results(results_in) {}
+
+  CandidateLiteralEvaluator* evaluator;
+  int clause_join_key_id;
+  const std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>* literal_groups;
+  Vector<CandidateLiteralInfo*>* results;
+};
 
 class CandidateLiteralEvaluator {
  public:
   CandidateLiteralEvaluator(const FoilClauseConstSharedPtr& building_clause)
       : building_clause_(building_clause) {}
 
+  // Stops counting the bindings of the literals found hopeless by <pruner>
+  // (not owned), which are marked as pruned in the results. Only Evaluate()
+  // prunes literals. <pruner> may be null to count all the literals.
+  void set_pruner(const CandidateLiteralPruner* pruner) {
+    pruner_ = pruner;
+  }
+
   void Evaluate(int clause_join_key_id,
                 const std::unordered_map<const FoilPredicate*,
                                          Vector<const FoilLiteral*>>& literal_groups,
-                Vector<CandidateLiteralInfo*>* results);
+                Vector<CandidateLiteralInfo*>* results) {
+    EvaluateTogether(false,
+                     {CandidateLiteralEvaluation(this, clause_join_key_id, &literal_groups, results)});
+  }
+
+  // Same as Evaluate(), but only counts on the positive bindings and leaves
+  // the negative counts of the results at zero.
+  void EvaluateOnPositives(int clause_join_key_id,
+                           const std::unordered_map<const FoilPredicate*,
+                                                    Vector<const FoilLiteral*>>& literal_groups,
+                           Vector<CandidateLiteralInfo*>* results) {
+    EvaluateTogether(true,
+                     {CandidateLiteralEvaluation(this, clause_join_key_id, &literal_groups, results)});
+  }
+
+  // Same as Evaluate() (or EvaluateOnPositives() if <positives_only>) on each
+  // of <evaluations>, which may be of different evaluators, but the
+  // background partitions of the literals on the same predicate and join key
+  // are streamed once for all of them: every chunk is probed against the
+  // bindings of each evaluation that has such literals, and counted with the
+  // plans of that evaluation.
+  static void EvaluateTogether(bool positives_only,
+                               const Vector<CandidateLiteralEvaluation>& evaluations);
 
  private:
+  friend class CandidateLiteralEvaluatorTest;
+
   void GeneratePredicateEvaluationPlan(const Vector<CandidateLiteralInfo*>& literals,
                                        Vector<FoilFilterPredicate>* predicates,
                                        PredicateEvaluationPlan* literal_evalution_plan);
@@ -40,6 +93,7 @@ class CandidateLiteralEvaluator {
                                             const PredicateEvaluationPlan& literal_evaluation_plan);
 
   const FoilClauseConstSharedPtr& building_clause_;
+  const CandidateLiteralPruner* pruner_ = nullptr;
 
   DISALLOW_COPY_AND_ASSIGN(CandidateLiteralEvaluator);
 };
@@ -0,0 +1,423 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/CandidateLiteralEvaluator.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "expressions/ComparisonPredicate.hpp"
+#include "learner/CandidateLiteralInfo.hpp"
+#include "learner/PredicateEvaluationPlan.hpp"
+#include "memory/Buffer.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/FoilParser.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "schema/FoilVariable.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/ElementDeleter.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_radix_bits);
+DECLARE_int32(num_threads);
+DECLARE_int32(partition_chunck_size);
+
+class CandidateLiteralEvaluatorTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+  // A (predicate argument, clause variable) pair compared by a predicate atom.
+  typedef std::pair<int, int> Atom;
+
+  // The candidate literals of a clause joined on the clause variable
+  // <clause_join_key_id>.
+  struct ClauseLiterals {
+    ClauseLiterals(const FoilClauseConstSharedPtr& clause_in,
+                   int clause_join_key_id_in,
+                   const Vector<FoilLiteral>& literals_in)
+        : clause(clause_in),
+          clause_join_key_id(clause_join_key_id_in),
+          literals(literals_in) {}
+
+    FoilClauseConstSharedPtr clause;
+    int clause_join_key_id;
+    Vector<FoilLiteral> literals;
+  };
+
+  // The first argument of the predicate is the join key of all the literals,
+  // and each other argument is unbound or bound to one of kNumBoundVariables
+  // clause variables.
+  static constexpr int kNumArguments = 6;
+  static constexpr int kNumBoundVariables = 2;
+
+  CandidateLiteralEvaluatorTest()
+      : predicate_(0,
+                   "p",
+                   0,
+                   Vector<int>(kNumArguments, 0),
+                   Vector<ConstBufferPtr>(kNumArguments)),
+        evaluator_(building_clause_),
+        example_predicate_(CreateDataPredicate(1, "example", {CreateExamples(200, 150)})),
+        pair_predicate_(CreateDataPredicate(2, "pair", CreatePairs())),
+        edge_predicate_(CreateDataPredicate(3, "edge", CreateEdges())),
+        mark_predicate_(CreateDataPredicate(4, "mark", {CreateMarks()})),
+        predicate_catalog_{{"example", example_predicate_.get()},
+                           {"pair", pair_predicate_.get()},
+                           {"edge", edge_predicate_.get()},
+                           {"mark", mark_predicate_.get()}} {
+    // The evaluations run on several workers, which split the partitions of
+    // a few chunks each.
+    FLAGS_num_threads = 4;
+    FLAGS_num_radix_bits = 2;
+    FLAGS_partition_chunck_size = 8;
+  }
+
+  static FoilPredicate* CreateDataPredicate(int id,
+                                            const std::string& name,
+                                            const Vector<Vector<cpp_type>>& columns) {
+    Vector<ConstBufferPtr> blocks;
+    for (const Vector<cpp_type>& values : columns) {
+      BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * values.size(), values.size()));
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        column->mutable_as_type<cpp_type>()[i] = values[i];
+      }
+      blocks.emplace_back(std::make_shared<const ConstBuffer>(column));
+    }
+    return new FoilPredicate(id, name, 0, Vector<int>(columns.size(), 0), std::move(blocks));
+  }
+
+  // The positive examples are [0, <num_positive>), and the negative ones
+  // [1000, 1000 + <num_negative>).
+  static Vector<cpp_type> CreateExamples(cpp_type num_positive, cpp_type num_negative) {
+    Vector<cpp_type> examples;
+    for (cpp_type i = 0; i < num_positive; ++i) {
+      examples.emplace_back(i);
+    }
+    for (cpp_type i = 0; i < num_negative; ++i) {
+      examples.emplace_back(1000 + i);
+    }
+    return examples;
+  }
+
+  // The 120 positive pairs are followed by 90 negative ones.
+  static Vector<Vector<cpp_type>> CreatePairs() {
+    Vector<Vector<cpp_type>> pairs(2);
+    for (cpp_type i = 0; i < 120; ++i) {
+      pairs[0].emplace_back(i);
+      pairs[1].emplace_back(i * 7 % 50);
+    }
+    for (cpp_type i = 0; i < 90; ++i) {
+      pairs[0].emplace_back(1000 + i);
+      pairs[1].emplace_back((i * 3 + 1) % 60);
+    }
+    return pairs;
+  }
+
+  // Every example that is not a multiple of 3 has two edges to [0, 60).
+  static Vector<Vector<cpp_type>> CreateEdges() {
+    Vector<Vector<cpp_type>> edges(2);
+    for (const cpp_type example : CreateExamples(200, 150)) {
+      if (example % 3 != 0) {
+        edges[0].emplace_back(example);
+        edges[1].emplace_back(example * 7 % 50);
+        edges[0].emplace_back(example);
+        edges[1].emplace_back(example % 13 + 47);
+      }
+    }
+    return edges;
+  }
+
+  static Vector<cpp_type> CreateMarks() {
+    Vector<cpp_type> marks;
+    for (cpp_type value = 0; value < 60; value += 4) {
+      marks.emplace_back(value);
+    }
+    return marks;
+  }
+
+  FoilLiteral CreateLiteral(const std::string& literal_string) const {
+    return FoilParser::CreateLiteralFromString(predicate_catalog_, literal_string);
+  }
+
+  Vector<FoilLiteral> CreateLiterals(const Vector<const char*>& literal_strings) const {
+    Vector<FoilLiteral> literals;
+    for (const char* literal_string : literal_strings) {
+      literals.emplace_back(CreateLiteral(literal_string));
+    }
+    return literals;
+  }
+
+  // Counts the bindings of <clause> extended with <literal> with the label
+  // <positive> one binding and fact at a time, and checks the counts of
+  // <result> against them.
+  static void ExpectSameCounts(const FoilClause& clause,
+                               const FoilLiteral& literal,
+                               bool positive,
+                               const CandidateLiteralInfo& result) {
+    const TableView bindings(positive ? clause.CreatePositiveBlocks()
+                                      : clause.CreateNegativeBlocks());
+    const TableView& facts = literal.predicate()->fact_table();
+    const Vector<FoilVariable>& variables = literal.variables();
+    size_type num_covered = 0;
+    size_type num_joined = 0;
+    for (size_type binding_id = 0; binding_id < bindings.num_tuples(); ++binding_id) {
+      size_type num_matches = 0;
+      for (size_type fact_id = 0; fact_id < facts.num_tuples(); ++fact_id) {
+        bool matches = true;
+        for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
+          if (variables[vid].IsBound() &&
+              facts.column_at(vid)->as_type<cpp_type>()[fact_id] !=
+                  bindings.column_at(variables[vid].variable_id())->as_type<cpp_type>()[binding_id]) {
+            matches = false;
+            break;
+          }
+        }
+        num_matches += matches;
+      }
+      num_covered += (num_matches > 0);
+      num_joined += num_matches;
+    }
+    EXPECT_EQ(num_covered, positive ? result.num_covered_positive : result.num_covered_negative)
+        << literal.ToString() << (positive ? " on the positives of " : " on the negatives of ")
+        << clause.ToString();
+    EXPECT_EQ(num_joined, positive ? result.num_binding_positive : result.num_binding_negative)
+        << literal.ToString() << (positive ? " on the positives of " : " on the negatives of ")
+        << clause.ToString();
+  }
+
+  // Evaluates all of <clause_literals> together, and checks the counts of
+  // every literal against counting its bindings one at a time.
+  void CheckEvaluateTogether(bool positives_only, const Vector<ClauseLiterals>& clause_literals) {
+    Vector<std::unique_ptr<CandidateLiteralEvaluator>> evaluators;
+    Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>> literal_groups(
+        clause_literals.size());
+    Vector<Vector<CandidateLiteralInfo*>> results(clause_literals.size());
+    Vector<CandidateLiteralEvaluation> evaluations;
+    for (std::size_t i = 0; i < clause_literals.size(); ++i) {
+      evaluators.emplace_back(new CandidateLiteralEvaluator(clause_literals[i].clause));
+      for (const FoilLiteral& literal : clause_literals[i].literals) {
+        literal_groups[i][literal.predicate()].emplace_back(&literal);
+      }
+      evaluations.emplace_back(evaluators.back().get(),
+                               clause_literals[i].clause_join_key_id,
+                               &literal_groups[i],
+                               &results[i]);
+    }
+    CandidateLiteralEvaluator::EvaluateTogether(positives_only, evaluations);
+
+    for (std::size_t i = 0; i < clause_literals.size(); ++i) {
+      ElementDeleter<CandidateLiteralInfo> results_deleter(&results[i]);
+      ASSERT_EQ(clause_literals[i].literals.size(), results[i].size());
+      for (const CandidateLiteralInfo* result : results[i]) {
+        EXPECT_FALSE(result->pruned);
+        ExpectSameCounts(*clause_literals[i].clause, *result->literal, true, *result);
+        if (positives_only) {
+          EXPECT_EQ(0u, result->num_covered_negative);
+          EXPECT_EQ(0u, result->num_binding_negative);
+        } else {
+          ExpectSameCounts(*clause_literals[i].clause, *result->literal, false, *result);
+        }
+      }
+    }
+  }
+
+  // Returns all the literals whose join key is bound to the variable 0, so
+  // that any two literals share most of their atoms.
+  Vector<FoilLiteral> CreateAllLiterals() const {
+    Vector<FoilLiteral> literals;
+    int num_literals = 1;
+    for (int vid = 1; vid < kNumArguments; ++vid) {
+      num_literals *= kNumBoundVariables + 1;
+    }
+    for (int code = 0; code < num_literals; ++code) {
+      Vector<FoilVariable> variables;
+      variables.emplace_back(0, 0);
+      for (int vid = 1, remaining_code = code; vid < kNumArguments; ++vid) {
+        const int variable_id = remaining_code % (kNumBoundVariables + 1);
+        remaining_code /= kNumBoundVariables + 1;
+        if (variable_id == kNumBoundVariables) {
+          variables.emplace_back(0);
+        } else {
+          variables.emplace_back(variable_id + 1, 0);
+        }
+      }
+      literals.emplace_back(&predicate_, variables);
+    }
+    return literals;
+  }
+
+  // Generates the plan of <literals>, and checks that each literal is
+  // assigned to exactly one node whose conjunction of atoms is the set of
+  // the bound non-join-key arguments of the literal, and that the children
+  // precede their parents in the plan.
+  void CheckPlan(const Vector<const FoilLiteral*>& literals) {
+    Vector<CandidateLiteralInfo> literal_infos;
+    for (const FoilLiteral* literal : literals) {
+      literal_infos.emplace_back(literal);
+    }
+    Vector<CandidateLiteralInfo*> literal_info_ptrs;
+    for (CandidateLiteralInfo& literal_info : literal_infos) {
+      literal_info_ptrs.emplace_back(&literal_info);
+    }
+
+    Vector<FoilFilterPredicate> predicates;
+    PredicateEvaluationPlan plan;
+    evaluator_.GeneratePredicateEvaluationPlan(literal_info_ptrs, &predicates, &plan);
+    ASSERT_EQ(predicates.size(), static_cast<std::size_t>(plan.num_atom_tree_nodes));
+
+    // The atoms of the literal assigned to each node.
+    std::unordered_map<const CandidateLiteralInfo*, Vector<Atom>> assigned_atoms;
+    if (plan.literal != nullptr) {
+      assigned_atoms.emplace(plan.literal, Vector<Atom>());
+    }
+    std::unordered_map<const PredicateTreeNode*, Vector<Atom>> node_atoms;
+    for (std::size_t node_id = 0; node_id < plan.tree_nodes.size(); ++node_id) {
+      const PredicateTreeNode* node = plan.tree_nodes[node_id].get();
+      Vector<Atom> atoms;
+      if (node_id < static_cast<std::size_t>(plan.num_atom_tree_nodes)) {
+        atoms.emplace_back(predicates[node_id].probe_attribute().column_id(),
+                           predicates[node_id].build_attribute().column_id());
+      } else {
+        const ConjunctivePredicateTreeNode* conjunctive_node =
+            dynamic_cast<const ConjunctivePredicateTreeNode*>(node);
+        ASSERT_TRUE(conjunctive_node != nullptr) << node_id;
+        const auto left_it = node_atoms.find(conjunctive_node->left_node.get());
+        const auto right_it = node_atoms.find(conjunctive_node->right_node.get());
+        ASSERT_TRUE(left_it != node_atoms.end()) << node_id;
+        ASSERT_TRUE(right_it != node_atoms.end()) << node_id;
+        atoms = left_it->second;
+        atoms.insert(atoms.end(), right_it->second.begin(), right_it->second.end());
+        std::sort(atoms.begin(), atoms.end());
+        ASSERT_TRUE(std::adjacent_find(atoms.begin(), atoms.end()) == atoms.end())
+            << "The children of the node " << node_id << " share an atom";
+      }
+      if (node->literal != nullptr) {
+        EXPECT_TRUE(assigned_atoms.emplace(node->literal, atoms).second)
+            << node->literal->literal->ToString() << " is assigned twice";
+      }
+      node_atoms.emplace(node, std::move(atoms));
+    }
+
+    EXPECT_EQ(literal_infos.size(), assigned_atoms.size());
+    for (const CandidateLiteralInfo& literal_info : literal_infos) {
+      Vector<Atom> expected_atoms;
+      const Vector<FoilVariable>& variables = literal_info.literal->variables();
+      for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
+        if (variables[vid].IsBound() && vid != literal_info.literal->join_key()) {
+          expected_atoms.emplace_back(vid, variables[vid].variable_id());
+        }
+      }
+      const auto it = assigned_atoms.find(&literal_info);
+      ASSERT_TRUE(it != assigned_atoms.end())
+          << literal_info.literal->ToString() << " is not assigned";
+      EXPECT_TRUE(expected_atoms == it->second) << literal_info.literal->ToString();
+    }
+  }
+
+  const FoilPredicate predicate_;
+  const FoilClauseConstSharedPtr building_clause_;
+  CandidateLiteralEvaluator evaluator_;
+
+  const std::unique_ptr<FoilPredicate> example_predicate_;
+  const std::unique_ptr<FoilPredicate> pair_predicate_;
+  const std::unique_ptr<FoilPredicate> edge_predicate_;
+  const std::unique_ptr<FoilPredicate> mark_predicate_;
+  const std::unordered_map<std::string, const FoilPredicate*> predicate_catalog_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CandidateLiteralEvaluatorTest);
+};
+
+constexpr int CandidateLiteralEvaluatorTest::kNumArguments;
+constexpr int CandidateLiteralEvaluatorTest::kNumBoundVariables;
+
+TEST_F(CandidateLiteralEvaluatorTest, SingleLiteral) {
+  const Vector<FoilLiteral> literals = CreateAllLiterals();
+  for (const FoilLiteral& literal : literals) {
+    CheckPlan({&literal});
+  }
+}
+
+// All the 243 literals of the predicate have many more conjunctive nodes than
+// atoms, so that the nodes are reallocated during the merges.
+TEST_F(CandidateLiteralEvaluatorTest, AllLiterals) {
+  const Vector<FoilLiteral> literals = CreateAllLiterals();
+  Vector<const FoilLiteral*> literal_ptrs;
+  for (const FoilLiteral& literal : literals) {
+    literal_ptrs.emplace_back(&literal);
+  }
+  CheckPlan(literal_ptrs);
+
+  std::reverse(literal_ptrs.begin(), literal_ptrs.end());
+  CheckPlan(literal_ptrs);
+}
+
+TEST_F(CandidateLiteralEvaluatorTest, SampledLiterals) {
+  const Vector<FoilLiteral> literals = CreateAllLiterals();
+  std::mt19937 generator(11);
+  for (const double sample_rate : {0.1, 0.3, 0.7}) {
+    std::bernoulli_distribution is_sampled(sample_rate);
+    for (int round = 0; round < 10; ++round) {
+      Vector<const FoilLiteral*> literal_ptrs;
+      for (const FoilLiteral& literal : literals) {
+        if (is_sampled(generator)) {
+          literal_ptrs.emplace_back(&literal);
+        }
+      }
+      if (!literal_ptrs.empty()) {
+        std::shuffle(literal_ptrs.begin(), literal_ptrs.end(), generator);
+        CheckPlan(literal_ptrs);
+      }
+    }
+  }
+}
+
+// The clauses share the partitions of the edges on either argument and of the
+// marks, while the edges on the first argument are also joined on the second
+// variable of the pairs.
+TEST_F(CandidateLiteralEvaluatorTest, EvaluateTogether) {
+  const FoilClauseConstSharedPtr example_clause =
+      FoilClause::Create(CreateLiteral("example(0)"),
+                         200,
+                         150,
+                         example_predicate_->fact_table().columns());
+  const FoilClauseConstSharedPtr pair_clause =
+      FoilClause::Create(CreateLiteral("pair(0, 1)"),
+                         120,
+                         90,
+                         pair_predicate_->fact_table().columns());
+  const Vector<ClauseLiterals> clause_literals{
+      ClauseLiterals(example_clause, 0, CreateLiterals({"edge(0, -1)", "edge(-1, 0)", "mark(0)"})),
+      ClauseLiterals(example_clause->CreateSample(70, 40, 17),
+                     0,
+                     CreateLiterals({"edge(0, -1)", "mark(0)"})),
+      ClauseLiterals(pair_clause, 0, CreateLiterals({"edge(0, -1)", "edge(0, 1)", "mark(0)"})),
+      ClauseLiterals(pair_clause, 1, CreateLiterals({"edge(-1, 1)", "edge(1, 0)", "mark(1)"}))};
+
+  // Which partitions are split between the workers varies from run to run.
+  for (int round = 0; round < 5; ++round) {
+    CheckEvaluateTogether(false, clause_literals);
+    CheckEvaluateTogether(true, clause_literals);
+  }
+  // One clause alone.
+  CheckEvaluateTogether(false, {clause_literals[2]});
+}
+
+}  // namespace quickfoil
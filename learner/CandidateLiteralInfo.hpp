@@ -23,6 +23,11 @@ struct CandidateLiteralInfo {
   size_type num_covered_negative = 0;
   size_type num_binding_positive = 0;
   size_type num_binding_negative = 0;
+  // True if the evaluation of the literal stopped before all its bindings were
+  // counted, because it cannot make it into the saved literals (see
+  // CandidateLiteralPruner). The counts are then incomplete, except that
+  // num_covered_positive is 0 only if the literal covers no positive binding.
+  bool pruned = false;
 };
 
 }  // namespace quickfoil
@@ -0,0 +1,84 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_LEARNER_CANDIDATE_LITERAL_PRUNER_HPP_
+#define QUICKFOIL_LEARNER_CANDIDATE_LITERAL_PRUNER_HPP_
+
+#include <algorithm>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "learner/LiteralScorer.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/TypeDefs.hpp"
+#include "utility/Macros.hpp"
+
+namespace quickfoil {
+
+// Decides from the partial counts of a candidate literal whether the literal
+// can still score at least <min_score> once all its bindings are counted.
+//
+// The negative counts only grow during the evaluation, so the partial ones are
+// lower bounds. The positive counts are bounded from above by the partial ones
+// plus the number of the positive bindings that are not seen yet. The score
+// never increases with the negative counts and never decreases with the
+// positive counts, so evaluating it on these bounds gives an upper bound.
+class CandidateLiteralPruner {
+ public:
+  // If <prune_unbound_literals> is false, the literals with new variables are
+  // never pruned, e.g. because they may be chosen as random literals
+  // regardless of their scores.
+  CandidateLiteralPruner(const LiteralScorer& scorer,
+                         double min_score,
+                         bool prune_unbound_literals)
+      : scorer_(scorer),
+        min_score_(min_score),
+        prune_unbound_literals_(prune_unbound_literals) {}
+
+  double min_score() const {
+    return min_score_;
+  }
+
+  // Returns true if <literal_info> cannot reach the minimum score, given that
+  // at most <num_unseen_positive_bindings> positive bindings of the clause are
+  // not counted yet.
+  bool IsHopeless(const CandidateLiteralInfo& literal_info,
+                  size_type num_unseen_positive_bindings) const {
+    if (!prune_unbound_literals_ && !literal_info.literal->IsBound()) {
+      return false;
+    }
+    // Keeps the literals covering no positive binding so far, so that a
+    // pruned literal with no covered positive binding covers none at all.
+    if (num_unseen_positive_bindings > 0 && literal_info.num_covered_positive == 0) {
+      return false;
+    }
+
+    const size_type max_num_covered_positive =
+        std::min(scorer_.num_positive_bindings(),
+                 literal_info.num_covered_positive + num_unseen_positive_bindings);
+    const double mcc = 1 + scorer_.ComputeMccScore(max_num_covered_positive,
+                                                   literal_info.num_covered_negative);
+    // The number of the positive bindings is unbounded if any positive
+    // binding is not seen yet.
+    const double auec = 1 + (num_unseen_positive_bindings > 0
+                                 ? scorer_.ComputeMaximumEntropyScore()
+                                 : scorer_.ComputeEntropyScore(literal_info.num_binding_positive,
+                                                               literal_info.num_binding_negative));
+    const double max_score =
+        (mcc > 0 && auec > 0 ? LiteralScorer::CombineScores(mcc, auec) : 0);
+    // The same tolerance as the ties of the best literals in LiteralSelector.
+    return max_score < min_score_ - 0.00001;
+  }
+
+ private:
+  const LiteralScorer scorer_;
+  const double min_score_;
+  const bool prune_unbound_literals_;
+
+  DISALLOW_COPY_AND_ASSIGN(CandidateLiteralPruner);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_LEARNER_CANDIDATE_LITERAL_PRUNER_HPP_ */
@@ -0,0 +1,106 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_LEARNER_CANONICAL_RELATION_HPP_
+#define QUICKFOIL_LEARNER_CANONICAL_RELATION_HPP_
+
+#include <sstream>
+#include <string>
+
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+// A relation of the canonical database of a clause, whose cells are variable
+// IDs (or -1 for no value). The rows have a fixed number of columns and are
+// stored contiguously in one buffer, which keeps its capacity when the
+// relation is cleared, so that a relation reused as a scratch buffer stops
+// allocating once it has grown to the largest size.
+class CanonicalRelation {
+ public:
+  explicit CanonicalRelation(int num_columns = 0)
+      : num_columns_(num_columns) {}
+
+  CanonicalRelation(CanonicalRelation&& other) = default;
+
+  CanonicalRelation& operator=(CanonicalRelation&& other) = default;
+
+  // Removes all the rows and sets the number of columns.
+  void Reset(int num_columns) {
+    num_columns_ = num_columns;
+    cells_.clear();
+  }
+
+  int num_columns() const {
+    return num_columns_;
+  }
+
+  int num_rows() const {
+    return num_columns_ == 0 ? 0 : cells_.size() / num_columns_;
+  }
+
+  bool empty() const {
+    return cells_.empty();
+  }
+
+  const int* row_at(int row_id) const {
+    DCHECK_LT(row_id, num_rows());
+    return cells_.data() + row_id * num_columns_;
+  }
+
+  // Appends a row with all the cells set to <value>, and returns it.
+  int* AppendRow(int value) {
+    cells_.resize(cells_.size() + num_columns_, value);
+    return cells_.data() + cells_.size() - num_columns_;
+  }
+
+  // Appends a copy of <row>, and returns the new row.
+  int* AppendRow(const int* row) {
+    cells_.insert(cells_.end(), row, row + num_columns_);
+    return cells_.data() + cells_.size() - num_columns_;
+  }
+
+  // Appends the rows <begin_row_id> to <end_row_id> - 1 of <other>, which has
+  // the same number of columns.
+  void AppendRows(const CanonicalRelation& other, int begin_row_id, int end_row_id) {
+    DCHECK_EQ(num_columns_, other.num_columns_);
+    cells_.insert(cells_.end(),
+                  other.cells_.begin() + begin_row_id * num_columns_,
+                  other.cells_.begin() + end_row_id * num_columns_);
+  }
+
+  std::string ToString() const {
+    std::ostringstream out;
+    out << "[";
+    for (int row_id = 0; row_id < num_rows(); ++row_id) {
+      if (row_id > 0) {
+        out << "; ";
+      }
+      out << "(";
+      for (int column_id = 0; column_id < num_columns_; ++column_id) {
+        if (column_id > 0) {
+          out << ", ";
+        }
+        out << row_at(row_id)[column_id];
+      }
+      out << ")";
+    }
+    out << "]";
+    return out.str();
+  }
+
+ private:
+  int num_columns_;
+  Vector<int> cells_;
+
+  DISALLOW_COPY_AND_ASSIGN(CanonicalRelation);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_LEARNER_CANONICAL_RELATION_HPP_ */
@@ -0,0 +1,99 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/LiteralCoverage.hpp"
+
+#include <memory>
+
+#include "expressions/AttributeReference.hpp"
+#include "operations/SemiJoin.hpp"
+#include "operations/SemiJoinFactory.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "schema/FoilVariable.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/FoilHashTable.hpp"
+#include "storage/TableView.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+size_type ComputeLiteralCoverage(const FoilClause& clause,
+                                 const FoilLiteral& literal,
+                                 bool positive,
+                                 size_type num_origin_tuples,
+                                 std::shared_ptr<const FoilHashTable>* background_hash_table,
+                                 BitVector* covered_tuples) {
+  Vector<AttributeReference> background_join_keys;
+  Vector<AttributeReference> clause_join_keys;
+  Vector<int> clause_join_column_ids;
+  const Vector<FoilVariable>& variables = literal.variables();
+  for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
+    if (variables[vid].IsBound()) {
+      background_join_keys.emplace_back(vid);
+      clause_join_keys.emplace_back(variables[vid].variable_id());
+      clause_join_column_ids.emplace_back(variables[vid].variable_id());
+    }
+  }
+
+  // Only the join keys are needed, since the bindings are mapped to the
+  // covered tuples through their origin row IDs instead of their head values.
+  std::unique_ptr<TableView> binding_table;
+  if (clause.IsBindingDataConseuctive()) {
+    binding_table.reset(new TableView(positive ? clause.CreatePositiveBlocks(clause_join_column_ids)
+                                               : clause.CreateNegativeBlocks(clause_join_column_ids)));
+  } else {
+    binding_table.reset(new TableView(positive ? clause.positive_blocks()
+                                               : clause.negative_blocks()));
+  }
+
+  const FoilClause::BindingLabel label =
+      (positive ? FoilClause::BindingLabel::kPositive : FoilClause::BindingLabel::kNegative);
+  std::shared_ptr<const FoilHashTable> binding_hash_table =
+      clause.GetBindingHashTable(label, clause_join_column_ids);
+  std::unique_ptr<SemiJoin> binding_semijoin(
+      SelectAndCreateSemiJoin(*binding_table,
+                              literal.predicate()->fact_table(),
+                              &binding_hash_table,
+                              background_hash_table,
+                              clause_join_keys,
+                              background_join_keys,
+                              Vector<int>()));
+  if (binding_hash_table != nullptr) {
+    clause.CacheBindingHashTable(label, clause_join_column_ids, binding_hash_table);
+  }
+
+  const size_type* origin_row_ids = nullptr;
+  if (clause.origin_row_ids() != nullptr) {
+    origin_row_ids = clause.origin_row_ids()->as_type<size_type>() +
+        (positive ? 0 : clause.GetNumPositiveBindings());
+  }
+
+  covered_tuples->resize(num_origin_tuples);
+  covered_tuples->reset();
+  // The chunks are on the consecutive bindings in order.
+  size_type chunk_offset = 0;
+  SemiJoinChunk chunk;
+  while (binding_semijoin->Next(&chunk)) {
+    if (chunk.num_ones > 0) {
+      for (BitVector::size_type i = chunk.semi_bitvector.find_first();
+           i != BitVector::npos;
+           i = chunk.semi_bitvector.find_next(i)) {
+        const size_type binding_id = chunk_offset + static_cast<size_type>(i);
+        covered_tuples->set(origin_row_ids == nullptr ? binding_id : origin_row_ids[binding_id]);
+      }
+    }
+    chunk_offset += chunk.semi_bitvector.size();
+  }
+  DCHECK_EQ(binding_table->num_tuples(), chunk_offset);
+
+  return covered_tuples->count();
+}
+
+}  // namespace quickfoil
@@ -0,0 +1,41 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_LEARNER_LITERAL_COVERAGE_HPP_
+#define QUICKFOIL_LEARNER_LITERAL_COVERAGE_HPP_
+
+#include <memory>
+
+#include "schema/TypeDefs.hpp"
+#include "utility/BitVector.hpp"
+
+namespace quickfoil {
+
+class FoilClause;
+class FoilHashTable;
+class FoilLiteral;
+
+// Computes the coverage of the clause <clause> extended with <literal> on the
+// tuples that the positive (or negative if <positive> is false) bindings of
+// <clause> originate from (see FoilClause::origin_row_ids()), i.e. on the
+// examples that the clause without body literals is created from. A tuple is
+// covered iff any of its bindings satisfies <literal>.
+//
+// Resizes <covered_tuples> to <num_origin_tuples>, the number of the tuples,
+// and sets the bits of the covered ones. Returns the number of the covered
+// tuples.
+// <background_hash_table> is the hash table on the fact table of <literal> on
+// its bound arguments, which is built if it is null and may then be reused for
+// the other label.
+size_type ComputeLiteralCoverage(const FoilClause& clause,
+                                 const FoilLiteral& literal,
+                                 bool positive,
+                                 size_type num_origin_tuples,
+                                 std::shared_ptr<const FoilHashTable>* background_hash_table,
+                                 BitVector* covered_tuples);
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_LEARNER_LITERAL_COVERAGE_HPP_ */
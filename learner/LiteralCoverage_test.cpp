@@ -0,0 +1,280 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/LiteralCoverage.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "expressions/AttributeReference.hpp"
+#include "memory/Buffer.hpp"
+#include "operations/BuildHashTable.hpp"
+#include "operations/SemiJoin.hpp"
+#include "operations/SemiJoinFactory.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/FoilParser.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "schema/FoilVariable.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/FoilHashTable.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class LiteralCoverageTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+  // The positive examples are [0, kNumPositive), and the negative ones
+  // [kFirstNegative, kFirstNegative + kNumNegative).
+  static constexpr size_type kNumPositive = 200;
+  static constexpr cpp_type kFirstNegative = 1000;
+  static constexpr size_type kNumNegative = 150;
+
+  LiteralCoverageTest()
+      : target_predicate_(CreatePredicate(0, "target", {CreateExamples()})),
+        edge_predicate_(CreatePredicate(1, "edge", CreateEdges())),
+        mark_predicate_(CreatePredicate(2, "mark", {CreateMarks()})),
+        predicate_catalog_{{"target", target_predicate_.get()},
+                           {"edge", edge_predicate_.get()},
+                           {"mark", mark_predicate_.get()}},
+        clause_(FoilClause::Create(CreateLiteral("target(0)"),
+                                   kNumPositive,
+                                   kNumNegative,
+                                   target_predicate_->fact_table().columns())) {}
+
+  static ConstBufferPtr CreateColumn(const Vector<cpp_type>& values) {
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * values.size(), values.size()));
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      column->mutable_as_type<cpp_type>()[i] = values[i];
+    }
+    return std::make_shared<const ConstBuffer>(column);
+  }
+
+  static FoilPredicate* CreatePredicate(int id,
+                                        const std::string& name,
+                                        const Vector<Vector<cpp_type>>& columns) {
+    Vector<ConstBufferPtr> blocks;
+    for (const Vector<cpp_type>& values : columns) {
+      blocks.emplace_back(CreateColumn(values));
+    }
+    return new FoilPredicate(id, name, 0, Vector<int>(columns.size(), 0), std::move(blocks));
+  }
+
+  static Vector<cpp_type> CreateExamples() {
+    Vector<cpp_type> examples;
+    for (size_type i = 0; i < kNumPositive; ++i) {
+      examples.emplace_back(i);
+    }
+    for (size_type i = 0; i < kNumNegative; ++i) {
+      examples.emplace_back(kFirstNegative + i);
+    }
+    return examples;
+  }
+
+  // Every example that is not a multiple of 3 has two edges to [0, 60), and
+  // the others have none.
+  static Vector<Vector<cpp_type>> CreateEdges() {
+    Vector<Vector<cpp_type>> edges(2);
+    for (const cpp_type example : CreateExamples()) {
+      if (example % 3 != 0) {
+        edges[0].emplace_back(example);
+        edges[1].emplace_back(example * 7 % 50);
+        edges[0].emplace_back(example);
+        edges[1].emplace_back(example % 13 + 47);
+      }
+    }
+    return edges;
+  }
+
+  static Vector<cpp_type> CreateMarks() {
+    Vector<cpp_type> marks;
+    for (cpp_type value = 0; value < 60; value += 4) {
+      marks.emplace_back(value);
+    }
+    return marks;
+  }
+
+  FoilLiteral CreateLiteral(const std::string& literal_string) const {
+    return FoilParser::CreateLiteralFromString(predicate_catalog_, literal_string);
+  }
+
+  // Returns <clause_> extended with the unbound literal "edge(0, -1)", whose
+  // bindings are joined with the edges.
+  FoilClauseConstSharedPtr ExtendWithEdges() const {
+    const TableView& edges = edge_predicate_->fact_table();
+    const cpp_type* sources = edges.column_at(0)->as_type<cpp_type>();
+    const cpp_type* destinations = edges.column_at(1)->as_type<cpp_type>();
+    const cpp_type* examples = clause_->integral_block_at(0)->as_type<cpp_type>();
+
+    Vector<size_type> row_ids;
+    Vector<cpp_type> new_values;
+    size_type num_positive_bindings = 0;
+    for (size_type i = 0; i < kNumPositive + kNumNegative; ++i) {
+      for (size_type edge_id = 0; edge_id < edges.num_tuples(); ++edge_id) {
+        if (sources[edge_id] == examples[i]) {
+          row_ids.emplace_back(i < kNumPositive ? i : i - kNumPositive);
+          new_values.emplace_back(destinations[edge_id]);
+          if (i < kNumPositive) {
+            ++num_positive_bindings;
+          }
+        }
+      }
+    }
+    BufferPtr row_id_buffer(std::make_shared<Buffer>(sizeof(size_type) * row_ids.size(),
+                                                     row_ids.size()));
+    for (std::size_t i = 0; i < row_ids.size(); ++i) {
+      row_id_buffer->mutable_as_type<size_type>()[i] = row_ids[i];
+    }
+    Vector<ConstBufferPtr> new_binding_blocks;
+    new_binding_blocks.emplace_back(CreateColumn(new_values));
+    return clause_->CopyWithAdditionalUnBoundBodyLiteral(
+        CreateLiteral("edge(0, -1)"),
+        false,
+        num_positive_bindings,
+        row_ids.size() - num_positive_bindings,
+        std::make_shared<const ConstBuffer>(row_id_buffer),
+        std::move(new_binding_blocks));
+  }
+
+  // Finds the examples with the label <positive> that the bindings of
+  // <clause> extended with <literal> cover, by joining the bindings with the
+  // facts of <literal> and then the examples with the heads of the joined
+  // bindings. Sets the bits of the covered examples in <covered_examples>, and
+  // returns their number.
+  size_type FindCoveredExamplesByJoins(const FoilClause& clause,
+                                       const FoilLiteral& literal,
+                                       bool positive,
+                                       BitVector* covered_examples) const {
+    Vector<AttributeReference> background_join_keys;
+    Vector<AttributeReference> clause_join_keys;
+    const Vector<FoilVariable>& variables = literal.variables();
+    for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
+      if (variables[vid].IsBound()) {
+        background_join_keys.emplace_back(vid);
+        clause_join_keys.emplace_back(variables[vid].variable_id());
+      }
+    }
+    const Vector<int> project_column_ids{0};
+    const Vector<AttributeReference> coverage_join_keys{AttributeReference(0)};
+
+    const TableView binding_table(positive ? clause.CreatePositiveBlocks()
+                                           : clause.CreateNegativeBlocks());
+    std::shared_ptr<const FoilHashTable> binding_hash_table;
+    std::shared_ptr<const FoilHashTable> background_hash_table;
+    std::unique_ptr<SemiJoin> binding_semijoin(
+        SelectAndCreateSemiJoin(binding_table,
+                                literal.predicate()->fact_table(),
+                                &binding_hash_table,
+                                &background_hash_table,
+                                clause_join_keys,
+                                background_join_keys,
+                                project_column_ids));
+    const std::unique_ptr<FoilHashTable> coverage_hash_table(
+        BuildHashTableAfterSemiJoin(binding_table.num_tuples(),
+                                    1,
+                                    binding_semijoin.release()));
+
+    const TableView& all_examples = target_predicate_->fact_table();
+    const size_type offset = positive ? 0 : kNumPositive;
+    const TableView example_table(
+        {std::make_shared<const ConstBuffer>(all_examples.column_at(0),
+                                             all_examples.column_at(0)->as_type<cpp_type>() + offset,
+                                             positive ? kNumPositive : kNumNegative)});
+    std::unique_ptr<SemiJoin> coverage_semijoin(
+        CreateSemiJoin(true,
+                       example_table,
+                       binding_table,
+                       *coverage_hash_table,
+                       coverage_join_keys,
+                       coverage_join_keys,
+                       project_column_ids));
+    covered_examples->resize(example_table.num_tuples());
+    covered_examples->reset();
+    size_type num_covered_examples = 0;
+    size_type chunk_offset = 0;
+    SemiJoinChunk coverage_result;
+    while (coverage_semijoin->Next(&coverage_result)) {
+      for (BitVector::size_type i = coverage_result.semi_bitvector.find_first();
+           i != BitVector::npos;
+           i = coverage_result.semi_bitvector.find_next(i)) {
+        covered_examples->set(chunk_offset + i);
+      }
+      num_covered_examples += coverage_result.num_ones;
+      chunk_offset += coverage_result.semi_bitvector.size();
+    }
+    return num_covered_examples;
+  }
+
+  // Checks that ComputeLiteralCoverage() covers the same examples of both
+  // labels as the joins, and returns the number of the covered examples.
+  size_type ExpectSameCoverage(const FoilClause& clause, const std::string& literal_string) const {
+    const FoilLiteral literal = CreateLiteral(literal_string);
+    std::shared_ptr<const FoilHashTable> background_hash_table;
+    size_type num_covered_examples = 0;
+    for (const bool positive : {true, false}) {
+      const size_type num_origin_tuples = positive ? kNumPositive : kNumNegative;
+      BitVector covered_tuples;
+      const size_type num_covered_tuples = ComputeLiteralCoverage(clause,
+                                                                  literal,
+                                                                  positive,
+                                                                  num_origin_tuples,
+                                                                  &background_hash_table,
+                                                                  &covered_tuples);
+      BitVector covered_examples;
+      EXPECT_EQ(FindCoveredExamplesByJoins(clause, literal, positive, &covered_examples),
+                num_covered_tuples)
+          << literal_string << (positive ? " on the positives" : " on the negatives");
+      EXPECT_TRUE(covered_examples == covered_tuples)
+          << literal_string << (positive ? " on the positives" : " on the negatives");
+      num_covered_examples += num_covered_tuples;
+    }
+    return num_covered_examples;
+  }
+
+  const std::unique_ptr<FoilPredicate> target_predicate_;
+  const std::unique_ptr<FoilPredicate> edge_predicate_;
+  const std::unique_ptr<FoilPredicate> mark_predicate_;
+  const std::unordered_map<std::string, const FoilPredicate*> predicate_catalog_;
+  const FoilClauseConstSharedPtr clause_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LiteralCoverageTest);
+};
+
+constexpr size_type LiteralCoverageTest::kNumPositive;
+constexpr LiteralCoverageTest::cpp_type LiteralCoverageTest::kFirstNegative;
+constexpr size_type LiteralCoverageTest::kNumNegative;
+
+TEST_F(LiteralCoverageTest, SampledClause) {
+  const FoilClauseConstSharedPtr sample = clause_->CreateSample(70, 40, 17);
+  ASSERT_EQ(70u, sample->GetNumPositiveBindings());
+  ASSERT_EQ(40u, sample->GetNumNegativeBindings());
+  EXPECT_LT(0u, ExpectSameCoverage(*sample, "edge(0, -1)"));
+  EXPECT_LT(0u, ExpectSameCoverage(*sample, "mark(0)"));
+}
+
+TEST_F(LiteralCoverageTest, ExtendedClause) {
+  const FoilClauseConstSharedPtr extended_clause = ExtendWithEdges();
+  EXPECT_LT(0u, ExpectSameCoverage(*extended_clause, "mark(1)"));
+  EXPECT_LT(0u, ExpectSameCoverage(*extended_clause, "edge(1, -1)"));
+
+  // A sample of the extended clause maps its bindings to the examples through
+  // the composed origin row IDs.
+  const FoilClauseConstSharedPtr sample = extended_clause->CreateSample(90, 60, 5);
+  EXPECT_LT(0u, ExpectSameCoverage(*sample, "mark(1)"));
+}
+
+}  // namespace quickfoil
@@ -0,0 +1,108 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_LEARNER_LITERAL_SCORER_HPP_
+#define QUICKFOIL_LEARNER_LITERAL_SCORER_HPP_
+
+#include <cmath>
+
+#include "schema/FoilClause.hpp"
+#include "schema/TypeDefs.hpp"
+
+namespace quickfoil {
+
+// Computes the scores of the candidate literals of a building clause. The
+// score of a literal combines the MCC of the bindings it covers and the gain
+// of the area under the entropy curve (AUEC) of its bindings.
+class LiteralScorer {
+ public:
+  explicit LiteralScorer(const FoilClause& clause)
+      : num_positive_bindings_(clause.GetNumPositiveBindings()),
+        num_negative_bindings_(clause.GetNumNegativeBindings()),
+        clause_entropy_area_(ComputeAreaUnderEntropyCurve(num_positive_bindings_,
+                                                          num_negative_bindings_)) {}
+
+  size_type num_positive_bindings() const {
+    return num_positive_bindings_;
+  }
+
+  // Returns the MCC of the bindings covered by a literal. Never decreases with
+  // <num_covered_positive> and never increases with <num_covered_negative>.
+  double ComputeMccScore(size_type num_covered_positive, size_type num_covered_negative) const {
+    if (num_covered_positive == 0) {
+      // This deviates from the actual MCC.
+      return -1;
+    }
+    if (num_covered_positive == num_positive_bindings_ &&
+        num_covered_negative == num_negative_bindings_) {
+      return 0;
+    }
+
+    const double true_negatives = num_negative_bindings_ - num_covered_negative;
+    const double false_negatives = num_positive_bindings_ - num_covered_positive;
+    const double num_total_covered = num_covered_positive + num_covered_negative;
+
+    return (num_covered_positive * true_negatives -
+        num_covered_negative * false_negatives) /
+        std::sqrt(num_total_covered *
+         (num_positive_bindings_ + num_negative_bindings_ - num_total_covered) *
+         num_negative_bindings_ *
+         num_positive_bindings_);
+  }
+
+  // Returns the gain of the AUEC of the bindings of a literal over that of the
+  // clause. Increases with the precision of the bindings.
+  double ComputeEntropyScore(size_type num_positive_bindings,
+                             size_type num_negative_bindings) const {
+    return ComputeAreaUnderEntropyCurve(num_positive_bindings, num_negative_bindings) -
+        clause_entropy_area_;
+  }
+
+  // Returns the largest possible value of ComputeEntropyScore().
+  double ComputeMaximumEntropyScore() const {
+    return 1 - clause_entropy_area_;
+  }
+
+  // Returns the score of a literal with the given counts, or 0 if the literal
+  // is never selected (see LiteralSelector::Insert()).
+  double ComputeScore(size_type num_covered_positive,
+                      size_type num_covered_negative,
+                      size_type num_binding_positive,
+                      size_type num_binding_negative) const {
+    const double mcc = 1 + ComputeMccScore(num_covered_positive, num_covered_negative);
+    const double auec = 1 + ComputeEntropyScore(num_binding_positive, num_binding_negative);
+    return (mcc > 0 && auec > 0 ? CombineScores(mcc, auec) : 0);
+  }
+
+  // Combines 1 + the MCC score and 1 + the entropy score, both of which must
+  // be positive. Increases with both of them.
+  static double CombineScores(double mcc, double auec) {
+    return 5 * auec * mcc / (mcc + 4 * auec);
+  }
+
+  static double ComputeAreaUnderEntropyCurve(size_type num_positive_bindings,
+                                             size_type num_negative_bindings) {
+    if (num_positive_bindings == 0) {
+      return 0;
+    }
+
+    if (num_negative_bindings == 0) {
+      return 1;
+    }
+
+    double precision = static_cast<double>(num_positive_bindings) / (num_positive_bindings + num_negative_bindings);
+    return ((1 - precision) * (1 - precision) * std::log2(1 - precision) -
+        precision * precision * std::log2(precision)) * std::log(2) + precision;
+  }
+
+ private:
+  const size_type num_positive_bindings_;
+  const size_type num_negative_bindings_;
+  const double clause_entropy_area_;
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_LEARNER_LITERAL_SCORER_HPP_ */
@@ -9,14 +9,14 @@
 #include <cmath>
 #include <memory>
 
-#include "operations/BuildHashTable.hpp"
-#include "operations/SemiJoin.hpp"
-#include "operations/SemiJoinFactory.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
+#include "learner/LiteralCoverage.hpp"
 #include "schema/FoilClause.hpp"
 #include "schema/FoilLiteral.hpp"
 #include "schema/TypeDefs.hpp"
 #include "storage/FoilHashTable.hpp"
 #include "storage/TableView.hpp"
+#include "utility/BitVector.hpp"
 #include "utility/StringUtil.hpp"
 #include "utility/Vector.hpp"
 
@@ -38,19 +38,18 @@ LiteralSelector::LiteralSelector(const size_type total_uncovered_positive,
                                  const FoilLiteralSet& black_random_literals)
     : total_uncovered_positive_(total_uncovered_positive),
       clause_(clause),
-      clause_entropy_area_(ComputeAreaUnderEntropyCurve(clause_->GetNumPositiveBindings(),
-                                                        clause_->GetNumNegativeBindings())),
+      scorer_(*clause_),
       black_random_literals_(black_random_literals) {
   DVLOG(4) << "Black list: " << ContainerToString(black_random_literals_);
 }
 
 template <bool consider_random_literal>
 void LiteralSelector::Insert(const CandidateLiteralInfo& literal_info) {
-  const double raw_mcc = ComputeMccScore(literal_info.num_covered_positive,
-                                         literal_info.num_covered_negative);
+  const double raw_mcc = scorer_.ComputeMccScore(literal_info.num_covered_positive,
+                                                 literal_info.num_covered_negative);
   const double mcc = 1 + raw_mcc;
-  const double auec = 1 + ComputeEntropyScore(literal_info.num_binding_positive,
-                                              literal_info.num_binding_negative);
+  const double auec = 1 + scorer_.ComputeEntropyScore(literal_info.num_binding_positive,
+                                                      literal_info.num_binding_negative);
 
   if (mcc == 0 || auec == 0) {
     DVLOG(4) << "Candidate literal " << literal_info.literal->ToString() << " is excluded, because "
@@ -65,7 +64,7 @@ void LiteralSelector::Insert(const CandidateLiteralInfo& literal_info) {
     return;
   }
 
-  const double score = 5 * auec * mcc / (mcc + 4 * auec);
+  const double score = LiteralScorer::CombineScores(mcc, auec);
 
   DVLOG(4) << "Candidate literal " << literal_info.literal->ToString() << ": "
            << "num_covered_positive=" << literal_info.num_covered_positive << ", "
@@ -75,10 +74,10 @@ void LiteralSelector::Insert(const CandidateLiteralInfo& literal_info) {
            << "num_binding_positive_in_clause=" << clause_->GetNumPositiveBindings() << ", "
            << "num_binding_negative_in_clause=" << clause_->GetNumNegativeBindings() << ", "
            << "clause_precision=" << static_cast<double>(clause_->GetNumPositiveBindings())/clause_->GetNumTotalBindings() << ", "
-           << "MCC score=" << ComputeMccScore(literal_info.num_covered_positive,
-                                              literal_info.num_covered_negative) << ", "
-           << "AUEC score=" << ComputeEntropyScore(literal_info.num_binding_positive,
-                                                   literal_info.num_binding_negative) << ", "
+           << "MCC score=" << scorer_.ComputeMccScore(literal_info.num_covered_positive,
+                                                      literal_info.num_covered_negative) << ", "
+           << "AUEC score=" << scorer_.ComputeEntropyScore(literal_info.num_binding_positive,
+                                                           literal_info.num_binding_negative) << ", "
            << "score=" << score;
 
   if (consider_random_literal) {
@@ -145,68 +144,36 @@ void LiteralSelector::Insert(const CandidateLiteralInfo& literal_info) {
   }
 }
 
+CandidateLiteralPruner* LiteralSelector::CreatePruner(bool consider_random_literal) const {
+  if (static_cast<int>(top_literal_heap_.size()) < FLAGS_num_saved_literals) {
+    return nullptr;
+  }
+  return new CandidateLiteralPruner(scorer_,
+                                    top_literal_heap_.front()->score,
+                                    !consider_random_literal);
+}
+
+bool LiteralSelector::IgnoresScoresBelow(double score) const {
+  // Inserting a literal that ties with the minimum score evicts all the ties,
+  // after which any literal makes it into the saved literals again.
+  return static_cast<int>(top_literal_heap_.size()) >= FLAGS_num_saved_literals &&
+         top_literal_heap_.front()->score >= score;
+}
+
 // TODO(qzeng): Record that the true positive coverage has been calculated so that it is not done
 //              again when the literal is chosen as the last body literal of a new clause.
 size_type LiteralSelector::ComputeCoveredPositives(const FoilLiteral& literal,
                                                    const std::shared_ptr<TableView>& uncovered_positive_data) {
-  std::unique_ptr<TableView> positive_table;
-
-  if (clause_->IsBindingDataConseuctive()) {
-    positive_table.reset(new TableView(clause_->CreatePositiveBlocks()));
-  } else {
-    positive_table.reset(new TableView(clause_->positive_blocks()));
-  }
-
-  Vector<AttributeReference> background_join_keys;
-  Vector<AttributeReference> clause_join_keys;
-  const Vector<FoilVariable>& variables = literal.variables();
-  for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
-    if (variables[vid].IsBound()) {
-      background_join_keys.emplace_back(vid);
-      clause_join_keys.emplace_back(variables[vid].variable_id());
-    }
-  }
-
-  Vector<int> project_column_ids;
-  Vector<AttributeReference> coverage_join_keys;
-  for (int i = 0; i < clause_->head_literal().num_variables(); ++i) {
-    project_column_ids.emplace_back(i);
-    coverage_join_keys.emplace_back(i);
-  }
-
-  std::unique_ptr<FoilHashTable> hash_table_for_bindings;
-  std::unique_ptr<FoilHashTable> background_hash_table;
-  std::unique_ptr<SemiJoin> binding_semijoin(
-      SelectAndCreateSemiJoin(*positive_table,
-                              literal.predicate()->fact_table(),
-                              &hash_table_for_bindings,
-                              &background_hash_table,
-                              clause_join_keys,
-                              background_join_keys,
-                              project_column_ids));
-
-  std::unique_ptr<FoilHashTable> positive_hash_table_for_coverage(
-      BuildHashTableAfterSemiJoin(positive_table->num_tuples(),
-                                  clause_->head_literal().num_variables(),
-                                  binding_semijoin.release()));
-
-  std::unique_ptr<SemiJoin> coverage_semijoin(
-      CreateSemiJoin(true,
-                     *uncovered_positive_data,
-                     *positive_table,
-                     *positive_hash_table_for_coverage,
-                     coverage_join_keys,
-                     coverage_join_keys,
-                     project_column_ids));
-
-  size_type num_covered_tuples = 0;
-  std::unique_ptr<SemiJoinChunk> coverage_result(coverage_semijoin->Next());
-  while (coverage_result != nullptr) {
-    num_covered_tuples += coverage_result->num_ones;
-    coverage_result.reset(coverage_semijoin->Next());
-  }
-
-  return num_covered_tuples;
+  // The positive bindings of the clause originate from the uncovered positive
+  // data.
+  std::shared_ptr<const FoilHashTable> background_hash_table;
+  BitVector covered_positives;
+  return ComputeLiteralCoverage(*clause_,
+                                literal,
+                                true,
+                                uncovered_positive_data->num_tuples(),
+                                &background_hash_table,
+                                &covered_positives);
 }
 
 bool LiteralSelector::ChooseRandomLiteral(
@@ -12,6 +12,8 @@
 #include <memory>
 
 #include "learner/CandidateLiteralInfo.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
+#include "learner/LiteralScorer.hpp"
 #include "memory/MemoryUsage.hpp"
 #include "schema/FoilClause.hpp"
 #include "schema/TypeDefs.hpp"
@@ -86,6 +88,36 @@ class LiteralSelector {
   template <bool consider_random_literal>
   void Insert(const CandidateLiteralInfo& literal_info);
 
+  // Inserts the candidate literals <literal_infos> in order, which are
+  // evaluated with <pruner> (nullptr if none) created by CreatePruner(), and
+  // gives the same saved literals as if none of them were pruned. A pruned
+  // literal cannot make it into the saved literals as long as they are full
+  // and score at least the minimum score of <pruner>. Once they are not, e.g.
+  // because the ties at the minimum score are replaced by a single literal,
+  // <reevaluate>(first_id) must count the pruned literals from
+  // <literal_infos>[first_id] on completely and clear their pruned flags.
+  // Returns the number of the literals that remain pruned.
+  template <bool consider_random_literal, typename ReevaluateFunctor>
+  int InsertEvaluatedLiterals(const CandidateLiteralPruner* pruner,
+                              const Vector<CandidateLiteralInfo*>& literal_infos,
+                              const ReevaluateFunctor& reevaluate) {
+    int num_pruned_literals = 0;
+    bool reevaluated = false;
+    for (std::size_t i = 0; i < literal_infos.size(); ++i) {
+      if (literal_infos[i]->pruned && !reevaluated && !IgnoresScoresBelow(pruner->min_score())) {
+        reevaluate(i);
+        reevaluated = true;
+      }
+      if (literal_infos[i]->pruned) {
+        DCHECK(!reevaluated);
+        ++num_pruned_literals;
+      } else {
+        Insert<consider_random_literal>(*literal_infos[i]);
+      }
+    }
+    return num_pruned_literals;
+  }
+
   // The caller needs to take ownership of the pointers.
   bool GetBestLiteral(Vector<EvaluatedLiteralInfo*>* best_literals,
                       const std::shared_ptr<TableView>& uncovered_positive_data) {
@@ -101,12 +133,12 @@ class LiteralSelector {
     double random_score = -1;
     bool use_random_literal = false;
     if (best_random_literal_ != nullptr) {
-      const double mcc = 2 + ComputeMccScore(best_random_literal_->candidate_literal_info.num_covered_positive,
-                                             best_random_literal_->candidate_literal_info.num_covered_negative);
-      const double auec = 1 + ComputeEntropyScore(best_random_literal_->candidate_literal_info.num_binding_positive,
-                                                  best_random_literal_->candidate_literal_info.num_binding_negative);
+      const double mcc = 2 + scorer_.ComputeMccScore(best_random_literal_->candidate_literal_info.num_covered_positive,
+                                                     best_random_literal_->candidate_literal_info.num_covered_negative);
+      const double auec = 1 + scorer_.ComputeEntropyScore(best_random_literal_->candidate_literal_info.num_binding_positive,
+                                                          best_random_literal_->candidate_literal_info.num_binding_negative);
 
-      random_score = 5 * auec * mcc / (mcc + 4 * auec);
+      random_score = LiteralScorer::CombineScores(mcc, auec);
     }
 
     const EvaluatedLiteralIntermediateInfo* best_regular_literal = top_literal_heap_.back();
@@ -157,6 +189,17 @@ class LiteralSelector {
     return saved_literal_infos_.empty();
   }
 
+  // Returns a pruner of the candidate literals that cannot make it into the
+  // saved literals any more, or nullptr if any literal can still make it
+  // (i.e. less than FLAGS_num_saved_literals literals are saved). If
+  // <consider_random_literal> is true, the literals that may be chosen as a
+  // random literal are never pruned. The caller takes ownership.
+  CandidateLiteralPruner* CreatePruner(bool consider_random_literal) const;
+
+  // Returns true if no literal with a score below <score> can be inserted
+  // into the saved literals any more.
+  bool IgnoresScoresBelow(double score) const;
+
   inline static bool NeedRegrow(const FoilClause& clause,
                                 const EvaluatedLiteralInfo& best_literal_info) {
     return NeedRegrow(clause,
@@ -209,12 +252,6 @@ class LiteralSelector {
 #endif
   }
 
-  double ComputeMccScore(size_type num_covered_positive, size_type num_covered_negative) const;
-  static double ComputeAreaUnderEntropyCurve(size_type num_positive_bindings,
-                                             size_type num_negative_bindings);
-  double ComputeEntropyScore(size_type num_positive_bindings,
-                             size_type num_negative_bindings) const;
-
   Vector<EvaluatedLiteralIntermediateInfo*> top_literal_heap_;  // Owned the pointers.
   GreaterComparator min_heap_comparator_;
 
@@ -222,7 +259,7 @@ class LiteralSelector {
 
   const size_type total_uncovered_positive_;
   FoilClauseConstSharedPtr clause_;
-  const double clause_entropy_area_;
+  const LiteralScorer scorer_;
   const FoilLiteralSet& black_random_literals_;
 
 //  double maximum_random_mcc_ = -1;
@@ -233,53 +270,6 @@ class LiteralSelector {
 };
 
 
-inline double LiteralSelector::ComputeMccScore(
-    size_type num_covered_positive,
-    size_type num_covered_negative) const {
-  if (num_covered_positive == 0) {
-    // This deviates from the actual MCC.
-    return -1;
-  }
-  if (num_covered_positive == clause_->GetNumPositiveBindings() &&
-      num_covered_negative == clause_->GetNumNegativeBindings()) {
-    return 0;
-  }
-
-  const double true_negatives = clause_->GetNumNegativeBindings() - num_covered_negative;
-  const double false_negatives = clause_->GetNumPositiveBindings() - num_covered_positive;
-  const double num_total_covered = num_covered_positive + num_covered_negative;
-
-  return (num_covered_positive * true_negatives -
-      num_covered_negative * false_negatives) /
-      std::sqrt(num_total_covered *
-       (clause_->GetNumTotalBindings() - num_total_covered) *
-       clause_->GetNumNegativeBindings() *
-       clause_->GetNumPositiveBindings());
-}
-
-inline double LiteralSelector::ComputeEntropyScore(
-    size_type num_positive_bindings,
-    size_type num_negative_bindings) const {
-  return ComputeAreaUnderEntropyCurve(num_positive_bindings, num_negative_bindings) -
-      clause_entropy_area_;
-}
-
-inline double LiteralSelector::ComputeAreaUnderEntropyCurve(
-    size_type num_positive_bindings,
-    size_type num_negative_bindings) {
-  if (num_positive_bindings == 0) {
-    return 0;
-  }
-
-  if (num_negative_bindings == 0) {
-    return 1;
-  }
-
-  double precision = static_cast<double>(num_positive_bindings) / (num_positive_bindings + num_negative_bindings);
-  return ((1 - precision) * (1 - precision) * std::log2(1 - precision) -
-      precision * precision * std::log2(precision)) * std::log(2) + precision;
-}
-
 extern template void LiteralSelector::Insert<true>(const CandidateLiteralInfo& literal_info);
 extern template void LiteralSelector::Insert<false>(const CandidateLiteralInfo& literal_info);
 
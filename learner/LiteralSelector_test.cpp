@@ -0,0 +1,187 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/LiteralSelector.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilLiteral.hpp"
+#include "schema/FoilParser.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "schema/TypeDefs.hpp"
+#include "utility/ElementDeleter.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_saved_literals);
+
+class LiteralSelectorTest : public ::testing::Test {
+ protected:
+  // The number of the positive and the negative bindings of the clause.
+  static constexpr size_type kNumBindings = 100;
+
+  // The counts of a candidate literal covering all its bindings.
+  struct LiteralCounts {
+    size_type num_positive;
+    size_type num_negative;
+  };
+
+  LiteralSelectorTest()
+      : head_predicate_(0, "p_0", 0, {0, 0}, {nullptr, nullptr}),
+        body_predicate_(1, "p_1", 0, {0, 0, 0}, {nullptr, nullptr, nullptr}),
+        predicate_catalog_{{"p_0", &head_predicate_}, {"p_1", &body_predicate_}},
+        clause_(FoilClause::Create(FoilParser::CreateLiteralFromString(predicate_catalog_, "p_0(0, 1)"),
+                                   kNumBindings,
+                                   kNumBindings,
+                                   Vector<ConstBufferPtr>())) {
+    FLAGS_num_saved_literals = 4;
+    for (const char* literal_string : {"p_1(0, 0, 0)", "p_1(0, 0, 1)", "p_1(0, 1, 0)", "p_1(0, 1, 1)",
+                                       "p_1(1, 0, 0)", "p_1(1, 0, 1)", "p_1(1, 1, 0)", "p_1(1, 1, 1)"}) {
+      literals_.emplace_back(FoilParser::CreateLiteralFromString(predicate_catalog_, literal_string));
+    }
+  }
+
+  ~LiteralSelectorTest() {
+    FLAGS_num_saved_literals = 5;
+  }
+
+  // Inserts the literals of each of <groups> in turn, where the literals of a
+  // group are evaluated with one pruner if <prune> is true, and the number of
+  // the reevaluated literals of the group is appended to
+  // <num_reevaluated_literals>. Returns the selected literals in the order of
+  // GetBestLiteral() and GetNextBestLiterals(), with the ties separated by
+  // spaces and the others by semicolons.
+  std::string Select(const Vector<Vector<LiteralCounts>>& groups,
+                             bool prune,
+                             Vector<int>* num_reevaluated_literals) {
+    LiteralSelector selector(kNumBindings, clause_, black_random_literals_);
+    std::size_t literal_id = 0;
+    for (const Vector<LiteralCounts>& group : groups) {
+      std::unique_ptr<CandidateLiteralPruner> pruner;
+      if (prune) {
+        pruner.reset(selector.CreatePruner(false));
+      }
+
+      Vector<CandidateLiteralInfo*> literal_infos;
+      ElementDeleter<CandidateLiteralInfo> literal_infos_deleter(&literal_infos);
+      Vector<CandidateLiteralInfo> complete_literal_infos;
+      for (const LiteralCounts& counts : group) {
+        CHECK_LT(literal_id, literals_.size());
+        CandidateLiteralInfo literal_info(&literals_[literal_id++]);
+        literal_info.num_covered_positive = counts.num_positive;
+        literal_info.num_covered_negative = counts.num_negative;
+        literal_info.num_binding_positive = counts.num_positive;
+        literal_info.num_binding_negative = counts.num_negative;
+        complete_literal_infos.emplace_back(literal_info);
+
+        // A pruned literal is only counted on some of its bindings.
+        if (pruner != nullptr && pruner->IsHopeless(literal_info, 0)) {
+          literal_info.num_covered_positive /= 2;
+          literal_info.num_covered_negative /= 4;
+          literal_info.num_binding_positive /= 2;
+          literal_info.num_binding_negative /= 4;
+          literal_info.pruned = true;
+        }
+        literal_infos.emplace_back(new CandidateLiteralInfo(literal_info));
+      }
+
+      if (!prune) {
+        for (const CandidateLiteralInfo* literal_info : literal_infos) {
+          selector.Insert<false>(*literal_info);
+        }
+        continue;
+      }
+      int num_reevaluated = 0;
+      const int num_pruned_literals = selector.InsertEvaluatedLiterals<false>(
+          pruner.get(),
+          literal_infos,
+          [&](std::size_t first_id) {
+            for (std::size_t i = first_id; i < literal_infos.size(); ++i) {
+              if (literal_infos[i]->pruned) {
+                *literal_infos[i] = complete_literal_infos[i];
+                ++num_reevaluated;
+              }
+            }
+          });
+      num_reevaluated_literals->emplace_back(num_reevaluated);
+      int num_remaining_pruned_literals = 0;
+      for (const CandidateLiteralInfo* literal_info : literal_infos) {
+        if (literal_info->pruned) {
+          ++num_remaining_pruned_literals;
+        }
+      }
+      EXPECT_EQ(num_remaining_pruned_literals, num_pruned_literals);
+    }
+
+    std::string selected_literals;
+    Vector<EvaluatedLiteralInfo*> best_literals;
+    ElementDeleter<EvaluatedLiteralInfo> best_literals_deleter(&best_literals);
+    if (!selector.GetBestLiteral(&best_literals, nullptr)) {
+      do {
+        for (const EvaluatedLiteralInfo* literal_info : best_literals) {
+          selected_literals.append(literal_info->literal.ToString()).append(" ");
+        }
+        selected_literals.append(";");
+        DeleteElements(&best_literals);
+        selector.GetNextBestLiterals(&best_literals);
+      } while (!best_literals.empty());
+    }
+    return selected_literals;
+  }
+
+  // Checks that pruning selects the same literals as evaluating all of them,
+  // and returns the number of the reevaluated literals of each group.
+  Vector<int> ExpectSameSelection(const Vector<Vector<LiteralCounts>>& groups) {
+    Vector<int> num_reevaluated_literals;
+    const std::string expected_literals = Select(groups, false, &num_reevaluated_literals);
+    EXPECT_FALSE(expected_literals.empty());
+    EXPECT_EQ(expected_literals, Select(groups, true, &num_reevaluated_literals));
+    return num_reevaluated_literals;
+  }
+
+  FoilPredicate head_predicate_;
+  FoilPredicate body_predicate_;
+  std::unordered_map<std::string, const FoilPredicate*> predicate_catalog_;
+  FoilClauseConstSharedPtr clause_;
+  Vector<FoilLiteral> literals_;
+  const FoilLiteralSet black_random_literals_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LiteralSelectorTest);
+};
+
+constexpr size_type LiteralSelectorTest::kNumBindings;
+
+TEST_F(LiteralSelectorTest, PrunedLiteralsCannotMakeIt) {
+  // The saved literals stay full and their minimum score only rises, so that
+  // the pruned literals are never counted completely.
+  const Vector<int> num_reevaluated_literals = ExpectSameSelection(
+      {{{50, 10}, {40, 20}, {41, 19}, {42, 18}},
+       {{45, 15}, {30, 30}, {20, 40}, {40, 21}}});
+  EXPECT_EQ((Vector<int>{0, 0}), num_reevaluated_literals);
+}
+
+TEST_F(LiteralSelectorTest, TiedMinimumScoresEvicted) {
+  // Inserting {45, 15} evicts the three literals tied at the minimum score, so
+  // that the pruned {30, 30} literals are saved, with tied scores, and the
+  // pruned {20, 40} literal is not.
+  const Vector<int> num_reevaluated_literals = ExpectSameSelection(
+      {{{50, 10}, {40, 20}, {40, 20}, {40, 20}},
+       {{45, 15}, {30, 30}, {30, 30}, {20, 40}}});
+  EXPECT_EQ((Vector<int>{0, 3}), num_reevaluated_literals);
+}
+
+}  // namespace quickfoil
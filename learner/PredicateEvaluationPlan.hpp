@@ -106,6 +106,8 @@ struct PredicateEvaluationPlan {
   BitVector positive_semi_bitvector;
   BitVector negative_semi_bitvector;
   int saved_partition_id = -1;
+  // True if all the literals of the plan are pruned.
+  bool pruned = false;
 
   Vector<PredicateTreeNodePtr> tree_nodes;
   int num_atom_tree_nodes = 0;
@@ -5,13 +5,22 @@
 
 #include "learner/QuickFoil.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "expressions/AttributeReference.hpp"
+#include "learner/CandidateLiteralCache.hpp"
 #include "learner/CandidateLiteralEnumerator.hpp"
 #include "learner/CandidateLiteralEvaluator.hpp"
 #include "learner/CandidateLiteralInfo.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
+#include "learner/LiteralCoverage.hpp"
+#include "learner/LiteralScorer.hpp"
 #include "learner/LiteralSearchStats.hpp"
 #include "learner/LiteralSelector.hpp"
 #include "memory/Buffer.hpp"
@@ -27,7 +36,10 @@
 #include "storage/TableView.hpp"
 #include "types/TypeID.hpp"
 #include "types/TypeTraits.hpp"
+#include "utility/BitVector.hpp"
 #include "utility/ElementDeleter.hpp"
+#include "utility/Hash.hpp"
+#include "utility/ThreadPool.hpp"
 #include "utility/Vector.hpp"
 
 #include "gflags/gflags.h"
@@ -67,11 +79,86 @@ DEFINE_int32(maximum_random_trials,
              5,
              "The maximum number of failed random literals for a rule search iteration");
 
+DEFINE_bool(cache_candidate_literals,
+            true,
+            "Whether to reuse the counts of the candidate literals evaluated on the same "
+            "clause in the previous iterations");
+
+DEFINE_bool(prune_candidate_literals,
+            true,
+            "Whether to stop evaluating the candidate literals whose scores cannot reach the "
+            "minimum score of the saved literals");
+
 DEFINE_double(minimum_coverage_for_tied_literal,
               0.1,
               "The minimum ratio of currently covered bindings to the uncovered examples"
               "for a saved tied literal");
 
+DEFINE_int32(beam_width,
+             1,
+             "The number of the partial clauses that are grown at once. With 1, only the "
+             "clause with the best literal is grown, and the tied and random literals are "
+             "backtracked over. A wider beam evaluates the candidate literals of all its "
+             "clauses in one pass over each background partition that they join with, "
+             "saves the literals tied with the last one it takes as tied literals, and "
+             "requires maximum_random_literals=0");
+
+DEFINE_bool(explore_tied_literals_in_parallel,
+            false,
+            "Whether to grow the building clauses of all the saved tied literals concurrently, "
+            "instead of one at a time. The ThreadPool runs the nested parallel operations of "
+            "a branch serially, so each branch evaluates its literals on one thread instead "
+            "of one thread per partition");
+
+DEFINE_int32(approximate_evaluation_min_bindings,
+             0,
+             "The minimum number of bindings of a building clause on which the candidate "
+             "literals are first scored on a sample of the bindings, and only the best ones "
+             "are evaluated exactly (0 to always evaluate all the literals exactly)");
+
+DEFINE_double(approximate_evaluation_confidence,
+              0.95,
+              "The confidence with which the fractions of the sampled bindings covered by a "
+              "literal are within approximate_evaluation_error of the exact ones");
+
+DEFINE_double(approximate_evaluation_error,
+              0.01,
+              "The maximum error of the fractions of the sampled bindings covered by a literal "
+              "at approximate_evaluation_confidence, which decides the sample size");
+
+DEFINE_int32(approximate_evaluation_num_exact_literals,
+             20,
+             "The number of the literals with the best scores on the sample of the bindings "
+             "that are evaluated exactly");
+
+namespace {
+
+// Returns the number of the samples out of <num_bindings> bindings, with which
+// the fraction of the bindings that a literal covers is estimated within
+// FLAGS_approximate_evaluation_error at FLAGS_approximate_evaluation_confidence
+// by Hoeffding's inequality.
+size_type ComputeSampleSize(size_type num_bindings) {
+  CHECK(FLAGS_approximate_evaluation_confidence > 0 && FLAGS_approximate_evaluation_confidence < 1);
+  CHECK_GT(FLAGS_approximate_evaluation_error, 0);
+  const double sample_size =
+      std::ceil(std::log(2 / (1 - FLAGS_approximate_evaluation_confidence)) /
+                (2 * FLAGS_approximate_evaluation_error * FLAGS_approximate_evaluation_error));
+  return (sample_size < num_bindings ? static_cast<size_type>(sample_size) : num_bindings);
+}
+
+// Scales <count> on <num_samples> sampled bindings up to all the
+// <num_bindings> bindings.
+size_type ScaleSampledCount(size_type count, size_type num_samples, size_type num_bindings) {
+  if (num_samples == 0) {
+    return 0;
+  }
+  const double scaled_count = static_cast<double>(count) * num_bindings / num_samples;
+  return static_cast<size_type>(std::min(std::round(scaled_count),
+                                         static_cast<double>(std::numeric_limits<size_type>::max())));
+}
+
+}  // namespace
+
 struct QuickFoil::TiedLiteralInfo {
   TiedLiteralInfo(const EvaluatedLiteralInfo* literal_info_in,
                   const std::shared_ptr<QuickFoilState>& building_state_in,
@@ -85,6 +172,61 @@ struct QuickFoil::TiedLiteralInfo {
   std::shared_ptr<LiteralSearchStats> literal_search_stats;
 };
 
+// The candidate literals of a building clause that are evaluated into a
+// LiteralSelector, and the state of the evaluation of those on the current
+// clause variable.
+struct QuickFoil::ClauseEvaluation {
+  ClauseEvaluation(const std::shared_ptr<QuickFoilState>& building_state_in,
+                   LiteralSelector* selector_in)
+      : building_state(building_state_in),
+        selector(selector_in),
+        entire_generated_literals(new std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>),
+        evaluator(building_state->building_clause),
+        pruned_literals_by_covered_results(new std::unordered_set<const FoilLiteral*>) {}
+
+  ~ClauseEvaluation() {
+    ClearLiteralGroup();
+  }
+
+  void ClearLiteralGroup() {
+    evaluator.set_pruner(nullptr);
+    pruner.reset();
+    DeleteElements(&results);
+    uncached_literal_groups.clear();
+    negative_cached_literal_groups.clear();
+    literal_to_result_map.clear();
+    DeleteElements(&uncached_results);
+    DeleteElements(&positive_results);
+  }
+
+  std::shared_ptr<LiteralSearchStats> CreateLiteralSearchStats() {
+    return std::make_shared<LiteralSearchStats>(entire_generated_literals,
+                                                pruned_literals_by_covered_results.release());
+  }
+
+  std::shared_ptr<QuickFoilState> building_state;
+  LiteralSelector* selector;
+  std::shared_ptr<std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>> entire_generated_literals;
+  // The literals to evaluate, grouped by the clause variables of their join
+  // keys.
+  Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>> literal_info_groups;
+  CandidateLiteralEvaluator evaluator;
+  CandidateLiteralCache::ClauseCache* clause_cache = nullptr;
+  std::unique_ptr<std::unordered_set<const FoilLiteral*>> pruned_literals_by_covered_results;
+
+  // The literals on the current clause variable. If there is a clause cache,
+  // only the uncached literals are evaluated into <uncached_results>, and
+  // only the positive counts of those whose negative counts are cached into
+  // <positive_results>.
+  std::unique_ptr<CandidateLiteralPruner> pruner;
+  Vector<CandidateLiteralInfo*> results;
+  std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>> uncached_literal_groups;
+  std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>> negative_cached_literal_groups;
+  std::unordered_map<const FoilLiteral*, CandidateLiteralInfo*> literal_to_result_map;
+  Vector<CandidateLiteralInfo*> uncached_results;
+  Vector<CandidateLiteralInfo*> positive_results;
+};
+
 QuickFoil::QuickFoil(const size_type num_true_facts,
                      const size_type num_false_facts,
                      const FoilPredicate* target_predicate,
@@ -93,8 +235,13 @@ QuickFoil::QuickFoil(const size_type num_true_facts,
       background_predicates_(background_predicates),
       maximum_uncovered_positive_(num_true_facts * (1 - FLAGS_positive_threshold)),
       literal_serarch_stats_for_first_iteration_(new LiteralSearchStats),
-      candidate_literal_enumerator_(background_predicates_) {
+      candidate_literal_enumerator_(background_predicates_),
+      is_tied_literal_branch_(false) {
   CHECK_GT(num_false_facts, 0) << "Positive-only data is not supported";
+  CHECK_GE(FLAGS_beam_width, 1);
+  // The beam search does not backtrack over random literals.
+  CHECK(FLAGS_beam_width == 1 || FLAGS_maximum_random_literals == 0)
+      << "--beam_width=" << FLAGS_beam_width << " requires --maximum_random_literals=0";
 
   FoilLiteral head_literal(target_predicate_);
   for (int i = 0; i < target_predicate_->num_arguments(); ++i) {
@@ -116,6 +263,21 @@ QuickFoil::QuickFoil(const size_type num_true_facts,
                                                      global_uncovered_positive_data_);
 }
 
+QuickFoil::QuickFoil(const QuickFoil* parent, int branch_id)
+    : target_predicate_(parent->target_predicate_),
+      background_predicates_(parent->background_predicates_),
+      global_uncovered_positive_data_(parent->global_uncovered_positive_data_),
+      original_negative_data_(parent->original_negative_data_),
+      maximum_uncovered_positive_(parent->maximum_uncovered_positive_),
+      current_outer_iterations_(parent->current_outer_iterations_),
+      literal_serarch_stats_for_first_iteration_(parent->literal_serarch_stats_for_first_iteration_),
+      candidate_literal_enumerator_(background_predicates_),
+      approximate_evaluation_seed_(
+          HashCombine(parent->approximate_evaluation_seed_ + parent->num_approximate_evaluations_,
+                      branch_id)),
+      is_tied_literal_branch_(true) {
+}
+
 QuickFoil::~QuickFoil() {
 }
 
@@ -177,185 +339,481 @@ void QuickFoil::Learn() {
     QLOG << "Memory usage: " << MemoryUsage::GetInstance()->GetMemoryUsageInGB() << "GB";
 #endif
 
-    for (;;) {
-      QLOG << "Literal search iteration: " << building_state_->building_clause->num_body_literals() << "\n"
-           << "Building clause: " << building_state_->building_clause->ToString() << "\n"
-           << "Num positive/negative bindings: " << building_state_->building_clause->GetNumPositiveBindings()
-           << "/" << building_state_->building_clause->GetNumNegativeBindings();
-#ifdef QUICKFOIL_ENABLE_MEMORY_MONITOR
-    QLOG << "Memory usage: " << MemoryUsage::GetInstance()->GetMemoryUsageInGB() << "GB";
-#endif
+    if (FLAGS_beam_width > 1) {
+      GrowBuildingClauseWithBeam();
+    } else {
+      GrowBuildingClause();
+    }
 
-      START_TIMER(QuickFoilTimer::kGenerateCandidateLiterals);
-
-      std::shared_ptr<std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>> entire_generated_literals(
-          new std::unordered_map<const FoilPredicate*, Vector<FoilLiteral>>);
-      std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>> pruned_generated_literals;
-      candidate_literal_enumerator_.EnumerateCandidateLiterals(*building_state_->building_clause,
-                                                               *building_state_->literal_search_stats,
-                                                               entire_generated_literals.get(),
-                                                               &pruned_generated_literals);
-
-      STOP_TIMER(QuickFoilTimer::kGenerateCandidateLiterals);
-      START_TIMER(QuickFoilTimer::kGroupLiterals);
-
-      const size_type local_num_uncovered_positives = building_state_->uncovered_positive_data->num_tuples();
-      std::unique_ptr<std::unordered_set<const FoilLiteral*>> pruned_literals_by_covered_results(new std::unordered_set<const FoilLiteral*>);
-      std::unique_ptr<LiteralSelector> selector(new LiteralSelector(local_num_uncovered_positives,
-                                                                    building_state_->building_clause,
-                                                                    building_state_->black_random_literals));
-
-      Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>> predicate_literal_info_groups(
-          building_state_->building_clause->num_variables());
-      CreateLiteralEvaluationInfoGroups(pruned_generated_literals,
-                                        &predicate_literal_info_groups);
-
-      STOP_TIMER(QuickFoilTimer::kGroupLiterals);
-
-      if (building_state_->building_clause->GetNumRandomLiterals() < FLAGS_maximum_random_literals &&
-          static_cast<int>(building_state_->black_random_literals.size()) < FLAGS_maximum_random_trials &&
-          building_state_->building_clause->GetNumPositiveBindings() / local_num_uncovered_positives < 50) {
-        EvaluateAllCandidateLiterals<true>(predicate_literal_info_groups,
-                                           selector.get(),
-                                           pruned_literals_by_covered_results.get());
-      } else {
-        EvaluateAllCandidateLiterals<false>(predicate_literal_info_groups,
-                                            selector.get(),
-                                            pruned_literals_by_covered_results.get());
+    ++current_outer_iterations_;
+    if (!ContinueRuleSearch()) {
+      break;
+    }
+
+    building_state_.reset();
+    if (FLAGS_explore_tied_literals_in_parallel) {
+      if (!tied_literal_infos_.empty() && !ExploreTiedLiteralsInParallel()) {
+        break;
+      }
+    } else {
+      while (!tied_literal_infos_.empty()) {
+        std::unique_ptr<TiedLiteralInfo> tied_literal_info(tied_literal_infos_.back().release());
+        tied_literal_infos_.pop_back();
+        if (!AddTiedLiteral(tied_literal_info.get())) {
+          break;
+        }
       }
+    }
+
+    if (building_state_ == nullptr) {
+      CreateMostGeneralBuildingClause();
+    }
+  }
+}
 
-      std::shared_ptr<LiteralSearchStats> literal_search_stats =
-          std::make_shared<LiteralSearchStats>(entire_generated_literals,
-                                               pruned_literals_by_covered_results.release());
+std::shared_ptr<LiteralSearchStats> QuickFoil::EvaluateBuildingClause(bool allow_random_literals,
+                                                                   LiteralSelector* selector) {
+  ClauseEvaluation clause_evaluation(building_state_, selector);
+  GenerateCandidateLiterals(&clause_evaluation);
+
+  const size_type local_num_uncovered_positives = building_state_->uncovered_positive_data->num_tuples();
+  if (allow_random_literals &&
+      building_state_->building_clause->GetNumRandomLiterals() < FLAGS_maximum_random_literals &&
+      static_cast<int>(building_state_->black_random_literals.size()) < FLAGS_maximum_random_trials &&
+      building_state_->building_clause->GetNumPositiveBindings() / local_num_uncovered_positives < 50) {
+    EvaluateAllCandidateLiterals<true>({&clause_evaluation});
+  } else {
+    EvaluateAllCandidateLiterals<false>({&clause_evaluation});
+  }
 
-      Vector<EvaluatedLiteralInfo*> best_literal_info_vec;
-      ElementDeleter<EvaluatedLiteralInfo> best_literal_info_vec_deleter(&best_literal_info_vec);
-      bool is_random_literal = selector->GetBestLiteral(&best_literal_info_vec,
-                                                        building_state_->uncovered_positive_data);
+  return clause_evaluation.CreateLiteralSearchStats();
+}
 
-      if (best_literal_info_vec.empty()) {
-        DLOG(ERROR) << "No valid candidate literal is found";
-        CHECK(!tied_literal_infos_.empty());
-        break;
-      }
+void QuickFoil::GenerateCandidateLiterals(ClauseEvaluation* clause_evaluation) {
+  const FoilClause& building_clause = *clause_evaluation->building_state->building_clause;
+  START_TIMER(QuickFoilTimer::kGenerateCandidateLiterals);
 
-      std::unique_ptr<const EvaluatedLiteralInfo> best_literal_to_add(best_literal_info_vec.back());
-      best_literal_info_vec.pop_back();
-      DCHECK_GT(best_literal_to_add->num_binding_positive, 0);
-
-      if (LiteralSelector::NeedRegrow(*building_state_->building_clause,
-                                      *best_literal_to_add)) {
-        QLOG << "The literal " << best_literal_to_add->literal.ToString()
-             << " does not reference the last random literal in the building clause "
-             << building_state_->building_clause->ToString()
-             << ", and we need to choose another literal";
-
-        is_random_literal = false;
-        LiteralSelector* local_selector = selector.get();
-        best_literal_to_add.reset();
-        for (;;) {
-          while (!best_literal_info_vec.empty()) {
-            best_literal_to_add.reset(best_literal_info_vec.back());
-            best_literal_info_vec.pop_back();
-            if (!LiteralSelector::NeedRegrow(*building_state_->building_clause,
-                                             *best_literal_to_add)) {
-              QLOG << "The literal " << best_literal_to_add->literal.ToString()
-                   << " references the last random literal in the building clause "
-                   << building_state_->building_clause->ToString();
-
-              break;
-            }
-            best_literal_to_add.reset();
+  std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>> pruned_generated_literals;
+  candidate_literal_enumerator_.EnumerateCandidateLiterals(building_clause,
+                                                           *clause_evaluation->building_state->literal_search_stats,
+                                                           clause_evaluation->entire_generated_literals.get(),
+                                                           &pruned_generated_literals);
+
+  STOP_TIMER(QuickFoilTimer::kGenerateCandidateLiterals);
+  START_TIMER(QuickFoilTimer::kGroupLiterals);
+
+  clause_evaluation->literal_info_groups.resize(building_clause.num_variables());
+  CreateLiteralEvaluationInfoGroups(pruned_generated_literals,
+                                    &clause_evaluation->literal_info_groups);
+
+  STOP_TIMER(QuickFoilTimer::kGroupLiterals);
+}
+
+void QuickFoil::GrowBuildingClause() {
+  for (;;) {
+    QLOG << "Literal search iteration: " << building_state_->building_clause->num_body_literals() << "\n"
+         << "Building clause: " << building_state_->building_clause->ToString() << "\n"
+         << "Num positive/negative bindings: " << building_state_->building_clause->GetNumPositiveBindings()
+         << "/" << building_state_->building_clause->GetNumNegativeBindings();
+#ifdef QUICKFOIL_ENABLE_MEMORY_MONITOR
+    QLOG << "Memory usage: " << MemoryUsage::GetInstance()->GetMemoryUsageInGB() << "GB";
+#endif
+
+    const size_type local_num_uncovered_positives = building_state_->uncovered_positive_data->num_tuples();
+    std::unique_ptr<LiteralSelector> selector(new LiteralSelector(local_num_uncovered_positives,
+                                                                  building_state_->building_clause,
+                                                                  building_state_->black_random_literals));
+    std::shared_ptr<LiteralSearchStats> literal_search_stats =
+        EvaluateBuildingClause(true, selector.get());
+
+    Vector<EvaluatedLiteralInfo*> best_literal_info_vec;
+    ElementDeleter<EvaluatedLiteralInfo> best_literal_info_vec_deleter(&best_literal_info_vec);
+    bool is_random_literal = selector->GetBestLiteral(&best_literal_info_vec,
+                                                      building_state_->uncovered_positive_data);
+
+    if (best_literal_info_vec.empty()) {
+      DLOG(ERROR) << "No valid candidate literal is found";
+      CHECK(!tied_literal_infos_.empty());
+      break;
+    }
+
+    std::unique_ptr<const EvaluatedLiteralInfo> best_literal_to_add(best_literal_info_vec.back());
+    best_literal_info_vec.pop_back();
+    DCHECK_GT(best_literal_to_add->num_binding_positive, 0);
+
+    if (LiteralSelector::NeedRegrow(*building_state_->building_clause,
+                                    *best_literal_to_add)) {
+      QLOG << "The literal " << best_literal_to_add->literal.ToString()
+           << " does not reference the last random literal in the building clause "
+           << building_state_->building_clause->ToString()
+           << ", and we need to choose another literal";
+
+      is_random_literal = false;
+      LiteralSelector* local_selector = selector.get();
+      best_literal_to_add.reset();
+      for (;;) {
+        while (!best_literal_info_vec.empty()) {
+          best_literal_to_add.reset(best_literal_info_vec.back());
+          best_literal_info_vec.pop_back();
+          if (!LiteralSelector::NeedRegrow(*building_state_->building_clause,
+                                           *best_literal_to_add)) {
+            QLOG << "The literal " << best_literal_to_add->literal.ToString()
+                 << " references the last random literal in the building clause "
+                 << building_state_->building_clause->ToString();
+
+            break;
           }
+          best_literal_to_add.reset();
+        }
 
-          if (best_literal_to_add == nullptr) {
+        if (best_literal_to_add == nullptr) {
+          local_selector->GetNextBestLiterals(&best_literal_info_vec);
+          if (best_literal_info_vec.empty()) {
+            std::shared_ptr<QuickFoilState> previous_state = building_state_->previous_state;
+            DCHECK(previous_state != nullptr);
+
+            previous_state->black_random_literals.emplace(
+                building_state_->building_clause->CreateUnboundLastLiteral());
+
+            // Note that literal_search_stats should be set to the stats for the current, not
+            // the previous clause.
+            literal_search_stats = building_state_->literal_search_stats;
+            building_state_ = previous_state;
+            local_selector = building_state_->literal_selector.get();
+            QLOG << "Drop the last added literal, and regrow the previous clause "
+                 << building_state_->building_clause->ToString();
+            DCHECK(local_selector != nullptr);
             local_selector->GetNextBestLiterals(&best_literal_info_vec);
-            if (best_literal_info_vec.empty()) {
-              std::shared_ptr<QuickFoilState> previous_state = building_state_->previous_state;
-              DCHECK(previous_state != nullptr);
-
-              previous_state->black_random_literals.emplace(
-                  building_state_->building_clause->CreateUnboundLastLiteral());
-
-              // Note that literal_search_stats should be set to the stats for the current, not
-              // the previous clause.
-              literal_search_stats = building_state_->literal_search_stats;
-              building_state_ = previous_state;
-              local_selector = building_state_->literal_selector.get();
-              QLOG << "Drop the last added literal, and regrow the previous clause "
-                   << building_state_->building_clause->ToString();
-              DCHECK(local_selector != nullptr);
-              local_selector->GetNextBestLiterals(&best_literal_info_vec);
-            }
-          } else {
-            break;
           }
+        } else {
+          break;
         }
       }
+    }
 
-      if (best_literal_to_add == nullptr) {
-        LOG(ERROR) << "Cannot expand the current building clause: " << building_state_->building_clause->ToString();
-        break;
+    if (best_literal_to_add == nullptr) {
+      LOG(ERROR) << "Cannot expand the current building clause: " << building_state_->building_clause->ToString();
+      break;
+    }
+
+    for (const EvaluatedLiteralInfo* literal_info : best_literal_info_vec) {
+      if (literal_info->num_covered_positive >
+          FLAGS_minimum_coverage_for_tied_literal * local_num_uncovered_positives) {
+        tied_literal_infos_.emplace_back(new TiedLiteralInfo(literal_info,
+                                                             building_state_,
+                                                             literal_search_stats));
+      } else {
+        delete literal_info;
       }
+    }
+    best_literal_info_vec.clear();
 
-      for (const EvaluatedLiteralInfo* literal_info : best_literal_info_vec) {
-        if (literal_info->num_covered_positive >
-            FLAGS_minimum_coverage_for_tied_literal * local_num_uncovered_positives) {
-          tied_literal_infos_.emplace_back(new TiedLiteralInfo(literal_info,
-                                                               building_state_,
-                                                               literal_search_stats));
-        } else {
-          delete literal_info;
-        }
+    if (AddBestCandidateLiteral(false,
+                                is_random_literal,
+                                best_literal_to_add.release(),
+                                literal_search_stats,
+                                &selector)) {
+      break;
+    }
+  }
+}
+
+void QuickFoil::GrowBuildingClauseWithBeam() {
+  // A candidate extension of a partial clause in the beam.
+  struct BeamExtension {
+    BeamExtension(int member_id_in,
+                  const EvaluatedLiteralInfo* literal_info_in,
+                  const std::shared_ptr<LiteralSearchStats>& literal_search_stats_in)
+        : member_id(member_id_in),
+          literal_info(literal_info_in),
+          literal_search_stats(literal_search_stats_in) {}
+
+    int member_id;
+    std::unique_ptr<const EvaluatedLiteralInfo> literal_info;
+    std::shared_ptr<LiteralSearchStats> literal_search_stats;
+  };
+
+  Vector<std::shared_ptr<QuickFoilState>> beam(1, building_state_);
+  for (;;) {
+    Vector<std::unique_ptr<LiteralSelector>> selectors;
+    Vector<std::unique_ptr<ClauseEvaluation>> clause_evaluations;
+    for (int member_id = 0; member_id < static_cast<int>(beam.size()); ++member_id) {
+      building_state_ = beam[member_id];
+      QLOG << "Literal search iteration: " << building_state_->building_clause->num_body_literals()
+           << " (beam member " << member_id << ")\n"
+           << "Building clause: " << building_state_->building_clause->ToString() << "\n"
+           << "Num positive/negative bindings: " << building_state_->building_clause->GetNumPositiveBindings()
+           << "/" << building_state_->building_clause->GetNumNegativeBindings();
+
+      selectors.emplace_back(new LiteralSelector(building_state_->uncovered_positive_data->num_tuples(),
+                                                 building_state_->building_clause,
+                                                 building_state_->black_random_literals));
+      clause_evaluations.emplace_back(new ClauseEvaluation(building_state_, selectors.back().get()));
+      GenerateCandidateLiterals(clause_evaluations.back().get());
+    }
+
+    Vector<ClauseEvaluation*> clause_evaluation_ptrs;
+    for (const std::unique_ptr<ClauseEvaluation>& clause_evaluation : clause_evaluations) {
+      clause_evaluation_ptrs.emplace_back(clause_evaluation.get());
+    }
+    EvaluateAllCandidateLiterals<false>(clause_evaluation_ptrs);
+
+    Vector<std::unique_ptr<BeamExtension>> extensions;
+    for (int member_id = 0; member_id < static_cast<int>(beam.size()); ++member_id) {
+      const std::shared_ptr<LiteralSearchStats> literal_search_stats =
+          clause_evaluations[member_id]->CreateLiteralSearchStats();
+
+      // All the saved literals of the member are candidates for the beam.
+      LiteralSelector* selector = selectors[member_id].get();
+      Vector<EvaluatedLiteralInfo*> literal_infos;
+      selector->GetBestLiteral(&literal_infos, beam[member_id]->uncovered_positive_data);
+      while (!selector->Empty()) {
+        selector->GetNextBestLiterals(&literal_infos);
       }
-      best_literal_info_vec.clear();
+      for (const EvaluatedLiteralInfo* literal_info : literal_infos) {
+        extensions.emplace_back(new BeamExtension(member_id, literal_info, literal_search_stats));
+      }
+    }
 
-      if (AddBestCandidateLiteral(false,
-                                  is_random_literal,
-                                  best_literal_to_add.release(),
-                                  literal_search_stats,
-                                  &selector)) {
+    // Keeps the order of the members and of their literals among the
+    // extensions with the same score.
+    std::stable_sort(extensions.begin(),
+                     extensions.end(),
+                     [](const std::unique_ptr<BeamExtension>& lhs,
+                        const std::unique_ptr<BeamExtension>& rhs) {
+                       return lhs->literal_info->score > rhs->literal_info->score;
+                     });
+
+    // Saves the extensions from <first_extension_id> on with the same score
+    // as the last one that the beam takes as tied literals, like
+    // GrowBuildingClause() does for the ties with its best literal.
+    const auto save_tied_extensions = [&](std::size_t first_extension_id, double score) {
+      for (std::size_t i = first_extension_id; i < extensions.size(); ++i) {
+        BeamExtension* extension = extensions[i].get();
+        if (std::fabs(extension->literal_info->score - score) >= 0.00001) {
+          break;
+        }
+        const std::shared_ptr<QuickFoilState>& member = beam[extension->member_id];
+        if (extension->literal_info->num_covered_positive >
+            FLAGS_minimum_coverage_for_tied_literal * member->uncovered_positive_data->num_tuples()) {
+          tied_literal_infos_.emplace_back(new TiedLiteralInfo(extension->literal_info.release(),
+                                                               member,
+                                                               extension->literal_search_stats));
+        }
+      }
+    };
+
+    Vector<std::shared_ptr<QuickFoilState>> next_beam;
+    // The score of the last extension taken into <next_beam>.
+    double next_beam_score = 0;
+    for (std::size_t extension_id = 0; extension_id < extensions.size(); ++extension_id) {
+      const std::unique_ptr<BeamExtension>& extension = extensions[extension_id];
+      if (static_cast<int>(next_beam.size()) >= FLAGS_beam_width) {
+        save_tied_extensions(extension_id, next_beam_score);
         break;
       }
+      building_state_ = beam[extension->member_id];
+      const EvaluatedLiteralInfo& literal_info = *extension->literal_info;
+      QLOG << "Add literal " << literal_info.literal.ToString()
+           << " (num_covered_positive=" << literal_info.num_covered_positive << ", "
+           << "num_covered_negative=" << literal_info.num_covered_negative << ", "
+           << "num_binding_positive=" << literal_info.num_binding_positive << ", "
+           << "num_binding_negative=" << literal_info.num_binding_negative << ", "
+           << "precision=" << literal_info.GetPrecision() << ", "
+           << "score=" << literal_info.score
+           << ") to beam member " << extension->member_id << " "
+           << building_state_->building_clause->ToString();
+
+      if (ShouldConsiderAsLastLiteral(literal_info)) {
+        if (AddBuildingClauseWithNewLiteral(&literal_info)) {
+          save_tied_extensions(extension_id + 1, literal_info.score);
+          building_state_.reset();
+          return;
+        }
+        if (building_state_->is_extended_from_tied_literal ||
+            building_state_->building_clause->num_body_literals() >= FLAGS_maximum_clause_length) {
+          QLOG << "Ignore the current building clause " << building_state_->building_clause->ToString()
+               << " with the new literal " << literal_info.literal.ToString();
+          continue;
+        }
+      }
+
+      const FoilClauseConstSharedPtr new_building_clause =
+          AddLiteralToBuildingClause(&literal_info, false);
+      next_beam.emplace_back(std::make_shared<QuickFoilState>(building_state_->is_extended_from_tied_literal,
+                                                              new_building_clause,
+                                                              extension->literal_search_stats,
+                                                              building_state_->black_random_literals,
+                                                              building_state_->uncovered_positive_data));
+      next_beam_score = literal_info.score;
+      if (new_building_clause->num_body_literals() == 1 && next_beam.size() == 1) {
+        literal_serarch_stats_for_first_iteration_ = extension->literal_search_stats;
+      }
     }
 
-    ++current_outer_iterations_;
-    if (!ContinueRuleSearch()) {
-      break;
+    if (next_beam.empty()) {
+      LOG(ERROR) << "Cannot expand any building clause in the beam";
+      building_state_.reset();
+      return;
     }
+    beam = std::move(next_beam);
+  }
+}
+
+bool QuickFoil::AddTiedLiteral(TiedLiteralInfo* tied_literal_info) {
+  building_state_ = tied_literal_info->building_state;
+  std::unique_ptr<const EvaluatedLiteralInfo>* literal_info = &tied_literal_info->literal_info;
 
+  QLOG << "Look at the tied literal " << (*literal_info)->literal.ToString()
+       << " for clause " << building_state_->building_clause->ToString();
+
+  // TODO(qzeng): Consider regrowing for tied literals.
+  if (LiteralSelector::NeedRegrow(*building_state_->building_clause,
+                                  **literal_info)) {
+    QLOG << "Do not consider the tied literal " << (*literal_info)->literal.ToString()
+         << " because regrowing is needed";
     building_state_.reset();
-    while (!tied_literal_infos_.empty()) {
-      std::unique_ptr<TiedLiteralInfo> tied_literal_info(tied_literal_infos_.back().release());
-      tied_literal_infos_.pop_back();
-      building_state_ = tied_literal_info->building_state;
-      std::unique_ptr<const EvaluatedLiteralInfo>* literal_info = &tied_literal_info->literal_info;
-
-      QLOG << "Look at the tied literal " << (*literal_info)->literal.ToString()
-           << " for clause " << building_state_->building_clause->ToString();
-
-      // TODO(qzeng): Consider regrowing for tied literals.
-      if (LiteralSelector::NeedRegrow(*building_state_->building_clause,
-                                      **literal_info)) {
-        QLOG << "Do not consider the tied literal " << (*literal_info)->literal.ToString()
-             << " because regrowing is needed";
-        building_state_.reset();
-        continue;
-      }
+    return true;
+  }
 
-      if (!AddBestCandidateLiteral(true,
-                                   false,
-                                   literal_info->release(),
-                                   tied_literal_info->literal_search_stats,
-                                   nullptr)) {
-        break;
+  return AddBestCandidateLiteral(true,
+                                 false,
+                                 literal_info->release(),
+                                 tied_literal_info->literal_search_stats,
+                                 nullptr);
+}
+
+bool QuickFoil::ExploreTiedLiteralsInParallel() {
+  // The branches are ordered as the tied literals would be popped.
+  Vector<std::unique_ptr<TiedLiteralInfo>> tied_literal_infos;
+  while (!tied_literal_infos_.empty()) {
+    tied_literal_infos.emplace_back(tied_literal_infos_.back().release());
+    tied_literal_infos_.pop_back();
+  }
+
+  // A branch only reads the building state of its tied literal, and starts
+  // its own building states from it, so the branches share nothing mutable.
+  Vector<std::unique_ptr<QuickFoil>> branches;
+  for (std::size_t i = 0; i < tied_literal_infos.size(); ++i) {
+    branches.emplace_back(new QuickFoil(this, i));
+  }
+  ThreadPool::GetInstance()->Run(
+      branches.size(),
+      [&branches, &tied_literal_infos](int branch_id) {
+        QuickFoil* branch = branches[branch_id].get();
+        if (!branch->AddTiedLiteral(tied_literal_infos[branch_id].get())) {
+          if (FLAGS_beam_width > 1) {
+            branch->GrowBuildingClauseWithBeam();
+          } else {
+            branch->GrowBuildingClause();
+          }
+          ++branch->current_outer_iterations_;
+        }
+      });
+
+  // Merges the branches as Learn() would explore them one at a time, i.e.
+  // depth-first: the tied literals saved by a branch are on top of the
+  // remaining ones, so they are explored and merged before the next branch.
+  const int previous_outer_iterations = current_outer_iterations_;
+  const std::shared_ptr<TableView> previous_uncovered_positive_data = global_uncovered_positive_data_;
+  const std::shared_ptr<LiteralSearchStats> previous_literal_search_stats =
+      literal_serarch_stats_for_first_iteration_;
+  for (std::size_t branch_id = 0; branch_id < branches.size(); ++branch_id) {
+    QuickFoil* branch = branches[branch_id].get();
+    num_approximate_evaluations_ += branch->num_approximate_evaluations_;
+    candidate_literal_cache_.MergeFrom(&branch->candidate_literal_cache_);
+    const bool is_grown = (branch->current_outer_iterations_ != previous_outer_iterations);
+    current_outer_iterations_ += branch->current_outer_iterations_ - previous_outer_iterations;
+    if (branch->literal_serarch_stats_for_first_iteration_ != previous_literal_search_stats) {
+      literal_serarch_stats_for_first_iteration_ = branch->literal_serarch_stats_for_first_iteration_;
+    }
+
+    DCHECK_LE(branch->learnt_clauses_.size(), 1u);
+    if (!branch->learnt_clauses_.empty()) {
+      MergeUncoveredPositiveData(previous_uncovered_positive_data,
+                                 branch->global_uncovered_positive_data_);
+      learnt_clauses_.emplace_back(branch->learnt_clauses_.back().release());
+      QLOG << "New rule from a tied literal: " << learnt_clauses_.back()->ToString()
+           << "(#Uncovered positive=" << global_uncovered_positive_data_->num_tuples() << ")";
+    }
+
+    // Learn() checks whether to continue after each grown building clause.
+    if (is_grown && !ContinueRuleSearch()) {
+      QLOG << "Drop the remaining " << branches.size() - branch_id - 1
+           << " tied literals, because the rule search has finished";
+      return false;
+    }
+
+    DCHECK(tied_literal_infos_.empty());
+    for (std::unique_ptr<TiedLiteralInfo>& tied_literal_info : branch->tied_literal_infos_) {
+      tied_literal_infos_.emplace_back(tied_literal_info.release());
+    }
+    if (!tied_literal_infos_.empty() && !ExploreTiedLiteralsInParallel()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void QuickFoil::MergeUncoveredPositiveData(
+    const std::shared_ptr<TableView>& previous_uncovered_positive_data,
+    const std::shared_ptr<TableView>& uncovered_positive_data) {
+  if (global_uncovered_positive_data_ == previous_uncovered_positive_data ||
+      uncovered_positive_data->num_tuples() == 0) {
+    global_uncovered_positive_data_ = uncovered_positive_data;
+    return;
+  }
+
+  const int num_target_arguments = target_predicate_->num_arguments();
+  Vector<AttributeReference> join_keys;
+  Vector<int> project_column_ids;
+  for (int i = 0; i < num_target_arguments; ++i) {
+    join_keys.emplace_back(i);
+    project_column_ids.emplace_back(i);
+  }
+
+  const size_type max_num_tuples = global_uncovered_positive_data_->num_tuples();
+  Vector<BufferPtr> output_buffers;
+  for (int i = 0; i < num_target_arguments; ++i) {
+    output_buffers.emplace_back(
+        std::make_shared<Buffer>(sizeof(cpp_type) * max_num_tuples,
+                                 max_num_tuples));
+  }
+
+  std::unique_ptr<FoilHashTable> hash_table(
+      BuildHashTableOnTable(join_keys, *uncovered_positive_data));
+  std::unique_ptr<SemiJoin> semi_join(
+      CreateSemiJoin(true,
+                     *global_uncovered_positive_data_,
+                     *uncovered_positive_data,
+                     *hash_table,
+                     join_keys,
+                     join_keys,
+                     project_column_ids));
+
+  size_type num_output_tuples = 0;
+  SemiJoinChunk result;
+  while (semi_join->Next(&result)) {
+    if (result.num_ones > 0) {
+      for (int i = 0; i < num_target_arguments; ++i) {
+        join_keys[i].EvaluateWithFilter(result.output_columns,
+                                        result.semi_bitvector,
+                                        result.num_ones,
+                                        num_output_tuples,
+                                        output_buffers[i].get());
       }
+      num_output_tuples += result.num_ones;
     }
+  }
 
-    if (building_state_ == nullptr) {
-      CreateMostGeneralBuildingClause();
+  Vector<ConstBufferPtr> output_const_buffers;
+  for (const BufferPtr& output_buffer : output_buffers) {
+    if (num_output_tuples != max_num_tuples) {
+      output_buffer->Realloc(num_output_tuples * sizeof(cpp_type), num_output_tuples);
     }
+    output_const_buffers.emplace_back(std::make_shared<const ConstBuffer>(output_buffer));
   }
+  global_uncovered_positive_data_.reset(new TableView(std::move(output_const_buffers)));
 }
 
 // Return true if the building clause is finished.
@@ -416,41 +874,281 @@ bool QuickFoil::AddBestCandidateLiteral(const bool is_tied_literal,
 }
 
 template <bool consider_random_literal>
-void QuickFoil::EvaluateAllCandidateLiterals(
-    const Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>>& predicate_literal_info_groups,
-    LiteralSelector* literal_selector,
-    std::unordered_set<const FoilLiteral*>* pruned_literals_by_covered_results) {
-  DCHECK_EQ(static_cast<int>(predicate_literal_info_groups.size()),
-            building_state_->building_clause->num_variables());
+void QuickFoil::EvaluateAllCandidateLiterals(const Vector<ClauseEvaluation*>& clause_evaluations) {
+  std::size_t num_literal_groups = 0;
+  for (ClauseEvaluation* clause_evaluation : clause_evaluations) {
+    const FoilClause& building_clause = *clause_evaluation->building_state->building_clause;
+    DCHECK_EQ(static_cast<int>(clause_evaluation->literal_info_groups.size()),
+              building_clause.num_variables());
+
+    // On very large binding sets, only the literals that are the most
+    // promising on a sample of the bindings are evaluated exactly.
+    if (FLAGS_approximate_evaluation_min_bindings > 0 &&
+        building_clause.GetNumTotalBindings() >= FLAGS_approximate_evaluation_min_bindings) {
+      Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>> exact_literal_info_groups;
+      SelectCandidateLiteralsOnSample(building_clause,
+                                      clause_evaluation->literal_info_groups,
+                                      &exact_literal_info_groups);
+      clause_evaluation->literal_info_groups = std::move(exact_literal_info_groups);
+    }
 
-  CandidateLiteralEvaluator evaluator(building_state_->building_clause);
-  for (size_t i = 0; i < predicate_literal_info_groups.size(); ++i) {
-    if (!predicate_literal_info_groups[i].empty()) {
-      Vector<CandidateLiteralInfo*> candidate_literal_results;
-      ElementDeleter<CandidateLiteralInfo> candidate_literal_results_deleter(&candidate_literal_results);
-      evaluator.Evaluate(i, predicate_literal_info_groups[i], &candidate_literal_results);
+    if (FLAGS_cache_candidate_literals) {
+      clause_evaluation->clause_cache =
+          candidate_literal_cache_.GetClauseCache(building_clause,
+                                                  clause_evaluation->building_state->uncovered_positive_data);
+    }
+    num_literal_groups = std::max(num_literal_groups, clause_evaluation->literal_info_groups.size());
+  }
+
+  for (size_t i = 0; i < num_literal_groups; ++i) {
+    Vector<ClauseEvaluation*> group_clause_evaluations;
+    Vector<CandidateLiteralEvaluation> full_evaluations;
+    Vector<CandidateLiteralEvaluation> positive_evaluations;
+    for (ClauseEvaluation* clause_evaluation : clause_evaluations) {
+      if (i >= clause_evaluation->literal_info_groups.size() ||
+          clause_evaluation->literal_info_groups[i].empty()) {
+        continue;
+      }
+      group_clause_evaluations.emplace_back(clause_evaluation);
+
+      // The literals that cannot beat the saved literals are not evaluated to
+      // the end.
+      if (FLAGS_prune_candidate_literals) {
+        clause_evaluation->pruner.reset(clause_evaluation->selector->CreatePruner(consider_random_literal));
+      }
+      clause_evaluation->evaluator.set_pruner(clause_evaluation->pruner.get());
+
+      if (clause_evaluation->clause_cache == nullptr) {
+        full_evaluations.emplace_back(&clause_evaluation->evaluator,
+                                      i,
+                                      &clause_evaluation->literal_info_groups[i],
+                                      &clause_evaluation->results);
+      } else {
+        LookUpCachedCandidateLiterals(i,
+                                      clause_evaluation,
+                                      &full_evaluations,
+                                      &positive_evaluations);
+      }
+    }
+    if (!full_evaluations.empty()) {
+      CandidateLiteralEvaluator::EvaluateTogether(false, full_evaluations);
+    }
+    if (!positive_evaluations.empty()) {
+      CandidateLiteralEvaluator::EvaluateTogether(true, positive_evaluations);
+    }
+
+    for (ClauseEvaluation* clause_evaluation : group_clause_evaluations) {
+      if (clause_evaluation->clause_cache != nullptr) {
+        CacheEvaluatedCandidateLiterals(clause_evaluation);
+      }
+
+      // The saved literals may change during the insertion so that the pruned
+      // literals could make it, in which case they are evaluated again
+      // without pruning.
+      CandidateLiteralEvaluator* evaluator = &clause_evaluation->evaluator;
+      CandidateLiteralCache::ClauseCache* clause_cache = clause_evaluation->clause_cache;
+      const Vector<CandidateLiteralInfo*>& candidate_literal_results = clause_evaluation->results;
+      const int num_pruned_literals =
+          clause_evaluation->selector->InsertEvaluatedLiterals<consider_random_literal>(
+              clause_evaluation->pruner.get(),
+              candidate_literal_results,
+              [&](std::size_t first_result_id) {
+                std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>> pruned_literal_groups;
+                std::unordered_map<const FoilLiteral*, CandidateLiteralInfo*> pruned_results;
+                for (std::size_t result_id = first_result_id;
+                     result_id < candidate_literal_results.size();
+                     ++result_id) {
+                  CandidateLiteralInfo* literal_info = candidate_literal_results[result_id];
+                  if (literal_info->pruned) {
+                    pruned_literal_groups[literal_info->literal->predicate()].emplace_back(literal_info->literal);
+                    pruned_results.emplace(literal_info->literal, literal_info);
+                  }
+                }
+
+                evaluator->set_pruner(nullptr);
+                Vector<CandidateLiteralInfo*> reevaluated_results;
+                ElementDeleter<CandidateLiteralInfo> reevaluated_results_deleter(&reevaluated_results);
+                evaluator->Evaluate(i, pruned_literal_groups, &reevaluated_results);
+                DCHECK_EQ(pruned_results.size(), reevaluated_results.size());
+                for (const CandidateLiteralInfo* reevaluated_result : reevaluated_results) {
+                  *pruned_results.at(reevaluated_result->literal) = *reevaluated_result;
+                  if (clause_cache != nullptr) {
+                    clause_cache->Insert(*reevaluated_result);
+                  }
+                }
+              });
       for (const CandidateLiteralInfo* literal_info : candidate_literal_results) {
-        literal_selector->Insert<consider_random_literal>(*literal_info);
         if (literal_info->num_covered_positive == 0) {
-          pruned_literals_by_covered_results->insert(literal_info->literal);
+          clause_evaluation->pruned_literals_by_covered_results->insert(literal_info->literal);
         }
       }
+      DVLOG(3) << "Prune " << num_pruned_literals << " out of "
+               << candidate_literal_results.size() << " candidate literals";
+      clause_evaluation->ClearLiteralGroup();
     }
   }
 }
 
+void QuickFoil::SelectCandidateLiteralsOnSample(
+    const FoilClause& building_clause,
+    const Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>>& predicate_literal_info_groups,
+    Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>>* exact_literal_info_groups) {
+  // Samples the positive and the negative bindings separately, so that both
+  // labels are estimated within the same error however skewed the clause is.
+  const FoilClauseConstSharedPtr sampled_clause(
+      building_clause.CreateSample(ComputeSampleSize(building_clause.GetNumPositiveBindings()),
+                                   ComputeSampleSize(building_clause.GetNumNegativeBindings()),
+                                   approximate_evaluation_seed_ + num_approximate_evaluations_++));
+  const size_type num_sampled_positive = sampled_clause->GetNumPositiveBindings();
+  const size_type num_sampled_negative = sampled_clause->GetNumNegativeBindings();
+  const LiteralScorer scorer(building_clause);
+
+  CandidateLiteralEvaluator evaluator(sampled_clause);
+  Vector<std::pair<double, const FoilLiteral*>> estimated_scores;
+  for (size_t i = 0; i < predicate_literal_info_groups.size(); ++i) {
+    if (!predicate_literal_info_groups[i].empty()) {
+      Vector<CandidateLiteralInfo*> sampled_results;
+      ElementDeleter<CandidateLiteralInfo> sampled_results_deleter(&sampled_results);
+      evaluator.Evaluate(i, predicate_literal_info_groups[i], &sampled_results);
+      for (const CandidateLiteralInfo* sampled_result : sampled_results) {
+        const double estimated_score = scorer.ComputeScore(
+            ScaleSampledCount(sampled_result->num_covered_positive,
+                              num_sampled_positive,
+                              building_clause.GetNumPositiveBindings()),
+            ScaleSampledCount(sampled_result->num_covered_negative,
+                              num_sampled_negative,
+                              building_clause.GetNumNegativeBindings()),
+            ScaleSampledCount(sampled_result->num_binding_positive,
+                              num_sampled_positive,
+                              building_clause.GetNumPositiveBindings()),
+            ScaleSampledCount(sampled_result->num_binding_negative,
+                              num_sampled_negative,
+                              building_clause.GetNumNegativeBindings()));
+        estimated_scores.emplace_back(estimated_score, sampled_result->literal);
+      }
+    }
+  }
+
+  // Keeps the order of the evaluation among the literals with the same
+  // estimated score.
+  std::stable_sort(estimated_scores.begin(),
+                   estimated_scores.end(),
+                   [](const std::pair<double, const FoilLiteral*>& lhs,
+                      const std::pair<double, const FoilLiteral*>& rhs) {
+                     return lhs.first > rhs.first;
+                   });
+  const std::size_t num_exact_literals =
+      std::min(estimated_scores.size(),
+               static_cast<std::size_t>(std::max(FLAGS_approximate_evaluation_num_exact_literals, 1)));
+  std::unordered_set<const FoilLiteral*> exact_literals;
+  for (std::size_t i = 0; i < num_exact_literals; ++i) {
+    exact_literals.emplace(estimated_scores[i].second);
+  }
+
+  // Keeps the order of the literals of each predicate, so that the ties
+  // between them are broken in the same way as without sampling.
+  exact_literal_info_groups->resize(predicate_literal_info_groups.size());
+  for (size_t i = 0; i < predicate_literal_info_groups.size(); ++i) {
+    for (const auto& literal_group : predicate_literal_info_groups[i]) {
+      for (const FoilLiteral* literal : literal_group.second) {
+        if (exact_literals.find(literal) != exact_literals.end()) {
+          (*exact_literal_info_groups)[i][literal_group.first].emplace_back(literal);
+        }
+      }
+    }
+  }
+
+  std::string approximate_literals;
+  for (std::size_t i = num_exact_literals; i < estimated_scores.size(); ++i) {
+    if (!approximate_literals.empty()) {
+      approximate_literals.append(", ");
+    }
+    approximate_literals.append(estimated_scores[i].second->ToString())
+        .append(" (estimated score=")
+        .append(std::to_string(estimated_scores[i].first))
+        .append(")");
+  }
+  QLOG << "Decide " << estimated_scores.size() - num_exact_literals << " out of "
+       << estimated_scores.size() << " candidate literals approximately on "
+       << num_sampled_positive << " positive and " << num_sampled_negative
+       << " negative sampled bindings: " << approximate_literals;
+}
+
+void QuickFoil::LookUpCachedCandidateLiterals(int clause_join_key_id,
+                                              ClauseEvaluation* clause_evaluation,
+                                              Vector<CandidateLiteralEvaluation>* full_evaluations,
+                                              Vector<CandidateLiteralEvaluation>* positive_evaluations) {
+  // The results are in the same order as by CandidateLiteralEvaluator::Evaluate(),
+  // so that the ties between the literals are broken in the same way.
+  Vector<CandidateLiteralInfo*>* results = &clause_evaluation->results;
+  int num_hits = 0;
+  int num_negative_hits = 0;
+  for (const auto& literal_group : clause_evaluation->literal_info_groups[clause_join_key_id]) {
+    for (const FoilLiteral* literal : literal_group.second) {
+      results->emplace_back(new CandidateLiteralInfo(literal));
+      switch (clause_evaluation->clause_cache->Lookup(results->back())) {
+        case CandidateLiteralCache::LookupResult::kMiss:
+          clause_evaluation->uncached_literal_groups[literal_group.first].emplace_back(literal);
+          clause_evaluation->literal_to_result_map.emplace(literal, results->back());
+          break;
+        case CandidateLiteralCache::LookupResult::kNegativeHit:
+          clause_evaluation->negative_cached_literal_groups[literal_group.first].emplace_back(literal);
+          clause_evaluation->literal_to_result_map.emplace(literal, results->back());
+          ++num_negative_hits;
+          break;
+        case CandidateLiteralCache::LookupResult::kHit:
+          ++num_hits;
+          break;
+      }
+    }
+  }
+  DVLOG(3) << "Reuse the cached counts of " << num_hits << " literals and the cached "
+           << "negative counts of " << num_negative_hits << " literals out of "
+           << results->size() << " literals";
+
+  if (!clause_evaluation->uncached_literal_groups.empty()) {
+    full_evaluations->emplace_back(&clause_evaluation->evaluator,
+                                   clause_join_key_id,
+                                   &clause_evaluation->uncached_literal_groups,
+                                   &clause_evaluation->uncached_results);
+  }
+  if (!clause_evaluation->negative_cached_literal_groups.empty()) {
+    positive_evaluations->emplace_back(&clause_evaluation->evaluator,
+                                       clause_join_key_id,
+                                       &clause_evaluation->negative_cached_literal_groups,
+                                       &clause_evaluation->positive_results);
+  }
+}
+
+void QuickFoil::CacheEvaluatedCandidateLiterals(ClauseEvaluation* clause_evaluation) {
+  CandidateLiteralCache::ClauseCache* clause_cache = clause_evaluation->clause_cache;
+  for (const CandidateLiteralInfo* uncached_result : clause_evaluation->uncached_results) {
+    *clause_evaluation->literal_to_result_map.at(uncached_result->literal) = *uncached_result;
+    clause_cache->Insert(*uncached_result);
+  }
+
+  for (const CandidateLiteralInfo* positive_result : clause_evaluation->positive_results) {
+    CandidateLiteralInfo* result = clause_evaluation->literal_to_result_map.at(positive_result->literal);
+    result->num_covered_positive = positive_result->num_covered_positive;
+    result->num_binding_positive = positive_result->num_binding_positive;
+    clause_cache->Insert(*result);
+  }
+}
+
 // Takes ownership of <literal_info_in>.
 FoilClauseConstSharedPtr QuickFoil::AddLiteralToBuildingClause(const EvaluatedLiteralInfo* literal_info,
                                                                bool is_random) {
   const FoilClauseConstSharedPtr& building_clause = building_state_->building_clause;
   const FoilLiteral& literal = literal_info->literal;
 
-  Vector<ConstBufferPtr> new_binding_table;
+  ConstBufferPtr binding_row_ids;
+  Vector<ConstBufferPtr> new_binding_blocks;
   CreateLabelAwareBindingTables(building_state_->building_clause,
                                 literal,
                                 literal_info->num_binding_positive,
                                 literal_info->num_binding_negative,
-                                &new_binding_table);
+                                &binding_row_ids,
+                                &new_binding_blocks);
 
   const FoilClauseConstSharedPtr new_building_clause =
       building_clause->CopyWithAdditionalUnBoundBodyLiteral(
@@ -458,7 +1156,8 @@ FoilClauseConstSharedPtr QuickFoil::AddLiteralToBuildingClause(const EvaluatedLi
           is_random,
           literal_info->num_binding_positive,
           literal_info->num_binding_negative,
-          std::move(new_binding_table));
+          binding_row_ids,
+          std::move(new_binding_blocks));
 
   QLOG << "New binding clause " << new_building_clause->ToString()
        << " (num_positive=" << new_building_clause->GetNumPositiveBindings() << ", "
@@ -469,107 +1168,27 @@ FoilClauseConstSharedPtr QuickFoil::AddLiteralToBuildingClause(const EvaluatedLi
 }
 
 void QuickFoil::ComputeCoverageOnUncoveredData(const FoilLiteral& literal,
-                                               std::unique_ptr<FoilHashTable>* positive_hash_table_for_coverage,
+                                               BitVector* covered_positives,
                                                size_type* num_positives_covered,
-                                               size_type* num_negatives_covered,
-                                               Vector<SemiJoinChunk*>* positive_coverage_results) {
-  *num_positives_covered = 0;
-  *num_negatives_covered = 0;
-
-  std::unique_ptr<TableView> positive_table;
-  std::unique_ptr<TableView> negative_table;
-
-  if (building_state_->building_clause->IsBindingDataConseuctive()) {
-    positive_table.reset(new TableView(
-        building_state_->building_clause->CreatePositiveBlocks()));
-    negative_table.reset(new TableView(
-        building_state_->building_clause->CreateNegativeBlocks()));
-  } else {
-    positive_table.reset(new TableView(
-        building_state_->building_clause->positive_blocks()));
-    negative_table.reset(new TableView(
-        building_state_->building_clause->negative_blocks()));
-  }
-
-  Vector<AttributeReference> background_join_keys;
-  Vector<AttributeReference> clause_join_keys;
-  const Vector<FoilVariable>& variables = literal.variables();
-  for (int vid = 0; vid < static_cast<int>(variables.size()); ++vid) {
-    if (variables[vid].IsBound()) {
-      background_join_keys.emplace_back(vid);
-      clause_join_keys.emplace_back(variables[vid].variable_id());
-    }
-  }
-
-  Vector<int> project_column_ids;
-  Vector<AttributeReference> coverage_join_keys;
-  for (int i = 0; i < target_predicate_->num_arguments(); ++i) {
-    project_column_ids.emplace_back(i);
-    coverage_join_keys.emplace_back(i);
-  }
-
-  const TableView& background_table = literal.predicate()->fact_table();
-  std::unique_ptr<FoilHashTable> background_hash_table;
-  {
-    std::unique_ptr<FoilHashTable> positive_hash_table_for_bindings;
-    std::unique_ptr<SemiJoin> binding_semijoin(
-        SelectAndCreateSemiJoin(*positive_table,
-                                background_table,
-                                &positive_hash_table_for_bindings,
-                                &background_hash_table,
-                                clause_join_keys,
-                                background_join_keys,
-                                project_column_ids));
-    positive_hash_table_for_coverage->reset(
-        BuildHashTableAfterSemiJoin(positive_table->num_tuples(),
-                                    target_predicate_->num_arguments(),
-                                    binding_semijoin.release()));
-
-    std::unique_ptr<SemiJoin> coverage_semijoin(
-        CreateSemiJoin(true,
-                       *building_state_->uncovered_positive_data,
-                       *positive_table,
-                       **positive_hash_table_for_coverage,
-                       coverage_join_keys,
-                       coverage_join_keys,
-                       project_column_ids));
-    std::unique_ptr<SemiJoinChunk> coverage_result(coverage_semijoin->Next());
-    while (coverage_result != nullptr) {
-      *num_positives_covered += coverage_result->num_ones;
-      positive_coverage_results->emplace_back(coverage_result.release());
-      coverage_result.reset(coverage_semijoin->Next());
-    }
-  }
-
-  {
-    std::unique_ptr<FoilHashTable> negative_hash_table_for_bindings;
-    std::unique_ptr<SemiJoin> binding_semijoin(
-        SelectAndCreateSemiJoin(*negative_table,
-                                background_table,
-                                &negative_hash_table_for_bindings,
-                                &background_hash_table,
-                                clause_join_keys,
-                                background_join_keys,
-                                project_column_ids));
-    std::unique_ptr<FoilHashTable> negative_hash_table_for_coverage(
-        BuildHashTableAfterSemiJoin(negative_table->num_tuples(),
-                                    target_predicate_->num_arguments(),
-                                    binding_semijoin.release()));
-
-    std::unique_ptr<SemiJoin> coverage_semijoin(
-        CreateSemiJoin(true,
-                       *original_negative_data_,
-                       *negative_table,
-                       *negative_hash_table_for_coverage,
-                       coverage_join_keys,
-                       coverage_join_keys,
-                       project_column_ids));
-    std::unique_ptr<SemiJoinChunk> coverage_result(coverage_semijoin->Next());
-    while (coverage_result != nullptr) {
-      *num_negatives_covered += coverage_result->num_ones;
-      coverage_result.reset(coverage_semijoin->Next());
-    }
-  }
+                                               size_type* num_negatives_covered) {
+  // The positive bindings of the building clause originate from its uncovered
+  // positive data, and the negative ones from the original negative data.
+  const FoilClause& building_clause = *building_state_->building_clause;
+  std::shared_ptr<const FoilHashTable> background_hash_table;
+  *num_positives_covered = ComputeLiteralCoverage(building_clause,
+                                                  literal,
+                                                  true,
+                                                  building_state_->uncovered_positive_data->num_tuples(),
+                                                  &background_hash_table,
+                                                  covered_positives);
+
+  BitVector covered_negatives;
+  *num_negatives_covered = ComputeLiteralCoverage(building_clause,
+                                                  literal,
+                                                  false,
+                                                  original_negative_data_->num_tuples(),
+                                                  &background_hash_table,
+                                                  &covered_negatives);
 }
 
 bool QuickFoil::AddBuildingClauseWithNewLiteral(const EvaluatedLiteralInfo* literal_info) {
@@ -578,17 +1197,13 @@ bool QuickFoil::AddBuildingClauseWithNewLiteral(const EvaluatedLiteralInfo* lite
 
   DVLOG(3) << "Calculate the true precision for literal " << literal.ToString();
 
-  Vector<SemiJoinChunk*> semi_join_positive_result;
-  ElementDeleter<SemiJoinChunk> semi_join_positive_result_deleter(&semi_join_positive_result);
-
+  BitVector covered_positives;
   size_type num_covered_local_positive;
   size_type num_covered_local_negative;
-  std::unique_ptr<FoilHashTable> positive_hash_table_for_coverage;
   ComputeCoverageOnUncoveredData(literal,
-                                 &positive_hash_table_for_coverage,
+                                 &covered_positives,
                                  &num_covered_local_positive,
-                                 &num_covered_local_negative,
-                                 &semi_join_positive_result);
+                                 &num_covered_local_negative);
 
   const double local_precision =
       static_cast<double>(num_covered_local_positive) / (num_covered_local_positive + num_covered_local_negative);
@@ -619,51 +1234,73 @@ bool QuickFoil::AddBuildingClauseWithNewLiteral(const EvaluatedLiteralInfo* lite
                                    uncovered_num_tuples));
     }
 
-    if (building_state_->uncovered_positive_data != global_uncovered_positive_data_) {
-      semi_join_positive_result_deleter.~ElementDeleter();
-
-      std::unique_ptr<TableView> positive_table;
+    const TableView& local_uncovered_positive_data = *building_state_->uncovered_positive_data;
+    Vector<AttributeReference> coverage_join_keys;
+    Vector<const cpp_type*> local_uncovered_columns;
+    for (int i = 0; i < num_target_arguments; ++i) {
+      coverage_join_keys.emplace_back(i);
+      local_uncovered_columns.emplace_back(
+          local_uncovered_positive_data.column_at(i)->as_type<cpp_type>());
+    }
 
-      if (building_state_->building_clause->IsBindingDataConseuctive()) {
-        positive_table.reset(new TableView(
-            building_state_->building_clause->CreatePositiveBlocks()));
+    if (building_state_->uncovered_positive_data != global_uncovered_positive_data_) {
+      // The global uncovered positive data have shrunk since the building
+      // clause was created from the local ones, so the covered tuples are
+      // removed from them by their values.
+      size_type num_output_tuples = 0;
+      if (num_covered_local_positive == 0) {
+        num_output_tuples = global_uncovered_positive_data_->num_tuples();
+        for (int i = 0; i < num_target_arguments; ++i) {
+          std::memcpy(output_buffers[i]->mutable_data(),
+                      global_uncovered_positive_data_->column_at(i)->data(),
+                      sizeof(cpp_type) * num_output_tuples);
+        }
       } else {
-        positive_table.reset(new TableView(
-            building_state_->building_clause->positive_blocks()));
-      }
-
-      Vector<AttributeReference> coverage_join_keys;
-      Vector<int> project_column_ids;
-      for (int i = 0; i < num_target_arguments; ++i) {
-        coverage_join_keys.emplace_back(i);
-        project_column_ids.emplace_back(i);
-      }
+        Vector<ConstBufferPtr> covered_columns;
+        for (int i = 0; i < num_target_arguments; ++i) {
+          BufferPtr covered_column(
+              std::make_shared<Buffer>(sizeof(cpp_type) * num_covered_local_positive,
+                                       num_covered_local_positive));
+          coverage_join_keys[i].EvaluateWithFilter(local_uncovered_columns,
+                                                   covered_positives,
+                                                   num_covered_local_positive,
+                                                   0,
+                                                   covered_column.get());
+          covered_columns.emplace_back(std::make_shared<const ConstBuffer>(covered_column));
+        }
+        const TableView covered_table(std::move(covered_columns));
 
-      std::unique_ptr<SemiJoin> semi_join(
-          CreateSemiJoin(true,
-                         *global_uncovered_positive_data_,
-                         *positive_table,
-                         *positive_hash_table_for_coverage,
-                         coverage_join_keys,
-                         coverage_join_keys,
-                         project_column_ids));
+        Vector<int> project_column_ids;
+        for (int i = 0; i < num_target_arguments; ++i) {
+          project_column_ids.emplace_back(i);
+        }
 
-      size_type num_output_tuples = 0;
-      std::unique_ptr<SemiJoinChunk> result(semi_join->Next());
-      while (result != nullptr) {
-        result->semi_bitvector.flip();
-        result->num_ones = result->semi_bitvector.size() - result->num_ones;
-        if (result->num_ones > 0) {
-          for (int i = 0; i < num_target_arguments; ++i) {
-            coverage_join_keys[i].EvaluateWithFilter(result->output_columns,
-                                                     result->semi_bitvector,
-                                                     result->num_ones,
-                                                     num_output_tuples,
-                                                     output_buffers[i].get());
+        std::unique_ptr<FoilHashTable> covered_hash_table(
+            BuildHashTableOnTable(coverage_join_keys, covered_table));
+        std::unique_ptr<SemiJoin> semi_join(
+            CreateSemiJoin(true,
+                           *global_uncovered_positive_data_,
+                           covered_table,
+                           *covered_hash_table,
+                           coverage_join_keys,
+                           coverage_join_keys,
+                           project_column_ids));
+
+        SemiJoinChunk result;
+        while (semi_join->Next(&result)) {
+          result.semi_bitvector.flip();
+          result.num_ones = result.semi_bitvector.size() - result.num_ones;
+          if (result.num_ones > 0) {
+            for (int i = 0; i < num_target_arguments; ++i) {
+              coverage_join_keys[i].EvaluateWithFilter(result.output_columns,
+                                                       result.semi_bitvector,
+                                                       result.num_ones,
+                                                       num_output_tuples,
+                                                       output_buffers[i].get());
+            }
+            num_output_tuples += result.num_ones;
           }
-          num_output_tuples += result->num_ones;
         }
-        result.reset(semi_join->Next());
       }
 
       DCHECK_GE(uncovered_num_tuples, num_output_tuples);
@@ -672,31 +1309,15 @@ bool QuickFoil::AddBuildingClauseWithNewLiteral(const EvaluatedLiteralInfo* lite
           output_buffers[i]->Realloc(num_output_tuples * sizeof(cpp_type), num_output_tuples);
         }
       }
-    } else {
-      positive_hash_table_for_coverage.reset();
-
-      Vector<AttributeReference> project_expressions;
+    } else if (uncovered_num_tuples > 0) {
+      covered_positives.flip();
       for (int i = 0; i < num_target_arguments; ++i) {
-        project_expressions.emplace_back(i);
-      }
-
-      size_type num_output_tuples = 0;
-      for (SemiJoinChunk* semi_join_result : semi_join_positive_result) {
-        semi_join_result->semi_bitvector.flip();
-        semi_join_result->num_ones =
-            semi_join_result->semi_bitvector.size() - semi_join_result->num_ones;
-        if (semi_join_result->num_ones > 0) {
-          for (int i = 0; i < num_target_arguments; ++i) {
-            project_expressions[i].EvaluateWithFilter(semi_join_result->output_columns,
-                                                      semi_join_result->semi_bitvector,
-                                                      semi_join_result->num_ones,
-                                                      num_output_tuples,
-                                                      output_buffers[i].get());
-          }
-          num_output_tuples += semi_join_result->num_ones;
-        }
+        coverage_join_keys[i].EvaluateWithFilter(local_uncovered_columns,
+                                                 covered_positives,
+                                                 uncovered_num_tuples,
+                                                 0,
+                                                 output_buffers[i].get());
       }
-      DCHECK_EQ(uncovered_num_tuples, num_output_tuples);
     }
 
     Vector<ConstBufferPtr> output_const_buffers;
@@ -8,6 +8,7 @@
 
 #include <memory>
 
+#include "learner/CandidateLiteralCache.hpp"
 #include "learner/CandidateLiteralEnumerator.hpp"
 #include "learner/QuickFoilState.hpp"
 #include "learner/QuickFoilTimer.hpp"
@@ -16,6 +17,7 @@
 #include "storage/TableView.hpp"
 #include "types/TypeID.hpp"
 #include "types/TypeTraits.hpp"
+#include "utility/BitVector.hpp"
 #include "utility/Macros.hpp"
 #include "utility/Vector.hpp"
 
@@ -27,11 +29,13 @@
 
 namespace quickfoil {
 
+class CandidateLiteralEvaluator;
+struct CandidateLiteralEvaluation;
 class LiteralSelector;
 struct EvaluatedLiteralInfo;
+struct LiteralSearchStats;
 class FoilLiteral;
 class FoilPredicate;
-class SemiJoinChunk;
 
 class QuickFoil {
  public:
@@ -60,13 +64,96 @@ class QuickFoil {
   }
 
  private:
+  struct ClauseEvaluation;
   struct TiedLiteralInfo;
 
+  // Creates a learner that grows a building clause from the tied literal
+  // <branch_id> of <parent> on its own, so that the tied literals can be
+  // explored in parallel (see ExploreTiedLiteralsInParallel()). It starts from
+  // the uncovered positive examples of <parent>, and has its own building
+  // states, candidate literal cache, learnt clauses and tied literals. Its
+  // samples of the bindings are seeded from <branch_id> and the number of the
+  // approximate evaluations of <parent>, so that the branches draw different
+  // samples whatever the thread schedule.
+  QuickFoil(const QuickFoil* parent, int branch_id);
+
+  // Adds literals to the building clause until it is finished, i.e. becomes a
+  // new rule or is given up.
+  void GrowBuildingClause();
+
+  // Same as GrowBuildingClause(), but keeps the FLAGS_beam_width best partial
+  // clauses grown from the building clause alive at once, instead of only the
+  // one with the best literal. The candidate literals of all the partial
+  // clauses are evaluated together (see EvaluateAllCandidateLiterals()), so
+  // the background partitions that several clauses join with are streamed
+  // once per step. The literals tied with the last one taken into the beam
+  // are saved as tied literals. Random literals are not used, which the
+  // constructor checks.
+  void GrowBuildingClauseWithBeam();
+
+  // Enumerates and evaluates the candidate literals of the building clause
+  // into <selector>, which considers random literals only if
+  // <allow_random_literals> is true and the clause can take one more. Returns
+  // the stats for enumerating the literals of the extended clauses.
+  std::shared_ptr<LiteralSearchStats> EvaluateBuildingClause(bool allow_random_literals,
+                                                             LiteralSelector* selector);
+
+  // Enumerates the candidate literals of the building clause of
+  // <clause_evaluation>, and groups them by the clause variables of their
+  // join keys.
+  void GenerateCandidateLiterals(ClauseEvaluation* clause_evaluation);
+
+  // Adds the literal of <tied_literal_info> to the building clause that it is
+  // tied for. Returns true if the building clause is finished, or false if
+  // the extended clause needs to be grown further.
+  bool AddTiedLiteral(TiedLiteralInfo* tied_literal_info);
+
+  // Grows the building clauses of all the tied literals concurrently as tasks
+  // on the ThreadPool, and merges the new rules, the cached candidate literal
+  // counts and the numbers of the approximate evaluations in the order in
+  // which Learn() would find them one tied literal at a time. The new tied
+  // literals of a branch are explored in the same way before the next branch
+  // is merged. Returns false if the rule search has finished.
+  bool ExploreTiedLiteralsInParallel();
+
+  // Keeps only the uncovered positive examples that are also in
+  // <uncovered_positive_data>, which is the result of learning one more rule
+  // from <previous_uncovered_positive_data>.
+  void MergeUncoveredPositiveData(const std::shared_ptr<TableView>& previous_uncovered_positive_data,
+                                  const std::shared_ptr<TableView>& uncovered_positive_data);
+
+  // Evaluates the generated candidate literals of each of
+  // <clause_evaluations> into its selector. The literals of all the clauses on
+  // the same clause variable are evaluated together, so that the clauses with
+  // literals on the same background table and join key share the pass over
+  // its partitions.
   template <bool consider_random_literal>
-  void EvaluateAllCandidateLiterals(
+  void EvaluateAllCandidateLiterals(const Vector<ClauseEvaluation*>& clause_evaluations);
+
+  // Evaluates the literals in <predicate_literal_info_groups> on a stratified
+  // random sample of the bindings of <building_clause>, and keeps the
+  // literals with the best estimated scores in <exact_literal_info_groups>,
+  // which are to be evaluated exactly. The other literals are decided on
+  // their estimated scores alone, and are reported as such.
+  void SelectCandidateLiteralsOnSample(
+      const FoilClause& building_clause,
       const Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>>& predicate_literal_info_groups,
-      LiteralSelector* selector,
-      std::unordered_set<const FoilLiteral*>* pruned_literals_by_covered_results);
+      Vector<std::unordered_map<const FoilPredicate*, Vector<const FoilLiteral*>>>* exact_literal_info_groups);
+
+  // Creates the results of the literals of <clause_evaluation> on the clause
+  // variable <clause_join_key_id> from its clause cache, and adds the
+  // evaluations of the literals on the labels whose counts are not cached to
+  // <full_evaluations> and <positive_evaluations>, which are to be evaluated
+  // on both labels and on the positive bindings only respectively.
+  void LookUpCachedCandidateLiterals(int clause_join_key_id,
+                                     ClauseEvaluation* clause_evaluation,
+                                     Vector<CandidateLiteralEvaluation>* full_evaluations,
+                                     Vector<CandidateLiteralEvaluation>* positive_evaluations);
+
+  // Copies the counts of the evaluations added by
+  // LookUpCachedCandidateLiterals() into the results of <clause_evaluation>,
+  // and adds them to its clause cache.
+  void CacheEvaluatedCandidateLiterals(ClauseEvaluation* clause_evaluation);
 
 //  void CreateInitialPositiveAndNegativeTableViews();
 //
@@ -85,11 +172,13 @@ class QuickFoil {
 
   bool AddBuildingClauseWithNewLiteral(const EvaluatedLiteralInfo* literal_info_in);
 
+  // Computes the coverage of the building clause extended with <literal> on
+  // its uncovered positive data, whose covered tuples are set in
+  // <covered_positives>, and on the original negative data.
   void ComputeCoverageOnUncoveredData(const FoilLiteral& literal,
-                                      std::unique_ptr<FoilHashTable>* positive_hash_table_for_coverage,
+                                      BitVector* covered_positives,
                                       size_type* num_positives_covered,
-                                      size_type* num_negatives_covered,
-                                      Vector<SemiJoinChunk*>* positive_coverage_results);
+                                      size_type* num_negatives_covered);
 
   bool ShouldConsiderAsLastLiteral(const EvaluatedLiteralInfo& best_literal_info);
 
@@ -106,7 +195,7 @@ class QuickFoil {
   Vector<std::unique_ptr<const FoilClause>> learnt_clauses_;
 
   std::shared_ptr<TableView> global_uncovered_positive_data_;
-  std::unique_ptr<TableView> original_negative_data_;
+  std::shared_ptr<TableView> original_negative_data_;
 
   const size_type maximum_uncovered_positive_;
   int current_outer_iterations_ = 0;
@@ -114,10 +203,17 @@ class QuickFoil {
   std::shared_ptr<LiteralSearchStats> literal_serarch_stats_for_first_iteration_;
 
   CandidateLiteralEnumerator candidate_literal_enumerator_;
+  CandidateLiteralCache candidate_literal_cache_;
+  // The seed of the next sample of the bindings is the sum of both.
+  unsigned approximate_evaluation_seed_ = 0;
+  unsigned num_approximate_evaluations_ = 0;
 
   // Owns the pointer.
   Vector<std::unique_ptr<TiedLiteralInfo>> tied_literal_infos_;
 
+  // True if this learner explores a tied literal of another one.
+  const bool is_tied_literal_branch_;
+
   DISALLOW_COPY_AND_ASSIGN(QuickFoil);
 };
 
@@ -64,8 +64,8 @@ TableView* QuickFoilTestRunner::ComputeUnCoveredData(
   }
 
   const TableView& background_table = literal.predicate()->fact_table();
-  std::unique_ptr<FoilHashTable> background_hash_table;
-  std::unique_ptr<FoilHashTable> hash_table_for_bindings;
+  std::shared_ptr<const FoilHashTable> background_hash_table;
+  std::shared_ptr<const FoilHashTable> hash_table_for_bindings;
   std::unique_ptr<SemiJoin> binding_semijoin(
       SelectAndCreateSemiJoin(current_binding_table,
                               background_table,
@@ -97,22 +97,21 @@ TableView* QuickFoilTestRunner::ComputeUnCoveredData(
   }
 
   size_type num_output_tuples = 0;
-  std::unique_ptr<SemiJoinChunk> coverage_result(coverage_semijoin->Next());
-  while (coverage_result != nullptr) {
-    coverage_result->semi_bitvector.flip();
-    coverage_result->num_ones =
-        coverage_result->semi_bitvector.size() - coverage_result->num_ones;
-    if (coverage_result->num_ones > 0) {
+  SemiJoinChunk coverage_result;
+  while (coverage_semijoin->Next(&coverage_result)) {
+    coverage_result.semi_bitvector.flip();
+    coverage_result.num_ones =
+        coverage_result.semi_bitvector.size() - coverage_result.num_ones;
+    if (coverage_result.num_ones > 0) {
       for (int i = 0; i < target_predicate_->num_arguments(); ++i) {
-        coverage_join_keys[i].EvaluateWithFilter(coverage_result->output_columns,
-                                                 coverage_result->semi_bitvector,
-                                                 coverage_result->num_ones,
+        coverage_join_keys[i].EvaluateWithFilter(coverage_result.output_columns,
+                                                 coverage_result.semi_bitvector,
+                                                 coverage_result.num_ones,
                                                  num_output_tuples,
                                                  output_buffers[i].get());
       }
-      num_output_tuples += coverage_result->num_ones;
+      num_output_tuples += coverage_result.num_ones;
     }
-    coverage_result.reset(coverage_semijoin->Next());
   }
 
   Vector<ConstBufferPtr> output_const_buffers;
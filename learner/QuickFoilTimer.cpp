@@ -7,6 +7,9 @@
 
 namespace quickfoil {
 
+thread_local std::chrono::time_point<std::chrono::system_clock>
+    QuickFoilTimer::start_time_vec[QuickFoilTimer::kNumberStages];
+
 const char* QuickFoilTimer::kStageNames[] = {
     "generate_candidate_literals",
     "group_literals",
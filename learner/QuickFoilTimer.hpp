@@ -6,6 +6,7 @@
 #ifndef QUICKFOIL_LEARNER_QUICK_FOIL_TIMER_HPP_
 #define QUICKFOIL_LEARNER_QUICK_FOIL_TIMER_HPP_
 
+#include <atomic>
 #include <chrono>
 
 #include "utility/Macros.hpp"
@@ -20,6 +21,8 @@
 
 namespace quickfoil {
 
+// Stages may be timed concurrently by multiple threads, in which case the
+// elapsed time of a stage is summed over all threads.
 class QuickFoilTimer {
  public:
   enum Stage {
@@ -55,11 +58,15 @@ class QuickFoilTimer {
   inline void StopTimer(Stage stage) {
     const std::chrono::duration<double> elapsed_seconds =
         std::chrono::system_clock::now() - start_time_vec[stage];
-    elapsed_time_vec[stage] += elapsed_seconds.count();
+    double elapsed_time = elapsed_time_vec[stage].load(std::memory_order_relaxed);
+    while (!elapsed_time_vec[stage].compare_exchange_weak(elapsed_time,
+                                                          elapsed_time + elapsed_seconds.count(),
+                                                          std::memory_order_relaxed)) {
+    }
   }
 
   double elapsed_time(int stage) const {
-    return elapsed_time_vec[stage];
+    return elapsed_time_vec[stage].load(std::memory_order_relaxed);
   }
 
   inline int num_stages() const {
@@ -69,9 +76,9 @@ class QuickFoilTimer {
   static const char* kStageNames[];
 
  private:
-  double elapsed_time_vec[kNumberStages];
+  std::atomic<double> elapsed_time_vec[kNumberStages];
 
-  std::chrono::time_point<std::chrono::system_clock> start_time_vec[kNumberStages];
+  static thread_local std::chrono::time_point<std::chrono::system_clock> start_time_vec[kNumberStages];
 
   DISALLOW_COPY_AND_ASSIGN(QuickFoilTimer);
 };
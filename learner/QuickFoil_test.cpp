@@ -0,0 +1,194 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "learner/QuickFoil.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "memory/Buffer.hpp"
+#include "schema/FoilClause.hpp"
+#include "schema/FoilPredicate.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(approximate_evaluation_min_bindings);
+DECLARE_int32(approximate_evaluation_num_exact_literals);
+DECLARE_double(approximate_evaluation_error);
+DECLARE_int32(beam_width);
+DECLARE_bool(explore_tied_literals_in_parallel);
+DECLARE_int32(maximum_random_literals);
+DECLARE_int32(num_threads);
+
+class QuickFoilTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+  // The positive examples are [0, kNumPositive), and the negative ones
+  // [kFirstNegative, kFirstNegative + kNumNegative).
+  static constexpr cpp_type kNumPositive = 600;
+  static constexpr cpp_type kFirstNegative = 1000;
+  static constexpr cpp_type kNumNegative = 600;
+
+  QuickFoilTest() {
+    FLAGS_num_threads = 4;
+  }
+
+  ~QuickFoilTest() {
+    FLAGS_approximate_evaluation_min_bindings = 0;
+    FLAGS_approximate_evaluation_num_exact_literals = 20;
+    FLAGS_approximate_evaluation_error = 0.01;
+    FLAGS_beam_width = 1;
+    FLAGS_explore_tied_literals_in_parallel = false;
+    FLAGS_maximum_random_literals = 2;
+  }
+
+  // Returns a unary predicate with the facts <values>.
+  static FoilPredicate* CreatePredicate(int id, const std::string& name, const Vector<cpp_type>& values) {
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * values.size(), values.size()));
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      column->mutable_as_type<cpp_type>()[i] = values[i];
+    }
+    Vector<ConstBufferPtr> columns;
+    columns.emplace_back(std::make_shared<const ConstBuffer>(column));
+    return new FoilPredicate(id, name, 0, {0}, std::move(columns));
+  }
+
+  // Adds a background predicate whose facts are the positive examples in the
+  // blocks of 100 in <positive_blocks>, and the negative examples in
+  // [<first_negative>, <first_negative> + <num_negative>).
+  void AddBackgroundPredicate(const std::string& name,
+                              const Vector<int>& positive_blocks,
+                              cpp_type first_negative,
+                              cpp_type num_negative) {
+    Vector<cpp_type> values;
+    for (const int block : positive_blocks) {
+      for (cpp_type i = 0; i < 100; ++i) {
+        values.emplace_back(block * 100 + i);
+      }
+    }
+    for (cpp_type i = 0; i < num_negative; ++i) {
+      values.emplace_back(kFirstNegative + first_negative + i);
+    }
+    background_predicates_.emplace_back(
+        CreatePredicate(background_predicates_.size(), name, values));
+  }
+
+  // Returns the rules learnt in order, one per line.
+  std::string Learn() {
+    Vector<const FoilPredicate*> background_predicates;
+    for (const std::unique_ptr<FoilPredicate>& predicate : background_predicates_) {
+      background_predicates.emplace_back(predicate.get());
+    }
+    // The target predicate has the ID after the background predicates.
+    Vector<cpp_type> examples;
+    for (cpp_type i = 0; i < kNumPositive; ++i) {
+      examples.emplace_back(i);
+    }
+    for (cpp_type i = 0; i < kNumNegative; ++i) {
+      examples.emplace_back(kFirstNegative + i);
+    }
+    const std::unique_ptr<FoilPredicate> target_predicate(
+        CreatePredicate(background_predicates.size(), "target", examples));
+
+    QuickFoil quick_foil(kNumPositive, kNumNegative, target_predicate.get(), background_predicates);
+    quick_foil.Learn();
+
+    std::string learnt_clauses;
+    for (const std::unique_ptr<const FoilClause>& clause : quick_foil.learnt_clauses()) {
+      learnt_clauses.append(clause->ToString()).append("\n");
+    }
+    return learnt_clauses;
+  }
+
+  Vector<std::unique_ptr<FoilPredicate>> background_predicates_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(QuickFoilTest);
+};
+
+constexpr QuickFoilTest::cpp_type QuickFoilTest::kNumPositive;
+constexpr QuickFoilTest::cpp_type QuickFoilTest::kFirstNegative;
+constexpr QuickFoilTest::cpp_type QuickFoilTest::kNumNegative;
+
+TEST_F(QuickFoilTest, TiedLiteralsInParallel) {
+  // Two tied first literals that cover all the positive examples and the same
+  // half of the negative examples.
+  AddBackgroundPredicate("all_1", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("all_2", {0, 1, 2, 3, 4, 5}, 300, 300);
+  // Three tied second literals, each covering two blocks of the positive
+  // examples and only negative examples that the first literals exclude. The
+  // rules from the tied literals of a branch are found before those of the
+  // next branch.
+  AddBackgroundPredicate("ab", {0, 1}, 0, 40);
+  AddBackgroundPredicate("cd", {2, 3}, 100, 40);
+  AddBackgroundPredicate("ef", {4, 5}, 200, 40);
+
+  const std::string serial_clauses = Learn();
+  EXPECT_EQ(4, std::count(serial_clauses.begin(), serial_clauses.end(), '\n')) << serial_clauses;
+
+  FLAGS_explore_tied_literals_in_parallel = true;
+  EXPECT_EQ(serial_clauses, Learn());
+}
+
+TEST_F(QuickFoilTest, TiedLiteralsInParallelWithApproximateEvaluation) {
+  AddBackgroundPredicate("all_1", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("all_2", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("ab", {0, 1}, 0, 40);
+  AddBackgroundPredicate("cd", {2, 3}, 100, 40);
+  AddBackgroundPredicate("ef", {4, 5}, 200, 40);
+
+  // The literals are decided on samples of a few hundred bindings, which the
+  // branches draw with their own seeds.
+  FLAGS_approximate_evaluation_min_bindings = 1;
+  FLAGS_approximate_evaluation_num_exact_literals = 3;
+  FLAGS_approximate_evaluation_error = 0.1;
+  const std::string serial_clauses = Learn();
+  EXPECT_EQ(4, std::count(serial_clauses.begin(), serial_clauses.end(), '\n')) << serial_clauses;
+
+  FLAGS_explore_tied_literals_in_parallel = true;
+  const std::string parallel_clauses = Learn();
+  EXPECT_EQ(serial_clauses, parallel_clauses);
+  EXPECT_EQ(parallel_clauses, Learn());
+}
+
+TEST_F(QuickFoilTest, BeamSavesTiedLiterals) {
+  // Three tied first literals, of which a beam of two only takes the first
+  // two, so that the third one is only explored as a tied literal.
+  AddBackgroundPredicate("all_1", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("all_2", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("all_3", {0, 1, 2, 3, 4, 5}, 300, 300);
+  AddBackgroundPredicate("ab", {0, 1}, 0, 40);
+  AddBackgroundPredicate("cd", {2, 3}, 100, 40);
+  AddBackgroundPredicate("ef", {4, 5}, 200, 40);
+
+  FLAGS_maximum_random_literals = 0;
+  FLAGS_beam_width = 2;
+  const std::string serial_clauses = Learn();
+  // A rule grown from the tied literal.
+  EXPECT_NE(std::string::npos, serial_clauses.find(":-  all_3(0),")) << serial_clauses;
+
+  FLAGS_explore_tied_literals_in_parallel = true;
+  EXPECT_EQ(serial_clauses, Learn());
+}
+
+TEST_F(QuickFoilTest, BeamRejectsRandomLiterals) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  AddBackgroundPredicate("all_1", {0, 1, 2, 3, 4, 5}, 300, 300);
+
+  FLAGS_beam_width = 2;
+  EXPECT_DEATH(Learn(), "requires --maximum_random_literals=0");
+}
+
+}  // namespace quickfoil
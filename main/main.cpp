@@ -5,28 +5,30 @@
 
 #include "main/Configuration.hpp"
 
+#include <sys/stat.h>
+
 #include <chrono>
-#include <fstream>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
-#include <vector>
 
 #include "memory/Buffer.hpp"
 #include "learner/QuickFoil.hpp"
 #include "learner/QuickFoilTestRunner.hpp"
 #include "learner/QuickFoilTimer.hpp"
+#include "operations/RadixPartition.hpp"
 #include "schema/FoilClause.hpp"
 #include "schema/FoilPredicate.hpp"
 #include "schema/TypeDefs.hpp"
+#include "storage/ColumnStore.hpp"
 #include "storage/TableView.hpp"
-#include "types/FromString.hpp"
+#include "storage/TextFileLoader.hpp"
 #include "types/TypeID.hpp"
 #include "types/TypeTraits.hpp"
 #include "utility/ElementDeleter.hpp"
 #include "utility/Vector.hpp"
 
-#include <boost/algorithm/string.hpp>
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
@@ -44,72 +46,101 @@ DEFINE_bool(quickfoil_also_output_to_err,
 namespace quickfoil {
 namespace {
 
-DEFINE_int32(inital_block__size, 327680, "Initial block size when loading data from files");
+DEFINE_bool(use_column_store,
+            true,
+            "Whether to map the data from the column store files written by "
+            "'quickfoil convert' instead of parsing the text files, if they "
+            "are newer than the text files");
+DEFINE_bool(persist_partitions,
+            false,
+            "Whether to partition all the columns of the background predicates "
+            "at startup, and persist the partitions next to the data files to be "
+            "mapped by the subsequent runs with the same partitioning scheme");
+
+void LoadTextData(const PredicateConfiguration& conf,
+                  const std::string& file_path,
+                  Vector<ConstBufferPtr>* output_const_buffers) {
+  Vector<bool> is_skipped;
+  for (const PredicateArgumentConfiguration& argument : conf.arguments) {
+    is_skipped.emplace_back(argument.is_skipped);
+  }
+  LoadTextFile(file_path, is_skipped, output_const_buffers);
+}
+
+// Returns true if the file at <path> exists and is not older than the file
+// at <source_path>.
+bool IsUpToDate(const std::string& path, const std::string& source_path) {
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    return false;
+  }
+  struct stat source_file_stat;
+  if (stat(source_path.c_str(), &source_file_stat) != 0) {
+    return true;
+  }
+  return file_stat.st_mtime >= source_file_stat.st_mtime;
+}
+
+// Returns the size of the file at <path>, or 0 if it does not exist.
+std::uint64_t GetFileSize(const std::string& path) {
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    return 0;
+  }
+  return file_stat.st_size;
+}
 
 void LoadData(const PredicateConfiguration& conf,
               const std::string& file_path,
               Vector<ConstBufferPtr>* output_const_buffers) {
   typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
 
-  Vector<BufferPtr> output_buffers;
-  Vector<cpp_type*> output_destinations;
-  const std::size_t inital_block_bytes = FLAGS_inital_block__size * sizeof(cpp_type);
-  size_type capacity = FLAGS_inital_block__size;
-  for (size_t i = 0; i < conf.arguments.size(); ++i) {
-    if (!conf.arguments[i].is_skipped) {
-      output_buffers.emplace_back(std::make_shared<Buffer>(inital_block_bytes,
-                                                           capacity));
-      output_destinations.emplace_back(output_buffers.back()->mutable_as_type<cpp_type>());
-    }
-  }
-
-  VLOG(2) << "Read data from " << file_path;
-  std::ifstream in(file_path);
-  CHECK(in.is_open())<< file_path;
-
-  std::string line;
-  size_type num_lines = 0;
-  while (std::getline(in, line)) {
-    if (capacity < num_lines) {
-      capacity *= 1.5;
-      const std::size_t new_block_bytes = capacity * sizeof(cpp_type);
-      for (int i = 0; i < static_cast<int>(output_buffers.size()); ++i) {
-        output_buffers[i]->Realloc(new_block_bytes, capacity);
-        output_destinations[i] = output_buffers[i]->mutable_as_type<cpp_type>() + num_lines;
+  const std::string column_store_path = GetColumnStorePath(file_path);
+  if (FLAGS_use_column_store && IsUpToDate(column_store_path, file_path)) {
+    std::size_t num_columns = 0;
+    for (const PredicateArgumentConfiguration& argument : conf.arguments) {
+      if (!argument.is_skipped) {
+        ++num_columns;
       }
     }
-
-    if (!line.empty() && line.at(0) != '#') {
-      std::vector<std::string> column_value_strs;
-      boost::split(column_value_strs, line, boost::is_any_of("|"));
-      CHECK_EQ(conf.arguments.size(), column_value_strs.size()) << line;
-      int column_id = 0;
-      for (size_t i = 0; i < column_value_strs.size(); ++i) {
-        if (!conf.arguments[i].is_skipped) {
-          cpp_type value;
-          FromString<kQuickFoilDefaultDataType>(column_value_strs[i], &value);
-          *output_destinations[column_id] = value;
-          ++output_destinations[column_id];
-          ++column_id;
-        }
-      }
-      ++num_lines;
+    if (ReadColumnStore(column_store_path,
+                        sizeof(cpp_type),
+                        num_columns,
+                        GetFileSize(file_path),
+                        output_const_buffers)) {
+      return;
     }
   }
+  LoadTextData(conf, file_path, output_const_buffers);
+}
 
-  const std::size_t actual_block_byptes = num_lines * sizeof(cpp_type);
-  for (BufferPtr& output_buffer : output_buffers) {
-    output_buffer->Realloc(actual_block_byptes, num_lines);
-    output_const_buffers->emplace_back(
-        std::make_shared<const ConstBuffer>(output_buffer));
-  }
-
+// Writes the column store file of the text data file <file_path>.
+void ConvertData(const PredicateConfiguration& conf,
+                 const std::string& file_path) {
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
 
-  VLOG(2) << "Read " << num_lines << " rows from file " << file_path;
+  Vector<ConstBufferPtr> blocks;
+  LoadTextData(conf, file_path, &blocks);
+  WriteColumnStore(GetColumnStorePath(file_path),
+                   sizeof(cpp_type),
+                   GetFileSize(file_path),
+                   blocks);
 }
 
 }  // namespace
 
+void ConvertToColumnStores(const Configuration& conf) {
+  for (const PredicateConfiguration& background_predicate_conf : conf.conf_for_background_predicates()) {
+    ConvertData(background_predicate_conf, background_predicate_conf.file_path);
+  }
+  const PredicateConfiguration& target_predicate_conf =
+      conf.conf_for_target_predicate().predicate_configuration;
+  ConvertData(target_predicate_conf, target_predicate_conf.file_path);
+  if (conf.test_setting() != nullptr) {
+    ConvertData(target_predicate_conf, conf.test_setting()->test_file_path);
+  }
+}
+
 FoilPredicate* CreateBackgroundPredicate(int id,
                                          const PredicateConfiguration& conf) {
   Vector<int> argument_types;
@@ -125,11 +156,21 @@ FoilPredicate* CreateBackgroundPredicate(int id,
     }
   }
 
-  return new FoilPredicate(id,
-                           conf.name,
-                           conf.key,
-                           argument_types,
-                           std::move(blocks));
+  FoilPredicate* predicate = new FoilPredicate(id,
+                                                conf.name,
+                                                conf.key,
+                                                argument_types,
+                                                std::move(blocks));
+
+  TableView* fact_table = predicate->mutable_fact_table();
+  if (FLAGS_persist_partitions && !fact_table->empty()) {
+    const std::string partition_store_path = GetPartitionStorePath(conf.file_path);
+    if (!IsUpToDate(partition_store_path, conf.file_path) ||
+        !LoadPersistedPartitions(partition_store_path, fact_table)) {
+      PersistPartitions(partition_store_path, fact_table);
+    }
+  }
+  return predicate;
 }
 
 FoilPredicate* CreateTargetPredicate(int id,
@@ -190,9 +231,17 @@ void CreateTestTableViews(const TestSetting& test_setting,
 
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true /* remove flags */);
-  CHECK(argc > 1) << "Usage: ./quickfoil <configuration_file_name>.json";
+  CHECK(argc > 1) << "Usage: ./quickfoil [convert] <configuration_file_name>.json";
   google::InitGoogleLogging(argv[0]);
 
+  // Writes the data files in the configuration as column stores, which are
+  // mapped instead of parsed by the subsequent runs.
+  if (std::string(argv[1]) == "convert") {
+    CHECK(argc > 2) << "Usage: ./quickfoil convert <configuration_file_name>.json";
+    quickfoil::ConvertToColumnStores(Configuration(argv[2]));
+    return 0;
+  }
+
 #ifndef ENABLE_LOGGING
 #ifdef NDEBUG
   if (FLAGS_v > 0) {
@@ -283,7 +332,9 @@ int main(int argc, char** argv) {
               << ((num_covered_positive == 0 && num_covered_negative == 0) ?
                    0 : (static_cast<double>(num_covered_positive)/(num_covered_positive + num_covered_negative)))
               << ", recall="
-              << static_cast<double>(num_covered_positive) / conf.test_setting()->num_test_positive;
+              << static_cast<double>(num_covered_positive) / conf.test_setting()->num_test_positive
+              << ", partition_skew="
+              << quickfoil::PartitionBalanceStatistics::GetInstance()->average_skew();
     if (!timer_info.empty()) {
       std::cout << ", " << timer_info;
     }
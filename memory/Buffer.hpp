@@ -8,6 +8,7 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <functional>
 #include <memory>
 
 #include "memory/MemUtil.hpp"
@@ -51,9 +52,22 @@ class Buffer {
         num_tuples_(num_tuples),
         parent_buffer_(parent_buffer) {}
 
+  // Takes the ownership of <data> that is not allocated by qf_malloc (e.g. a
+  // memory-mapped file), which is released by <deleter> instead of free().
+  Buffer(void* data,
+         std::size_t num_tuples,
+         std::function<void(void*)> deleter)
+      : data_(data),
+        num_tuples_(num_tuples),
+        deleter_(std::move(deleter)) {}
+
   ~Buffer() {
     if (parent_buffer_ == nullptr) {
-      free(data_);
+      if (deleter_) {
+        deleter_(data_);
+      } else {
+        free(data_);
+      }
     }
   }
 
@@ -98,6 +112,7 @@ class Buffer {
   std::size_t num_tuples_;
 
   std::shared_ptr<Buffer> parent_buffer_;
+  std::function<void(void*)> deleter_;
 
   DISALLOW_COPY_AND_ASSIGN(Buffer);
 };
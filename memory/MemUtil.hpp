@@ -86,6 +86,14 @@ inline void cacheline_memcpy(void* __restrict__ dst, void* __restrict__ src) {
 #endif
 }
 
+// Makes the streaming stores of cacheline_memcpy() issued by the calling
+// thread visible to the other threads.
+inline void streaming_store_fence() {
+#if defined(__AVX__) || defined(__SSE2__)
+  _mm_sfence();
+#endif
+}
+
 }
 
 #endif /* QUICKFOIL_MEMORY_MEMUTIL_HPP_ */
@@ -25,6 +25,21 @@ namespace quickfoil {
 
 DECLARE_int32(num_radix_bits);
 
+DEFINE_bool(bucketized_hash_tables,
+            false,
+            "Whether to build the hash tables with cache-line buckets that store the "
+            "hash values of the entries inline, instead of with separate arrays of "
+            "bucket heads and next pointers.");
+
+namespace {
+
+inline HashTableLayout GetHashTableLayout() {
+  return FLAGS_bucketized_hash_tables ? HashTableLayout::kBucketized
+                                      : HashTableLayout::kChained;
+}
+
+}  // namespace
+
 template <typename cpp_type>
 FoilHashTable* BuildHashTable(int num_radix_bits,
                               size_type num_tuples,
@@ -32,20 +47,12 @@ FoilHashTable* BuildHashTable(int num_radix_bits,
   DCHECK_GT(num_tuples, 0);
 
   std::unique_ptr<FoilHashTable> hash_table(new FoilHashTable(num_tuples,
-                                                              num_radix_bits));
-
-  const uint32_t mask = hash_table->mask();
-  int* __restrict__ buckets = hash_table->mutable_buckets();
-  int* __restrict__ next = hash_table->mutable_next();
+                                                              num_radix_bits,
+                                                              GetHashTableLayout()));
 
   for (size_type index = 0; index < num_tuples; ++index) {
-    const hash_type hash_value = Hash(*values);
-    const int bucket_id = HASH_BIT_MODULO(hash_value, mask, num_radix_bits);
-    DCHECK_LT(static_cast<size_t>(bucket_id), (mask >> num_radix_bits) + 1);
-    *next = buckets[bucket_id];
-    buckets[bucket_id] = index + 1;
+    hash_table->Insert(HashKey(*values), index);
     ++values;
-    ++next;
   }
 
   return hash_table.release();
@@ -59,6 +66,7 @@ void BuildHashTableOnPartitions(
   DCHECK(!partitions.empty());
   DCHECK(table->hash_tables_at(column_id).empty());
 
+  const HashTableLayout layout = GetHashTableLayout();
   Vector<FoilHashTable> hash_tables;
   hash_tables.reserve(partitions.size());
   for (const ConstBufferPtr& partition : partitions) {
@@ -72,20 +80,13 @@ void BuildHashTableOnPartitions(
         partition->as_type<PartitionTuple<kQuickFoilDefaultDataType>>();
 
     hash_tables.emplace_back(num_tuples,
-                             num_radix_bits);
-
-    const std::uint32_t mask = hash_tables.back().mask();
-    int* __restrict__ buckets = hash_tables.back().mutable_buckets();
-    int* __restrict__ next = hash_tables.back().mutable_next();
+                             num_radix_bits,
+                             layout);
+    FoilHashTable* hash_table = &hash_tables.back();
 
     for (size_type index = 0; index < num_tuples; ++index) {
-      const hash_type hash_value = Hash(partition_tuples->value);
-      const int bucket_id = HASH_BIT_MODULO(hash_value, mask, num_radix_bits);
-      DCHECK_LT(static_cast<size_t>(bucket_id), (mask >> num_radix_bits) + 1);
-      *next = buckets[bucket_id];
-      buckets[bucket_id] = index + 1;
+      hash_table->Insert(HashKey(partition_tuples->value), index);
       ++partition_tuples;
-      ++next;
     }
   }
 
@@ -108,44 +109,32 @@ FoilHashTable* BuildHashTableOnTableImpl(
 
   const size_type num_tuples = table.num_tuples();
   std::unique_ptr<FoilHashTable> hash_table(new FoilHashTable(num_tuples,
-                                                              0));
-  const std::uint32_t mask = hash_table->mask();
-  int* __restrict__ buckets = hash_table->mutable_buckets();
-  int* __restrict__ next = hash_table->mutable_next();
+                                                              0,
+                                                              GetHashTableLayout()));
 
   for (size_type index = 0; index < num_tuples; ++index) {
-    const hash_type hash_value = Hash<num_keys>(build_keys_values, index);
-    const int bucket_id = hash_value & mask;
-    *next = buckets[bucket_id];
-    buckets[bucket_id] = index + 1;
-    ++next;
+    hash_table->Insert(Hash<num_keys>(build_keys_values, index), index);
   }
 
   return hash_table.release();
 }
 
 template <int num_keys, typename T>
-inline void InsertIfNotPresent(const std::uint32_t mask,
-                               const Vector<const T*>& build_keys_values,
+inline void InsertIfNotPresent(const Vector<const T*>& build_keys_values,
                                const size_type tid,
-                               int* __restrict__ buckets,
-                               int* __restrict__ next) {
-  const int bucket_id = Hash<num_keys>(build_keys_values, tid) & mask;
+                               FoilHashTable* hash_table) {
+  const hash_type hash_value = Hash<num_keys>(build_keys_values, tid);
   bool exist = false;
-  for (int build_position = buckets[bucket_id] - 1;
-       build_position >= 0;
-       build_position = next[build_position] - 1) {
-    if (VectorEqualAt<num_keys>(build_keys_values,
-                                build_keys_values,
-                                tid,
-                                build_position)) {
-      exist = true;
-      break;
-    }
-  }
+  hash_table->Probe(hash_value,
+                    [&](int build_position) -> bool {
+                      exist = VectorEqualAt<num_keys>(build_keys_values,
+                                                      build_keys_values,
+                                                      tid,
+                                                      build_position);
+                      return exist;
+                    });
   if (!exist) {
-    next[tid] = buckets[bucket_id];
-    buckets[bucket_id] = tid + 1 ;
+    hash_table->Insert(hash_value, tid);
   }
 }
 
@@ -157,32 +146,23 @@ FoilHashTable* BuildHashTableAfterSemiJoinImpl(
 
   std::unique_ptr<SemiJoin> semi_join(semi_join_in);
   std::unique_ptr<FoilHashTable> hash_table(
-      new FoilHashTable(num_build_tuples, 0));
-
-  const std::uint32_t mask = hash_table->mask();
-  int* buckets = hash_table->mutable_buckets();
-  int* next = hash_table->mutable_next();
+      new FoilHashTable(num_build_tuples, 0, GetHashTableLayout()));
 
-  std::unique_ptr<SemiJoinChunk> semi_join_result(semi_join->Next());
-  while (semi_join_result != nullptr) {
-    const size_type num_result = semi_join_result->num_ones;
+  SemiJoinChunk semi_join_result;
+  while (semi_join->Next(&semi_join_result)) {
+    const size_type num_result = semi_join_result.num_ones;
     if (num_result > 0) {
-      const Vector<const cpp_type*>& build_keys_values = semi_join_result->output_columns;
-      BitVectorIterator bv_it(semi_join_result->semi_bitvector);
-      InsertIfNotPresent<num_keys>(mask,
-                                   build_keys_values,
+      const Vector<const cpp_type*>& build_keys_values = semi_join_result.output_columns;
+      BitVectorIterator bv_it(semi_join_result.semi_bitvector);
+      InsertIfNotPresent<num_keys>(build_keys_values,
                                    bv_it.GetFirst(),
-                                   buckets,
-                                   next);
+                                   hash_table.get());
       for (size_type i = 1; i < num_result; ++i) {
-        InsertIfNotPresent<num_keys>(mask,
-                                     build_keys_values,
+        InsertIfNotPresent<num_keys>(build_keys_values,
                                      bv_it.FindNext(),
-                                     buckets,
-                                     next);
+                                     hash_table.get());
       }
     }
-    semi_join_result.reset(semi_join->Next());
   }
 
   return hash_table.release();
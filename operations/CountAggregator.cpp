@@ -9,14 +9,14 @@
 #include <memory>
 
 #include "learner/CandidateLiteralInfo.hpp"
+#include "learner/CandidateLiteralPruner.hpp"
 #include "learner/PredicateEvaluationPlan.hpp"
 #include "learner/QuickFoilTimer.hpp"
 #include "operations/Filter.hpp"
 #include "operations/HashJoin.hpp"
+#include "operations/SemiBitVectorMerger.hpp"
 #include "utility/BitVector.hpp"
-#include "utility/BitVectorBuilder.hpp"
-#include "utility/BitVectorIterator.hpp"
-#include "utility/ElementDeleter.hpp"
+#include "utility/BitVectorKernels.hpp"
 #include "utility/Macros.hpp"
 #include "utility/Vector.hpp"
 
@@ -55,50 +55,86 @@ void ResetSemiVectors(std::size_t num_binding_tuples,
 
 }  // namespace
 
-void CountAggregator::LabelBitVector(const size_type num_positive,
-                                     const Vector<size_type>& build_tids,
-                                     BitVector* bit_vector) const {
-  BitVectorBuilder result_builder(bit_vector);
-  BitVectorBuilder::buffer_type::iterator raw_bit_vector_iterator =
-      result_builder.bit_vector()->begin();
-  Vector<size_type>::const_iterator tid_it = build_tids.begin();
-  for (std::size_t block_id = 0; block_id < result_builder.num_blocks(); ++block_id) {
-    for (unsigned bit = 0; bit < 64; ++bit) {
-      *raw_bit_vector_iterator |=
-          (static_cast<BitVectorBuilder::block_type>(*tid_it < num_positive) << bit);
-      ++tid_it;
+void CountAggregator::CountRootLiteral(const size_type num_positive,
+                                       const HashJoinChunk& hash_join_chunk,
+                                       PredicateEvaluationPlan* evaluation_plan) const {
+  CandidateLiteralInfo* __restrict__ root_literal = evaluation_plan->literal;
+  BitVector* __restrict__ positive_semi_bitvector =
+      &evaluation_plan->positive_semi_bitvector;
+  BitVector* __restrict__ negative_semi_bitvector =
+      &evaluation_plan->negative_semi_bitvector;
+  DCHECK(root_literal != nullptr);
+  const std::size_t num_tuples = hash_join_chunk.build_tids.size();
+  const SelectionVector& build_tids = hash_join_chunk.build_tids;
+  const SelectionVector& build_relative_tids = hash_join_chunk.build_relative_tids;
+  for (std::size_t i = 0; i < num_tuples; ++i) {
+    if (build_tids[i] < num_positive) {
+      ++root_literal->num_binding_positive;
+      if (!positive_semi_bitvector->test_set(build_relative_tids[i])) {
+        ++root_literal->num_covered_positive;
+      }
+    } else {
+      ++root_literal->num_binding_negative;
+      if (!negative_semi_bitvector->test_set(build_relative_tids[i])) {
+        ++root_literal->num_covered_negative;
+      }
     }
-    ++raw_bit_vector_iterator;
   }
+}
 
-  for (unsigned bit = 0; bit < result_builder.bits_in_last_block(); ++bit) {
-    *raw_bit_vector_iterator |=
-        (static_cast<BitVectorBuilder::block_type>(*tid_it < num_positive) << bit);
-    ++tid_it;
+template <bool positive, bool negative>
+void CountAggregator::CountTreeNodes(const FilterChunk& filter_chunk,
+                                     PredicateEvaluationPlan* evaluation_plan) {
+  const SelectionVector& build_relative_tids =
+      filter_chunk.hash_join_chunk->build_relative_tids;
+  // Only the positive bindings are masked if both labels are counted.
+  const BitVector* label_mask = (positive && negative ? &positive_label_bit_vector_ : nullptr);
+  const int num_conjunctive_nodes =
+      evaluation_plan->tree_nodes.size() - evaluation_plan->num_atom_tree_nodes;
+  if (static_cast<int>(conjunction_bit_vectors_.size()) < num_conjunctive_nodes) {
+    conjunction_bit_vectors_.resize(num_conjunctive_nodes);
   }
-}
 
-void CountAggregator::UpdateSemiBitVector(const Vector<size_type>& build_relative_tids,
-                                          const BitVector& join_bitvector,
-                                          const std::size_t num_ones,
-                                          size_type* __restrict__ count,
-                                          BitVector* __restrict__ semi_bitvector) const {
-  if (num_ones > 0) {
-    DCHECK_EQ(build_relative_tids.size(), join_bitvector.size());
-    BitVectorIterator bv_it(join_bitvector);
-    if (!semi_bitvector->test_set(build_relative_tids[bv_it.GetFirst()])) {
-      ++*count;
+  const Vector<BitVector>& bit_vectors = *filter_chunk.bit_vectors;
+  DCHECK_EQ(evaluation_plan->num_atom_tree_nodes, static_cast<int>(bit_vectors.size()));
+  for (int i = 0; i < static_cast<int>(evaluation_plan->tree_nodes.size()); ++i) {
+    PredicateTreeNode* node = evaluation_plan->tree_nodes[i].get();
+    if (i < evaluation_plan->num_atom_tree_nodes) {
+      node->bit_vector = &bit_vectors[i];
+    } else {
+      const ConjunctivePredicateTreeNode* conjunctive_node =
+          static_cast<const ConjunctivePredicateTreeNode*>(node);
+      BitVector* conjunction_bit_vector =
+          &conjunction_bit_vectors_[i - evaluation_plan->num_atom_tree_nodes];
+      BitVectorKernels::And(*conjunctive_node->left_node->bit_vector,
+                            *conjunctive_node->right_node->bit_vector,
+                            conjunction_bit_vector);
+      node->bit_vector = conjunction_bit_vector;
     }
-    for (std::size_t i = 1; i < num_ones; ++i) {
-      if (!semi_bitvector->test_set(build_relative_tids[bv_it.FindNext()])) {
-        ++*count;
+
+    if (node->literal != nullptr && !node->literal->pruned) {
+      if (positive) {
+        BitVectorKernels::AndCountScatter<false>(*node->bit_vector,
+                                                 label_mask,
+                                                 build_relative_tids,
+                                                 &node->positive_semi_bitvector,
+                                                 &node->literal->num_binding_positive,
+                                                 &node->literal->num_covered_positive);
+      }
+      if (negative) {
+        BitVectorKernels::AndCountScatter<true>(*node->bit_vector,
+                                                label_mask,
+                                                build_relative_tids,
+                                                &node->negative_semi_bitvector,
+                                                &node->literal->num_binding_negative,
+                                                &node->literal->num_covered_negative);
       }
     }
   }
 }
 
 void CountAggregator::UpdateSemiBitVectorWithNoFilter(
-    const Vector<size_type>& build_relative_tids,
+    const SelectionVector& build_relative_tids,
     size_type* __restrict__ count,
     BitVector* __restrict__ semi_bitvector) const {
   for (size_type tid : build_relative_tids) {
@@ -108,156 +144,131 @@ void CountAggregator::UpdateSemiBitVectorWithNoFilter(
   }
 }
 
-void CountAggregator::Execute(const size_type num_positive) {
-  std::unique_ptr<FilterChunk> filter_chunk(filter_->Next());
-  DCHECK(filter_chunk != nullptr);
+void CountAggregator::PrunePlan(const HashJoinChunk& hash_join_chunk,
+                                size_type num_unseen_positive_bindings,
+                                PredicateEvaluationPlan* evaluation_plan) {
+  DCHECK(pruner_ != nullptr);
+  bool all_pruned = true;
+  if (evaluation_plan->literal != nullptr) {
+    CandidateLiteralInfo* root_literal = evaluation_plan->literal;
+    if (!root_literal->pruned) {
+      root_literal->pruned = pruner_->IsHopeless(*root_literal, num_unseen_positive_bindings);
+    }
+    all_pruned = root_literal->pruned;
+  }
+  for (const PredicateTreeNodePtr& tree_node : evaluation_plan->tree_nodes) {
+    CandidateLiteralInfo* literal = tree_node->literal;
+    if (literal != nullptr) {
+      if (!literal->pruned) {
+        literal->pruned = pruner_->IsHopeless(*literal, num_unseen_positive_bindings);
+      }
+      all_pruned = all_pruned && literal->pruned;
+    }
+  }
+
+  if (all_pruned) {
+    evaluation_plan->pruned = true;
+    filter_->SkipJoinGroup(hash_join_chunk.table_id, hash_join_chunk.join_group_id);
+  }
+}
+
+void CountAggregator::MergeAllSemiBitVectors() {
+  if (merger_ == nullptr) {
+    return;
+  }
+  for (std::size_t table_id = 0; table_id < score_plans_.size(); ++table_id) {
+    for (std::size_t join_group_id = 0; join_group_id < score_plans_[table_id].size(); ++join_group_id) {
+      merger_->Merge(table_id, join_group_id, &score_plans_[table_id][join_group_id]);
+    }
+  }
+}
 
-  do {
-    const HashJoinChunk* hash_join_chunk = filter_chunk->hash_join_chunk.get();
+void CountAggregator::Count(const size_type num_positive) {
+  const FilterChunk* filter_chunk = filter_->Next();
+  // The filter may produce no chunk at all if it only sees a subset of the
+  // partitions.
+  while (filter_chunk != nullptr) {
+    const HashJoinChunk* hash_join_chunk = filter_chunk->hash_join_chunk;
 
     START_TIMER(QuickFoilTimer::kCount);
     PredicateEvaluationPlan* evaluation_plan =
         &score_plans_[hash_join_chunk->table_id][hash_join_chunk->join_group_id];
     if (evaluation_plan->saved_partition_id != hash_join_chunk->partition_id) {
+      if (merger_ != nullptr) {
+        merger_->Merge(hash_join_chunk->table_id,
+                       hash_join_chunk->join_group_id,
+                       evaluation_plan);
+      }
       ResetSemiVectors<true, true>(hash_join_chunk->binding_partition_size,
                                    evaluation_plan);
       evaluation_plan->saved_partition_id = hash_join_chunk->partition_id;
+      if (pruner_ != nullptr && !evaluation_plan->pruned) {
+        PrunePlan(*hash_join_chunk,
+                  (num_unseen_positive_bindings_ == nullptr
+                       ? num_positive
+                       : (*num_unseen_positive_bindings_)[hash_join_chunk->partition_id]),
+                  evaluation_plan);
+      }
+    }
+
+    if (evaluation_plan->pruned) {
+      // A chunk produced before the join group was skipped.
+      STOP_TIMER(QuickFoilTimer::kCount);
+      filter_chunk = filter_->Next();
+      continue;
     }
 
     if (evaluation_plan->num_atom_tree_nodes == 0) {
       // Fast path.
-      CandidateLiteralInfo* __restrict__ root_literal = evaluation_plan->literal;
-      BitVector* __restrict__ positive_semi_bitvector =
-          &evaluation_plan->positive_semi_bitvector;
-      BitVector* __restrict__ negative_semi_bitvector =
-          &evaluation_plan->negative_semi_bitvector;
-      DCHECK(root_literal != nullptr);
-      const std::size_t num_tuples = hash_join_chunk->build_tids.size();
-      const Vector<size_type>& build_tids = hash_join_chunk->build_tids;
-      const Vector<size_type>& build_relative_tids = hash_join_chunk->build_relative_tids;
-      for (std::size_t i = 0; i < num_tuples; ++i) {
-        if (build_tids[i] < num_positive) {
-          ++root_literal->num_binding_positive;
-          if (!positive_semi_bitvector->test_set(build_relative_tids[i])) {
-            ++root_literal->num_covered_positive;
-          }
-        } else {
-          ++root_literal->num_binding_negative;
-          if (!negative_semi_bitvector->test_set(build_relative_tids[i])) {
-            ++root_literal->num_covered_negative;
-          }
-        }
-      }
+      CountRootLiteral(num_positive, *hash_join_chunk, evaluation_plan);
     } else {
-      BitVector unfiltered_positive_bit_vector(hash_join_chunk->build_tids.size());
-      LabelBitVector(num_positive,
-                     hash_join_chunk->build_tids,
-                     &unfiltered_positive_bit_vector);
-      BitVector unfiltered_negative_bit_vector = ~unfiltered_positive_bit_vector;
-
-      if (evaluation_plan->literal != nullptr) {
-        const size_type num_positives = unfiltered_positive_bit_vector.count();
-        const size_type num_negative = hash_join_chunk->build_tids.size() - num_positives;
-
-        evaluation_plan->literal->num_binding_positive += num_positives;
-        evaluation_plan->literal->num_binding_negative += num_negative;
-        UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                            unfiltered_positive_bit_vector,
-                            num_positives,
-                            &evaluation_plan->literal->num_covered_positive,
-                            &evaluation_plan->positive_semi_bitvector);
-        UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                            unfiltered_negative_bit_vector,
-                            num_negative,
-                            &evaluation_plan->literal->num_covered_negative,
-                            &evaluation_plan->negative_semi_bitvector);
-      }
-
-      const Vector<BitVector>& bit_vectors = filter_chunk->bit_vectors;
-      DCHECK_EQ(evaluation_plan->num_atom_tree_nodes, static_cast<int>(bit_vectors.size()));
-      for (int i = 0; i < evaluation_plan->num_atom_tree_nodes; ++i) {
-        const PredicateTreeNodePtr& node = evaluation_plan->tree_nodes[i];
-        node->bit_vector = &bit_vectors[i];
-        if (node->literal != nullptr) {
-          const BitVector positive_bitvector =
-              *node->bit_vector & unfiltered_positive_bit_vector;
-          const BitVector negative_bitvector =
-              *node->bit_vector & unfiltered_negative_bit_vector;
-
-          const size_type num_positives = positive_bitvector.count();
-          const size_type num_negative = negative_bitvector.count();
-
-          node->literal->num_binding_positive += num_positives;
-          node->literal->num_binding_negative += num_negative;
-          UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                              positive_bitvector,
-                              num_positives,
-                              &node->literal->num_covered_positive,
-                              &node->positive_semi_bitvector);
-          UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                              negative_bitvector,
-                              num_negative,
-                              &node->literal->num_covered_negative,
-                              &node->negative_semi_bitvector);
-        }
-      }
-
-      Vector<BitVector*> tmp_bit_vectors;
-      ElementDeleter<BitVector> tmp_bit_vectors_deliter(&tmp_bit_vectors);
-      for (int i = evaluation_plan->num_atom_tree_nodes;
-           i < static_cast<int>(evaluation_plan->tree_nodes.size());
-           ++i) {
-        ConjunctivePredicateTreeNode* node =
-            static_cast<ConjunctivePredicateTreeNode*>(evaluation_plan->tree_nodes[i].get());
-        tmp_bit_vectors.emplace_back(
-            new BitVector(std::move(*node->left_node->bit_vector & *node->right_node->bit_vector)));
-        node->bit_vector = tmp_bit_vectors.back();
-        if (node->literal != nullptr) {
-          const BitVector positive_bitvector =
-              *node->bit_vector & unfiltered_positive_bit_vector;
-          const BitVector negative_bitvector =
-              *node->bit_vector & unfiltered_negative_bit_vector;
-
-          const size_type num_positives = positive_bitvector.count();
-          const size_type num_negative = negative_bitvector.count();
-
-          node->literal->num_binding_positive += num_positives;
-          node->literal->num_binding_negative += num_negative;
-          UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                              positive_bitvector,
-                              num_positives,
-                              &node->literal->num_covered_positive,
-                              &node->positive_semi_bitvector);
-          UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                              negative_bitvector,
-                              num_negative,
-                              &node->literal->num_covered_negative,
-                              &node->negative_semi_bitvector);
-        }
+      if (evaluation_plan->literal != nullptr && !evaluation_plan->literal->pruned) {
+        CountRootLiteral(num_positive, *hash_join_chunk, evaluation_plan);
       }
+      BitVectorKernels::LessThan(hash_join_chunk->build_tids,
+                                 num_positive,
+                                 &positive_label_bit_vector_);
+      CountTreeNodes<true, true>(*filter_chunk, evaluation_plan);
     }
     STOP_TIMER(QuickFoilTimer::kCount);
 
-    filter_chunk.reset(filter_->Next());
-  } while (filter_chunk != nullptr);
+    filter_chunk = filter_->Next();
+  }
 }
 
 
 template <bool positive>
-void CountAggregator::ExecuteOnOneLabel() {
-  std::unique_ptr<FilterChunk> filter_chunk(filter_->Next());
-  DCHECK(filter_chunk != nullptr);
-
-  do {
+void CountAggregator::CountOneLabel() {
+  const FilterChunk* filter_chunk = filter_->Next();
+  // The filter may produce no chunk at all if it only sees a subset of the
+  // partitions.
+  while (filter_chunk != nullptr) {
     START_TIMER(QuickFoilTimer::kCount);
 
-    const HashJoinChunk* hash_join_chunk = filter_chunk->hash_join_chunk.get();
+    const HashJoinChunk* hash_join_chunk = filter_chunk->hash_join_chunk;
     PredicateEvaluationPlan* evaluation_plan =
         &score_plans_[hash_join_chunk->table_id][hash_join_chunk->join_group_id];
     if (evaluation_plan->saved_partition_id != hash_join_chunk->partition_id) {
+      if (merger_ != nullptr) {
+        merger_->Merge(hash_join_chunk->table_id,
+                       hash_join_chunk->join_group_id,
+                       evaluation_plan);
+      }
       ResetSemiVectors<positive, !positive>(hash_join_chunk->binding_partition_size,
                                             evaluation_plan);
       evaluation_plan->saved_partition_id = hash_join_chunk->partition_id;
+      // The positive counts are complete once the negative bindings are
+      // counted, while nothing can be pruned before.
+      if (!positive && pruner_ != nullptr && !evaluation_plan->pruned) {
+        PrunePlan(*hash_join_chunk, 0, evaluation_plan);
+      }
+    }
+
+    if (evaluation_plan->pruned) {
+      // A chunk produced before the join group was skipped.
+      STOP_TIMER(QuickFoilTimer::kCount);
+      filter_chunk = filter_->Next();
+      continue;
     }
 
     if (evaluation_plan->num_atom_tree_nodes == 0) {
@@ -284,7 +295,7 @@ void CountAggregator::ExecuteOnOneLabel() {
         }
       }
     } else {
-      if (evaluation_plan->literal != nullptr) {
+      if (evaluation_plan->literal != nullptr && !evaluation_plan->literal->pruned) {
         if (positive) {
           evaluation_plan->literal->num_binding_positive += hash_join_chunk->build_tids.size();
           UpdateSemiBitVectorWithNoFilter(hash_join_chunk->build_relative_tids,
@@ -298,74 +309,30 @@ void CountAggregator::ExecuteOnOneLabel() {
         }
       }
 
-      const Vector<BitVector>& bit_vectors = filter_chunk->bit_vectors;
-      DCHECK_EQ(evaluation_plan->num_atom_tree_nodes, static_cast<int>(bit_vectors.size()));
-      for (int i = 0; i < evaluation_plan->num_atom_tree_nodes; ++i) {
-        const PredicateTreeNodePtr& node = evaluation_plan->tree_nodes[i];
-        node->bit_vector = &bit_vectors[i];
-        if (node->literal != nullptr) {
-          if (positive) {
-            const size_type num_positives = node->bit_vector->count();
-            node->literal->num_binding_positive += num_positives;
-            UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                                *node->bit_vector,
-                                num_positives,
-                                &node->literal->num_covered_positive,
-                                &node->positive_semi_bitvector);
-          } else {
-            const size_type num_negative = node->bit_vector->count();
-            node->literal->num_binding_negative += num_negative;
-            UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                                *node->bit_vector,
-                                num_negative,
-                                &node->literal->num_covered_negative,
-                                &node->negative_semi_bitvector);
-          }
-        }
-      }
-
-      Vector<BitVector*> tmp_bit_vectors;
-      ElementDeleter<BitVector> tmp_bit_vectors_deliter(&tmp_bit_vectors);
-      for (int i = evaluation_plan->num_atom_tree_nodes;
-           i < static_cast<int>(evaluation_plan->tree_nodes.size());
-           ++i) {
-        ConjunctivePredicateTreeNode* node =
-            static_cast<ConjunctivePredicateTreeNode*>(evaluation_plan->tree_nodes[i].get());
-        tmp_bit_vectors.emplace_back(
-            new BitVector(std::move(*node->left_node->bit_vector & *node->right_node->bit_vector)));
-        node->bit_vector = tmp_bit_vectors.back();
-        if (node->literal != nullptr) {
-          if (positive) {
-            const size_type num_positives = node->bit_vector->count();
-            node->literal->num_binding_positive += num_positives;
-            UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                                *node->bit_vector,
-                                num_positives,
-                                &node->literal->num_covered_positive,
-                                &node->positive_semi_bitvector);
-          } else {
-            const size_type num_negative = node->bit_vector->count();
-            node->literal->num_binding_negative += num_negative;
-            UpdateSemiBitVector(hash_join_chunk->build_relative_tids,
-                                *node->bit_vector,
-                                num_negative,
-                                &node->literal->num_covered_negative,
-                                &node->negative_semi_bitvector);
-          }
-        }
-      }
+      CountTreeNodes<positive, !positive>(*filter_chunk, evaluation_plan);
     }
     STOP_TIMER(QuickFoilTimer::kCount);
-    filter_chunk.reset(filter_->Next());
-  } while (filter_chunk != nullptr);
+    filter_chunk = filter_->Next();
+  }
+}
+
+void CountAggregator::Execute(const size_type num_positive) {
+  Count(num_positive);
+  Finish();
 }
 
 void CountAggregator::ExecuteOnPositives() {
-  ExecuteOnOneLabel<true>();
+  CountOnPositives();
+  Finish();
 }
 
 void CountAggregator::ExecuteOnNegatives() {
-  ExecuteOnOneLabel<false>();
+  CountOneLabel<false>();
+  Finish();
+}
+
+void CountAggregator::CountOnPositives() {
+  CountOneLabel<true>();
 }
 
 }  // namespace quickfoil
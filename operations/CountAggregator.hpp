@@ -10,17 +10,42 @@
 
 #include "learner/PredicateEvaluationPlan.hpp"
 #include "operations/Filter.hpp"
+#include "operations/HashJoin.hpp"
+#include "utility/BitVector.hpp"
 #include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
 #include "utility/Vector.hpp"
 
 namespace quickfoil {
 
+class CandidateLiteralPruner;
+class SemiBitVectorMerger;
+
 class CountAggregator {
  public:
+  // If <merger> is not null, the semi-bitvectors of every partition are passed
+  // to it once the aggregator is done with the partition.
   CountAggregator(Filter* filter,
-                  Vector<Vector<PredicateEvaluationPlan>>&& score_plans)
+                  Vector<Vector<PredicateEvaluationPlan>>&& score_plans,
+                  SemiBitVectorMerger* merger = nullptr)
       : filter_(filter),
-        score_plans_(std::move(score_plans)) {}
+        score_plans_(std::move(score_plans)),
+        merger_(merger) {}
+
+  // Stops counting the literals found hopeless by <pruner> when the
+  // aggregator moves to a new partition of their plans, and skips the join
+  // groups whose literals are all pruned. The negative bindings are expected
+  // to be counted after all the positive ones by ExecuteOnNegatives(), or
+  // together with them by Execute(). In the latter case,
+  // <num_unseen_positive_bindings>, if not null, has for every partition of
+  // the bindings the number of the positive bindings in the partition and in
+  // the following ones, and the partitions must be processed in order.
+  // Does not take ownership of <pruner> and <num_unseen_positive_bindings>.
+  void set_pruner(const CandidateLiteralPruner* pruner,
+                  const Vector<size_type>* num_unseen_positive_bindings = nullptr) {
+    pruner_ = pruner;
+    num_unseen_positive_bindings_ = num_unseen_positive_bindings;
+  }
 
   void Execute(const size_type num_positive);
 
@@ -28,26 +53,60 @@ class CountAggregator {
 
   void ExecuteOnNegatives();
 
- private:
-  template <bool positive>
-  void ExecuteOnOneLabel();
+  // Count() and CountOnPositives() are the steps of Execute() and
+  // ExecuteOnPositives() before Finish(): they count the chunks of the filter
+  // until it has none left. They can be called again if the filter may have
+  // more chunks later, as when its chunks are relayed by a PartitionAssigner.
+  // Finish() must be called once after the last chunk.
+  void Count(const size_type num_positive);
 
-  void LabelBitVector(const size_type num_positive,
-                      const Vector<size_type>& build_tids,
-                      BitVector* bit_vector) const;
+  void CountOnPositives();
 
-  void UpdateSemiBitVector(const Vector<size_type>& build_relative_tids,
-                           const BitVector& join_bitvector,
-                           const std::size_t num_ones,
-                           size_type* count,
-                           BitVector* semi_bitvector) const;
+  void Finish() {
+    MergeAllSemiBitVectors();
+  }
 
-  void UpdateSemiBitVectorWithNoFilter(const Vector<size_type>& build_relative_tids,
+ private:
+  template <bool positive>
+  void CountOneLabel();
+
+  // Counts the bindings of the root literal of <evaluation_plan>, which are
+  // not filtered.
+  void CountRootLiteral(const size_type num_positive,
+                        const HashJoinChunk& hash_join_chunk,
+                        PredicateEvaluationPlan* evaluation_plan) const;
+
+  // Counts the bindings of the literals on the tree nodes of <evaluation_plan>.
+  // If both labels are counted, positive_label_bit_vector_ must be set for the
+  // chunk.
+  template <bool positive, bool negative>
+  void CountTreeNodes(const FilterChunk& filter_chunk,
+                      PredicateEvaluationPlan* evaluation_plan);
+
+  // Marks the literals of <evaluation_plan> found hopeless by pruner_ as
+  // pruned, given that at most <num_unseen_positive_bindings> positive
+  // bindings are not counted yet. If all of them are pruned, marks the plan
+  // as pruned and skips the rest of its join group.
+  void PrunePlan(const HashJoinChunk& hash_join_chunk,
+                 size_type num_unseen_positive_bindings,
+                 PredicateEvaluationPlan* evaluation_plan);
+
+  void MergeAllSemiBitVectors();
+
+  void UpdateSemiBitVectorWithNoFilter(const SelectionVector& build_relative_tids,
                                        size_type* count,
                                        BitVector* semi_bitvector) const;
 
   std::unique_ptr<Filter> filter_;
   Vector<Vector<PredicateEvaluationPlan>> score_plans_;
+  SemiBitVectorMerger* merger_;
+  const CandidateLiteralPruner* pruner_ = nullptr;
+  const Vector<size_type>* num_unseen_positive_bindings_ = nullptr;
+
+  // Scratch bit vectors reused across the chunks: whether each binding of the
+  // chunk is positive, and the results of the conjunctive tree nodes.
+  BitVector positive_label_bit_vector_;
+  Vector<BitVector> conjunction_bit_vectors_;
 
   DISALLOW_COPY_AND_ASSIGN(CountAggregator);
 };
@@ -16,14 +16,11 @@
 
 namespace quickfoil {
 
+// The output of a Filter. The chunk is owned by the Filter and recycled across
+// the calls of Next().
 struct FilterChunk {
-  FilterChunk(HashJoinChunk* hash_join_chunk_in,
-              const Vector<BitVector>& bit_vectors_in)
-      : hash_join_chunk(hash_join_chunk_in),
-        bit_vectors(bit_vectors_in) {}
-
-  std::unique_ptr<HashJoinChunk> hash_join_chunk;
-  const Vector<BitVector>& bit_vectors;
+  const HashJoinChunk* hash_join_chunk = nullptr;
+  const Vector<BitVector>* bit_vectors = nullptr;
 };
 
 class Filter {
@@ -38,11 +35,20 @@ class Filter {
       : predicate_groups_(predicate_groups),
         hash_join_(hash_join) {}
 
-  FilterChunk* Next();
+  // Returns the filter results of the next chunk of the join, or nullptr if
+  // there is none left. The chunk is valid until the next call.
+  const FilterChunk* Next();
+
+  // Stops producing the chunks of the join group <join_group_id> of the table
+  // <table_id>. The chunks already produced are not affected.
+  void SkipJoinGroup(int table_id, int join_group_id) {
+    hash_join_->SkipJoinGroup(table_id, join_group_id);
+  }
 
  private:
   Vector<Vector<Vector<FoilFilterPredicate>>> predicate_groups_;
   Vector<BitVector> bit_vectors_;
+  FilterChunk chunk_;
   std::unique_ptr<HashJoin> hash_join_;
 
   DISALLOW_COPY_AND_ASSIGN(Filter);
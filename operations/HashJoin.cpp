@@ -5,36 +5,35 @@
 
 #include "operations/HashJoin.hpp"
 
-#include <memory>
+#include <algorithm>
+#include <cstddef>
 
 #include "learner/QuickFoilTimer.hpp"
 #include "operations/PartitionAssigner.hpp"
 #include "storage/FoilHashTable.hpp"
+#include "storage/PartitionTuple.hpp"
 #include "utility/Hash.hpp"
 #include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
 #include "utility/Vector.hpp"
 
-#include "gflags/gflags.h"
+#include "glog/logging.h"
 
 namespace quickfoil {
 
-DECLARE_int32(num_radix_bits);
-
-HashJoinChunk* HashJoin::Next() {
-  std::unique_ptr<const PartitionChunk> partition_chunk;
-  Vector<size_type> probe_tids;
-  Vector<size_type> build_tids;
-  Vector<size_type> build_relative_tids;
+const HashJoinChunk* HashJoin::Next() {
+  const PartitionChunk* partition_chunk = &partition_chunk_;
+  std::size_t num_results = 0;
 
   do {
-    partition_chunk.reset(assigner_->Next());
-    if (partition_chunk == nullptr) {
+    if (!assigner_->Next(&partition_chunk_)) {
       return nullptr;
     }
 
-    const partition_tuple_type* __restrict__ probe_partition =
-        partition_chunk->partition->as_type<partition_tuple_type>();
-    if (build_partitions_[partition_chunk->partition_id]->num_tuples() == 0) {
+    const partition_tuple_type* __restrict__ probe_partition = partition_chunk->tuples;
+    const std::size_t build_partition_size =
+        build_partitions_[partition_chunk->partition_id]->num_tuples();
+    if (build_partition_size == 0) {
       continue;
     }
 
@@ -43,46 +42,103 @@ HashJoinChunk* HashJoin::Next() {
         build_partitions_[partition_chunk->partition_id]->as_type<partition_tuple_type>();
     const FoilHashTable& build_hash_table = build_hash_tables_[partition_chunk->partition_id];
 
-    const int* __restrict__ next = build_hash_table.next();
-    const int* __restrict__ buckets = build_hash_table.buckets();
-
-    std::uint32_t mask = build_hash_table.mask();
-    const std::size_t num_tuples = partition_chunk->partition->num_tuples();
-
-    probe_tids.reserve(num_tuples);
-    build_tids.reserve(num_tuples);
-    build_relative_tids.reserve(num_tuples);
-    for (std::size_t tid = 0; tid < num_tuples; ++tid) {
-      const hash_type hash_value = Hash(probe_partition->value);
-      const int bucket_id = (hash_value & mask) >> FLAGS_num_radix_bits;
-      for (int build_partition_position = buckets[bucket_id] - 1;
-           build_partition_position >= 0;
-           build_partition_position = next[build_partition_position] - 1) {
-        DCHECK_LT(build_partition_position,
-                  static_cast<int>(build_partitions_[partition_chunk->partition_id]->num_tuples()));
-        if (equality_operator_(build_partition[build_partition_position].value,
-                               probe_partition->value)) {
-          build_tids.emplace_back(build_partition[build_partition_position].tuple_id);
-          probe_tids.emplace_back(probe_partition->tuple_id);
-          build_relative_tids.emplace_back(build_partition_position);
-        }
+    // A probe tuple matches at most all the tuples of the build partition, so
+    // the results of a batch fit into the selection vectors without any
+    // capacity check if there is room for <batch_size> * <build_partition_size>
+    // more results. The vectors are grown to the bound unless it is larger than
+    // a chunk, in which case the capacity is checked per result instead.
+    const std::size_t num_tuples = partition_chunk->num_tuples;
+    for (std::size_t tid = 0; tid < num_tuples; tid += FoilHashTable::kProbeBatchSize) {
+      const std::size_t batch_size =
+          std::min(static_cast<std::size_t>(FoilHashTable::kProbeBatchSize), num_tuples - tid);
+      const std::size_t max_num_batch_results = batch_size * build_partition_size;
+      if (num_results + max_num_batch_results > chunk_.probe_tids.capacity() &&
+          max_num_batch_results <= static_cast<std::size_t>(FLAGS_partition_chunck_size)) {
+        chunk_.set_size(num_results);
+        chunk_.Reserve(num_results + max_num_batch_results);
+      }
+      if (num_results + max_num_batch_results <= chunk_.probe_tids.capacity()) {
+        ProbeTuples<false>(probe_partition + tid,
+                           batch_size,
+                           build_partition,
+                           build_hash_table,
+                           &num_results);
+      } else {
+        ProbeTuples<true>(probe_partition + tid,
+                          batch_size,
+                          build_partition,
+                          build_hash_table,
+                          &num_results);
       }
-      ++probe_partition;
     }
 
     STOP_TIMER(QuickFoilTimer::kHashJoin);
 
-  } while (build_tids.empty());
-
-  return new HashJoinChunk(partition_chunk->table_id,
-                           partition_chunk->join_group_id,
-                           partition_chunk->partition_id,
-                           build_partitions_[partition_chunk->partition_id]->num_tuples(),
-                           partition_chunk->columns,
-                           build_columns_,
-                           std::move(probe_tids),
-                           std::move(build_tids),
-                           std::move(build_relative_tids));
+  } while (num_results == 0);
+
+  chunk_.set_size(num_results);
+  chunk_.table_id = partition_chunk->table_id;
+  chunk_.join_group_id = partition_chunk->join_group_id;
+  chunk_.partition_id = partition_chunk->partition_id;
+  chunk_.binding_partition_size =
+      build_partitions_[partition_chunk->partition_id]->num_tuples();
+  chunk_.probe_columns = partition_chunk->columns;
+  chunk_.build_columns = &build_columns_;
+  return &chunk_;
+}
+
+template <bool check_capacity>
+void HashJoin::ProbeTuples(const partition_tuple_type* probe_tuples,
+                           std::size_t num_probe_tuples,
+                           const partition_tuple_type* build_partition,
+                           const FoilHashTable& build_hash_table,
+                           std::size_t* num_results) {
+  DCHECK_LE(num_probe_tuples, static_cast<std::size_t>(FoilHashTable::kProbeBatchSize));
+  std::size_t num_chunk_results = *num_results;
+  size_type* __restrict__ probe_tids = chunk_.probe_tids.mutable_data();
+  size_type* __restrict__ build_tids = chunk_.build_tids.mutable_data();
+  size_type* __restrict__ build_relative_tids = chunk_.build_relative_tids.mutable_data();
+
+  const auto join_tuple = [&](const partition_tuple_type& probe_tuple,
+                              int build_partition_position) -> bool {
+    if (equality_operator_(build_partition[build_partition_position].value,
+                           probe_tuple.value)) {
+      if (check_capacity && num_chunk_results == chunk_.probe_tids.capacity()) {
+        chunk_.set_size(num_chunk_results);
+        chunk_.Reserve(num_chunk_results + 1);
+        probe_tids = chunk_.probe_tids.mutable_data();
+        build_tids = chunk_.build_tids.mutable_data();
+        build_relative_tids = chunk_.build_relative_tids.mutable_data();
+      }
+      DCHECK_LT(num_chunk_results, chunk_.probe_tids.capacity());
+      build_tids[num_chunk_results] = build_partition[build_partition_position].tuple_id;
+      probe_tids[num_chunk_results] = probe_tuple.tuple_id;
+      build_relative_tids[num_chunk_results] = build_partition_position;
+      ++num_chunk_results;
+    }
+    return false;
+  };
+
+  if (num_probe_tuples == static_cast<std::size_t>(FoilHashTable::kProbeBatchSize)) {
+    hash_type hash_values[FoilHashTable::kProbeBatchSize];
+    for (int i = 0; i < FoilHashTable::kProbeBatchSize; ++i) {
+      hash_values[i] = HashKey(probe_tuples[i].value);
+    }
+    build_hash_table.ProbeBatch(
+        hash_values,
+        [&](int i, int build_partition_position) -> bool {
+          return join_tuple(probe_tuples[i], build_partition_position);
+        });
+  } else {
+    for (std::size_t i = 0; i < num_probe_tuples; ++i) {
+      build_hash_table.Probe(
+          HashKey(probe_tuples[i].value),
+          [&](int build_partition_position) -> bool {
+            return join_tuple(probe_tuples[i], build_partition_position);
+          });
+    }
+  }
+  *num_results = num_chunk_results;
 }
 
 }  // namespace quickfoil
@@ -6,6 +6,7 @@
 #ifndef QUICKFOIL_OPERATIONS_HASHJOIN_HPP_
 #define QUICKFOIL_OPERATIONS_HASHJOIN_HPP_
 
+#include <cstddef>
 #include <memory>
 
 #include "expressions/OperatorTraits.hpp"
@@ -14,39 +15,37 @@
 #include "operations/PartitionAssigner.hpp"
 #include "storage/TableView.hpp"
 #include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
 #include "utility/Vector.hpp"
 
 namespace quickfoil {
 
+// The output of a HashJoin. The chunk and its selection vectors are owned by
+// the HashJoin and recycled across the calls of Next().
 struct HashJoinChunk {
-  HashJoinChunk(int table_id_in,
-                int join_group_id_in,
-                int partition_id_in,
-                size_type binding_partition_size_in,
-                const Vector<ConstBufferPtr>& probe_columns_in,
-                const Vector<ConstBufferPtr>& build_columns_in,
-                Vector<size_type>&& probe_tids_in,
-                Vector<size_type>&& build_tids_in,
-                Vector<size_type>&& build_relative_tids_in)
-      : table_id(table_id_in),
-        join_group_id(join_group_id_in),
-        partition_id(partition_id_in),
-        binding_partition_size(binding_partition_size_in),
-        probe_columns(probe_columns_in),
-        build_columns(build_columns_in),
-        probe_tids(std::move(probe_tids_in)),
-        build_tids(std::move(build_tids_in)),
-        build_relative_tids(std::move(build_relative_tids_in)) {}
-
-  int table_id;
-  int join_group_id;
-  int partition_id;
-  size_type binding_partition_size;
-  const Vector<ConstBufferPtr>& probe_columns;
-  const Vector<ConstBufferPtr>& build_columns;
-  Vector<size_type> probe_tids;
-  Vector<size_type> build_tids;
-  Vector<size_type> build_relative_tids;
+  // Makes the capacity of the selection vectors at least <capacity>.
+  void Reserve(std::size_t capacity) {
+    probe_tids.Reserve(capacity);
+    build_tids.Reserve(capacity);
+    build_relative_tids.Reserve(capacity);
+  }
+
+  void set_size(std::size_t size) {
+    probe_tids.set_size(size);
+    build_tids.set_size(size);
+    build_relative_tids.set_size(size);
+  }
+
+  int table_id = 0;
+  int join_group_id = 0;
+  int partition_id = 0;
+  size_type binding_partition_size = 0;
+  const Vector<ConstBufferPtr>* probe_columns = nullptr;
+  const Vector<ConstBufferPtr>* build_columns = nullptr;
+  SelectionVector probe_tids;
+  SelectionVector build_tids;
+  // The positions of the build tuples in the build partition.
+  SelectionVector build_relative_tids;
 };
 
 class HashJoin {
@@ -59,12 +58,35 @@ class HashJoin {
       : assigner_(assigner),
         build_columns_(build_table.columns()),
         build_hash_tables_(build_table.hash_tables_at(build_column_id)),
-        build_partitions_(build_table.partitions_at(build_column_id)) {}
+        build_partitions_(build_table.partitions_at(build_column_id)) {
+    chunk_.Reserve(FLAGS_partition_chunck_size);
+  }
 
-  HashJoinChunk* Next();
+  // Returns the next non-empty chunk of the join results, or nullptr if there
+  // is none left. The chunk is valid until the next call.
+  const HashJoinChunk* Next();
+
+  // Stops joining the tuples of the join group <join_group_id> of the table
+  // <table_id>.
+  void SkipJoinGroup(int table_id, int join_group_id) {
+    assigner_->SkipJoinGroup(table_id, join_group_id);
+  }
 
  private:
+  // Probes <num_probe_tuples> (at most a batch of) tuples and appends the
+  // results to chunk_ from position <*num_results> on. Grows the selection
+  // vectors as needed if <check_capacity> is true, otherwise they must have
+  // room for all the possible results.
+  template <bool check_capacity>
+  void ProbeTuples(const partition_tuple_type* probe_tuples,
+                   std::size_t num_probe_tuples,
+                   const partition_tuple_type* build_partition,
+                   const FoilHashTable& build_hash_table,
+                   std::size_t* num_results);
+
   std::unique_ptr<PartitionAssigner> assigner_;
+  PartitionChunk partition_chunk_;
+  HashJoinChunk chunk_;
   const Vector<ConstBufferPtr>& build_columns_;
   const Vector<FoilHashTable>& build_hash_tables_;
   const Vector<ConstBufferPtr>& build_partitions_;
@@ -0,0 +1,129 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "operations/HashJoin.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "memory/Buffer.hpp"
+#include "operations/BuildHashTable.hpp"
+#include "operations/PartitionAssigner.hpp"
+#include "operations/RadixPartition.hpp"
+#include "schema/TypeDefs.hpp"
+#include "storage/PartitionTuple.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_radix_bits);
+
+class HashJoinTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+  typedef HashJoin::partition_tuple_type partition_tuple_type;
+
+  // The value of the skewed build tuples, which is also the value of some
+  // probe tuples.
+  static constexpr cpp_type kSkewedValue = 7;
+
+  HashJoinTest() {
+    FLAGS_num_radix_bits = 2;
+    // Smaller than the number of the results of a batch of probe tuples that
+    // match the skewed build tuples.
+    FLAGS_partition_chunck_size = 64;
+  }
+
+  // Returns a table whose only column contains <num_skewed_tuples> tuples
+  // with the value kSkewedValue followed by <num_distinct_tuples> tuples with
+  // the values from <first_distinct_value> on. The column is partitioned.
+  static TableView* CreateTable(int num_skewed_tuples,
+                                int num_distinct_tuples,
+                                cpp_type first_distinct_value) {
+    const int num_tuples = num_skewed_tuples + num_distinct_tuples;
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+    cpp_type* values = column->mutable_as_type<cpp_type>();
+    for (int i = 0; i < num_tuples; ++i) {
+      values[i] = (i < num_skewed_tuples ? kSkewedValue
+                                         : first_distinct_value + i - num_skewed_tuples);
+    }
+    Vector<ConstBufferPtr> columns;
+    columns.emplace_back(std::make_shared<const ConstBuffer>(column));
+    TableView* table = new TableView(std::move(columns));
+    RadixPartition(0, table);
+    return table;
+  }
+
+  // Checks that <build_table> joined with <probe_table> by HashJoin produces
+  // the same pairs of tuple IDs as a nested-loop join.
+  static void CheckJoin(TableView* build_table, const TableView& probe_table) {
+    BuildHashTableOnPartitions(0, build_table);
+    // The assigner refers to <probe_tables>.
+    const Vector<const TableView*> probe_tables{&probe_table};
+    Vector<Vector<int>> probe_column_ids(1);
+    probe_column_ids[0].emplace_back(0);
+    HashJoin hash_join(*build_table,
+                       0,
+                       new PartitionAssigner(probe_tables, probe_column_ids));
+
+    Vector<std::pair<size_type, size_type>> results;
+    const HashJoinChunk* chunk;
+    while ((chunk = hash_join.Next()) != nullptr) {
+      ASSERT_LT(0u, chunk->probe_tids.size());
+      const partition_tuple_type* build_partition =
+          build_table->partitions_at(0)[chunk->partition_id]->as_type<partition_tuple_type>();
+      for (std::size_t i = 0; i < chunk->probe_tids.size(); ++i) {
+        EXPECT_EQ(build_partition[chunk->build_relative_tids[i]].tuple_id, chunk->build_tids[i]);
+        results.emplace_back(chunk->probe_tids[i], chunk->build_tids[i]);
+      }
+    }
+
+    const cpp_type* probe_values = probe_table.column_at(0)->as_type<cpp_type>();
+    const cpp_type* build_values = build_table->column_at(0)->as_type<cpp_type>();
+    Vector<std::pair<size_type, size_type>> expected_results;
+    for (size_type probe_tid = 0; probe_tid < probe_table.num_tuples(); ++probe_tid) {
+      for (size_type build_tid = 0; build_tid < build_table->num_tuples(); ++build_tid) {
+        if (probe_values[probe_tid] == build_values[build_tid]) {
+          expected_results.emplace_back(probe_tid, build_tid);
+        }
+      }
+    }
+
+    std::sort(results.begin(), results.end());
+    std::sort(expected_results.begin(), expected_results.end());
+    EXPECT_TRUE(expected_results == results);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(HashJoinTest);
+};
+
+constexpr HashJoinTest::cpp_type HashJoinTest::kSkewedValue;
+
+TEST_F(HashJoinTest, SmallBuildPartitions) {
+  std::unique_ptr<TableView> build_table(CreateTable(1, 100, 20));
+  std::unique_ptr<TableView> probe_table(CreateTable(5, 150, 50));
+  CheckJoin(build_table.get(), *probe_table);
+}
+
+// A batch of probe tuples that match the skewed build partition has more
+// possible results than a chunk, so that the selection vectors are grown
+// per result.
+TEST_F(HashJoinTest, SkewedBuildPartition) {
+  std::unique_ptr<TableView> build_table(CreateTable(200, 100, 20));
+  std::unique_ptr<TableView> probe_table(CreateTable(40, 150, 50));
+  CheckJoin(build_table.get(), *probe_table);
+}
+
+}  // namespace quickfoil
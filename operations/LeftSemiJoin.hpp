@@ -40,7 +40,9 @@ class LeftSemiJoin : public SemiJoin {
         cur_probe_offset_(0) {
   }
 
-  SemiJoinChunk* Next() override;
+  using SemiJoin::Next;
+
+  bool Next(SemiJoinChunk* chunk) override;
 
  private:
   void DoSemiJoin(const size_type num_probe_tuples,
@@ -49,22 +51,25 @@ class LeftSemiJoin : public SemiJoin {
 
   size_type total_probe_tuples_;
   size_type cur_probe_offset_;
+  Vector<const cpp_type*> probe_key_values_block_;
   DISALLOW_COPY_AND_ASSIGN(LeftSemiJoin);
 };
 
 template <int num_keys>
-SemiJoinChunk* LeftSemiJoin<num_keys>::Next() {
+bool LeftSemiJoin<num_keys>::Next(SemiJoinChunk* chunk) {
   if (cur_probe_offset_ >= total_probe_tuples_) {
-    return nullptr;
+    return false;
   }
 
   const size_type num_tuples = std::min(FLAGS_semijoin_chunck_size,
                                         total_probe_tuples_ - cur_probe_offset_);
 
-  Vector<const cpp_type*> result_columns;
-  BitVector bit_vector(num_tuples);
+  BitVector* bit_vector = &chunk->semi_bitvector;
+  bit_vector->resize(num_tuples);
+  bit_vector->reset();
 
-  Vector<const cpp_type*> probe_key_values_block;
+  Vector<const cpp_type*>& probe_key_values_block = probe_key_values_block_;
+  probe_key_values_block.clear();
   for (const cpp_type* probe_key_values : probe_key_values_) {
     probe_key_values_block.emplace_back(
         probe_key_values + cur_probe_offset_);
@@ -72,15 +77,17 @@ SemiJoinChunk* LeftSemiJoin<num_keys>::Next() {
 
   DoSemiJoin(num_tuples,
              probe_key_values_block,
-             &bit_vector);
+             bit_vector);
 
+  chunk->output_columns.clear();
   for (int column_id : project_column_ids_) {
-    result_columns.emplace_back(
+    chunk->output_columns.emplace_back(
         probe_table_.column_at(column_id)->template as_type<cpp_type>() + cur_probe_offset_);
   }
+  chunk->num_ones = bit_vector->count();
   cur_probe_offset_ += FLAGS_semijoin_chunck_size;
 
-  return new SemiJoinChunk(std::move(result_columns), std::move(bit_vector));
+  return true;
 }
 
 template <int num_keys>
@@ -88,52 +95,47 @@ void LeftSemiJoin<num_keys>::DoSemiJoin(
     const size_type num_probe_tuples,
     const Vector<const cpp_type*>& probe_key_values,
     BitVector* semi_bitvector) {
-  const std::uint32_t mask = build_hash_table_.mask();
-  const int* __restrict__ buckets = build_hash_table_.buckets();
-  const int* __restrict__ next = build_hash_table_.next();
-
   BitVectorBuilder result_builder(semi_bitvector);
   BitVectorBuilder::buffer_type::iterator raw_bit_vector_iterator =
       result_builder.bit_vector()->begin();
+  static_assert(64 % FoilHashTable::kProbeBatchSize == 0,
+                "A block of the bit vector is not a whole number of probe batches");
   size_type probe_tid = 0;
+  hash_type hash_values[FoilHashTable::kProbeBatchSize];
   for (std::size_t block_id = 0; block_id < result_builder.num_blocks(); ++block_id) {
-    for (unsigned bit = 0; bit < 64; ++bit) {
-      const hash_type hash_value = Hash<num_keys>(probe_key_values, probe_tid);
-      const int bucket_id = hash_value & mask;
-      bool has_match = false;
-      for (int build_position = buckets[bucket_id] - 1;
-           build_position >= 0;
-           build_position = next[build_position] - 1) {
-        if (VectorEqualAt<num_keys>(probe_key_values,
-                                    build_key_values_,
-                                    probe_tid,
-                                    build_position)) {
-          has_match = true;
-          break;
-        }
+    for (unsigned bit = 0; bit < 64; bit += FoilHashTable::kProbeBatchSize) {
+      for (int i = 0; i < FoilHashTable::kProbeBatchSize; ++i) {
+        hash_values[i] = Hash<num_keys>(probe_key_values, probe_tid + i);
       }
-      *raw_bit_vector_iterator |=
-          (static_cast<BitVectorBuilder::block_type>(has_match) << bit);
-      ++probe_tid;
+      build_hash_table_.ProbeBatch(
+          hash_values,
+          [&](int i, int build_position) -> bool {
+            if (VectorEqualAt<num_keys>(probe_key_values,
+                                        build_key_values_,
+                                        probe_tid + i,
+                                        build_position)) {
+              *raw_bit_vector_iterator |=
+                  (static_cast<BitVectorBuilder::block_type>(1) << (bit + i));
+              return true;
+            }
+            return false;
+          });
+      probe_tid += FoilHashTable::kProbeBatchSize;
     }
     ++raw_bit_vector_iterator;
   }
 
   for (unsigned bit = 0; bit < result_builder.bits_in_last_block(); ++bit) {
-    const hash_type hash_value = Hash<num_keys>(probe_key_values, probe_tid);
-    const int bucket_id = hash_value & mask;
     bool has_match = false;
-    for (int build_position = buckets[bucket_id] - 1;
-         build_position >= 0;
-         build_position = next[build_position] - 1) {
-      if (VectorEqualAt<num_keys>(probe_key_values,
-                                  build_key_values_,
-                                  probe_tid,
-                                  build_position)) {
-        has_match = true;
-        break;
-      }
-    }
+    build_hash_table_.Probe(
+        Hash<num_keys>(probe_key_values, probe_tid),
+        [&](int build_position) -> bool {
+          has_match = VectorEqualAt<num_keys>(probe_key_values,
+                                              build_key_values_,
+                                              probe_tid,
+                                              build_position);
+          return has_match;
+        });
     *raw_bit_vector_iterator |=
         (static_cast<BitVectorBuilder::block_type>(has_match) << bit);
     ++probe_tid;
@@ -5,6 +5,9 @@
 
 #include "operations/MultiColumnHashJoin.hpp"
 
+#include <algorithm>
+#include <memory>
+
 #include "expressions/AttributeReference.hpp"
 #include "learner/QuickFoilTimer.hpp"
 #include "memory/Buffer.hpp"
@@ -118,15 +121,19 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
                                    const FoilLiteral& new_literal,
                                    const size_type num_binding_positives,
                                    const size_type num_binding_negatives,
-                                   Vector<ConstBufferPtr>* new_binding_table) {
+                                   ConstBufferPtr* binding_row_ids,
+                                   Vector<ConstBufferPtr>* new_binding_blocks) {
   typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
 
+  START_TIMER(QuickFoilTimer::kCreateBindingTable);
+
   const size_type positive_binding_size = clause->GetNumPositiveBindings();
   const size_type negative_binding_size = clause->GetNumNegativeBindings();
   const size_type background_table_size = new_literal.predicate()->GetNumTotalFacts();
 
   Vector<AttributeReference> clause_keys;
   Vector<AttributeReference> background_keys;
+  Vector<int> clause_key_ids;
   Vector<int> unbounded_vids;
 
   const int num_background_columns = new_literal.num_variables();
@@ -135,34 +142,41 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
     if (variables[i].IsBound()) {
       background_keys.emplace_back(i);
       clause_keys.emplace_back(variables[i].variable_id());
+      clause_key_ids.emplace_back(variables[i].variable_id());
     } else {
       unbounded_vids.emplace_back(i);
     }
   }
 
-  const int num_clause_columns = clause->num_variables();
-  Vector<BufferPtr> output_buffers;
+  // Only the new columns are projected. The columns of the clause are
+  // referenced by the row IDs of the joined bindings.
   const size_type num_binding_tuples = num_binding_positives + num_binding_negatives;
+  Vector<BufferPtr> output_buffers;
   const std::size_t output_buffer_bytes = sizeof(cpp_type) * num_binding_tuples;
-  for (int i = 0; i < num_clause_columns + static_cast<int>(unbounded_vids.size()); ++i) {
-    output_buffers.emplace_back(std::move(std::make_shared<Buffer>(
-        output_buffer_bytes,
-        num_binding_tuples)));
+  for (std::size_t i = 0; i < unbounded_vids.size(); ++i) {
+    output_buffers.emplace_back(std::make_shared<Buffer>(output_buffer_bytes,
+                                                         num_binding_tuples));
   }
-
   Vector<BufferPtr> output_negative_buffers;
   for (const BufferPtr& output_buffer : output_buffers) {
     output_negative_buffers.emplace_back(
-        std::move(std::make_shared<Buffer>(output_buffer,
-                                           output_buffer->mutable_as_type<cpp_type>() + num_binding_positives,
-                                           num_binding_negatives)));
+        std::make_shared<Buffer>(output_buffer,
+                                 output_buffer->mutable_as_type<cpp_type>() + num_binding_positives,
+                                 num_binding_negatives));
   }
 
+  BufferPtr row_ids(std::make_shared<Buffer>(sizeof(size_type) * num_binding_tuples,
+                                             num_binding_tuples));
+  BufferPtr negative_row_ids(
+      std::make_shared<Buffer>(row_ids,
+                               row_ids->mutable_as_type<size_type>() + num_binding_positives,
+                               num_binding_negatives));
+
   std::unique_ptr<TableView> positive_table;
   std::unique_ptr<TableView> negative_table;
   if (clause->IsBindingDataConseuctive()) {
-    positive_table.reset(new TableView(std::move(clause->CreatePositiveBlocks())));
-    negative_table.reset(new TableView(std::move(clause->CreateNegativeBlocks())));
+    positive_table.reset(new TableView(clause->CreatePositiveBlocks(clause_key_ids)));
+    negative_table.reset(new TableView(clause->CreateNegativeBlocks(clause_key_ids)));
   } else {
     positive_table.reset(new TableView(clause->positive_blocks()));
     negative_table.reset(new TableView(clause->negative_blocks()));
@@ -178,9 +192,6 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
         BuildHashTableOnTable(clause_keys, *negative_table));
 
     Vector<AttributeReference> project_expressions;
-    for (int i = 0; i < clause->num_variables(); ++i) {
-      project_expressions.emplace_back(i + num_background_columns);
-    }
     for (int unbounded_vid : unbounded_vids) {
       project_expressions.emplace_back(unbounded_vid);
     }
@@ -195,7 +206,9 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
                                              *negative_hash_table,
                                              clause_keys,
                                              &output_buffers,
-                                             &output_negative_buffers);
+                                             &output_negative_buffers,
+                                             row_ids.get(),
+                                             negative_row_ids.get());
     } else {
       hash_join.CollaborateJoin<true, true>(*positive_table,
                                             *negative_table,
@@ -203,17 +216,16 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
                                             *negative_hash_table,
                                             clause_keys,
                                             &output_buffers,
-                                            &output_negative_buffers);
+                                            &output_negative_buffers,
+                                            row_ids.get(),
+                                            negative_row_ids.get());
     }
   } else {
     std::unique_ptr<FoilHashTable> hash_table(
         BuildHashTableOnTable(background_keys, background_table));
     Vector<AttributeReference> project_expressions;
-    for (int i = 0; i < num_clause_columns; ++i) {
-      project_expressions.emplace_back(i);
-    }
     for (int unbounded_vid : unbounded_vids) {
-      project_expressions.emplace_back(unbounded_vid + num_clause_columns);
+      project_expressions.emplace_back(unbounded_vid + clause->num_variables());
     }
 
     {
@@ -224,12 +236,14 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
         hash_join.Join<false, true, false>(background_table,
                                            *hash_table,
                                            background_keys,
-                                           &output_buffers);
+                                           &output_buffers,
+                                           row_ids.get());
       } else {
         hash_join.Join<false, true, true>(background_table,
                                           *hash_table,
                                           background_keys,
-                                          &output_buffers);
+                                          &output_buffers,
+                                          row_ids.get());
       }
     }
 
@@ -240,19 +254,23 @@ void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
       hash_join.Join<false, true, false>(background_table,
                                          *hash_table,
                                          background_keys,
-                                         &output_negative_buffers);
+                                         &output_negative_buffers,
+                                         negative_row_ids.get());
     } else {
       hash_join.Join<false, true, true>(background_table,
                                         *hash_table,
                                         background_keys,
-                                        &output_negative_buffers);
+                                        &output_negative_buffers,
+                                        negative_row_ids.get());
     }
   }
 
+  *binding_row_ids = std::make_shared<const ConstBuffer>(row_ids);
   for (const BufferPtr& output_buffer : output_buffers) {
-    new_binding_table->emplace_back(std::move(std::make_shared<const ConstBuffer>(
-        output_buffer)));
+    new_binding_blocks->emplace_back(std::make_shared<const ConstBuffer>(output_buffer));
   }
+
+  STOP_TIMER(QuickFoilTimer::kCreateBindingTable);
 }
 
 template <bool resizeable, bool populate_probe_tids, bool populate_build_tids>
@@ -260,8 +278,10 @@ void MultiColumnHashJoin::Join(
     const TableView& build_table,
     const FoilHashTable& hash_table,
     const Vector<AttributeReference>& build_keys,
-    Vector<BufferPtr>* output_buffers) {
+    Vector<BufferPtr>* output_buffers,
+    Buffer* output_probe_tids) {
   DCHECK_EQ(project_expressions_.size(), output_buffers->size());
+  DCHECK(output_probe_tids == nullptr || (populate_probe_tids && !resizeable));
 
   Vector<const cpp_type*> build_keys_values;
   for (const AttributeReference& build_key : build_keys) {
@@ -276,37 +296,43 @@ void MultiColumnHashJoin::Join(
       JoinImpl<resizeable, 1, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
     case 2:
       JoinImpl<resizeable, 2, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
     case 3:
       JoinImpl<resizeable, 3, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
     case 4:
       JoinImpl<resizeable, 4, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
     case 5:
       JoinImpl<resizeable, 5, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
     default:
       JoinImpl<resizeable, 6, populate_probe_tids, populate_build_tids>(build_table,
                                                                         hash_table,
                                                                         build_keys_values,
-                                                                        output_buffers);
+                                                                        output_buffers,
+                                                                        output_probe_tids);
       return;
   }
 }
@@ -318,8 +344,12 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                           const FoilHashTable& right_hash_table,
                                           const Vector<AttributeReference>& build_keys,
                                           Vector<BufferPtr>* left_output_buffers,
-                                          Vector<BufferPtr>* right_output_buffers) {
+                                          Vector<BufferPtr>* right_output_buffers,
+                                          Buffer* left_output_build_tids,
+                                          Buffer* right_output_build_tids) {
   DCHECK_EQ(project_expressions_.size(), left_output_buffers->size());
+  DCHECK((left_output_build_tids == nullptr) == (right_output_build_tids == nullptr));
+  DCHECK(left_output_build_tids == nullptr || populate_build_tids);
   DCHECK_EQ(project_expressions_.size(), right_output_buffers->size());
 
   Vector<const cpp_type*> left_build_keys_values;
@@ -347,7 +377,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
     case 2:
       CollaborateJoinImpl<2, populate_probe_tids, populate_build_tids>(left_build_table,
@@ -357,7 +389,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
     case 3:
       CollaborateJoinImpl<3, populate_probe_tids, populate_build_tids>(left_build_table,
@@ -367,7 +401,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
     case 4:
       CollaborateJoinImpl<4, populate_probe_tids, populate_build_tids>(left_build_table,
@@ -377,7 +413,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
     case 5:
       CollaborateJoinImpl<5, populate_probe_tids, populate_build_tids>(left_build_table,
@@ -387,7 +425,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
     default:
       CollaborateJoinImpl<6, populate_probe_tids, populate_build_tids>(left_build_table,
@@ -397,7 +437,9 @@ void MultiColumnHashJoin::CollaborateJoin(const TableView& left_build_table,
                                                                        left_build_keys_values,
                                                                        right_build_keys_values,
                                                                        left_output_buffers,
-                                                                       right_output_buffers);
+                                                                       right_output_buffers,
+                                                                       left_output_build_tids,
+                                                                       right_output_build_tids);
       return;
   }
 }
@@ -406,7 +448,8 @@ template <bool resizeable, int num_keys, bool populate_probe_tids, bool populate
 void MultiColumnHashJoin::JoinImpl(const TableView& build_table,
                                    const FoilHashTable& hash_table,
                                    const Vector<const cpp_type*> build_key_values,
-                                   Vector<BufferPtr>* output_buffers) {
+                                   Vector<BufferPtr>* output_buffers,
+                                   Buffer* output_probe_tids) {
   static_assert(populate_build_tids || populate_probe_tids,
                 "At least one side of tuple ids needs to be populated");
 
@@ -468,6 +511,13 @@ void MultiColumnHashJoin::JoinImpl(const TableView& build_table,
                                               output_offset,
                                               (*output_buffers)[i].get());
     }
+    if (output_probe_tids != nullptr) {
+      size_type* __restrict__ output_tids =
+          output_probe_tids->mutable_as_type<size_type>() + output_offset;
+      for (const size_type probe_tid : probe_tids) {
+        *output_tids++ = probe_tuple_offset + probe_tid;
+      }
+    }
 
     if (populate_build_tids) {
       output_offset += build_tids.size();
@@ -501,29 +551,23 @@ void MultiColumnHashJoin::DoBlockJoin(
     const FoilHashTable& hash_table,
     Vector<size_type>* probe_tids,
     Vector<size_type>* build_tids) {
-  const std::uint32_t mask = hash_table.mask();
-  const int* __restrict__ buckets = hash_table.buckets();
-  const int* __restrict__ next = hash_table.next();
-
   for (size_type probe_tid = 0; probe_tid < num_probe_values; ++probe_tid) {
-    const hash_type hash_value = Hash<num_keys>(probe_values, probe_tid);
-    const int bucket_id = hash_value & mask;
-
-    for (int build_position = buckets[bucket_id] - 1;
-         build_position >= 0;
-         build_position = next[build_position] - 1) {
-      if (VectorEqualAt<num_keys>(probe_values,
-                                  build_values,
-                                  probe_tid,
-                                  build_position)) {
-        if (populate_probe_tids) {
-          probe_tids->emplace_back(probe_tid);
-        }
-        if (populate_build_tids) {
-          build_tids->emplace_back(build_position);
-        }
-      }
-    }
+    hash_table.Probe(
+        Hash<num_keys>(probe_values, probe_tid),
+        [&](int build_position) -> bool {
+          if (VectorEqualAt<num_keys>(probe_values,
+                                      build_values,
+                                      probe_tid,
+                                      build_position)) {
+            if (populate_probe_tids) {
+              probe_tids->emplace_back(probe_tid);
+            }
+            if (populate_build_tids) {
+              build_tids->emplace_back(build_position);
+            }
+          }
+          return false;
+        });
   }
 }
 
@@ -535,7 +579,9 @@ void MultiColumnHashJoin::CollaborateJoinImpl(const TableView& left_build_table,
                                               const Vector<const cpp_type*>& left_build_key_values,
                                               const Vector<const cpp_type*>& right_build_key_values,
                                               Vector<BufferPtr>* left_output_buffers,
-                                              Vector<BufferPtr>* right_output_buffers) {
+                                              Vector<BufferPtr>* right_output_buffers,
+                                              Buffer* left_output_build_tids,
+                                              Buffer* right_output_build_tids) {
   static_assert(populate_build_tids || populate_probe_tids,
                 "At least one side of tuple ids needs to be populated");
 
@@ -606,6 +652,14 @@ void MultiColumnHashJoin::CollaborateJoinImpl(const TableView& left_build_table,
                                               right_output_offset,
                                               (*right_output_buffers)[i].get());
     }
+    if (left_output_build_tids != nullptr) {
+      std::copy(left_build_tids.begin(),
+                left_build_tids.end(),
+                left_output_build_tids->mutable_as_type<size_type>() + left_output_offset);
+      std::copy(right_build_tids.begin(),
+                right_build_tids.end(),
+                right_output_build_tids->mutable_as_type<size_type>() + right_output_offset);
+    }
 
     if (populate_build_tids) {
       left_output_offset += left_build_tids.size();
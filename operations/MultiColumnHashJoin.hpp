@@ -19,11 +19,16 @@
 
 namespace quickfoil {
 
+// Joins the bindings of <clause> with the background table of <new_literal>.
+// Instead of materializing the new binding table, outputs the row IDs of the
+// joined bindings of <clause> (see FoilClause::CopyWithAdditionalUnBoundBodyLiteral())
+// and the columns of the variables introduced by <new_literal>.
 void CreateLabelAwareBindingTables(const FoilClauseConstSharedPtr& clause,
                                    const FoilLiteral& new_literal,
                                    const size_type num_binding_positives,
                                    const size_type num_binding_negatives,
-                                   Vector<ConstBufferPtr>* new_binding_table);
+                                   ConstBufferPtr* binding_row_ids,
+                                   Vector<ConstBufferPtr>* new_binding_blocks);
 
 void CreateBindingTable(const FoilLiteral& new_literal,
                         const TableView& cur_binding_table,
@@ -61,12 +66,17 @@ class MultiColumnHashJoin {
     }
   }
 
+  // If <output_probe_tids> is not null, the IDs of the probe tuples of the
+  // join results are written to it as well.
   template <bool resizeable, bool populate_probe_tids, bool populate_build_tids>
   void Join(const TableView& build_table,
             const FoilHashTable& hash_table,
             const Vector<AttributeReference>& build_keys,
-            Vector<BufferPtr>* output_buffers);
+            Vector<BufferPtr>* output_buffers,
+            Buffer* output_probe_tids = nullptr);
 
+  // If <left_output_build_tids> and <right_output_build_tids> are not null,
+  // the IDs of the build tuples of the join results are written to them as well.
   template <bool populate_probe_tids, bool populate_build_tids>
   void CollaborateJoin(const TableView& left_build_table,
                        const TableView& right_build_table,
@@ -74,14 +84,17 @@ class MultiColumnHashJoin {
                        const FoilHashTable& right_hash_table,
                        const Vector<AttributeReference>& build_keys,
                        Vector<BufferPtr>* left_output_buffers,
-                       Vector<BufferPtr>* right_output_buffers);
+                       Vector<BufferPtr>* right_output_buffers,
+                       Buffer* left_output_build_tids = nullptr,
+                       Buffer* right_output_build_tids = nullptr);
 
  private:
   template <bool resizeable, int num_keys, bool populate_probe_tids, bool populate_build_tids>
   void JoinImpl(const TableView& build_table,
                 const FoilHashTable& hash_table,
                 const Vector<const cpp_type*> build_values,
-                Vector<BufferPtr>* output_buffers);
+                Vector<BufferPtr>* output_buffers,
+                Buffer* output_probe_tids);
 
   template <int num_keys, bool populate_probe_tids, bool populate_build_tids>
   void CollaborateJoinImpl(const TableView& left_build_table,
@@ -91,7 +104,9 @@ class MultiColumnHashJoin {
                            const Vector<const cpp_type*>& left_build_key_values,
                            const Vector<const cpp_type*>& right_build_key_values,
                            Vector<BufferPtr>* left_output_buffers,
-                           Vector<BufferPtr>* right_output_buffers);
+                           Vector<BufferPtr>* right_output_buffers,
+                           Buffer* left_output_build_tids,
+                           Buffer* right_output_build_tids);
 
   template <int num_keys, bool populate_probe_tids, bool populate_build_tids>
   void DoBlockJoin(
@@ -5,7 +5,10 @@
 
 #include "operations/PartitionAssigner.hpp"
 
+#include "operations/PartitionChunkScheduler.hpp"
+
 #include "gflags/gflags.h"
+#include "glog/logging.h"
 
 namespace quickfoil{
 
@@ -13,5 +16,57 @@ DEFINE_int32(partition_chunck_size,
              32768,
              "The number of tuples of a chunk in the PartitionAssigner.");
 
+PartitionAssigner::PartitionAssigner(PartitionChunkScheduler* scheduler,
+                                     int worker_id)
+    : tables_(scheduler->tables()),
+      num_partitions_(0),
+      cur_table_id_(0),
+      cur_join_group_id_(0),
+      cur_partition_id_(0),
+      cur_partition_offset_(0),
+      cur_partitions_(nullptr),
+      scheduler_(scheduler),
+      worker_id_(worker_id) {
+  DCHECK_LT(worker_id, scheduler->num_workers());
+}
+
+PartitionAssigner::PartitionAssigner(const Vector<const TableView*>& tables)
+    : tables_(tables),
+      num_partitions_(0),
+      cur_table_id_(0),
+      cur_join_group_id_(0),
+      cur_partition_id_(0),
+      cur_partition_offset_(0),
+      cur_partitions_(nullptr),
+      is_relay_(true) {}
+
+bool PartitionAssigner::NextFromScheduler(PartitionChunk* chunk) {
+  return scheduler_->Next(worker_id_, chunk);
+}
+
+void PartitionAssigner::SkipJoinGroup(int table_id, int join_group_id) {
+  if (scheduler_ != nullptr) {
+    scheduler_->SkipJoinGroup(table_id, join_group_id);
+    return;
+  }
+  if (is_relay_) {
+    // The join groups of the relayed chunks are not known in advance.
+    if (static_cast<std::size_t>(table_id) >= skipped_join_groups_.size()) {
+      skipped_join_groups_.resize(table_id + 1);
+    }
+    if (static_cast<std::size_t>(join_group_id) >= skipped_join_groups_[table_id].size()) {
+      skipped_join_groups_[table_id].resize(join_group_id + 1, false);
+    }
+    skipped_join_groups_[table_id][join_group_id] = true;
+    return;
+  }
+  if (skipped_join_groups_.empty()) {
+    for (const Vector<int>& join_group_column_ids : partition_column_ids_) {
+      skipped_join_groups_.emplace_back(join_group_column_ids.size(), false);
+    }
+  }
+  skipped_join_groups_[table_id][join_group_id] = true;
+}
+
 }  // namespace quickfoil
 
@@ -20,33 +20,45 @@
 #include "utility/Vector.hpp"
 
 #include "gflags/gflags.h"
+#include "glog/logging.h"
 
 namespace quickfoil {
 
 DECLARE_int32(partition_chunck_size);
 
+class PartitionChunkScheduler;
+
+// A range of the tuples of one partition. The chunks are filled in place by
+// the assigners, so that no memory is allocated per chunk.
 struct PartitionChunk {
-  PartitionChunk(int table_id_in,
-                 int join_group_id_in,
-                 int partition_id_in,
-                 ConstBufferPtr&& partition_in,
-                 const Vector<ConstBufferPtr>& columns_in)
-      : table_id(table_id_in),
-        join_group_id(join_group_id_in),
-        partition_id(partition_id_in),
-        partition(std::move(partition_in)),
-        columns(columns_in) {}
-
-  int table_id;
-  int join_group_id;
-  int partition_id;
-  ConstBufferPtr partition;
-  const Vector<ConstBufferPtr>& columns;
+  typedef PartitionTuple<kQuickFoilDefaultDataType> partition_tuple_type;
+
+  void Reset(int table_id_in,
+             int join_group_id_in,
+             int partition_id_in,
+             const partition_tuple_type* tuples_in,
+             std::size_t num_tuples_in,
+             const Vector<ConstBufferPtr>* columns_in) {
+    table_id = table_id_in;
+    join_group_id = join_group_id_in;
+    partition_id = partition_id_in;
+    tuples = tuples_in;
+    num_tuples = num_tuples_in;
+    columns = columns_in;
+  }
+
+  int table_id = 0;
+  int join_group_id = 0;
+  int partition_id = 0;
+  // Points into the partition, which is owned by the table.
+  const partition_tuple_type* tuples = nullptr;
+  std::size_t num_tuples = 0;
+  const Vector<ConstBufferPtr>* columns = nullptr;
 };
 
 class PartitionAssigner {
  public:
-  typedef PartitionTuple<kQuickFoilDefaultDataType> partition_tuple_type;
+  typedef PartitionChunk::partition_tuple_type partition_tuple_type;
 
   PartitionAssigner(Vector<const TableView*>&& tables,
                     Vector<Vector<int>>&& partition_column_ids)
@@ -74,36 +86,84 @@ class PartitionAssigner {
     num_partitions_ = cur_partitions_->size();
   }
 
-  PartitionChunk* Next() {
-    do {
-      START_TIMER(QuickFoilTimer::kAssigner);
-      while (cur_partition_offset_ == (*cur_partitions_)[cur_partition_id_]->num_tuples()) {
-        if (MoveToNextJoinGroup()) {
-          STOP_TIMER(QuickFoilTimer::kAssigner);
-          return nullptr;
-        }
+  // Hands out the chunks scheduled by <scheduler> to the worker <worker_id>.
+  // Does not take ownership of <scheduler>.
+  PartitionAssigner(PartitionChunkScheduler* scheduler,
+                    int worker_id);
+
+  // Hands out the chunks passed to Relay() instead, each of them once, so
+  // that the chunks handed out by another assigner on <tables> can be joined
+  // by more than one HashJoin. Next() returns false until the next Relay().
+  explicit PartitionAssigner(const Vector<const TableView*>& tables);
+
+  // Fills <chunk> with the next chunk. Returns false if there is none left.
+  bool Next(PartitionChunk* chunk) {
+    if (scheduler_ != nullptr) {
+      return NextFromScheduler(chunk);
+    }
+    if (is_relay_) {
+      if (relayed_chunk_ == nullptr) {
+        return false;
       }
+      *chunk = *relayed_chunk_;
+      relayed_chunk_ = nullptr;
+      return true;
+    }
+    if (cur_partition_id_ >= num_partitions_) {
+      return false;
+    }
 
-      const ConstBufferPtr& cur_partition = (*cur_partitions_)[cur_partition_id_];
-      const std::size_t num_partition_tuples =
-          std::min(static_cast<std::size_t>(FLAGS_partition_chunck_size),
-                   cur_partition->num_tuples() - cur_partition_offset_);
-      ConstBufferPtr partition_chunk(std::move(
-          std::make_shared<const ConstBuffer>(
-              cur_partition,
-              cur_partition->as_type<partition_tuple_type>() + cur_partition_offset_,
-              num_partition_tuples)));
-      cur_partition_offset_ += num_partition_tuples;
-      STOP_TIMER(QuickFoilTimer::kAssigner);
-      return new PartitionChunk(cur_table_id_,
-                                cur_join_group_id_,
-                                cur_partition_id_,
-                                std::move(partition_chunk),
-                                tables_[cur_table_id_]->columns());
-    } while (true);
+    START_TIMER(QuickFoilTimer::kAssigner);
+    while (cur_partition_offset_ == (*cur_partitions_)[cur_partition_id_]->num_tuples() ||
+           IsSkipped(cur_table_id_, cur_join_group_id_)) {
+      if (MoveToNextJoinGroup()) {
+        STOP_TIMER(QuickFoilTimer::kAssigner);
+        return false;
+      }
+    }
+
+    const ConstBufferPtr& cur_partition = (*cur_partitions_)[cur_partition_id_];
+    const std::size_t num_partition_tuples =
+        std::min(static_cast<std::size_t>(FLAGS_partition_chunck_size),
+                 cur_partition->num_tuples() - cur_partition_offset_);
+    chunk->Reset(cur_table_id_,
+                 cur_join_group_id_,
+                 cur_partition_id_,
+                 cur_partition->as_type<partition_tuple_type>() + cur_partition_offset_,
+                 num_partition_tuples,
+                 &tables_[cur_table_id_]->columns());
+    cur_partition_offset_ += num_partition_tuples;
+    STOP_TIMER(QuickFoilTimer::kAssigner);
+    return true;
+  }
+
+  // Hands out no more chunks of the join group <join_group_id> of the table
+  // <table_id>. If the chunks are scheduled by a PartitionChunkScheduler, the
+  // join group is skipped for all the workers.
+  void SkipJoinGroup(int table_id, int join_group_id);
+
+  // Makes <chunk> (not owned) the next chunk of a relaying assigner. The
+  // chunk must be valid until the next call of Next().
+  void Relay(const PartitionChunk& chunk) {
+    DCHECK(is_relay_);
+    relayed_chunk_ = &chunk;
+  }
+
+  // Returns true if the join group <join_group_id> of the table <table_id> is
+  // skipped by SkipJoinGroup() on this assigner.
+  bool IsJoinGroupSkipped(int table_id, int join_group_id) const {
+    return IsSkipped(table_id, join_group_id);
   }
 
  private:
+  bool NextFromScheduler(PartitionChunk* chunk);
+
+  bool IsSkipped(std::size_t table_id, std::size_t join_group_id) const {
+    return table_id < skipped_join_groups_.size() &&
+           join_group_id < skipped_join_groups_[table_id].size() &&
+           skipped_join_groups_[table_id][join_group_id];
+  }
+
   bool MoveToNextJoinGroup() {
     ++cur_join_group_id_;
     if (cur_join_group_id_ == partition_column_ids_[cur_table_id_].size() &&
@@ -131,7 +191,7 @@ class PartitionAssigner {
     cur_table_id_ = 0;
     cur_join_group_id_ = 0;
 
-    if (cur_partition_id_ == num_partitions_) {
+    if (cur_partition_id_ >= num_partitions_) {
       return true;
     }
     return false;
@@ -146,6 +206,14 @@ class PartitionAssigner {
   std::size_t cur_partition_id_;
   std::size_t cur_partition_offset_;
   const Vector<ConstBufferPtr>* cur_partitions_;
+  // Empty if no join group is skipped.
+  Vector<Vector<bool>> skipped_join_groups_;
+
+  PartitionChunkScheduler* scheduler_ = nullptr;
+  int worker_id_ = 0;
+
+  bool is_relay_ = false;
+  const PartitionChunk* relayed_chunk_ = nullptr;
 
   DISALLOW_COPY_AND_ASSIGN(PartitionAssigner);
 };
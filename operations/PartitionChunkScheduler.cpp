@@ -0,0 +1,156 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "operations/PartitionChunkScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+#include "learner/QuickFoilTimer.hpp"
+#include "memory/Buffer.hpp"
+#include "operations/PartitionAssigner.hpp"
+#include "storage/TableView.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+PartitionChunkScheduler::PartitionChunkScheduler(
+    const Vector<const TableView*>& tables,
+    const Vector<Vector<int>>& partition_column_ids,
+    int num_workers)
+    : tables_(tables),
+      partition_column_ids_(partition_column_ids) {
+  DCHECK_GT(num_workers, 0);
+  DCHECK_EQ(tables_.size(), partition_column_ids_.size());
+  num_partitions_ = tables_[0]->partitions_at(partition_column_ids_[0][0]).size();
+
+  std::size_t num_join_groups = 0;
+  for (const Vector<int>& join_group_column_ids : partition_column_ids_) {
+    join_group_offsets_.emplace_back(num_join_groups);
+    num_join_groups += join_group_column_ids.size();
+  }
+
+  const std::size_t num_partition_keys = num_join_groups * num_partitions_;
+  split_flags_.reset(new std::atomic<bool>[num_partition_keys]);
+  for (std::size_t i = 0; i < num_partition_keys; ++i) {
+    split_flags_[i].store(false);
+  }
+
+  skip_flags_.reset(new std::atomic<bool>[num_join_groups]);
+  for (std::size_t i = 0; i < num_join_groups; ++i) {
+    skip_flags_[i].store(false);
+  }
+
+  for (int worker_id = 0; worker_id < num_workers; ++worker_id) {
+    queues_.emplace_back(new WorkQueue);
+  }
+  for (std::size_t partition_id = 0; partition_id < num_partitions_; ++partition_id) {
+    std::deque<WorkUnit>* units = &queues_[partition_id % num_workers]->units;
+    for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+      for (std::size_t join_group_id = 0;
+           join_group_id < partition_column_ids_[table_id].size();
+           ++join_group_id) {
+        const std::size_t num_tuples =
+            tables_[table_id]->partitions_at(
+                partition_column_ids_[table_id][join_group_id])[partition_id]->num_tuples();
+        if (num_tuples > 0) {
+          units->emplace_back(table_id, join_group_id, partition_id, 0, num_tuples);
+        }
+      }
+    }
+  }
+}
+
+bool PartitionChunkScheduler::Next(int worker_id, PartitionChunk* chunk) {
+  START_TIMER(QuickFoilTimer::kAssigner);
+  WorkQueue* queue = queues_[worker_id].get();
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  WorkUnit* unit;
+  while (true) {
+    while (queue->units.empty()) {
+      lock.unlock();
+      if (!Steal(worker_id)) {
+        STOP_TIMER(QuickFoilTimer::kAssigner);
+        return false;
+      }
+      lock.lock();
+    }
+    unit = &queue->units.front();
+    if (!skip_flags_[join_group_offsets_[unit->table_id] + unit->join_group_id].load()) {
+      break;
+    }
+    queue->units.pop_front();
+  }
+
+  unit->started = true;
+  const std::size_t begin = unit->begin;
+  const std::size_t num_chunk_tuples =
+      std::min(static_cast<std::size_t>(FLAGS_partition_chunck_size),
+               unit->end - unit->begin);
+  const int table_id = unit->table_id;
+  const int join_group_id = unit->join_group_id;
+  const int partition_id = unit->partition_id;
+  unit->begin += num_chunk_tuples;
+  if (unit->begin == unit->end) {
+    queue->units.pop_front();
+  }
+  lock.unlock();
+
+  const ConstBufferPtr& partition =
+      tables_[table_id]->partitions_at(
+          partition_column_ids_[table_id][join_group_id])[partition_id];
+  chunk->Reset(table_id,
+               join_group_id,
+               partition_id,
+               partition->as_type<partition_tuple_type>() + begin,
+               num_chunk_tuples,
+               &tables_[table_id]->columns());
+  STOP_TIMER(QuickFoilTimer::kAssigner);
+  return true;
+}
+
+bool PartitionChunkScheduler::Steal(int worker_id) {
+  const int num_workers = queues_.size();
+  for (int i = 1; i < num_workers; ++i) {
+    WorkQueue* victim = queues_[(worker_id + i) % num_workers].get();
+    std::unique_lock<std::mutex> victim_lock(victim->mutex);
+    if (victim->units.empty()) {
+      continue;
+    }
+
+    WorkUnit* unit = &victim->units.back();
+    const std::size_t num_remaining_tuples = unit->end - unit->begin;
+    WorkUnit stolen_unit(*unit);
+    if (!unit->started) {
+      victim->units.pop_back();
+    } else {
+      // Leave the last chunk to the victim, which is about to process it anyway.
+      if (num_remaining_tuples <= static_cast<std::size_t>(FLAGS_partition_chunck_size)) {
+        continue;
+      }
+      const std::size_t num_victim_chunks =
+          (num_remaining_tuples / FLAGS_partition_chunck_size + 1) / 2;
+      unit->end = unit->begin + num_victim_chunks * FLAGS_partition_chunck_size;
+      stolen_unit.begin = unit->end;
+      split_flags_[GetPartitionKey(unit->table_id, unit->join_group_id, unit->partition_id)].store(true);
+    }
+    victim_lock.unlock();
+
+    stolen_unit.started = false;
+    WorkQueue* queue = queues_[worker_id].get();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->units.emplace_back(stolen_unit);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace quickfoil
@@ -0,0 +1,120 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_OPERATIONS_PARTITION_CHUNK_SCHEDULER_HPP_
+#define QUICKFOIL_OPERATIONS_PARTITION_CHUNK_SCHEDULER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "operations/PartitionAssigner.hpp"
+#include "storage/TableView.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+namespace quickfoil {
+
+// Schedules the PartitionChunks of a set of partitioned background tables
+// across a number of workers with work stealing.
+//
+// A work unit is the range of the tuples in one partition of one join group
+// of one table that is not handed out yet. The units are initially
+// distributed to the workers by partition in the same order as in
+// PartitionAssigner (worker i gets the partitions i, i + n, ...). A worker
+// takes chunks of at most FLAGS_partition_chunck_size tuples from the front
+// of its own queue. When its queue is empty, it steals from the back of the
+// queue of another worker: an untouched unit is taken as a whole, while a unit
+// that is being processed is split in half. The tuples of a split unit are
+// thus joined by more than one worker, which has to be taken into account by
+// any per-partition state of the consumers (see IsSplit()).
+class PartitionChunkScheduler {
+ public:
+  typedef PartitionAssigner::partition_tuple_type partition_tuple_type;
+
+  PartitionChunkScheduler(const Vector<const TableView*>& tables,
+                          const Vector<Vector<int>>& partition_column_ids,
+                          int num_workers);
+
+  // Fills <chunk> with the next chunk for the worker <worker_id>. Returns
+  // false if there is no work left for any worker. Thread-safe.
+  bool Next(int worker_id, PartitionChunk* chunk);
+
+  // Returns true if the tuples of the given partition have been (or may be)
+  // handed out to more than one worker. Once all the chunks of a partition
+  // obtained by a worker have been handed out, the return value for the
+  // partition can no longer change from false to true.
+  bool IsSplit(int table_id, int join_group_id, int partition_id) const {
+    return split_flags_[GetPartitionKey(table_id, join_group_id, partition_id)].load();
+  }
+
+  // Hands out no more chunks of the join group <join_group_id> of the table
+  // <table_id> to any worker. Thread-safe.
+  void SkipJoinGroup(int table_id, int join_group_id) {
+    skip_flags_[join_group_offsets_[table_id] + join_group_id].store(true);
+  }
+
+  // Returns a dense ID of the given partition.
+  inline std::size_t GetPartitionKey(int table_id, int join_group_id, int partition_id) const {
+    return (join_group_offsets_[table_id] + join_group_id) * num_partitions_ + partition_id;
+  }
+
+  const Vector<const TableView*>& tables() const {
+    return tables_;
+  }
+
+  int num_workers() const {
+    return queues_.size();
+  }
+
+ private:
+  struct WorkUnit {
+    WorkUnit(int table_id_in,
+             int join_group_id_in,
+             int partition_id_in,
+             std::size_t begin_in,
+             std::size_t end_in)
+        : table_id(table_id_in),
+          join_group_id(join_group_id_in),
+          partition_id(partition_id_in),
+          begin(begin_in),
+          end(end_in) {}
+
+    int table_id;
+    int join_group_id;
+    int partition_id;
+    std::size_t begin;
+    std::size_t end;
+    // True if some chunk of the unit has been handed out.
+    bool started = false;
+  };
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<WorkUnit> units;
+  };
+
+  // Moves work from the queue of another worker to the queue of <worker_id>.
+  // Returns false if no work can be stolen.
+  bool Steal(int worker_id);
+
+  const Vector<const TableView*>& tables_;
+  const Vector<Vector<int>>& partition_column_ids_;
+  std::size_t num_partitions_;
+  Vector<std::size_t> join_group_offsets_;
+
+  Vector<std::unique_ptr<WorkQueue>> queues_;
+  std::unique_ptr<std::atomic<bool>[]> split_flags_;
+  // Keyed by join_group_offsets_[table_id] + join_group_id.
+  std::unique_ptr<std::atomic<bool>[]> skip_flags_;
+
+  DISALLOW_COPY_AND_ASSIGN(PartitionChunkScheduler);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_OPERATIONS_PARTITION_CHUNK_SCHEDULER_HPP_ */
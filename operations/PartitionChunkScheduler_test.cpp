@@ -0,0 +1,222 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "operations/PartitionChunkScheduler.hpp"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "memory/Buffer.hpp"
+#include "operations/PartitionAssigner.hpp"
+#include "operations/RadixPartition.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/ThreadPool.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_radix_bits);
+
+class PartitionChunkSchedulerTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+  typedef PartitionChunkScheduler::partition_tuple_type partition_tuple_type;
+
+  // A chunk handed out to a worker.
+  struct ScheduledChunk {
+    int table_id;
+    int join_group_id;
+    int partition_id;
+    std::size_t begin;
+    std::size_t num_tuples;
+  };
+
+  PartitionChunkSchedulerTest() {
+    FLAGS_num_radix_bits = 3;
+    FLAGS_partition_chunck_size = 16;
+  }
+
+  // Adds a table with <num_columns> columns of <num_tuples> tuples, in which
+  // the value of the i-th tuple is 0 if i % <skew_period> is not 0, so that
+  // most tuples are in one partition, and i otherwise. All the columns are
+  // partitioned.
+  void AddTable(int num_columns, int num_tuples, int skew_period) {
+    Vector<ConstBufferPtr> columns;
+    for (int column_id = 0; column_id < num_columns; ++column_id) {
+      BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+      cpp_type* values = column->mutable_as_type<cpp_type>();
+      for (int i = 0; i < num_tuples; ++i) {
+        values[i] = (i % skew_period == 0 ? i + column_id : 0);
+      }
+      columns.emplace_back(std::make_shared<const ConstBuffer>(column));
+    }
+    tables_.emplace_back(new TableView(std::move(columns)));
+    partition_column_ids_.emplace_back();
+    for (int column_id = 0; column_id < num_columns; ++column_id) {
+      RadixPartition(column_id, tables_.back().get());
+      partition_column_ids_.back().emplace_back(column_id);
+    }
+    table_ptrs_.emplace_back(tables_.back().get());
+  }
+
+  // Takes all the chunks from <scheduler> with <num_workers> threads into
+  // <worker_chunks>. The worker 0 is slowed down, so that its partitions are
+  // stolen by the others.
+  void RunWorkers(int num_workers,
+                  PartitionChunkScheduler* scheduler,
+                  Vector<Vector<ScheduledChunk>>* worker_chunks) {
+    worker_chunks->resize(num_workers);
+    ThreadPool thread_pool(num_workers);
+    thread_pool.Run(
+        num_workers,
+        [this, scheduler, worker_chunks](int worker_id) {
+          PartitionChunk chunk;
+          while (scheduler->Next(worker_id, &chunk)) {
+            const partition_tuple_type* partition_begin =
+                table_ptrs_[chunk.table_id]->partitions_at(
+                    partition_column_ids_[chunk.table_id][chunk.join_group_id])[chunk.partition_id]
+                        ->as_type<partition_tuple_type>();
+            (*worker_chunks)[worker_id].push_back(
+                ScheduledChunk{chunk.table_id,
+                               chunk.join_group_id,
+                               chunk.partition_id,
+                               static_cast<std::size_t>(chunk.tuples - partition_begin),
+                               chunk.num_tuples});
+            if (worker_id == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+          }
+        });
+  }
+
+  // Checks that every tuple of every partition that is not in a skipped join
+  // group is handed out exactly once, in chunks of at most
+  // FLAGS_partition_chunck_size tuples, and that the partitions handed out to
+  // more than one worker are reported as split.
+  void CheckChunks(const PartitionChunkScheduler& scheduler,
+                   const Vector<Vector<ScheduledChunk>>& worker_chunks,
+                   const Vector<Vector<bool>>& skipped_join_groups) {
+    Vector<Vector<Vector<Vector<int>>>> num_visits(tables_.size());
+    Vector<Vector<Vector<Vector<int>>>> visiting_workers(tables_.size());
+    for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+      for (const int column_id : partition_column_ids_[table_id]) {
+        num_visits[table_id].emplace_back();
+        visiting_workers[table_id].emplace_back();
+        for (const ConstBufferPtr& partition : tables_[table_id]->partitions_at(column_id)) {
+          num_visits[table_id].back().emplace_back(partition->num_tuples(), 0);
+          visiting_workers[table_id].back().emplace_back();
+        }
+      }
+    }
+
+    for (std::size_t worker_id = 0; worker_id < worker_chunks.size(); ++worker_id) {
+      for (const ScheduledChunk& chunk : worker_chunks[worker_id]) {
+        EXPECT_FALSE(skipped_join_groups[chunk.table_id][chunk.join_group_id]);
+        EXPECT_GT(chunk.num_tuples, 0u);
+        EXPECT_LE(chunk.num_tuples, static_cast<std::size_t>(FLAGS_partition_chunck_size));
+        Vector<int>& partition_visits =
+            num_visits[chunk.table_id][chunk.join_group_id][chunk.partition_id];
+        ASSERT_LE(chunk.begin + chunk.num_tuples, partition_visits.size());
+        for (std::size_t i = chunk.begin; i < chunk.begin + chunk.num_tuples; ++i) {
+          ++partition_visits[i];
+        }
+        Vector<int>& workers =
+            visiting_workers[chunk.table_id][chunk.join_group_id][chunk.partition_id];
+        if (workers.empty() || workers.back() != static_cast<int>(worker_id)) {
+          workers.emplace_back(worker_id);
+        }
+      }
+    }
+
+    for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+      for (std::size_t join_group_id = 0; join_group_id < num_visits[table_id].size(); ++join_group_id) {
+        const int expected_visits = skipped_join_groups[table_id][join_group_id] ? 0 : 1;
+        for (std::size_t partition_id = 0;
+             partition_id < num_visits[table_id][join_group_id].size();
+             ++partition_id) {
+          for (const int visits : num_visits[table_id][join_group_id][partition_id]) {
+            EXPECT_EQ(expected_visits, visits)
+                << "table " << table_id << ", join group " << join_group_id
+                << ", partition " << partition_id;
+          }
+          if (visiting_workers[table_id][join_group_id][partition_id].size() > 1u) {
+            EXPECT_TRUE(scheduler.IsSplit(table_id, join_group_id, partition_id));
+          }
+        }
+      }
+    }
+  }
+
+  Vector<std::unique_ptr<TableView>> tables_;
+  Vector<const TableView*> table_ptrs_;
+  Vector<Vector<int>> partition_column_ids_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PartitionChunkSchedulerTest);
+};
+
+TEST_F(PartitionChunkSchedulerTest, EveryTupleOnce) {
+  AddTable(2, 5000, 1);
+  AddTable(1, 300, 1);
+  const Vector<Vector<bool>> skipped_join_groups{{false, false}, {false}};
+  for (const int num_workers : {1, 2, 3, 8}) {
+    PartitionChunkScheduler scheduler(table_ptrs_, partition_column_ids_, num_workers);
+    Vector<Vector<ScheduledChunk>> worker_chunks;
+    RunWorkers(num_workers, &scheduler, &worker_chunks);
+    CheckChunks(scheduler, worker_chunks, skipped_join_groups);
+  }
+}
+
+TEST_F(PartitionChunkSchedulerTest, SkewedPartitionsAreStolen) {
+  // Almost all the tuples are in the partition of 0, which is split among
+  // the workers that run out of work.
+  AddTable(1, 20000, 50);
+  AddTable(2, 100, 1);
+  const Vector<Vector<bool>> skipped_join_groups{{false}, {false, false}};
+  for (const int num_workers : {2, 4, 8}) {
+    PartitionChunkScheduler scheduler(table_ptrs_, partition_column_ids_, num_workers);
+    Vector<Vector<ScheduledChunk>> worker_chunks;
+    RunWorkers(num_workers, &scheduler, &worker_chunks);
+    CheckChunks(scheduler, worker_chunks, skipped_join_groups);
+
+    int num_busy_workers = 0;
+    for (const Vector<ScheduledChunk>& chunks : worker_chunks) {
+      num_busy_workers += !chunks.empty();
+    }
+    EXPECT_GT(num_busy_workers, 1);
+  }
+}
+
+TEST_F(PartitionChunkSchedulerTest, MoreWorkersThanPartitions) {
+  FLAGS_num_radix_bits = 1;
+  AddTable(1, 1000, 1);
+  const Vector<Vector<bool>> skipped_join_groups{{false}};
+  PartitionChunkScheduler scheduler(table_ptrs_, partition_column_ids_, 6);
+  Vector<Vector<ScheduledChunk>> worker_chunks;
+  RunWorkers(6, &scheduler, &worker_chunks);
+  CheckChunks(scheduler, worker_chunks, skipped_join_groups);
+}
+
+TEST_F(PartitionChunkSchedulerTest, SkipJoinGroup) {
+  AddTable(2, 3000, 1);
+  AddTable(1, 3000, 1);
+  const Vector<Vector<bool>> skipped_join_groups{{false, true}, {true}};
+  PartitionChunkScheduler scheduler(table_ptrs_, partition_column_ids_, 4);
+  scheduler.SkipJoinGroup(0, 1);
+  scheduler.SkipJoinGroup(1, 0);
+  Vector<Vector<ScheduledChunk>> worker_chunks;
+  RunWorkers(4, &scheduler, &worker_chunks);
+  CheckChunks(scheduler, worker_chunks, skipped_join_groups);
+}
+
+}  // namespace quickfoil
@@ -5,17 +5,25 @@
 
 #include "operations/RadixPartition.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "memory/Buffer.hpp"
 #include "memory/MemUtil.hpp"
+#include "storage/ColumnStore.hpp"
 #include "storage/PartitionTuple.hpp"
 #include "storage/TableView.hpp"
 #include "types/TypeID.hpp"
 #include "utility/Hash.hpp"
 #include "utility/Macros.hpp"
 #include "utility/Math.hpp"
+#include "utility/ThreadPool.hpp"
 #include "utility/Vector.hpp"
 
 #include "gflags/gflags.h"
@@ -24,6 +32,10 @@
 namespace quickfoil {
 
 DEFINE_int32(num_radix_bits, 5, "Number of radix bits");
+DEFINE_int32(max_radix_bits_per_pass,
+             8,
+             "The maximum number of radix bits partitioned in one pass. "
+             "The partitioning takes two passes if num_radix_bits is larger.");
 
 namespace {
 
@@ -45,6 +57,9 @@ class FreeDeleter {
   DISALLOW_COPY_AND_ASSIGN(FreeDeleter);
 };
 
+// Only uses multiple threads if each of them gets at least this many tuples.
+constexpr std::uint32_t kMinNumTuplesPerWorker = 16384;
+
 template <TypeID type_id>
 class RadixPartitioner {
  public:
@@ -53,88 +68,312 @@ class RadixPartitioner {
   static constexpr const int block_byte_size = LCM(sizeof(partition_tuple_type), CACHE_LINE_SIZE);
   static constexpr const int block_capacity = block_byte_size / sizeof(partition_tuple_type);
 
+  // Partitions <block> on the lowest FLAGS_num_radix_bits bits of the hash
+  // values. Each partition keeps the tuples in the order of <block>.
+  //
+  // The input is split into contiguous ranges that are partitioned by the
+  // workers of the thread pool: each worker builds a histogram of its range,
+  // and after a prefix sum over all histograms, scatters its range into its
+  // own region of every output partition. If FLAGS_num_radix_bits is larger
+  // than FLAGS_max_radix_bits_per_pass, the first pass only partitions on the
+  // higher half of the radix bits and a second pass partitions each of the
+  // resulting partitions on the lower half, which keeps the fan-out of each
+  // pass within the TLB reach. Both ways result in the same output.
   static void Partition(const ConstBufferPtr& block,
                         Vector<ConstBufferPtr>* partitions) {
+    const std::uint32_t total_num_tuples = block->num_tuples();
+    const int num_radix_bits = FLAGS_num_radix_bits;
+    const int num_second_pass_bits =
+        num_radix_bits > FLAGS_max_radix_bits_per_pass ? num_radix_bits / 2 : 0;
+    const int num_first_pass_bits = num_radix_bits - num_second_pass_bits;
+    const std::uint32_t num_partitions = 1 << num_radix_bits;
 
-    const uint32_t num_partitions =  1 << FLAGS_num_radix_bits;
-    const uint32_t mask = num_partitions - 1;
+    const size_type num_cache_lines =
+        std::ceil(static_cast<double>(total_num_tuples) / block_capacity);
+    const std::size_t output_data_size = sizeof(CacheLine) * num_cache_lines;
+    BufferPtr output_buffer(new Buffer(cacheline_aligned_alloc(output_data_size),
+                                       output_data_size,
+                                       total_num_tuples));
+
+    Vector<std::uint32_t> partition_sizes;
+    if (num_second_pass_bits == 0) {
+      PartitionColumn(block->as_type<cpp_type>(),
+                      total_num_tuples,
+                      num_first_pass_bits,
+                      0 /* shift */,
+                      output_buffer->mutable_as_type<CacheLine>(),
+                      &partition_sizes);
+    } else {
+      CacheLine* first_pass_output =
+          static_cast<CacheLine*>(cacheline_aligned_alloc(output_data_size));
+      DCHECK(first_pass_output != nullptr);
+      FreeDeleter first_pass_output_deleter(first_pass_output);
+
+      Vector<std::uint32_t> first_pass_partition_sizes;
+      PartitionColumn(block->as_type<cpp_type>(),
+                      total_num_tuples,
+                      num_first_pass_bits,
+                      num_second_pass_bits,
+                      first_pass_output,
+                      &first_pass_partition_sizes);
+      RepartitionPartitions(reinterpret_cast<const partition_tuple_type*>(first_pass_output),
+                            first_pass_partition_sizes,
+                            num_second_pass_bits,
+                            output_buffer->mutable_as_type<CacheLine>(),
+                            &partition_sizes);
+    }
+    DCHECK_EQ(num_partitions, partition_sizes.size());
+    PartitionBalanceStatistics::GetInstance()->AddColumn(
+        total_num_tuples,
+        *std::max_element(partition_sizes.begin(), partition_sizes.end()),
+        num_partitions);
+
+    size_type partition_offset = 0;
+    for (std::uint32_t partition_id = 0; partition_id < num_partitions; ++partition_id) {
+      partitions->emplace_back(
+          std::make_shared<const ConstBuffer>(
+              output_buffer,
+              output_buffer->as_type<partition_tuple_type>() + partition_offset,
+              partition_sizes[partition_id]));
+      partition_offset += partition_sizes[partition_id];
+    }
+  }
 
-    uint32_t* histogram = static_cast<uint32_t*>(calloc(num_partitions, sizeof(uint32_t)));
-    FreeDeleter histogram_deleter(histogram);
+ private:
+  union CacheLine {
+    struct partition_tuples {
+      PartitionTuple<type_id> tuples[block_capacity];
+    } partition_tuples;
 
-    // Build a histogram.
-    const std::uint32_t total_num_tuples = block->num_tuples();
-    {
-      const cpp_type* values = block->as_type<cpp_type>();
-      for (std::uint32_t index = 0; index < total_num_tuples; ++index) {
-        const hash_type hash_value = Hash(*values);
-        ++histogram[HASH_BIT_MODULO(hash_value, mask, 0)];
-        ++values;
+    struct partition_info {
+      PartitionTuple<type_id> tuples_[block_capacity - 1];
+
+      uint32_t tuple_slot;
+      uint8_t buffer_slot;
+    } partition_info;
+  } __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+  static_assert(sizeof(CacheLine) == block_byte_size,
+                "The size of PartitionBlock is not expected");
+
+  // Reads the tuples of a column. The tuple IDs are the positions in the column.
+  struct ColumnInput {
+    explicit ColumnInput(const cpp_type* values_in)
+        : values(values_in) {}
+
+    inline cpp_type value_at(std::uint32_t position) const {
+      return values[position];
+    }
+
+    inline size_type tuple_id_at(std::uint32_t position) const {
+      return position;
+    }
+
+    const cpp_type* values;
+  };
+
+  // Reads the tuples of a partition produced by an earlier pass.
+  struct PartitionInput {
+    explicit PartitionInput(const partition_tuple_type* tuples_in)
+        : tuples(tuples_in) {}
+
+    inline cpp_type value_at(std::uint32_t position) const {
+      return tuples[position].value;
+    }
+
+    inline size_type tuple_id_at(std::uint32_t position) const {
+      return tuples[position].tuple_id;
+    }
+
+    const partition_tuple_type* tuples;
+  };
+
+  // Partitions the <num_tuples> values of a column on <num_bits> bits of the
+  // hash values starting from the bit <shift>.
+  static void PartitionColumn(const cpp_type* values,
+                              std::uint32_t num_tuples,
+                              int num_bits,
+                              int shift,
+                              CacheLine* output,
+                              Vector<std::uint32_t>* partition_sizes) {
+    const std::uint32_t num_partitions = 1 << num_bits;
+    const int num_workers =
+        std::max(1u,
+                 std::min(static_cast<std::uint32_t>(ThreadPool::GetInstance()->num_threads()),
+                          num_tuples / kMinNumTuplesPerWorker));
+    const ColumnInput input(values);
+
+    // Worker i partitions the tuples in [range_begins[i], range_begins[i + 1]).
+    Vector<std::uint32_t> range_begins;
+    for (int worker_id = 0; worker_id <= num_workers; ++worker_id) {
+      range_begins.emplace_back(static_cast<std::uint64_t>(num_tuples) * worker_id / num_workers);
+    }
+
+    // histograms[i * num_partitions + p] is the number of tuples of worker i in
+    // the partition p. It is turned into the output offsets after the prefix sum.
+    Vector<std::uint32_t> histograms(num_workers * num_partitions, 0);
+    ThreadPool::GetInstance()->Run(
+        num_workers,
+        [&](int worker_id) {
+          BuildHistogram(input,
+                         range_begins[worker_id],
+                         range_begins[worker_id + 1],
+                         num_partitions - 1,
+                         shift,
+                         histograms.data() + worker_id * num_partitions);
+        });
+
+    partition_sizes->assign(num_partitions, 0);
+    std::uint32_t offset = 0;
+    for (std::uint32_t partition_id = 0; partition_id < num_partitions; ++partition_id) {
+      for (int worker_id = 0; worker_id < num_workers; ++worker_id) {
+        std::uint32_t* count = &histograms[worker_id * num_partitions + partition_id];
+        (*partition_sizes)[partition_id] += *count;
+        const std::uint32_t region_offset = offset;
+        offset += *count;
+        *count = region_offset;
       }
     }
 
-    // Write buffer.
-    CacheLine* write_buffer =
-        static_cast<CacheLine*>(cacheline_aligned_alloc(num_partitions * sizeof(CacheLine)));
-    DCHECK(write_buffer != nullptr);
-    FreeDeleter write_buffer_deleter(write_buffer);
+    ThreadPool::GetInstance()->Run(
+        num_workers,
+        [&](int worker_id) {
+          CacheLine* write_buffer =
+              static_cast<CacheLine*>(cacheline_aligned_alloc(num_partitions * sizeof(CacheLine)));
+          DCHECK(write_buffer != nullptr);
+          FreeDeleter write_buffer_deleter(write_buffer);
+          Scatter(input,
+                  range_begins[worker_id],
+                  range_begins[worker_id + 1],
+                  num_partitions - 1,
+                  shift,
+                  histograms.data() + worker_id * num_partitions,
+                  write_buffer,
+                  output);
+        });
+  }
 
-    // Output destination.
-    size_type num_cache_lines =
-        std::ceil(static_cast<double>(total_num_tuples) / block_capacity);
-    const std::size_t output_data_size = sizeof(CacheLine) * num_cache_lines;
-    BufferPtr output_buffer(new Buffer(
-        output_data_size,
-        total_num_tuples));
-    CacheLine* __restrict__ output_destination =
-        output_buffer->mutable_as_type<CacheLine>();
+  // Partitions each of <input_partitions>, which are stored consecutively in
+  // <input>, on the lowest <num_bits> bits of the hash values. The partitions
+  // are distributed over the workers of the thread pool.
+  static void RepartitionPartitions(const partition_tuple_type* input,
+                                    const Vector<std::uint32_t>& input_partition_sizes,
+                                    int num_bits,
+                                    CacheLine* output,
+                                    Vector<std::uint32_t>* partition_sizes) {
+    const std::uint32_t fan_out = 1 << num_bits;
+    const std::uint32_t num_input_partitions = input_partition_sizes.size();
+    Vector<std::uint32_t> input_partition_offsets;
+    std::uint32_t offset = 0;
+    for (const std::uint32_t input_partition_size : input_partition_sizes) {
+      input_partition_offsets.emplace_back(offset);
+      offset += input_partition_size;
+    }
 
-    std::vector<std::uint32_t> original_tuple_slots;
-    original_tuple_slots.reserve(num_partitions);
+    partition_sizes->assign(num_input_partitions * fan_out, 0);
+    ThreadPool::GetInstance()->Run(
+        num_input_partitions,
+        [&](int input_partition_id) {
+          const PartitionInput partition_input(input + input_partition_offsets[input_partition_id]);
+          const std::uint32_t num_tuples = input_partition_sizes[input_partition_id];
+          std::uint32_t* histogram = partition_sizes->data() + input_partition_id * fan_out;
+          BuildHistogram(partition_input, 0, num_tuples, fan_out - 1, 0, histogram);
+
+          Vector<std::uint32_t> region_offsets;
+          std::uint32_t region_offset = input_partition_offsets[input_partition_id];
+          for (std::uint32_t partition_id = 0; partition_id < fan_out; ++partition_id) {
+            region_offsets.emplace_back(region_offset);
+            region_offset += histogram[partition_id];
+          }
+
+          CacheLine* write_buffer =
+              static_cast<CacheLine*>(cacheline_aligned_alloc(fan_out * sizeof(CacheLine)));
+          DCHECK(write_buffer != nullptr);
+          FreeDeleter write_buffer_deleter(write_buffer);
+          Scatter(partition_input,
+                  0,
+                  num_tuples,
+                  fan_out - 1,
+                  0,
+                  region_offsets.data(),
+                  write_buffer,
+                  output);
+        });
+  }
 
-    std::vector<std::uint8_t> original_buffer_slots;
-    original_buffer_slots.reserve(num_partitions);
+  template <class Input>
+  static void BuildHistogram(const Input& input,
+                             std::uint32_t begin,
+                             std::uint32_t end,
+                             std::uint32_t mask,
+                             int shift,
+                             std::uint32_t* histogram) {
+    for (std::uint32_t position = begin; position < end; ++position) {
+      const hash_type hash_value = HashKey(input.value_at(position));
+      ++histogram[(hash_value >> shift) & mask];
+    }
+  }
 
-    size_type partition_offsets = 0;
-    for (std::size_t i = 0; i < num_partitions; ++i) {
-      write_buffer[i].partition_info.tuple_slot =
-          partition_offsets / block_capacity;
-      write_buffer[i].partition_info.buffer_slot =
-          partition_offsets % block_capacity;
+  // Scatters the tuples in [begin, end) of <input> to the output regions
+  // starting at the tuple offsets <region_offsets>, one region per partition,
+  // through the software write-combining buffers <write_buffer>. Only the
+  // tuple slots of the regions are written, so that the regions of other
+  // workers may share the cache lines at their boundaries.
+  template <class Input>
+  static void Scatter(const Input& input,
+                      std::uint32_t begin,
+                      std::uint32_t end,
+                      std::uint32_t mask,
+                      int shift,
+                      const std::uint32_t* region_offsets,
+                      CacheLine* write_buffer,
+                      CacheLine* __restrict__ output_destination) {
+    const std::uint32_t num_partitions = mask + 1;
+    Vector<std::uint32_t> original_tuple_slots;
+    original_tuple_slots.reserve(num_partitions);
+    Vector<std::uint8_t> original_buffer_slots;
+    original_buffer_slots.reserve(num_partitions);
+    for (std::uint32_t i = 0; i < num_partitions; ++i) {
+      write_buffer[i].partition_info.tuple_slot = region_offsets[i] / block_capacity;
+      write_buffer[i].partition_info.buffer_slot = region_offsets[i] % block_capacity;
       original_tuple_slots.emplace_back(write_buffer[i].partition_info.tuple_slot);
       original_buffer_slots.emplace_back(write_buffer[i].partition_info.buffer_slot);
-      partitions->emplace_back(
-          std::make_shared<const ConstBuffer>(
-              output_buffer,
-              output_buffer->as_type<partition_tuple_type>() + partition_offsets,
-              histogram[i]));
-      partition_offsets += histogram[i];
     }
 
-    const cpp_type* __restrict__ values = block->as_type<cpp_type>();
-    for (std::size_t i = 0; i < total_num_tuples; ++i) {
-      const hash_type hash_value = Hash(*values);
-      CacheLine* __restrict__ write_buffer_entry =
-          write_buffer + (hash_value & mask);
+    for (std::uint32_t position = begin; position < end; ++position) {
+      const cpp_type value = input.value_at(position);
+      const hash_type hash_value = HashKey(value);
+      const std::uint32_t partition_id = (hash_value >> shift) & mask;
+      CacheLine* __restrict__ write_buffer_entry = write_buffer + partition_id;
       const uint8_t buffer_destination_idx =
           write_buffer_entry->partition_info.buffer_slot;
       if (buffer_destination_idx == block_capacity - 1) {
         const uint32_t tuple_slot = write_buffer_entry->partition_info.tuple_slot;
-        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].value = *values;
-        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].tuple_id = i;
-        cacheline_memcpy((output_destination + tuple_slot), write_buffer_entry);
+        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].value = value;
+        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].tuple_id =
+            input.tuple_id_at(position);
+        if (tuple_slot == original_tuple_slots[partition_id] &&
+            original_buffer_slots[partition_id] != 0) {
+          // The first cache line of the region is shared with the preceding region.
+          const uint8_t first_slot = original_buffer_slots[partition_id];
+          memcpy(output_destination[tuple_slot].partition_tuples.tuples + first_slot,
+                 write_buffer_entry->partition_tuples.tuples + first_slot,
+                 (block_capacity - first_slot) * sizeof(partition_tuple_type));
+        } else {
+          cacheline_memcpy((output_destination + tuple_slot), write_buffer_entry);
+        }
         write_buffer_entry->partition_info.tuple_slot = tuple_slot + 1;
         write_buffer_entry->partition_info.buffer_slot = 0;
       } else {
-        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].value = *values;
-        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].tuple_id = i;
+        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].value = value;
+        write_buffer_entry->partition_tuples.tuples[buffer_destination_idx].tuple_id =
+            input.tuple_id_at(position);
         ++write_buffer_entry->partition_info.buffer_slot;
       }
-      ++values;
     }
 
     // Write left data in the buffers.
-    for (std::size_t partition_id = 0; partition_id < num_partitions; ++partition_id) {
+    for (std::uint32_t partition_id = 0; partition_id < num_partitions; ++partition_id) {
       const std::size_t current_tuple_slot = write_buffer[partition_id].partition_info.tuple_slot;
 
       if (original_tuple_slots[partition_id] != current_tuple_slot) {
@@ -152,30 +391,31 @@ class RadixPartitioner {
                num_buffer_slots_filled * sizeof(partition_tuple_type));
       }
     }
+    streaming_store_fence();
   }
 
- private:
-  union CacheLine {
-    struct partition_tuples {
-      PartitionTuple<type_id> tuples[block_capacity];
-    } partition_tuples;
-
-    struct partition_info {
-      PartitionTuple<type_id> tuples_[block_capacity - 1];
-
-      uint32_t tuple_slot;
-      uint8_t buffer_slot;
-    } partition_info;
-  } __attribute__ ((aligned(CACHE_LINE_SIZE)));
-
-  static_assert(sizeof(CacheLine) == block_byte_size,
-                "The size of PartitionBlock is not expected");
-
   DISALLOW_COPY_AND_ASSIGN(RadixPartitioner);
 };
 
 }  // namespace
 
+void PartitionBalanceStatistics::AddColumn(size_type num_tuples,
+                                           size_type max_partition_size,
+                                           int num_partitions) {
+  if (num_tuples == 0) {
+    return;
+  }
+  const double skew = static_cast<double>(max_partition_size) * num_partitions / num_tuples;
+  std::lock_guard<std::mutex> lock(mutex_);
+  total_num_tuples_ += num_tuples;
+  weighted_skew_sum_ += skew * num_tuples;
+}
+
+double PartitionBalanceStatistics::average_skew() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_num_tuples_ == 0 ? 0 : weighted_skew_sum_ / total_num_tuples_;
+}
+
 void RadixPartition(int column_id,
                     TableView* table) {
   DCHECK_GT(FLAGS_num_radix_bits, 0);
@@ -185,4 +425,49 @@ void RadixPartition(int column_id,
   table->set_partitions_at(column_id, std::move(partitions));
 }
 
+namespace {
+
+typedef PartitionTuple<kQuickFoilDefaultDataType> partition_tuple_type;
+
+// Identifies how the tuples are assigned to the partitions.
+inline std::uint64_t GetPartitioningSignature() {
+  return (static_cast<std::uint64_t>(key_hash_function) << 32) | FLAGS_num_radix_bits;
+}
+
+}  // namespace
+
+bool LoadPersistedPartitions(const std::string& file_path,
+                             TableView* table) {
+  if (!ReadPartitionStore(file_path,
+                          sizeof(partition_tuple_type),
+                          GetPartitioningSignature(),
+                          table)) {
+    return false;
+  }
+  for (int column_id = 0; column_id < table->num_columns(); ++column_id) {
+    const Vector<ConstBufferPtr>& partitions = table->partitions_at(column_id);
+    size_type max_partition_size = 0;
+    for (const ConstBufferPtr& partition : partitions) {
+      max_partition_size = std::max<size_type>(max_partition_size, partition->num_tuples());
+    }
+    PartitionBalanceStatistics::GetInstance()->AddColumn(table->num_tuples(),
+                                                         max_partition_size,
+                                                         partitions.size());
+  }
+  return true;
+}
+
+void PersistPartitions(const std::string& file_path,
+                       TableView* table) {
+  for (int column_id = 0; column_id < table->num_columns(); ++column_id) {
+    if (table->partitions_at(column_id).empty()) {
+      RadixPartition(column_id, table);
+    }
+  }
+  WritePartitionStore(file_path,
+                      sizeof(partition_tuple_type),
+                      GetPartitioningSignature(),
+                      *table);
+}
+
 }  // namespace quickfoil
@@ -6,6 +6,12 @@
 #ifndef QUICKFOIL_OPERATIONS_RADIX_PARTITION_HPP_
 #define QUICKFOIL_OPERATIONS_RADIX_PARTITION_HPP_
 
+#include <mutex>
+#include <string>
+
+#include "schema/TypeDefs.hpp"
+#include "utility/Macros.hpp"
+
 namespace quickfoil {
 
 class TableView;
@@ -13,6 +19,46 @@ class TableView;
 void RadixPartition(int column_id,
                     TableView* table);
 
+// Sets the partitions of all the columns of <table> from the partition store
+// <file_path> written by PersistPartitions() with the same number of radix bits
+// and key hash function. Returns false if there is no such store.
+bool LoadPersistedPartitions(const std::string& file_path,
+                             TableView* table);
+
+// Partitions the columns of <table> that are not partitioned yet, and writes
+// the partitions of all the columns to the partition store <file_path>.
+void PersistPartitions(const std::string& file_path,
+                       TableView* table);
+
+// Statistics on the balance of the partitions created by RadixPartition().
+// The skew of a partitioned column is the size of its largest partition
+// relative to the average partition size, i.e. 1 for perfectly balanced
+// partitions.
+class PartitionBalanceStatistics {
+ public:
+  static PartitionBalanceStatistics* GetInstance() {
+    static PartitionBalanceStatistics statistics;
+    return &statistics;
+  }
+
+  PartitionBalanceStatistics() {}
+
+  void AddColumn(size_type num_tuples,
+                 size_type max_partition_size,
+                 int num_partitions);
+
+  // The skew averaged over all the partitioned columns, weighted by their
+  // numbers of tuples.
+  double average_skew() const;
+
+ private:
+  mutable std::mutex mutex_;
+  double total_num_tuples_ = 0;
+  double weighted_skew_sum_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(PartitionBalanceStatistics);
+};
+
 }  // namespace quickfoil
 
 #endif /* QUICKFOIL_OPERATIONS_RADIX_PARTITION_HPP_ */
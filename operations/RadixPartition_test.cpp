@@ -5,14 +5,23 @@
 
 #include "operations/RadixPartition.hpp"
 
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
 #include <set>
+#include <string>
 
 #include "memory/Buffer.hpp"
+#include "storage/ColumnStore.hpp"
 #include "storage/PartitionTuple.hpp"
 #include "storage/TableView.hpp"
 #include "types/Type.hpp"
 #include "types/TypeID.hpp"
 #include "types/TypeTraits.hpp"
+#include "utility/Hash.hpp"
 #include "utility/Macros.hpp"
 #include "utility/StringUtil.hpp"
 #include "utility/Vector.hpp"
@@ -38,6 +47,7 @@
 namespace quickfoil {
 
 DECLARE_int32(num_radix_bits);
+DECLARE_int32(num_threads);
 
 template <TypeID type_id>
 struct PartitionTupleCompare {
@@ -53,12 +63,14 @@ class RadixPartitionTest : public ::testing::Test {
   typedef std::multiset<PartitionTuple<kQuickFoilDefaultDataType>,
                         PartitionTupleCompare<kQuickFoilDefaultDataType>>  multiset_type;
 
-  RadixPartitionTest() {}
+  RadixPartitionTest() {
+    // Partitions the larger columns in parallel.
+    FLAGS_num_threads = 4;
+  }
 
   void SetColumnSize(int size) {
     block_ = std::make_shared<Buffer>(TypeTraits<kQuickFoilDefaultDataType>::size * size,
-                                      size,
-                                      nullptr);
+                                      size);
     current_id_ = 0;
   }
 
@@ -81,6 +93,34 @@ class RadixPartitionTest : public ::testing::Test {
 
   multiset_type GenerateMultiset(const ConstBufferPtr& partition);
 
+  // Returns a table of <num_columns> columns of <num_tuples> values that is
+  // not partitioned.
+  static std::unique_ptr<TableView> CreateUnpartitionedTable(int num_columns, int num_tuples) {
+    Vector<ConstBufferPtr> columns;
+    for (int column_id = 0; column_id < num_columns; ++column_id) {
+      BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+      for (int i = 0; i < num_tuples; ++i) {
+        column->mutable_as_type<cpp_type>()[i] = (i * 7919 + column_id) % 1009;
+      }
+      columns.emplace_back(std::make_shared<const ConstBuffer>(column));
+    }
+    return std::unique_ptr<TableView>(new TableView(std::move(columns)));
+  }
+
+  // Returns the path of a partition store file for the current test.
+  static std::string GetPartitionStoreTestPath() {
+    return GetPartitionStorePath(
+        std::string("/tmp/quickfoil_RadixPartitionTest_") + std::to_string(getpid()) + "_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+  }
+
+  // Checks that <table> has no partitions, as if no partition store was read.
+  static void ExpectNotPartitioned(const TableView& table) {
+    for (int column_id = 0; column_id < table.num_columns(); ++column_id) {
+      EXPECT_TRUE(table.partitions_at(column_id).empty());
+    }
+  }
+
   BufferPtr block_;
 
   int current_id_ = -1;
@@ -116,7 +156,7 @@ TEST_F(RadixPartitionTest, SimpleTests) {
       Vector<RadixPartitionTest::multiset_type> expected_partitions(partitions);
       for (int i = 0; i < test_size; ++i) {
         AddValue(i);
-        expected_partitions[i%partitions].emplace(i, i);
+        expected_partitions[HashKey(i) & (partitions - 1)].emplace(i, i);
       }
       GENERATE_PARTITIONS_AND_CHECK(expected_partitions);
     }
@@ -137,7 +177,7 @@ TEST_F(RadixPartitionTest, AllZero) {
       Vector<RadixPartitionTest::multiset_type> expected_partitions(partitions);
       for (int i = 0; i < test_size; ++i) {
         AddValue(0);
-        expected_partitions[0].emplace(0, i);
+        expected_partitions[HashKey(0) & (partitions - 1)].emplace(0, i);
       }
       GENERATE_PARTITIONS_AND_CHECK(expected_partitions);
     }
@@ -159,13 +199,125 @@ TEST_F(RadixPartitionTest, ZeroInterleaveOne) {
       for (int i = 0; i < test_size/2; ++i) {
         AddValue(0);
         AddValue(1);
-        expected_partitions[0].emplace(0, 2*i);
-        expected_partitions[1].emplace(1, 2*i + 1);
+        expected_partitions[HashKey(0) & (partitions - 1)].emplace(0, 2*i);
+        expected_partitions[HashKey(1) & (partitions - 1)].emplace(1, 2*i + 1);
       }
       GENERATE_PARTITIONS_AND_CHECK(expected_partitions);
     }
   }
 }
 
-}  // namespace quickfoil
+TEST_F(RadixPartitionTest, PreservesInputOrder) {
+  Vector<int> num_radix_bits_vec{3, 12};
+  for (int num_radix_bits : num_radix_bits_vec) {
+    FLAGS_num_radix_bits = num_radix_bits;
+    const int test_size = 100000;
+    SetColumnSize(test_size);
+    for (int i = 0; i < test_size; ++i) {
+      AddValue((i * 7919) % 5003);
+    }
+    CreateTable();
+    RadixPartition(0, table_.get());
+    for (const ConstBufferPtr& partition : table_->partitions_at(0)) {
+      const PartitionTuple<kQuickFoilDefaultDataType>* partition_tuples =
+          partition->as_type<PartitionTuple<kQuickFoilDefaultDataType>>();
+      for (std::size_t i = 1; i < partition->num_tuples(); ++i) {
+        EXPECT_LT(partition_tuples[i - 1].tuple_id, partition_tuples[i].tuple_id);
+      }
+    }
+  }
+}
 
+TEST_F(RadixPartitionTest, PersistedPartitionsRoundTrip) {
+  FLAGS_num_radix_bits = 3;
+  const std::string file_path = GetPartitionStoreTestPath();
+  std::unique_ptr<TableView> persisted_table(CreateUnpartitionedTable(2, 1000));
+  PersistPartitions(file_path, persisted_table.get());
+
+  std::unique_ptr<TableView> loaded_table(CreateUnpartitionedTable(2, 1000));
+  ASSERT_TRUE(LoadPersistedPartitions(file_path, loaded_table.get()));
+  for (int column_id = 0; column_id < 2; ++column_id) {
+    const Vector<ConstBufferPtr>& expected_partitions = persisted_table->partitions_at(column_id);
+    const Vector<ConstBufferPtr>& partitions = loaded_table->partitions_at(column_id);
+    ASSERT_EQ(expected_partitions.size(), partitions.size());
+    for (std::size_t partition_id = 0; partition_id < partitions.size(); ++partition_id) {
+      ASSERT_EQ(expected_partitions[partition_id]->num_tuples(),
+                partitions[partition_id]->num_tuples());
+      const PartitionTuple<kQuickFoilDefaultDataType>* expected_tuples =
+          expected_partitions[partition_id]->as_type<PartitionTuple<kQuickFoilDefaultDataType>>();
+      const PartitionTuple<kQuickFoilDefaultDataType>* tuples =
+          partitions[partition_id]->as_type<PartitionTuple<kQuickFoilDefaultDataType>>();
+      for (std::size_t i = 0; i < partitions[partition_id]->num_tuples(); ++i) {
+        EXPECT_EQ(expected_tuples[i].value, tuples[i].value);
+        EXPECT_EQ(expected_tuples[i].tuple_id, tuples[i].tuple_id);
+      }
+    }
+  }
+  std::remove(file_path.c_str());
+}
+
+TEST_F(RadixPartitionTest, RejectStalePersistedPartitions) {
+  FLAGS_num_radix_bits = 3;
+  const std::string file_path = GetPartitionStoreTestPath();
+  std::unique_ptr<TableView> persisted_table(CreateUnpartitionedTable(2, 1000));
+  PersistPartitions(file_path, persisted_table.get());
+
+  std::unique_ptr<TableView> table(CreateUnpartitionedTable(2, 1000));
+  // The number of radix bits has changed.
+  FLAGS_num_radix_bits = 4;
+  EXPECT_FALSE(LoadPersistedPartitions(file_path, table.get()));
+  FLAGS_num_radix_bits = 3;
+
+  // The key hash function has changed.
+  const KeyHashFunction saved_key_hash_function = key_hash_function;
+  key_hash_function = (saved_key_hash_function == KeyHashFunction::kMurmur
+                           ? KeyHashFunction::kIdentity
+                           : KeyHashFunction::kMurmur);
+  EXPECT_FALSE(LoadPersistedPartitions(file_path, table.get()));
+  key_hash_function = saved_key_hash_function;
+  ExpectNotPartitioned(*table);
+
+  // The data file has changed.
+  std::unique_ptr<TableView> larger_table(CreateUnpartitionedTable(2, 1001));
+  EXPECT_FALSE(LoadPersistedPartitions(file_path, larger_table.get()));
+  ExpectNotPartitioned(*larger_table);
+  std::unique_ptr<TableView> narrower_table(CreateUnpartitionedTable(1, 1000));
+  EXPECT_FALSE(LoadPersistedPartitions(file_path, narrower_table.get()));
+  ExpectNotPartitioned(*narrower_table);
+
+  EXPECT_TRUE(LoadPersistedPartitions(file_path, table.get()));
+  std::remove(file_path.c_str());
+}
+
+TEST_F(RadixPartitionTest, RejectCorruptPersistedPartitions) {
+  FLAGS_num_radix_bits = 3;
+  const std::string file_path = GetPartitionStoreTestPath();
+  std::unique_ptr<TableView> persisted_table(CreateUnpartitionedTable(2, 1000));
+  std::unique_ptr<TableView> table(CreateUnpartitionedTable(2, 1000));
+
+  // Truncated in the header, in the partition entries, and in the partitions.
+  for (const off_t file_size : {0, 32, 80, 2000}) {
+    PersistPartitions(file_path, persisted_table.get());
+    ASSERT_EQ(0, truncate(file_path.c_str(), file_size));
+    EXPECT_FALSE(LoadPersistedPartitions(file_path, table.get())) << file_size;
+    ExpectNotPartitioned(*table);
+  }
+
+  // The magic, the version, and the number of tuples of the first partition
+  // of the first column, which is right after the header of a cache line.
+  for (const std::streamoff offset : {0, 8, 72}) {
+    PersistPartitions(file_path, persisted_table.get());
+    {
+      std::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+      ASSERT_TRUE(file.is_open());
+      file.seekp(offset);
+      const std::uint32_t garbage = 0xdeadbeef;
+      file.write(reinterpret_cast<const char*>(&garbage), sizeof(garbage));
+    }
+    EXPECT_FALSE(LoadPersistedPartitions(file_path, table.get())) << offset;
+    ExpectNotPartitioned(*table);
+  }
+  std::remove(file_path.c_str());
+}
+
+}  // namespace quickfoil
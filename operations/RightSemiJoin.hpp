@@ -33,7 +33,9 @@ class RightSemiJoin : public SemiJoin {
                  std::move(project_column_ids)),
         finished_(false) {}
 
-  SemiJoinChunk* Next() override;
+  using SemiJoin::Next;
+
+  bool Next(SemiJoinChunk* chunk) override;
 
  private:
   bool finished_;
@@ -42,43 +44,41 @@ class RightSemiJoin : public SemiJoin {
 };
 
 template <int num_keys>
-SemiJoinChunk* RightSemiJoin<num_keys>::Next() {
+bool RightSemiJoin<num_keys>::Next(SemiJoinChunk* chunk) {
   if (finished_) {
-    return nullptr;
+    return false;
   }
 
   finished_ = true;
 
   const size_type num_build_tuples = build_table_.num_tuples();
 
-  BitVector bit_vector(num_build_tuples);
+  BitVector& bit_vector = chunk->semi_bitvector;
+  bit_vector.resize(num_build_tuples);
+  bit_vector.reset();
 
-  const std::uint32_t mask = build_hash_table_.mask();
-  const int* __restrict__ buckets = build_hash_table_.buckets();
-  const int* __restrict__ next = build_hash_table_.next();
   const size_type num_probe_tuples = probe_table_.num_tuples();
   for (size_type probe_tid = 0; probe_tid < num_probe_tuples; ++probe_tid) {
-    const hash_type hash_value = Hash<num_keys>(probe_key_values_, probe_tid);
-    const int bucket_id = hash_value & mask;
-    for (int build_position = buckets[bucket_id] - 1;
-         build_position >= 0;
-         build_position = next[build_position] - 1) {
-      if (VectorEqualAt<num_keys>(probe_key_values_,
-                                  build_key_values_,
-                                  probe_tid,
-                                  build_position)) {
-        bit_vector.test_set(build_position);
-      }
-    }
+    build_hash_table_.Probe(
+        Hash<num_keys>(probe_key_values_, probe_tid),
+        [&](int build_position) -> bool {
+          if (VectorEqualAt<num_keys>(probe_key_values_,
+                                      build_key_values_,
+                                      probe_tid,
+                                      build_position)) {
+            bit_vector.test_set(build_position);
+          }
+          return false;
+        });
   }
 
-  Vector<const cpp_type*> output_columns;
+  chunk->output_columns.clear();
   for (int column_id : project_column_ids_) {
-    output_columns.emplace_back(
+    chunk->output_columns.emplace_back(
         build_table_.column_at(column_id)->template as_type<cpp_type>());
   }
-  return new SemiJoinChunk(std::move(output_columns),
-                           std::move(bit_vector));
+  chunk->num_ones = bit_vector.count();
+  return true;
 }
 
 }  // namespace quickfoil
@@ -0,0 +1,108 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "operations/SemiBitVectorMerger.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "learner/PredicateEvaluationPlan.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+namespace {
+
+void MergeSemiBitVector(BitVector* semi_bitvector,
+                        size_type* num_covered,
+                        BitVector* merged_semi_bitvector) {
+  if (semi_bitvector->empty()) {
+    return;
+  }
+  *num_covered -= semi_bitvector->count();
+  if (merged_semi_bitvector->empty()) {
+    *merged_semi_bitvector = std::move(*semi_bitvector);
+  } else {
+    DCHECK_EQ(merged_semi_bitvector->size(), semi_bitvector->size());
+    *merged_semi_bitvector |= *semi_bitvector;
+  }
+}
+
+}  // namespace
+
+void SemiBitVectorMerger::Merge(int table_id,
+                                int join_group_id,
+                                PredicateEvaluationPlan* plan) {
+  const int partition_id = plan->saved_partition_id;
+  if (partition_id < 0 ||
+      !scheduler_.IsSplit(table_id, join_group_id, partition_id)) {
+    return;
+  }
+
+  Vector<PredicateTreeNode*> literal_nodes;
+  for (const PredicateTreeNodePtr& tree_node : plan->tree_nodes) {
+    if (tree_node->literal != nullptr) {
+      literal_nodes.emplace_back(tree_node.get());
+    }
+  }
+  const std::size_t num_literals = literal_nodes.size() + (plan->literal != nullptr ? 1 : 0);
+  if (num_literals == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  MergedPartition* merged_partition =
+      &merged_partitions_[scheduler_.GetPartitionKey(table_id, join_group_id, partition_id)];
+  if (merged_partition->literals.empty()) {
+    if (plan->literal != nullptr) {
+      merged_partition->literals.emplace_back(plan->literal);
+    }
+    for (PredicateTreeNode* literal_node : literal_nodes) {
+      merged_partition->literals.emplace_back(literal_node->literal);
+    }
+    merged_partition->positive_semi_bitvectors.resize(num_literals);
+    merged_partition->negative_semi_bitvectors.resize(num_literals);
+  }
+  DCHECK_EQ(num_literals, merged_partition->literals.size());
+
+  std::size_t literal_id = 0;
+  if (plan->literal != nullptr) {
+    MergeSemiBitVector(&plan->positive_semi_bitvector,
+                       &plan->literal->num_covered_positive,
+                       &merged_partition->positive_semi_bitvectors[literal_id]);
+    MergeSemiBitVector(&plan->negative_semi_bitvector,
+                       &plan->literal->num_covered_negative,
+                       &merged_partition->negative_semi_bitvectors[literal_id]);
+    ++literal_id;
+  }
+  for (PredicateTreeNode* literal_node : literal_nodes) {
+    MergeSemiBitVector(&literal_node->positive_semi_bitvector,
+                       &literal_node->literal->num_covered_positive,
+                       &merged_partition->positive_semi_bitvectors[literal_id]);
+    MergeSemiBitVector(&literal_node->negative_semi_bitvector,
+                       &literal_node->literal->num_covered_negative,
+                       &merged_partition->negative_semi_bitvectors[literal_id]);
+    ++literal_id;
+  }
+}
+
+void SemiBitVectorMerger::Finalize() {
+  for (auto& key_and_merged_partition : merged_partitions_) {
+    MergedPartition& merged_partition = key_and_merged_partition.second;
+    for (std::size_t i = 0; i < merged_partition.literals.size(); ++i) {
+      merged_partition.literals[i]->num_covered_positive +=
+          merged_partition.positive_semi_bitvectors[i].count();
+      merged_partition.literals[i]->num_covered_negative +=
+          merged_partition.negative_semi_bitvectors[i].count();
+    }
+  }
+  merged_partitions_.clear();
+}
+
+}  // namespace quickfoil
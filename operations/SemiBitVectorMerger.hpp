@@ -0,0 +1,62 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_OPERATIONS_SEMI_BIT_VECTOR_MERGER_HPP_
+#define QUICKFOIL_OPERATIONS_SEMI_BIT_VECTOR_MERGER_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+
+#include "learner/PredicateEvaluationPlan.hpp"
+#include "operations/PartitionChunkScheduler.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+namespace quickfoil {
+
+class CandidateLiteralInfo;
+
+// Computes the number of covered bindings of the partitions split by a
+// PartitionChunkScheduler. The semi-bitvectors a CountAggregator builds for a
+// split partition only reflect the chunks it has processed, so the number of
+// covered bindings counted from them is withdrawn and the semi-bitvectors are
+// OR-ed with those of the other aggregators. The final counts are added back
+// by Finalize().
+class SemiBitVectorMerger {
+ public:
+  explicit SemiBitVectorMerger(const PartitionChunkScheduler& scheduler)
+      : scheduler_(scheduler) {}
+
+  // Called by an aggregator when it is done with the current partition of
+  // <plan>, before the semi-bitvectors of <plan> are reset. Thread-safe.
+  void Merge(int table_id,
+             int join_group_id,
+             PredicateEvaluationPlan* plan);
+
+  // Adds the numbers of covered bindings of the merged semi-bitvectors to the
+  // literals. Must be called after all the aggregators are done.
+  void Finalize();
+
+ private:
+  struct MergedPartition {
+    Vector<CandidateLiteralInfo*> literals;
+    Vector<BitVector> positive_semi_bitvectors;
+    Vector<BitVector> negative_semi_bitvectors;
+  };
+
+  const PartitionChunkScheduler& scheduler_;
+
+  std::mutex mutex_;
+  // Keyed by (table_id, join_group_id, partition_id).
+  std::unordered_map<std::size_t, MergedPartition> merged_partitions_;
+
+  DISALLOW_COPY_AND_ASSIGN(SemiBitVectorMerger);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_OPERATIONS_SEMI_BIT_VECTOR_MERGER_HPP_ */
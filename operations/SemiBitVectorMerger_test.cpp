@@ -0,0 +1,229 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "operations/SemiBitVectorMerger.hpp"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "learner/CandidateLiteralInfo.hpp"
+#include "learner/PredicateEvaluationPlan.hpp"
+#include "memory/Buffer.hpp"
+#include "operations/PartitionAssigner.hpp"
+#include "operations/PartitionChunkScheduler.hpp"
+#include "operations/RadixPartition.hpp"
+#include "storage/TableView.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/ThreadPool.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_radix_bits);
+
+namespace {
+
+typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+typedef PartitionChunkScheduler::partition_tuple_type partition_tuple_type;
+
+// The size of the semi-bitvectors, i.e. of the binding partitions.
+constexpr std::size_t kNumBindings = 97;
+constexpr int kNumLiterals = 3;
+
+// Returns whether the literal <literal_id> covers a binding with the
+// background tuple <tuple>, and which one it covers in <binding_id>.
+bool CoversBinding(int literal_id, const partition_tuple_type& tuple, std::size_t* binding_id) {
+  *binding_id = (tuple.tuple_id * (literal_id + 7) + literal_id) % kNumBindings;
+  return (tuple.tuple_id + literal_id) % (literal_id + 2) != 0;
+}
+
+// A plan with a root literal and kNumLiterals - 1 tree node literals, and the
+// literals it counts.
+struct TestPlan {
+  TestPlan() {
+    for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+      literals.emplace_back(new CandidateLiteralInfo(nullptr));
+    }
+    plan.literal = literals[0].get();
+    for (int literal_id = 1; literal_id < kNumLiterals; ++literal_id) {
+      plan.tree_nodes.emplace_back(new PredicateTreeNode(literals[literal_id].get()));
+    }
+  }
+
+  BitVector* semi_bitvector(int literal_id, bool positive) {
+    if (literal_id == 0) {
+      return positive ? &plan.positive_semi_bitvector : &plan.negative_semi_bitvector;
+    }
+    PredicateTreeNode* tree_node = plan.tree_nodes[literal_id - 1].get();
+    return positive ? &tree_node->positive_semi_bitvector : &tree_node->negative_semi_bitvector;
+  }
+
+  Vector<std::unique_ptr<CandidateLiteralInfo>> literals;
+  PredicateEvaluationPlan plan;
+};
+
+}  // namespace
+
+class SemiBitVectorMergerTest : public ::testing::Test {
+ protected:
+  SemiBitVectorMergerTest() {
+    FLAGS_num_radix_bits = 2;
+    FLAGS_partition_chunck_size = 8;
+  }
+
+  // Adds a table whose only column has <num_tuples> tuples, most of which are
+  // in the partition of 0.
+  void AddTable(int num_tuples) {
+    BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+    cpp_type* values = column->mutable_as_type<cpp_type>();
+    for (int i = 0; i < num_tuples; ++i) {
+      values[i] = (i % 10 == 0 ? i : 0);
+    }
+    Vector<ConstBufferPtr> columns;
+    columns.emplace_back(std::make_shared<const ConstBuffer>(column));
+    tables_.emplace_back(new TableView(std::move(columns)));
+    RadixPartition(0, tables_.back().get());
+    table_ptrs_.emplace_back(tables_.back().get());
+    partition_column_ids_.emplace_back(1, 0);
+  }
+
+  // Counts the covered bindings of the literals of every table as a
+  // CountAggregator does on the chunks scheduled for <num_workers> workers,
+  // with the semi-bitvectors of the split partitions merged by a
+  // SemiBitVectorMerger. The counts of every literal summed over the workers
+  // are set in <num_covered_positive> and <num_covered_negative>.
+  void CountInParallel(int num_workers,
+                       Vector<Vector<size_type>>* num_covered_positive,
+                       Vector<Vector<size_type>>* num_covered_negative) {
+    PartitionChunkScheduler scheduler(table_ptrs_, partition_column_ids_, num_workers);
+    SemiBitVectorMerger merger(scheduler);
+    Vector<Vector<std::unique_ptr<TestPlan>>> worker_plans(num_workers);
+    for (int worker_id = 0; worker_id < num_workers; ++worker_id) {
+      for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+        worker_plans[worker_id].emplace_back(new TestPlan);
+      }
+    }
+
+    ThreadPool thread_pool(num_workers);
+    thread_pool.Run(
+        num_workers,
+        [&scheduler, &merger, &worker_plans](int worker_id) {
+          PartitionChunk chunk;
+          while (scheduler.Next(worker_id, &chunk)) {
+            TestPlan* test_plan = worker_plans[worker_id][chunk.table_id].get();
+            if (test_plan->plan.saved_partition_id != chunk.partition_id) {
+              merger.Merge(chunk.table_id, chunk.join_group_id, &test_plan->plan);
+              for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+                for (const bool positive : {true, false}) {
+                  test_plan->semi_bitvector(literal_id, positive)->resize(kNumBindings);
+                  test_plan->semi_bitvector(literal_id, positive)->reset();
+                }
+              }
+              test_plan->plan.saved_partition_id = chunk.partition_id;
+            }
+            for (std::size_t i = 0; i < chunk.num_tuples; ++i) {
+              for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+                std::size_t binding_id;
+                if (!CoversBinding(literal_id, chunk.tuples[i], &binding_id)) {
+                  continue;
+                }
+                // The odd bindings are the positive ones.
+                const bool positive = (binding_id % 2 == 1);
+                CandidateLiteralInfo* literal = test_plan->literals[literal_id].get();
+                if (!test_plan->semi_bitvector(literal_id, positive)->test_set(binding_id)) {
+                  ++(positive ? literal->num_covered_positive : literal->num_covered_negative);
+                }
+              }
+            }
+            if (worker_id == 0) {
+              std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+          }
+          for (std::size_t table_id = 0; table_id < worker_plans[worker_id].size(); ++table_id) {
+            merger.Merge(table_id, 0, &worker_plans[worker_id][table_id]->plan);
+          }
+        });
+    merger.Finalize();
+
+    num_covered_positive->assign(tables_.size(), Vector<size_type>(kNumLiterals, 0));
+    num_covered_negative->assign(tables_.size(), Vector<size_type>(kNumLiterals, 0));
+    for (int worker_id = 0; worker_id < num_workers; ++worker_id) {
+      for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+        for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+          const CandidateLiteralInfo& literal = *worker_plans[worker_id][table_id]->literals[literal_id];
+          (*num_covered_positive)[table_id][literal_id] += literal.num_covered_positive;
+          (*num_covered_negative)[table_id][literal_id] += literal.num_covered_negative;
+        }
+      }
+    }
+  }
+
+  // Counts the covered bindings of the literals with the semi-bitvectors of
+  // every partition OR-ed over all its tuples.
+  void CountSerially(Vector<Vector<size_type>>* num_covered_positive,
+                     Vector<Vector<size_type>>* num_covered_negative) {
+    num_covered_positive->assign(tables_.size(), Vector<size_type>(kNumLiterals, 0));
+    num_covered_negative->assign(tables_.size(), Vector<size_type>(kNumLiterals, 0));
+    for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+      for (const ConstBufferPtr& partition : tables_[table_id]->partitions_at(0)) {
+        const partition_tuple_type* tuples = partition->as_type<partition_tuple_type>();
+        for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+          BitVector positive_semi_bitvector(kNumBindings);
+          BitVector negative_semi_bitvector(kNumBindings);
+          for (std::size_t i = 0; i < partition->num_tuples(); ++i) {
+            std::size_t binding_id;
+            if (CoversBinding(literal_id, tuples[i], &binding_id)) {
+              (binding_id % 2 == 1 ? positive_semi_bitvector : negative_semi_bitvector).set(binding_id);
+            }
+          }
+          (*num_covered_positive)[table_id][literal_id] += positive_semi_bitvector.count();
+          (*num_covered_negative)[table_id][literal_id] += negative_semi_bitvector.count();
+        }
+      }
+    }
+  }
+
+  Vector<std::unique_ptr<TableView>> tables_;
+  Vector<const TableView*> table_ptrs_;
+  Vector<Vector<int>> partition_column_ids_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SemiBitVectorMergerTest);
+};
+
+// The semi-bitvectors of a worker only have the bits of the serial OR of its
+// partition, so the merged semi-bitvectors equal the serial OR iff the counts
+// of their bits are the same.
+TEST_F(SemiBitVectorMergerTest, MergedCountsEqualSerialOr) {
+  AddTable(3000);
+  AddTable(500);
+  Vector<Vector<size_type>> expected_positive;
+  Vector<Vector<size_type>> expected_negative;
+  CountSerially(&expected_positive, &expected_negative);
+
+  for (const int num_workers : {1, 2, 3, 6}) {
+    Vector<Vector<size_type>> actual_positive;
+    Vector<Vector<size_type>> actual_negative;
+    CountInParallel(num_workers, &actual_positive, &actual_negative);
+    for (std::size_t table_id = 0; table_id < tables_.size(); ++table_id) {
+      for (int literal_id = 0; literal_id < kNumLiterals; ++literal_id) {
+        EXPECT_EQ(expected_positive[table_id][literal_id], actual_positive[table_id][literal_id])
+            << num_workers << " workers, table " << table_id << ", literal " << literal_id;
+        EXPECT_EQ(expected_negative[table_id][literal_id], actual_negative[table_id][literal_id])
+            << num_workers << " workers, table " << table_id << ", literal " << literal_id;
+      }
+    }
+  }
+}
+
+}  // namespace quickfoil
@@ -25,6 +25,9 @@ class FoilHashTable;
 struct SemiJoinChunk {
   typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
 
+  SemiJoinChunk()
+      : num_ones(0) {}
+
   SemiJoinChunk(Vector<const cpp_type*>&& output_columns_in,
                 BitVector&& semi_bitvector_in)
       : output_columns(std::move(output_columns_in)),
@@ -66,7 +69,20 @@ class SemiJoin {
 
   virtual ~SemiJoin() {}
 
-  virtual SemiJoinChunk* Next() = 0;
+  // Returns the next chunk, which is owned by the caller, or nullptr if there
+  // is none left.
+  SemiJoinChunk* Next() {
+    std::unique_ptr<SemiJoinChunk> chunk(new SemiJoinChunk);
+    if (!Next(chunk.get())) {
+      return nullptr;
+    }
+    return chunk.release();
+  }
+
+  // Fills <chunk> with the next chunk, reusing the memory of <chunk>. Returns
+  // false if there is none left. Callers that do not keep the chunks should
+  // pass the same chunk to every call.
+  virtual bool Next(SemiJoinChunk* chunk) = 0;
 
  protected:
   const TableView& probe_table_;
@@ -45,8 +45,8 @@ SemiJoin* CreateSemiJoinHelper(bool left_semijoin,
 SemiJoin* SelectAndCreateSemiJoin(
     const TableView& output_table,
     const TableView& other_table,
-    std::unique_ptr<FoilHashTable>* output_hash_table,
-    std::unique_ptr<FoilHashTable>* other_hash_table,
+    std::shared_ptr<const FoilHashTable>* output_hash_table,
+    std::shared_ptr<const FoilHashTable>* other_hash_table,
     const Vector<AttributeReference>& output_join_keys,
     const Vector<AttributeReference>& other_join_keys,
     const Vector<int>& project_column_ids) {
@@ -14,11 +14,15 @@ class FoilHashTable;
 class SemiJoin;
 class TableView;
 
+// Creates a semi-join that outputs the tuples of <output_table> matching any
+// tuple of <other_table>, which builds the hash table on the smaller table. The
+// hash table is taken from <output_hash_table> or <other_hash_table> if it is
+// already there, and is built into it otherwise.
 SemiJoin* SelectAndCreateSemiJoin(
     const TableView& output_table,
     const TableView& other_table,
-    std::unique_ptr<FoilHashTable>* output_hash_table,
-    std::unique_ptr<FoilHashTable>* other_hash_table,
+    std::shared_ptr<const FoilHashTable>* output_hash_table,
+    std::shared_ptr<const FoilHashTable>* other_hash_table,
     const Vector<AttributeReference>& output_join_keys,
     const Vector<AttributeReference>& other_join_keys,
     const Vector<int>& project_column_ids);
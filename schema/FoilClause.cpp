@@ -5,14 +5,375 @@
 
 #include "schema/FoilClause.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "memory/Buffer.hpp"
 #include "schema/FoilLiteral.hpp"
 #include "schema/FoilVariable.hpp"
+#include "schema/TypeDefs.hpp"
 #include "utility/Vector.hpp"
 
 #include "glog/logging.h"
 
 namespace quickfoil {
 
+namespace {
+
+typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+// Composes the row IDs <parent_row_ids> of the bindings of a parent clause
+// with the row IDs <row_ids> of the bindings of its child into the parent
+// bindings.
+ConstBufferPtr ComposeRowIds(const ConstBufferPtr& parent_row_ids,
+                             size_type num_parent_positive_bindings,
+                             const ConstBufferPtr& row_ids,
+                             size_type num_positive_bindings) {
+  const size_type num_bindings = row_ids->num_tuples();
+  BufferPtr composed_row_ids(std::make_shared<Buffer>(sizeof(size_type) * num_bindings,
+                                                      num_bindings));
+  const size_type* __restrict__ parent_values = parent_row_ids->as_type<size_type>();
+  const size_type* __restrict__ values = row_ids->as_type<size_type>();
+  size_type* __restrict__ composed_values = composed_row_ids->mutable_as_type<size_type>();
+  for (size_type i = 0; i < num_positive_bindings; ++i) {
+    composed_values[i] = parent_values[values[i]];
+  }
+  const size_type* __restrict__ parent_negative_values =
+      parent_values + num_parent_positive_bindings;
+  for (size_type i = num_positive_bindings; i < num_bindings; ++i) {
+    composed_values[i] = parent_negative_values[values[i]];
+  }
+  return std::make_shared<const ConstBuffer>(composed_row_ids);
+}
+
+// Draws <num_samples> distinct row IDs out of [0, <num_rows>) uniformly at
+// random (Floyd's algorithm), and returns them in increasing order.
+Vector<size_type> DrawSortedRowIds(size_type num_rows,
+                                   size_type num_samples,
+                                   std::mt19937* generator) {
+  DCHECK_LE(num_samples, num_rows);
+  std::unordered_set<size_type> sampled_row_ids;
+  for (size_type i = num_rows - num_samples; i < num_rows; ++i) {
+    const size_type row_id = std::uniform_int_distribution<size_type>(0, i)(*generator);
+    if (!sampled_row_ids.insert(row_id).second) {
+      sampled_row_ids.insert(i);
+    }
+  }
+  Vector<size_type> row_ids(sampled_row_ids.begin(), sampled_row_ids.end());
+  std::sort(row_ids.begin(), row_ids.end());
+  return row_ids;
+}
+
+// Gathers the values of <sampled_row_ids> in <source> into <values>, where the
+// i-th value of <source> is at <source_row_ids>[i] if <source_row_ids> is not
+// null.
+void GatherSampledValues(const ConstBufferPtr& source,
+                         const size_type* source_row_ids,
+                         const Vector<size_type>& sampled_row_ids,
+                         cpp_type* values) {
+  const cpp_type* __restrict__ source_values = source->as_type<cpp_type>();
+  if (source_row_ids == nullptr) {
+    for (const size_type row_id : sampled_row_ids) {
+      *values++ = source_values[row_id];
+    }
+  } else {
+    for (const size_type row_id : sampled_row_ids) {
+      *values++ = source_values[source_row_ids[row_id]];
+    }
+  }
+}
+
+}  // namespace
+
+FoilClauseConstSharedPtr FoilClause::CreateSample(size_type num_positive_samples,
+                                                  size_type num_negative_samples,
+                                                  unsigned seed) const {
+  std::mt19937 generator(seed);
+  const Vector<size_type> positive_row_ids =
+      DrawSortedRowIds(num_positive_bindings_,
+                       std::min(num_positive_samples, num_positive_bindings_),
+                       &generator);
+  const Vector<size_type> negative_row_ids =
+      DrawSortedRowIds(num_negative_bindings_,
+                       std::min(num_negative_samples, num_negative_bindings_),
+                       &generator);
+  const size_type num_samples = positive_row_ids.size() + negative_row_ids.size();
+
+  std::shared_ptr<FoilClause> mutable_copy = std::make_shared<FoilClause>(*this);
+  mutable_copy->num_positive_bindings_ = positive_row_ids.size();
+  mutable_copy->num_negative_bindings_ = negative_row_ids.size();
+  for (int column_id = 0; column_id < num_variables(); ++column_id) {
+    ConstBufferPtr positive_source;
+    ConstBufferPtr negative_source;
+    ConstBufferPtr source_row_ids;
+    GetBindingColumnSources(column_id, &positive_source, &negative_source, &source_row_ids);
+
+    BufferPtr buffer(std::make_shared<Buffer>(sizeof(cpp_type) * num_samples, num_samples));
+    cpp_type* values = buffer->mutable_as_type<cpp_type>();
+    if (source_row_ids == nullptr) {
+      GatherSampledValues(positive_source, nullptr, positive_row_ids, values);
+      GatherSampledValues(negative_source, nullptr, negative_row_ids,
+                          values + positive_row_ids.size());
+    } else {
+      const size_type* row_ids = source_row_ids->as_type<size_type>();
+      GatherSampledValues(positive_source, row_ids, positive_row_ids, values);
+      GatherSampledValues(negative_source, row_ids + num_positive_bindings_, negative_row_ids,
+                          values + positive_row_ids.size());
+    }
+    mutable_copy->integral_blocks_.emplace_back(std::make_shared<const ConstBuffer>(buffer));
+  }
+  mutable_copy->lazy_columns_.resize(mutable_copy->integral_blocks_.size());
+
+  BufferPtr origin_row_ids(std::make_shared<Buffer>(sizeof(size_type) * num_samples, num_samples));
+  size_type* origin_values = origin_row_ids->mutable_as_type<size_type>();
+  const size_type* parent_origin_values =
+      origin_row_ids_ == nullptr ? nullptr : origin_row_ids_->as_type<size_type>();
+  for (const size_type row_id : positive_row_ids) {
+    *origin_values++ = (parent_origin_values == nullptr ? row_id : parent_origin_values[row_id]);
+  }
+  for (const size_type row_id : negative_row_ids) {
+    *origin_values++ = (parent_origin_values == nullptr
+                            ? row_id
+                            : parent_origin_values[num_positive_bindings_ + row_id]);
+  }
+  mutable_copy->origin_row_ids_ = std::make_shared<const ConstBuffer>(origin_row_ids);
+  return mutable_copy;
+}
+
+FoilClauseConstSharedPtr FoilClause::CopyWithAdditionalUnBoundBodyLiteral(
+    const FoilLiteral& new_body_literal,
+    bool is_random,
+    const size_type num_positive_bindings,
+    const size_type num_negative_bindings,
+    const ConstBufferPtr& binding_row_ids,
+    Vector<ConstBufferPtr>&& new_binding_blocks) const {
+  DCHECK_EQ(static_cast<std::size_t>(num_positive_bindings + num_negative_bindings),
+            binding_row_ids->num_tuples());
+  std::shared_ptr<FoilClause> mutable_copy = std::make_shared<FoilClause>(*this);
+  mutable_copy->AddUnBoundBodyLiteral(new_body_literal, is_random);
+  mutable_copy->num_positive_bindings_ = num_positive_bindings;
+  mutable_copy->num_negative_bindings_ = num_negative_bindings;
+
+  // The columns with the same row IDs share the composed row IDs.
+  std::unordered_map<const ConstBuffer*, ConstBufferPtr> composed_row_ids;
+  for (int column_id = 0; column_id < num_variables(); ++column_id) {
+    LazyBindingColumn lazy_column;
+    ConstBufferPtr parent_row_ids;
+    GetBindingColumnSources(column_id,
+                            &lazy_column.positive_source,
+                            &lazy_column.negative_source,
+                            &parent_row_ids);
+    if (parent_row_ids == nullptr) {
+      lazy_column.row_ids = binding_row_ids;
+    } else {
+      ConstBufferPtr& row_ids = composed_row_ids[parent_row_ids.get()];
+      if (row_ids == nullptr) {
+        row_ids = ComposeRowIds(parent_row_ids,
+                                num_positive_bindings_,
+                                binding_row_ids,
+                                num_positive_bindings);
+      }
+      lazy_column.row_ids = row_ids;
+    }
+    mutable_copy->integral_blocks_.emplace_back();
+    mutable_copy->lazy_columns_.emplace_back(std::move(lazy_column));
+  }
+  for (ConstBufferPtr& new_binding_block : new_binding_blocks) {
+    mutable_copy->integral_blocks_.emplace_back(std::move(new_binding_block));
+    mutable_copy->lazy_columns_.emplace_back();
+  }
+  mutable_copy->origin_row_ids_ = (origin_row_ids_ == nullptr
+                                       ? binding_row_ids
+                                       : ComposeRowIds(origin_row_ids_,
+                                                       num_positive_bindings_,
+                                                       binding_row_ids,
+                                                       num_positive_bindings));
+  DCHECK_EQ(mutable_copy->num_variables(),
+            static_cast<int>(mutable_copy->integral_blocks_.size()));
+  return mutable_copy;
+}
+
+void FoilClause::GetBindingColumnSources(int column_id,
+                                         ConstBufferPtr* positive_source,
+                                         ConstBufferPtr* negative_source,
+                                         ConstBufferPtr* row_ids) const {
+  if (integral_blocks_.empty()) {
+    *positive_source = positive_blocks_[column_id];
+    *negative_source = negative_blocks_[column_id];
+    row_ids->reset();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(materialize_mutex_);
+  const ConstBufferPtr& block = integral_blocks_[column_id];
+  if (block != nullptr) {
+    *positive_source = std::make_shared<const ConstBuffer>(block,
+                                                           block->data(),
+                                                           num_positive_bindings_);
+    *negative_source = std::make_shared<const ConstBuffer>(
+        block,
+        block->as_type<cpp_type>() + num_positive_bindings_,
+        num_negative_bindings_);
+    row_ids->reset();
+    return;
+  }
+  const LazyBindingColumn& lazy_column = lazy_columns_[column_id];
+  *positive_source = lazy_column.positive_source;
+  *negative_source = lazy_column.negative_source;
+  *row_ids = lazy_column.row_ids;
+}
+
+const ConstBufferPtr& FoilClause::integral_block_at(int column_id) const {
+  DCHECK(!integral_blocks_.empty());
+  std::lock_guard<std::mutex> lock(materialize_mutex_);
+  ConstBufferPtr& block = integral_blocks_[column_id];
+  if (block != nullptr) {
+    return block;
+  }
+
+  LazyBindingColumn* lazy_column = &lazy_columns_[column_id];
+  const size_type num_bindings = GetNumTotalBindings();
+  BufferPtr buffer(std::make_shared<Buffer>(sizeof(cpp_type) * num_bindings,
+                                            num_bindings));
+  const size_type* __restrict__ row_ids = lazy_column->row_ids->as_type<size_type>();
+  const cpp_type* __restrict__ positive_values =
+      lazy_column->positive_source->as_type<cpp_type>();
+  const cpp_type* __restrict__ negative_values =
+      lazy_column->negative_source->as_type<cpp_type>();
+  cpp_type* __restrict__ values = buffer->mutable_as_type<cpp_type>();
+  for (size_type i = 0; i < num_positive_bindings_; ++i) {
+    values[i] = positive_values[row_ids[i]];
+  }
+  for (size_type i = num_positive_bindings_; i < num_bindings; ++i) {
+    values[i] = negative_values[row_ids[i]];
+  }
+
+  block = std::make_shared<const ConstBuffer>(buffer);
+  // Releases the sources, which may be the last references to the bindings of
+  // an ancestor clause.
+  *lazy_column = LazyBindingColumn();
+  return block;
+}
+
+Vector<ConstBufferPtr> FoilClause::GetIntegralBlocks(const Vector<int>& column_ids) const {
+  DCHECK(!integral_blocks_.empty());
+  Vector<bool> is_used(integral_blocks_.size(), false);
+  for (const int column_id : column_ids) {
+    is_used[column_id] = true;
+  }
+
+  Vector<ConstBufferPtr> blocks;
+  for (int column_id = 0; column_id < static_cast<int>(integral_blocks_.size()); ++column_id) {
+    if (is_used[column_id]) {
+      blocks.emplace_back(integral_block_at(column_id));
+    } else {
+      std::lock_guard<std::mutex> lock(materialize_mutex_);
+      if (integral_blocks_[column_id] != nullptr) {
+        blocks.emplace_back(integral_blocks_[column_id]);
+      } else {
+        blocks.emplace_back(std::make_shared<const ConstBuffer>(std::shared_ptr<const Buffer>(),
+                                                                nullptr,
+                                                                GetNumTotalBindings()));
+      }
+    }
+  }
+  return blocks;
+}
+
+Vector<ConstBufferPtr> FoilClause::GetBindingBlocks(const Vector<int>& column_ids) const {
+  if (!integral_blocks_.empty()) {
+    return GetIntegralBlocks(column_ids);
+  }
+
+  Vector<bool> is_used(positive_blocks_.size(), false);
+  for (const int column_id : column_ids) {
+    is_used[column_id] = true;
+  }
+
+  const size_type num_bindings = GetNumTotalBindings();
+  Vector<ConstBufferPtr> blocks;
+  std::lock_guard<std::mutex> lock(binding_cache_mutex_);
+  if (merged_binding_blocks_.empty()) {
+    merged_binding_blocks_.resize(positive_blocks_.size());
+  }
+  for (int column_id = 0; column_id < static_cast<int>(positive_blocks_.size()); ++column_id) {
+    if (!is_used[column_id]) {
+      blocks.emplace_back(std::make_shared<const ConstBuffer>(std::shared_ptr<const Buffer>(),
+                                                              nullptr,
+                                                              num_bindings));
+      continue;
+    }
+    ConstBufferPtr& merged_block = merged_binding_blocks_[column_id];
+    if (merged_block == nullptr) {
+      BufferPtr buffer(std::make_shared<Buffer>(sizeof(cpp_type) * num_bindings,
+                                                num_bindings));
+      std::memcpy(buffer->mutable_data(),
+                  positive_blocks_[column_id]->data(),
+                  sizeof(cpp_type) * num_positive_bindings_);
+      std::memcpy(buffer->mutable_as_type<cpp_type>() + num_positive_bindings_,
+                  negative_blocks_[column_id]->data(),
+                  sizeof(cpp_type) * num_negative_bindings_);
+      merged_block = std::make_shared<const ConstBuffer>(buffer);
+    }
+    blocks.emplace_back(merged_block);
+  }
+  return blocks;
+}
+
+std::shared_ptr<const TableView> FoilClause::GetPartitionedBindings(BindingLabel label,
+                                                                    int column_id) const {
+  std::lock_guard<std::mutex> lock(binding_cache_mutex_);
+  const auto table_it = partitioned_bindings_.find(std::make_pair(label, column_id));
+  return table_it == partitioned_bindings_.end() ? nullptr : table_it->second;
+}
+
+void FoilClause::CachePartitionedBindings(BindingLabel label,
+                                          int column_id,
+                                          const std::shared_ptr<const TableView>& table) const {
+  std::lock_guard<std::mutex> lock(binding_cache_mutex_);
+  partitioned_bindings_[std::make_pair(label, column_id)] = table;
+}
+
+std::shared_ptr<const FoilHashTable> FoilClause::GetBindingHashTable(
+    BindingLabel label,
+    const Vector<int>& key_column_ids) const {
+  std::lock_guard<std::mutex> lock(binding_cache_mutex_);
+  const auto hash_table_it = binding_hash_tables_.find(std::make_pair(label, key_column_ids));
+  return hash_table_it == binding_hash_tables_.end() ? nullptr : hash_table_it->second;
+}
+
+void FoilClause::CacheBindingHashTable(BindingLabel label,
+                                       const Vector<int>& key_column_ids,
+                                       const std::shared_ptr<const FoilHashTable>& hash_table) const {
+  std::lock_guard<std::mutex> lock(binding_cache_mutex_);
+  binding_hash_tables_[std::make_pair(label, key_column_ids)] = hash_table;
+}
+
+Vector<ConstBufferPtr> FoilClause::CreateLabelBlocks(bool is_positive,
+                                                     const Vector<int>* column_ids) const {
+  const Vector<ConstBufferPtr>& integral_blocks =
+      column_ids == nullptr ? this->integral_blocks() : GetIntegralBlocks(*column_ids);
+  const size_type num_bindings = is_positive ? num_positive_bindings_ : num_negative_bindings_;
+  const size_type offset = is_positive ? 0 : num_positive_bindings_;
+
+  Vector<ConstBufferPtr> blocks;
+  for (const ConstBufferPtr& block : integral_blocks) {
+    blocks.emplace_back(
+        std::make_shared<const ConstBuffer>(
+            block,
+            block->data() == nullptr ? nullptr : block->as_type<cpp_type>() + offset,
+            num_bindings));
+  }
+  return blocks;
+}
+
 bool FoilClause::Equals(const FoilClause& other) const {
   if (num_body_literals() != other.num_body_literals()) {
     return false;
@@ -6,7 +6,9 @@
 #ifndef QUICKFOIL_SCHEMA_FOILCLAUSE_HPP_
 #define QUICKFOIL_SCHEMA_FOILCLAUSE_HPP_
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -14,6 +16,7 @@
 #include "memory/Buffer.hpp"
 #include "schema/FoilVariable.hpp"
 #include "schema/FoilLiteral.hpp"
+#include "schema/TypeDefs.hpp"
 #include "types/TypeID.hpp"
 #include "types/TypeTraits.hpp"
 #include "utility/Macros.hpp"
@@ -23,7 +26,9 @@
 
 namespace quickfoil {
 
+class FoilHashTable;
 class FoilPredicate;
+class TableView;
 
 class FoilClause;
 typedef std::shared_ptr<const FoilClause> FoilClauseConstSharedPtr;
@@ -32,6 +37,13 @@ class FoilClause {
  public:
   typedef typename TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
 
+  // The bindings that a table or hash table cached with the clause is on.
+  enum class BindingLabel {
+    kAll,
+    kPositive,
+    kNegative
+  };
+
   // Takes ownership of head_literal.
   FoilClause(const FoilLiteral& head_literal)
       : head_literal_(head_literal),
@@ -74,28 +86,25 @@ class FoilClause {
     return positive_blocks_;
   }
 
+  // Creates the views of the positive (negative) bindings on the integral
+  // blocks. All the columns are materialized.
   Vector<ConstBufferPtr> CreatePositiveBlocks() const {
-    DCHECK(!integral_blocks_.empty());
-    Vector<ConstBufferPtr> positive_blocks;
-    for (const ConstBufferPtr& block : integral_blocks_) {
-      positive_blocks.emplace_back(
-          std::make_shared<const ConstBuffer>(block,
-                                              block->data(),
-                                              num_positive_bindings_));
-    }
-    return positive_blocks;
+    return CreateLabelBlocks(true, nullptr);
   }
 
   Vector<ConstBufferPtr> CreateNegativeBlocks() const {
-    DCHECK(!integral_blocks_.empty());
-    Vector<ConstBufferPtr> negative_blocks;
-    for (const ConstBufferPtr& block : integral_blocks_) {
-      negative_blocks.emplace_back(
-          std::make_shared<const ConstBuffer>(block,
-                                              block->as_type<cpp_type>() + num_positive_bindings_,
-                                              num_negative_bindings_));
-    }
-    return negative_blocks;
+    return CreateLabelBlocks(false, nullptr);
+  }
+
+  // Same as above, but only the columns in <column_ids> are materialized. The
+  // other columns are placeholders with the right number of tuples and no
+  // data, which must not be accessed.
+  Vector<ConstBufferPtr> CreatePositiveBlocks(const Vector<int>& column_ids) const {
+    return CreateLabelBlocks(true, &column_ids);
+  }
+
+  Vector<ConstBufferPtr> CreateNegativeBlocks(const Vector<int>& column_ids) const {
+    return CreateLabelBlocks(false, &column_ids);
   }
 
   const Vector<ConstBufferPtr>& negative_blocks() const {
@@ -103,11 +112,29 @@ class FoilClause {
     return negative_blocks_;
   }
 
+  // Materializes all the columns of the bindings.
   const Vector<ConstBufferPtr>& integral_blocks() const {
     DCHECK(!integral_blocks_.empty());
+    for (int column_id = 0; column_id < static_cast<int>(integral_blocks_.size()); ++column_id) {
+      integral_block_at(column_id);
+    }
     return integral_blocks_;
   }
 
+  // Materializes the column <column_id> of the bindings if it is not yet.
+  // Thread-safe.
+  const ConstBufferPtr& integral_block_at(int column_id) const;
+
+  // Returns the integral blocks in which only the columns in <column_ids> are
+  // materialized, and the others are placeholders without data.
+  Vector<ConstBufferPtr> GetIntegralBlocks(const Vector<int>& column_ids) const;
+
+  // Same as GetIntegralBlocks(), but also works on a clause whose binding data
+  // are not consecutive, for which the positive and negative blocks of each
+  // column in <column_ids> are copied into an integral block the first time
+  // the column is used. Thread-safe.
+  Vector<ConstBufferPtr> GetBindingBlocks(const Vector<int>& column_ids) const;
+
   const Vector<FoilVariable>& variables() const {
     return variables_;
   }
@@ -160,18 +187,64 @@ class FoilClause {
     return mutable_clause;
   }
 
+  // Creates a copy with the body literal <new_body_literal> added, whose
+  // bindings are given by <binding_row_ids> and <new_binding_blocks>. The
+  // first <num_positive_bindings> row IDs refer to the positive bindings of
+  // this clause, and the others to the negative bindings. The columns of this
+  // clause are not copied, but gathered through the row IDs only when they
+  // are accessed. <new_binding_blocks> are the columns of the variables
+  // introduced by <new_body_literal>.
   FoilClauseConstSharedPtr CopyWithAdditionalUnBoundBodyLiteral(
       const FoilLiteral& new_body_literal,
       bool is_random,
       const size_type num_positive_bindings,
       const size_type num_negative_bindings,
-      Vector<ConstBufferPtr>&& binding_blocks) const {
-    std::shared_ptr<FoilClause> mutable_copy = std::make_shared<FoilClause>(*this);
-    mutable_copy->AddUnBoundBodyLiteral(new_body_literal, is_random);
-    mutable_copy->num_positive_bindings_ = num_positive_bindings;
-    mutable_copy->num_negative_bindings_ = num_negative_bindings;
-    mutable_copy->integral_blocks_ = std::move(binding_blocks);
-    return mutable_copy;
+      const ConstBufferPtr& binding_row_ids,
+      Vector<ConstBufferPtr>&& new_binding_blocks) const;
+
+  // Creates a copy whose bindings are a uniform random sample without
+  // replacement of <num_positive_samples> positive and <num_negative_samples>
+  // negative bindings of this clause, drawn with <seed>. A label with fewer
+  // bindings is not sampled. The sampled bindings keep their relative order,
+  // and all their columns are materialized.
+  FoilClauseConstSharedPtr CreateSample(size_type num_positive_samples,
+                                        size_type num_negative_samples,
+                                        unsigned seed) const;
+
+  // The partitions and the hash tables built on the bindings are cached with
+  // the clause, so that all the evaluations and semi-joins on the same binding
+  // data share them. The cache methods are thread-safe.
+
+  // Returns the cached table on the bindings with <label>, which is
+  // partitioned with hash tables on the column <column_id>, or null if there
+  // is none. The other columns of the table may be placeholders, so the
+  // partitions are meant to be shared by TableView::SharePartitionsAt().
+  std::shared_ptr<const TableView> GetPartitionedBindings(BindingLabel label,
+                                                          int column_id) const;
+
+  // Caches <table>, which must be on the bindings with <label> and partitioned
+  // with hash tables on the column <column_id>.
+  void CachePartitionedBindings(BindingLabel label,
+                                int column_id,
+                                const std::shared_ptr<const TableView>& table) const;
+
+  // Returns the cached hash table built by BuildHashTableOnTable() on the
+  // columns <key_column_ids> of the bindings with <label>, or null if there is
+  // none.
+  std::shared_ptr<const FoilHashTable> GetBindingHashTable(BindingLabel label,
+                                                           const Vector<int>& key_column_ids) const;
+
+  void CacheBindingHashTable(BindingLabel label,
+                             const Vector<int>& key_column_ids,
+                             const std::shared_ptr<const FoilHashTable>& hash_table) const;
+
+  // Returns the IDs of the tuples that the bindings originate from in the
+  // bindings of the clause without body literals, where the first
+  // GetNumPositiveBindings() IDs are of the positive bindings and refer to its
+  // positive bindings, and the others to its negative bindings. Null if the
+  // clause has no body literal, i.e. every binding is its own origin.
+  const ConstBufferPtr& origin_row_ids() const {
+    return origin_row_ids_;
   }
 
   bool IsBindingDataConseuctive() const {
@@ -210,8 +283,28 @@ class FoilClause {
  private:
   friend class FoilParser;
 
+  // A binding column that is not materialized: the value of the i-th binding
+  // is the <row_ids>[i]-th value of <positive_source> if the binding is
+  // positive, or of <negative_source> otherwise. The row IDs are shared by all
+  // the columns from the same sources.
+  struct LazyBindingColumn {
+    ConstBufferPtr positive_source;
+    ConstBufferPtr negative_source;
+    ConstBufferPtr row_ids;
+  };
+
   void AddBoundBodyLiteral(const FoilLiteral& body_literal, bool is_random);
 
+  Vector<ConstBufferPtr> CreateLabelBlocks(bool is_positive,
+                                           const Vector<int>* column_ids) const;
+
+  // Gets the sources of the column <column_id> and the row IDs into them. The
+  // row IDs are null if the sources are the materialized column itself.
+  void GetBindingColumnSources(int column_id,
+                               ConstBufferPtr* positive_source,
+                               ConstBufferPtr* negative_source,
+                               ConstBufferPtr* row_ids) const;
+
   FoilLiteral head_literal_;
   Vector<FoilLiteral> body_literals_;
   Vector<FoilVariable> variables_;  // 1:1 matching with binding_columns_;
@@ -220,7 +313,19 @@ class FoilClause {
   size_type num_negative_bindings_;
   Vector<ConstBufferPtr> positive_blocks_;
   Vector<ConstBufferPtr> negative_blocks_;
-  Vector<ConstBufferPtr> integral_blocks_;
+  ConstBufferPtr origin_row_ids_;
+  // The columns that are not materialized are null, and are described by
+  // <lazy_columns_> instead.
+  mutable Vector<ConstBufferPtr> integral_blocks_;
+  mutable Vector<LazyBindingColumn> lazy_columns_;
+  mutable std::mutex materialize_mutex_;
+
+  mutable std::map<std::pair<BindingLabel, int>, std::shared_ptr<const TableView>> partitioned_bindings_;
+  mutable std::map<std::pair<BindingLabel, Vector<int>>, std::shared_ptr<const FoilHashTable>> binding_hash_tables_;
+  // The integral blocks copied by GetBindingBlocks(), which are null until
+  // used.
+  mutable Vector<ConstBufferPtr> merged_binding_blocks_;
+  mutable std::mutex binding_cache_mutex_;
 
   int num_variables_without_last_body_literal_;
 
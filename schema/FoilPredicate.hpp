@@ -6,6 +6,7 @@
 #ifndef QUICKFOIL_SCHEMA_FOILPREDICATE_HPP_
 #define QUICKFOIL_SCHEMA_FOILPREDICATE_HPP_
 
+#include <mutex>
 #include <string>
 
 #include "memory/Buffer.hpp"
@@ -47,6 +48,19 @@ class FoilPredicate {
     return &fact_table_;
   }
 
+  // Returns the facts partitioned on the column <column_id>. If they are not
+  // yet, <partition>(column_id, table) partitions them in place first.
+  // Thread-safe, because concurrent evaluators may request the partitions.
+  template <typename PartitionFunctor>
+  const TableView& GetPartitionedFactTable(int column_id,
+                                           const PartitionFunctor& partition) const {
+    std::lock_guard<std::mutex> lock(partition_mutex_);
+    if (fact_table_.partitions_at(column_id).empty()) {
+      partition(column_id, const_cast<TableView*>(&fact_table_));
+    }
+    return fact_table_;
+  }
+
   const Vector<int>& argument_types() const {
     return argument_types_;
   }
@@ -74,6 +88,8 @@ class FoilPredicate {
   int key_;
   Vector<int> argument_types_;
   TableView fact_table_;
+  // Protects the partitions of <fact_table_> created on demand.
+  mutable std::mutex partition_mutex_;
 
   DISALLOW_COPY_AND_ASSIGN(FoilPredicate);
 };
@@ -0,0 +1,311 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "storage/ColumnStore.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "memory/Buffer.hpp"
+#include "memory/MemUtil.hpp"
+#include "storage/TableView.hpp"
+#include "utility/Vector.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+namespace {
+
+constexpr char kColumnStoreMagic[8] = {'Q', 'F', 'C', 'O', 'L', 'U', 'M', 'N'};
+constexpr std::uint32_t kColumnStoreVersion = 2;
+constexpr char kPartitionStoreMagic[8] = {'Q', 'F', 'P', 'A', 'R', 'T', 'S', 0};
+constexpr std::uint32_t kPartitionStoreVersion = 1;
+
+struct ColumnStoreHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t value_size;
+  std::uint64_t num_columns;
+  std::uint64_t num_tuples;
+  std::uint64_t column_bytes;
+  std::uint64_t source_file_size;
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+static_assert(sizeof(ColumnStoreHeader) == CACHE_LINE_SIZE,
+              "The size of the column store header is not a cache line");
+
+struct PartitionStoreHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t tuple_size;
+  std::uint64_t signature;
+  std::uint64_t num_columns;
+  std::uint64_t num_partitions;
+  std::uint64_t num_tuples;
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+static_assert(sizeof(PartitionStoreHeader) == CACHE_LINE_SIZE,
+              "The size of the partition store header is not a cache line");
+
+struct PartitionStoreEntry {
+  std::uint64_t offset;
+  std::uint64_t num_tuples;
+};
+
+inline std::uint64_t RoundUpToCacheLine(std::uint64_t num_bytes) {
+  return (num_bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+inline std::uint64_t GetColumnBytes(std::uint64_t num_tuples, std::size_t value_size) {
+  return RoundUpToCacheLine(num_tuples * value_size);
+}
+
+// Maps the file <file_path> into memory read-only. Returns a buffer that
+// unmaps the file when destroyed, or nullptr if the file cannot be opened or
+// is shorter than <min_file_size> bytes.
+std::shared_ptr<const Buffer> MapFile(const std::string& file_path,
+                                      std::size_t min_file_size,
+                                      std::size_t* file_size) {
+  const int fd = open(file_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat file_stat;
+  CHECK_EQ(0, fstat(fd, &file_stat)) << file_path;
+  *file_size = file_stat.st_size;
+  if (*file_size < min_file_size) {
+    LOG(WARNING) << "Ignore the truncated file " << file_path;
+    close(fd);
+    return nullptr;
+  }
+
+  void* data = mmap(nullptr, *file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(data != MAP_FAILED) << "Failed to map " << file_path;
+
+  const std::size_t mapped_size = *file_size;
+  return std::make_shared<const Buffer>(
+      data,
+      mapped_size,
+      [mapped_size](void* mapped_data) {
+        munmap(mapped_data, mapped_size);
+      });
+}
+
+// Writes <num_bytes> zero bytes to <out>.
+void WritePadding(std::size_t num_bytes, std::ofstream* out) {
+  const char padding[CACHE_LINE_SIZE] = {0};
+  DCHECK_LE(num_bytes, sizeof(padding));
+  out->write(padding, num_bytes);
+}
+
+// Closes <out> writing <temp_file_path>, and renames it to <file_path>.
+void CommitFile(const std::string& temp_file_path,
+                const std::string& file_path,
+                std::ofstream* out) {
+  out->close();
+  CHECK(!out->fail()) << "Failed to write " << temp_file_path;
+  CHECK_EQ(0, std::rename(temp_file_path.c_str(), file_path.c_str())) << file_path;
+}
+
+}  // namespace
+
+std::string GetColumnStorePath(const std::string& file_path) {
+  return file_path + ".qfc";
+}
+
+void WriteColumnStore(const std::string& file_path,
+                      std::size_t value_size,
+                      std::uint64_t source_file_size,
+                      const Vector<ConstBufferPtr>& columns) {
+  ColumnStoreHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kColumnStoreMagic, sizeof(header.magic));
+  header.version = kColumnStoreVersion;
+  header.value_size = value_size;
+  header.num_columns = columns.size();
+  header.num_tuples = columns.empty() ? 0 : columns[0]->num_tuples();
+  header.column_bytes = GetColumnBytes(header.num_tuples, value_size);
+  header.source_file_size = source_file_size;
+
+  const std::string temp_file_path = file_path + ".tmp";
+  std::ofstream out(temp_file_path, std::ios::binary | std::ios::trunc);
+  CHECK(out.is_open()) << temp_file_path;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  const std::size_t num_data_bytes = header.num_tuples * value_size;
+  for (const ConstBufferPtr& column : columns) {
+    CHECK_EQ(header.num_tuples, column->num_tuples());
+    out.write(static_cast<const char*>(column->data()), num_data_bytes);
+    WritePadding(header.column_bytes - num_data_bytes, &out);
+  }
+  CommitFile(temp_file_path, file_path, &out);
+
+  VLOG(2) << "Wrote " << header.num_tuples << " rows to column store " << file_path;
+}
+
+bool ReadColumnStore(const std::string& file_path,
+                     std::size_t value_size,
+                     std::size_t num_columns,
+                     std::uint64_t source_file_size,
+                     Vector<ConstBufferPtr>* columns) {
+  std::size_t file_size;
+  const std::shared_ptr<const Buffer> mapping(
+      MapFile(file_path, sizeof(ColumnStoreHeader), &file_size));
+  if (mapping == nullptr) {
+    return false;
+  }
+  const char* data = mapping->as_type<char>();
+
+  const ColumnStoreHeader& header = *reinterpret_cast<const ColumnStoreHeader*>(data);
+  if (std::memcmp(header.magic, kColumnStoreMagic, sizeof(header.magic)) != 0 ||
+      header.version != kColumnStoreVersion ||
+      header.value_size != value_size ||
+      header.num_columns != num_columns ||
+      header.source_file_size != source_file_size ||
+      header.column_bytes != GetColumnBytes(header.num_tuples, value_size) ||
+      file_size != sizeof(ColumnStoreHeader) + header.num_columns * header.column_bytes) {
+    LOG(WARNING) << "Ignore the incompatible column store " << file_path;
+    return false;
+  }
+
+  const char* column_data = data + sizeof(ColumnStoreHeader);
+  for (std::size_t i = 0; i < num_columns; ++i) {
+    columns->emplace_back(
+        std::make_shared<const ConstBuffer>(mapping, column_data, header.num_tuples));
+    column_data += header.column_bytes;
+  }
+
+  VLOG(2) << "Mapped " << header.num_tuples << " rows from column store " << file_path;
+  return true;
+}
+
+std::string GetPartitionStorePath(const std::string& file_path) {
+  return file_path + ".qfp";
+}
+
+void WritePartitionStore(const std::string& file_path,
+                         std::size_t tuple_size,
+                         std::uint64_t signature,
+                         const TableView& table) {
+  PartitionStoreHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kPartitionStoreMagic, sizeof(header.magic));
+  header.version = kPartitionStoreVersion;
+  header.tuple_size = tuple_size;
+  header.signature = signature;
+  header.num_columns = table.num_columns();
+  header.num_partitions = table.partitions_at(0).size();
+  header.num_tuples = table.num_tuples();
+
+  const std::uint64_t num_entries = header.num_columns * header.num_partitions;
+  Vector<PartitionStoreEntry> entries;
+  entries.reserve(num_entries);
+  std::uint64_t offset =
+      sizeof(PartitionStoreHeader) + RoundUpToCacheLine(num_entries * sizeof(PartitionStoreEntry));
+  for (int column_id = 0; column_id < table.num_columns(); ++column_id) {
+    const Vector<ConstBufferPtr>& partitions = table.partitions_at(column_id);
+    CHECK_EQ(header.num_partitions, partitions.size());
+    for (const ConstBufferPtr& partition : partitions) {
+      entries.push_back(PartitionStoreEntry{offset, partition->num_tuples()});
+      offset += RoundUpToCacheLine(partition->num_tuples() * tuple_size);
+    }
+  }
+
+  const std::string temp_file_path = file_path + ".tmp";
+  std::ofstream out(temp_file_path, std::ios::binary | std::ios::trunc);
+  CHECK(out.is_open()) << temp_file_path;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()),
+            num_entries * sizeof(PartitionStoreEntry));
+  WritePadding(RoundUpToCacheLine(num_entries * sizeof(PartitionStoreEntry)) -
+                   num_entries * sizeof(PartitionStoreEntry),
+               &out);
+  for (int column_id = 0; column_id < table.num_columns(); ++column_id) {
+    for (const ConstBufferPtr& partition : table.partitions_at(column_id)) {
+      const std::size_t num_data_bytes = partition->num_tuples() * tuple_size;
+      out.write(static_cast<const char*>(partition->data()), num_data_bytes);
+      WritePadding(RoundUpToCacheLine(num_data_bytes) - num_data_bytes, &out);
+    }
+  }
+  CommitFile(temp_file_path, file_path, &out);
+
+  VLOG(2) << "Wrote " << header.num_columns << " partitioned columns to partition store "
+          << file_path;
+}
+
+bool ReadPartitionStore(const std::string& file_path,
+                        std::size_t tuple_size,
+                        std::uint64_t signature,
+                        TableView* table) {
+  std::size_t file_size;
+  const std::shared_ptr<const Buffer> mapping(
+      MapFile(file_path, sizeof(PartitionStoreHeader), &file_size));
+  if (mapping == nullptr) {
+    return false;
+  }
+  const char* data = mapping->as_type<char>();
+
+  const PartitionStoreHeader& header = *reinterpret_cast<const PartitionStoreHeader*>(data);
+  const std::uint64_t num_entries = header.num_columns * header.num_partitions;
+  if (std::memcmp(header.magic, kPartitionStoreMagic, sizeof(header.magic)) != 0 ||
+      header.version != kPartitionStoreVersion ||
+      header.tuple_size != tuple_size ||
+      header.signature != signature ||
+      header.num_columns != static_cast<std::uint64_t>(table->num_columns()) ||
+      header.num_tuples != table->num_tuples() ||
+      file_size < sizeof(PartitionStoreHeader) + num_entries * sizeof(PartitionStoreEntry)) {
+    LOG(WARNING) << "Ignore the incompatible partition store " << file_path;
+    return false;
+  }
+
+  // Validates all the entries before setting any partitions.
+  const PartitionStoreEntry* entries =
+      reinterpret_cast<const PartitionStoreEntry*>(data + sizeof(PartitionStoreHeader));
+  for (std::uint64_t column_id = 0; column_id < header.num_columns; ++column_id) {
+    std::uint64_t num_column_tuples = 0;
+    for (std::uint64_t partition_id = 0; partition_id < header.num_partitions; ++partition_id) {
+      const PartitionStoreEntry& entry = entries[column_id * header.num_partitions + partition_id];
+      if (entry.offset % CACHE_LINE_SIZE != 0 ||
+          entry.offset > file_size ||
+          entry.num_tuples > (file_size - entry.offset) / tuple_size) {
+        LOG(WARNING) << "Ignore the corrupted partition store " << file_path;
+        return false;
+      }
+      num_column_tuples += entry.num_tuples;
+    }
+    if (num_column_tuples != header.num_tuples) {
+      LOG(WARNING) << "Ignore the corrupted partition store " << file_path;
+      return false;
+    }
+  }
+
+  for (std::uint64_t column_id = 0; column_id < header.num_columns; ++column_id) {
+    Vector<ConstBufferPtr> partitions;
+    partitions.reserve(header.num_partitions);
+    for (std::uint64_t partition_id = 0; partition_id < header.num_partitions; ++partition_id) {
+      const PartitionStoreEntry& entry = entries[column_id * header.num_partitions + partition_id];
+      partitions.emplace_back(
+          std::make_shared<const ConstBuffer>(mapping, data + entry.offset, entry.num_tuples));
+    }
+    table->set_partitions_at(column_id, std::move(partitions));
+  }
+
+  VLOG(2) << "Mapped " << header.num_columns << " partitioned columns from partition store "
+          << file_path;
+  return true;
+}
+
+}  // namespace quickfoil
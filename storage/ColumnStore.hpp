@@ -0,0 +1,86 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_STORAGE_COLUMN_STORE_HPP_
+#define QUICKFOIL_STORAGE_COLUMN_STORE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "memory/Buffer.hpp"
+#include "utility/Vector.hpp"
+
+namespace quickfoil {
+
+class TableView;
+
+// A binary columnar file of fixed-size values. The file starts with a header
+// of one cache line, followed by the columns, each of which is padded to a
+// multiple of the cache line size, so that the columns of a memory-mapped
+// file are cache-line aligned and can be used in place.
+//
+// Header: magic (8 bytes), version (4), value size (4), number of columns (8),
+// number of tuples (8), bytes per column including the padding (8), size of
+// the source data file (8).
+
+// Returns the path of the column store file for the text data file <file_path>.
+std::string GetColumnStorePath(const std::string& file_path);
+
+// Writes <columns>, which have the same number of values of <value_size>
+// bytes and are loaded from a data file of <source_file_size> bytes, to the
+// column store file <file_path>. The file is written to a temporary file first
+// and renamed, so that a reader never sees a partial file.
+void WriteColumnStore(const std::string& file_path,
+                      std::size_t value_size,
+                      std::uint64_t source_file_size,
+                      const Vector<ConstBufferPtr>& columns);
+
+// Maps the column store file <file_path> into memory read-only and appends
+// its columns to <columns> without copying. The mapping is released when the
+// last buffer on it is destroyed. Returns false and leaves <columns> unchanged
+// if the file does not exist, or is not a column store with <num_columns>
+// columns of values of <value_size> bytes written for a data file of
+// <source_file_size> bytes.
+bool ReadColumnStore(const std::string& file_path,
+                     std::size_t value_size,
+                     std::size_t num_columns,
+                     std::uint64_t source_file_size,
+                     Vector<ConstBufferPtr>* columns);
+
+// A binary file of the partitions of all the columns of a table. The file
+// starts with a header of one cache line, followed by the offset and the
+// number of tuples of each partition, and then the partitions themselves,
+// each of which starts at a cache line boundary.
+//
+// Header: magic (8 bytes), version (4), tuple size (4), partitioning
+// signature (8), number of columns (8), number of partitions per column (8),
+// number of tuples per column (8).
+
+// Returns the path of the partition store file for the text data file <file_path>.
+std::string GetPartitionStorePath(const std::string& file_path);
+
+// Writes the partitions of all the columns of <table>, which are partitioned
+// into the same number of partitions of tuples of <tuple_size> bytes, to the
+// partition store file <file_path>. <signature> identifies the partitioning
+// scheme, so that the partitions are only read back for the same scheme.
+void WritePartitionStore(const std::string& file_path,
+                         std::size_t tuple_size,
+                         std::uint64_t signature,
+                         const TableView& table);
+
+// Maps the partition store file <file_path> into memory read-only and sets
+// the partitions of the columns of <table>, none of which is partitioned yet,
+// without copying. Returns false and leaves <table> unchanged if the file does
+// not exist, or was not written for a table of the same shape with the same
+// <tuple_size> and <signature>.
+bool ReadPartitionStore(const std::string& file_path,
+                        std::size_t tuple_size,
+                        std::uint64_t signature,
+                        TableView* table);
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_STORAGE_COLUMN_STORE_HPP_ */
@@ -0,0 +1,187 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "storage/ColumnStore.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "memory/Buffer.hpp"
+#include "memory/MemUtil.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class ColumnStoreTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+  // The offsets of the fields of the column store header.
+  static constexpr std::streamoff kVersionOffset = 8;
+  static constexpr std::streamoff kNumTuplesOffset = 24;
+  static constexpr std::streamoff kColumnBytesOffset = 32;
+
+  static constexpr std::uint64_t kSourceFileSize = 12345;
+
+  ColumnStoreTest()
+      : file_path_(GetColumnStorePath(
+            std::string("/tmp/quickfoil_ColumnStoreTest_") + std::to_string(getpid()) + "_" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name())) {}
+
+  ~ColumnStoreTest() {
+    std::remove(file_path_.c_str());
+  }
+
+  // Writes <num_columns> columns of <num_tuples> distinct values to the store.
+  void WriteColumns(int num_columns, int num_tuples) {
+    columns_.clear();
+    for (int column_id = 0; column_id < num_columns; ++column_id) {
+      BufferPtr column(std::make_shared<Buffer>(sizeof(cpp_type) * num_tuples, num_tuples));
+      cpp_type* values = column->mutable_as_type<cpp_type>();
+      for (int i = 0; i < num_tuples; ++i) {
+        values[i] = column_id * 100000 + i * 3;
+      }
+      columns_.emplace_back(std::make_shared<const ConstBuffer>(column));
+    }
+    WriteColumnStore(file_path_, sizeof(cpp_type), kSourceFileSize, columns_);
+  }
+
+  bool ReadColumns(Vector<ConstBufferPtr>* columns) const {
+    return ReadColumnStore(file_path_, sizeof(cpp_type), columns_.size(), kSourceFileSize, columns);
+  }
+
+  // Overwrites the bytes at <offset> of the store with <value>.
+  template <typename T>
+  void OverwriteHeader(std::streamoff offset, T value) const {
+    std::fstream file(file_path_, std::ios::binary | std::ios::in | std::ios::out);
+    ASSERT_TRUE(file.is_open());
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  // Checks that the store is rejected.
+  void ExpectRejected() const {
+    Vector<ConstBufferPtr> columns;
+    EXPECT_FALSE(ReadColumns(&columns));
+    EXPECT_TRUE(columns.empty());
+  }
+
+  const std::string file_path_;
+  Vector<ConstBufferPtr> columns_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ColumnStoreTest);
+};
+
+constexpr std::streamoff ColumnStoreTest::kVersionOffset;
+constexpr std::streamoff ColumnStoreTest::kNumTuplesOffset;
+constexpr std::streamoff ColumnStoreTest::kColumnBytesOffset;
+constexpr std::uint64_t ColumnStoreTest::kSourceFileSize;
+
+TEST_F(ColumnStoreTest, RoundTrip) {
+  // The columns are not a multiple of the cache line size.
+  WriteColumns(3, 37);
+
+  Vector<ConstBufferPtr> columns;
+  ASSERT_TRUE(ReadColumns(&columns));
+  ASSERT_EQ(columns_.size(), columns.size());
+  for (std::size_t column_id = 0; column_id < columns.size(); ++column_id) {
+    ASSERT_EQ(columns_[column_id]->num_tuples(), columns[column_id]->num_tuples());
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(columns[column_id]->data()) % CACHE_LINE_SIZE);
+    for (std::size_t i = 0; i < columns[column_id]->num_tuples(); ++i) {
+      EXPECT_EQ(columns_[column_id]->as_type<cpp_type>()[i],
+                columns[column_id]->as_type<cpp_type>()[i]);
+    }
+  }
+}
+
+TEST_F(ColumnStoreTest, RoundTripEmptyColumns) {
+  WriteColumns(2, 0);
+
+  Vector<ConstBufferPtr> columns;
+  ASSERT_TRUE(ReadColumns(&columns));
+  ASSERT_EQ(2u, columns.size());
+  EXPECT_EQ(0u, columns[0]->num_tuples());
+  EXPECT_EQ(0u, columns[1]->num_tuples());
+}
+
+TEST_F(ColumnStoreTest, AppendsToColumns) {
+  WriteColumns(2, 10);
+
+  Vector<ConstBufferPtr> columns(1, columns_[0]);
+  ASSERT_TRUE(ReadColumns(&columns));
+  ASSERT_EQ(3u, columns.size());
+  EXPECT_EQ(columns_[0], columns[0]);
+}
+
+TEST_F(ColumnStoreTest, MissingFile) {
+  columns_.resize(2);
+  ExpectRejected();
+}
+
+TEST_F(ColumnStoreTest, RejectStale) {
+  WriteColumns(2, 50);
+  Vector<ConstBufferPtr> columns;
+
+  // The data file has changed.
+  EXPECT_FALSE(ReadColumnStore(file_path_, sizeof(cpp_type), 2, kSourceFileSize + 1, &columns));
+  // The columns of the predicate have changed.
+  EXPECT_FALSE(ReadColumnStore(file_path_, sizeof(cpp_type), 3, kSourceFileSize, &columns));
+  EXPECT_FALSE(ReadColumnStore(file_path_, sizeof(cpp_type), 1, kSourceFileSize, &columns));
+  // The value type has changed.
+  EXPECT_FALSE(ReadColumnStore(file_path_, 2 * sizeof(cpp_type), 2, kSourceFileSize, &columns));
+  EXPECT_TRUE(columns.empty());
+}
+
+TEST_F(ColumnStoreTest, RejectTruncated) {
+  WriteColumns(2, 50);
+  // Shorter than the header.
+  ASSERT_EQ(0, truncate(file_path_.c_str(), CACHE_LINE_SIZE / 2));
+  ExpectRejected();
+
+  // A complete header without all the columns.
+  WriteColumns(2, 50);
+  ASSERT_EQ(0, truncate(file_path_.c_str(), CACHE_LINE_SIZE + 50 * sizeof(cpp_type)));
+  ExpectRejected();
+
+  // An empty file.
+  ASSERT_EQ(0, truncate(file_path_.c_str(), 0));
+  ExpectRejected();
+}
+
+TEST_F(ColumnStoreTest, RejectCorruptHeader) {
+  WriteColumns(2, 50);
+  OverwriteHeader<std::uint64_t>(0, 0x1234567890abcdefull);
+  ExpectRejected();
+
+  WriteColumns(2, 50);
+  OverwriteHeader<std::uint32_t>(kVersionOffset, 1);
+  ExpectRejected();
+
+  // The number of tuples does not match the size of the columns.
+  WriteColumns(2, 50);
+  OverwriteHeader<std::uint64_t>(kNumTuplesOffset, 1000000);
+  ExpectRejected();
+
+  WriteColumns(2, 50);
+  OverwriteHeader<std::uint64_t>(kNumTuplesOffset, 10);
+  ExpectRejected();
+
+  WriteColumns(2, 50);
+  OverwriteHeader<std::uint64_t>(kColumnBytesOffset, 2 * CACHE_LINE_SIZE);
+  ExpectRejected();
+}
+
+}  // namespace quickfoil
@@ -6,9 +6,11 @@
 #include "storage/FoilHashTable.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 
 #include "memory/Buffer.hpp"
+#include "memory/MemUtil.hpp"
 
 #include "glog/logging.h"
 
@@ -31,21 +33,45 @@ namespace quickfoil {
     } while(false)
 #endif
 
-FoilHashTable::FoilHashTable(int size, uint32_t radix_bits) {
+FoilHashTable::FoilHashTable(int size,
+                             uint32_t radix_bits,
+                             HashTableLayout layout)
+    : layout_(layout),
+      radix_bits_(radix_bits) {
   DCHECK_GT(size, 0);
 
-  int num_buckets = size;
-  NEXT_POW_2(num_buckets);
-  mask_ = (num_buckets - 1) << (radix_bits);
+  if (layout_ == HashTableLayout::kChained) {
+    int num_buckets = size;
+    NEXT_POW_2(num_buckets);
+    mask_ = (num_buckets - 1) << (radix_bits);
 
-  const std::size_t next_buffer_size = sizeof(int) * size;
-  const std::size_t buckets_buffer_size = sizeof(int) * num_buckets;
+    const std::size_t next_buffer_size = sizeof(int) * size;
+    const std::size_t buckets_buffer_size = sizeof(int) * num_buckets;
 
-  buckets_buffer_.reset(new Buffer(calloc(num_buckets, sizeof(int)),
-                                   buckets_buffer_size,
-                                   num_buckets));
+    buckets_buffer_.reset(new Buffer(calloc(num_buckets, sizeof(int)),
+                                     buckets_buffer_size,
+                                     num_buckets));
+
+    next_buffer_.reset(new Buffer(next_buffer_size, next_buffer_size));
+    return;
+  }
 
-  next_buffer_.reset(new Buffer(next_buffer_size, next_buffer_size));
+  // Two to four entries per home bucket on average for distinct keys. An
+  // overflow bucket is only allocated when the previous one is full, so the
+  // home buckets plus one bucket for every kBucketCapacity entries suffice.
+  int num_home_buckets = (size + 3) / 4;
+  NEXT_POW_2(num_home_buckets);
+  mask_ = (num_home_buckets - 1) << (radix_bits);
+  num_buckets_ = num_home_buckets;
+
+  const int max_num_buckets = num_home_buckets + (size + kBucketCapacity - 1) / kBucketCapacity;
+  const std::size_t buckets_buffer_size = sizeof(Bucket) * max_num_buckets;
+  void* buckets = cacheline_aligned_alloc(buckets_buffer_size);
+  DCHECK(buckets != nullptr);
+  memset(buckets, 0, sizeof(Bucket) * num_home_buckets);
+  buckets_buffer_.reset(new Buffer(buckets,
+                                   buckets_buffer_size,
+                                   max_num_buckets));
 }
 
 }  // namespace quickfoil
@@ -6,58 +6,305 @@
 #ifndef QUICKFOIL_STORAGE_FOIL_HASH_TABLE_HPP_
 #define QUICKFOIL_STORAGE_FOIL_HASH_TABLE_HPP_
 
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 
 #include "memory/Buffer.hpp"
+#include "memory/MemUtil.hpp"
 #include "types/TypeTraits.hpp"
+#include "utility/Hash.hpp"
 #include "utility/Macros.hpp"
 
+#include "glog/logging.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 namespace quickfoil {
 
-// Chained hash table.
+enum class HashTableLayout {
+  // Separate arrays of bucket heads and next pointers.
+  kChained,
+  // Cache-line buckets that store the hash values (fingerprints) and the
+  // positions of the entries inline, chained to overflow buckets when full.
+  kBucketized
+};
+
+// Hash table on the positions of the build tuples. The keys themselves are
+// not stored, so that a probe calls back with the candidate positions for the
+// caller to compare the keys. Tables on the partitions of a radix partitioned
+// column ignore the lowest <radix_bits> bits of the hash values, which are
+// the same for all the tuples in a partition.
 class FoilHashTable {
  public:
   FoilHashTable()
       : mask_(0) {
   }
 
-  FoilHashTable(int size, uint32_t radix_bits);
+  FoilHashTable(int size,
+                uint32_t radix_bits,
+                HashTableLayout layout = HashTableLayout::kChained);
 
   FoilHashTable(FoilHashTable&& other)
-      : mask_(other.mask_),
+      : layout_(other.layout_),
+        mask_(other.mask_),
+        radix_bits_(other.radix_bits_),
         next_buffer_(std::move(other.next_buffer_)),
-        buckets_buffer_(std::move(other.buckets_buffer_)) {}
+        buckets_buffer_(std::move(other.buckets_buffer_)),
+        num_buckets_(other.num_buckets_) {}
 
-  const int* next() const {
-    return next_buffer_->as_type<int>();
+  HashTableLayout layout() const {
+    return layout_;
   }
 
-  const int* buckets() const {
-    return buckets_buffer_->as_type<int>();
+  const uint32_t mask() const {
+    return mask_;
   }
 
-  int* mutable_next() {
-    return next_buffer_->mutable_as_type<int>();
-  }
+  // Inserts the build tuple at <position> with the hash value <hash_value>.
+  inline void Insert(hash_type hash_value, int position);
 
-  int* mutable_buckets() {
-    return buckets_buffer_->mutable_as_type<int>();
-  }
+  // Calls <visitor>(position) on the positions of the entries that may have
+  // the hash value <hash_value>, until it returns true.
+  template <typename Visitor>
+  inline void Probe(hash_type hash_value, Visitor visitor) const;
 
-  const uint32_t mask() const {
-    return mask_;
-  }
+#ifdef __AVX512F__
+  static constexpr int kProbeBatchSize = 16;
+#else
+  static constexpr int kProbeBatchSize = 8;
+#endif
+
+  // Probes kProbeBatchSize hash values at once. Calls <visitor>(i, position)
+  // on the entries that may have the hash value <hash_values>[i], until it
+  // returns true for the i-th hash value. The entries of each hash value are
+  // visited in the same order as by Probe(), but those of different hash
+  // values may be interleaved. The bucket IDs of the batch are computed with
+  // SIMD instructions, and the chains of the chained layout are walked in
+  // lockstep with gathers, so that the cache misses of the batch overlap.
+  template <typename Visitor>
+  inline void ProbeBatch(const hash_type* hash_values, Visitor visitor) const;
 
  private:
+  static constexpr int kBucketCapacity = 7;
+
+  struct Bucket {
+    hash_type fingerprints[kBucketCapacity];
+    int positions[kBucketCapacity];
+    // One plus the index of the next overflow bucket, or 0.
+    int next;
+    int num_entries;
+  } __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+  static_assert(sizeof(Bucket) == CACHE_LINE_SIZE,
+                "The size of a hash bucket is not a cache line");
+
+  inline uint32_t GetBucketId(hash_type hash_value) const {
+    return (hash_value & mask_) >> radix_bits_;
+  }
+
+  inline void GetBucketIds(const hash_type* hash_values, int* bucket_ids) const;
+
+  template <typename Visitor>
+  inline void ProbeBuckets(hash_type hash_value,
+                           const Bucket* bucket,
+                           Visitor visitor) const;
+
+  HashTableLayout layout_ = HashTableLayout::kChained;
   uint32_t mask_ = 0;
+  uint32_t radix_bits_ = 0;
 
+  // Chained layout: the positions are stored plus one, so that 0 is null.
   std::unique_ptr<Buffer> next_buffer_;
   std::unique_ptr<Buffer> buckets_buffer_;
 
+  // Bucketized layout: the overflow buckets are allocated after the home
+  // buckets in <buckets_buffer_>.
+  int num_buckets_ = 0;
+
   DISALLOW_COPY_AND_ASSIGN(FoilHashTable);
 };
 
+inline void FoilHashTable::Insert(hash_type hash_value, int position) {
+  const uint32_t bucket_id = GetBucketId(hash_value);
+  if (layout_ == HashTableLayout::kChained) {
+    int* __restrict__ buckets = buckets_buffer_->mutable_as_type<int>();
+    next_buffer_->mutable_as_type<int>()[position] = buckets[bucket_id];
+    buckets[bucket_id] = position + 1;
+    return;
+  }
+
+  Bucket* __restrict__ buckets = buckets_buffer_->mutable_as_type<Bucket>();
+  Bucket* bucket = buckets + bucket_id;
+  if (bucket->num_entries == kBucketCapacity) {
+    // Insert into the first overflow bucket, and add a new one in front of
+    // the chain if it is full too.
+    if (bucket->next == 0 ||
+        buckets[bucket->next - 1].num_entries == kBucketCapacity) {
+      Bucket* overflow_bucket = buckets + num_buckets_;
+      overflow_bucket->next = bucket->next;
+      overflow_bucket->num_entries = 0;
+      bucket->next = ++num_buckets_;
+    }
+    bucket = buckets + bucket->next - 1;
+  }
+  bucket->fingerprints[bucket->num_entries] = hash_value;
+  bucket->positions[bucket->num_entries] = position;
+  ++bucket->num_entries;
+}
+
+template <typename Visitor>
+inline void FoilHashTable::Probe(hash_type hash_value, Visitor visitor) const {
+  const uint32_t bucket_id = GetBucketId(hash_value);
+  if (layout_ == HashTableLayout::kChained) {
+    const int* __restrict__ buckets = buckets_buffer_->as_type<int>();
+    const int* __restrict__ next = next_buffer_->as_type<int>();
+    for (int position = buckets[bucket_id] - 1;
+         position >= 0;
+         position = next[position] - 1) {
+      if (visitor(position)) {
+        return;
+      }
+    }
+    return;
+  }
+
+  ProbeBuckets(hash_value, buckets_buffer_->as_type<Bucket>() + bucket_id, visitor);
+}
+
+inline void FoilHashTable::GetBucketIds(const hash_type* hash_values,
+                                        int* bucket_ids) const {
+#if defined(__AVX512F__)
+  const __m512i masked_hash_values =
+      _mm512_and_si512(_mm512_loadu_si512(hash_values), _mm512_set1_epi32(mask_));
+  _mm512_storeu_si512(bucket_ids,
+                      _mm512_srl_epi32(masked_hash_values, _mm_cvtsi32_si128(radix_bits_)));
+#elif defined(__AVX2__)
+  const __m256i masked_hash_values =
+      _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hash_values)),
+                       _mm256_set1_epi32(mask_));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(bucket_ids),
+                      _mm256_srl_epi32(masked_hash_values, _mm_cvtsi32_si128(radix_bits_)));
+#else
+  for (int i = 0; i < kProbeBatchSize; ++i) {
+    bucket_ids[i] = GetBucketId(hash_values[i]);
+  }
+#endif
+}
+
+template <typename Visitor>
+inline void FoilHashTable::ProbeBatch(const hash_type* hash_values,
+                                      Visitor visitor) const {
+  int bucket_ids[kProbeBatchSize];
+  GetBucketIds(hash_values, bucket_ids);
+
+  if (layout_ == HashTableLayout::kChained) {
+    const int* __restrict__ buckets = buckets_buffer_->as_type<int>();
+    const int* __restrict__ next = next_buffer_->as_type<int>();
+#if defined(__AVX512F__)
+    // Walks the chains of the batch in lockstep, gathering the next entries of
+    // all the chains that are not done with one instruction.
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i heads = _mm512_i32gather_epi32(_mm512_loadu_si512(bucket_ids), buckets, 4);
+    __mmask16 active = _mm512_cmpneq_epi32_mask(heads, zero);
+    while (active != 0) {
+      const __m512i positions = _mm512_sub_epi32(heads, _mm512_set1_epi32(1));
+      int lane_positions[kProbeBatchSize];
+      _mm512_storeu_si512(lane_positions, positions);
+      for (std::uint32_t lanes = active; lanes != 0; lanes &= lanes - 1) {
+        const int i = __builtin_ctz(lanes);
+        if (visitor(i, lane_positions[i])) {
+          active &= ~(1u << i);
+        }
+      }
+      heads = _mm512_mask_i32gather_epi32(zero, active, positions, next, 4);
+      active = _mm512_cmpneq_epi32_mask(heads, zero);
+    }
+#elif defined(__AVX2__)
+    // Walks the chains of the batch in lockstep, gathering the next entries of
+    // all the chains that are not done with one instruction.
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i heads =
+        _mm256_i32gather_epi32(buckets,
+                               _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bucket_ids)),
+                               4);
+    std::uint32_t active =
+        ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(heads, zero))) & 0xFF;
+    while (active != 0) {
+      const __m256i positions = _mm256_sub_epi32(heads, _mm256_set1_epi32(1));
+      int lane_positions[kProbeBatchSize];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane_positions), positions);
+      for (std::uint32_t lanes = active; lanes != 0; lanes &= lanes - 1) {
+        const int i = __builtin_ctz(lanes);
+        if (visitor(i, lane_positions[i])) {
+          active &= ~(1u << i);
+        }
+      }
+      const __m256i active_lanes =
+          _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(active), lane_bits), lane_bits);
+      heads = _mm256_mask_i32gather_epi32(zero, next, positions, active_lanes, 4);
+      active = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(heads, zero))) & 0xFF;
+    }
+#else
+    int heads[kProbeBatchSize];
+    for (int i = 0; i < kProbeBatchSize; ++i) {
+      heads[i] = buckets[bucket_ids[i]];
+    }
+    for (int i = 0; i < kProbeBatchSize; ++i) {
+      for (int position = heads[i] - 1;
+           position >= 0;
+           position = next[position] - 1) {
+        if (visitor(i, position)) {
+          break;
+        }
+      }
+    }
+#endif
+    return;
+  }
+
+  const Bucket* __restrict__ buckets = buckets_buffer_->as_type<Bucket>();
+  for (int i = 0; i < kProbeBatchSize; ++i) {
+    __builtin_prefetch(buckets + bucket_ids[i]);
+  }
+  for (int i = 0; i < kProbeBatchSize; ++i) {
+    ProbeBuckets(hash_values[i],
+                 buckets + bucket_ids[i],
+                 [&](int position) -> bool {
+                   return visitor(i, position);
+                 });
+  }
+}
+
+template <typename Visitor>
+inline void FoilHashTable::ProbeBuckets(hash_type hash_value,
+                                        const Bucket* bucket,
+                                        Visitor visitor) const {
+  const Bucket* __restrict__ buckets = buckets_buffer_->as_type<Bucket>();
+  while (true) {
+    // Compares all the fingerprints without branching and only visits the
+    // matching entries.
+    uint32_t matches = 0;
+    for (int slot = 0; slot < kBucketCapacity; ++slot) {
+      matches |= static_cast<uint32_t>(bucket->fingerprints[slot] == hash_value) << slot;
+    }
+    matches &= (1u << bucket->num_entries) - 1;
+    while (matches != 0) {
+      if (visitor(bucket->positions[__builtin_ctz(matches)])) {
+        return;
+      }
+      matches &= matches - 1;
+    }
+    if (bucket->next == 0) {
+      return;
+    }
+    bucket = buckets + bucket->next - 1;
+  }
+}
+
 }  // namespace quickfoil
 
 #endif /* QUICKFOIL_STORAGE_FOIL_HASH_TABLE_HPP_ */
@@ -0,0 +1,263 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "storage/FoilHashTable.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include "utility/Hash.hpp"
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class FoilHashTableTest : public ::testing::Test {
+ protected:
+  static constexpr HashTableLayout kLayouts[] = {HashTableLayout::kChained,
+                                                 HashTableLayout::kBucketized};
+
+  FoilHashTableTest() {}
+
+  // Builds a hash table with <layout> on the positions of <hash_values>.
+  void CreateTable(HashTableLayout layout, uint32_t radix_bits) {
+    table_.reset(new FoilHashTable(std::max<int>(hash_values_.size(), 1), radix_bits, layout));
+    for (std::size_t position = 0; position < hash_values_.size(); ++position) {
+      table_->Insert(hash_values_[position], position);
+    }
+  }
+
+  // Returns the sorted positions with the hash value <hash_value>.
+  Vector<int> GetExpectedPositions(hash_type hash_value) const {
+    Vector<int> positions;
+    for (std::size_t position = 0; position < hash_values_.size(); ++position) {
+      if (hash_values_[position] == hash_value) {
+        positions.emplace_back(position);
+      }
+    }
+    return positions;
+  }
+
+  // Returns the sorted positions visited by Probe() that have the hash value
+  // <hash_value>, and checks that no position is visited twice.
+  Vector<int> ProbeAll(hash_type hash_value) const {
+    Vector<int> visited_positions;
+    Vector<int> positions;
+    table_->Probe(hash_value,
+                  [&](int position) -> bool {
+                    EXPECT_LE(0, position);
+                    EXPECT_GT(static_cast<int>(hash_values_.size()), position);
+                    visited_positions.emplace_back(position);
+                    if (hash_values_[position] == hash_value) {
+                      positions.emplace_back(position);
+                    }
+                    return false;
+                  });
+    std::sort(visited_positions.begin(), visited_positions.end());
+    EXPECT_TRUE(std::adjacent_find(visited_positions.begin(), visited_positions.end()) ==
+                visited_positions.end());
+    if (table_->layout() == HashTableLayout::kBucketized) {
+      // The bucketized layout filters the entries with their fingerprints.
+      EXPECT_EQ(positions.size(), visited_positions.size());
+    }
+    std::sort(positions.begin(), positions.end());
+    return positions;
+  }
+
+  // Checks that every hash value finds all and only its positions.
+  void CheckAllHashValues() const {
+    Vector<hash_type> distinct_hash_values(hash_values_);
+    std::sort(distinct_hash_values.begin(), distinct_hash_values.end());
+    distinct_hash_values.erase(std::unique(distinct_hash_values.begin(), distinct_hash_values.end()),
+                               distinct_hash_values.end());
+    for (const hash_type hash_value : distinct_hash_values) {
+      EXPECT_EQ(GetExpectedPositions(hash_value), ProbeAll(hash_value))
+          << "Hash value " << hash_value;
+    }
+  }
+
+  // Returns the positions visited by Probe() for <hash_value> in order. If
+  // <stop_at_match> is true, the probe stops at the first position with the
+  // hash value <hash_value>.
+  Vector<int> GetProbeSequence(hash_type hash_value, bool stop_at_match) const {
+    Vector<int> positions;
+    table_->Probe(hash_value,
+                  [&](int position) -> bool {
+                    positions.emplace_back(position);
+                    return stop_at_match && hash_values_[position] == hash_value;
+                  });
+    return positions;
+  }
+
+  // Checks that ProbeBatch() visits the same positions in the same order as
+  // Probe() for every hash value in <probe_hash_values>.
+  void CheckProbeBatch(const Vector<hash_type>& probe_hash_values, bool stop_at_match) const {
+    constexpr int kBatchSize = FoilHashTable::kProbeBatchSize;
+    for (std::size_t begin = 0; begin + kBatchSize <= probe_hash_values.size(); begin += kBatchSize) {
+      const hash_type* batch = &probe_hash_values[begin];
+      Vector<Vector<int>> lane_positions(kBatchSize);
+      table_->ProbeBatch(batch,
+                         [&](int i, int position) -> bool {
+                           EXPECT_LE(0, i);
+                           EXPECT_GT(kBatchSize, i);
+                           lane_positions[i].emplace_back(position);
+                           return stop_at_match && hash_values_[position] == batch[i];
+                         });
+      for (int i = 0; i < kBatchSize; ++i) {
+        EXPECT_EQ(GetProbeSequence(batch[i], stop_at_match), lane_positions[i])
+            << "Hash value " << batch[i] << " in lane " << i;
+      }
+    }
+  }
+
+  Vector<hash_type> hash_values_;
+  std::unique_ptr<FoilHashTable> table_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FoilHashTableTest);
+};
+
+constexpr HashTableLayout FoilHashTableTest::kLayouts[];
+
+TEST_F(FoilHashTableTest, EmptyTable) {
+  for (const HashTableLayout layout : kLayouts) {
+    table_.reset(new FoilHashTable(16, 0, layout));
+    for (hash_type hash_value = 0; hash_value < 100; ++hash_value) {
+      table_->Probe(hash_value,
+                    [](int position) -> bool {
+                      ADD_FAILURE() << "Visited position " << position;
+                      return false;
+                    });
+    }
+  }
+}
+
+TEST_F(FoilHashTableTest, DistinctKeys) {
+  for (int i = 0; i < 1000; ++i) {
+    hash_values_.emplace_back(Hash(i * 7919));
+  }
+  for (const HashTableLayout layout : kLayouts) {
+    CreateTable(layout, 0);
+    CheckAllHashValues();
+    // Hash values that are not in the table.
+    EXPECT_TRUE(ProbeAll(1).empty());
+    EXPECT_TRUE(ProbeAll(7919 * 1000).empty());
+  }
+}
+
+TEST_F(FoilHashTableTest, RadixBits) {
+  // All the hash values have the same lowest 3 bits as in a radix partition.
+  for (hash_type i = 0; i < 500; ++i) {
+    hash_values_.emplace_back((i << 3) | 5);
+  }
+  for (const HashTableLayout layout : kLayouts) {
+    CreateTable(layout, 3);
+    CheckAllHashValues();
+  }
+}
+
+TEST_F(FoilHashTableTest, DuplicateKeys) {
+  for (int copy = 0; copy < 20; ++copy) {
+    for (hash_type i = 0; i < 50; ++i) {
+      hash_values_.emplace_back(i * 13);
+    }
+  }
+  for (const HashTableLayout layout : kLayouts) {
+    CreateTable(layout, 0);
+    CheckAllHashValues();
+
+    // Stops at the first match.
+    for (hash_type i = 0; i < 50; ++i) {
+      int num_matches = 0;
+      table_->Probe(i * 13,
+                    [&](int position) -> bool {
+                      if (hash_values_[position] == i * 13) {
+                        ++num_matches;
+                        return true;
+                      }
+                      return false;
+                    });
+      EXPECT_EQ(1, num_matches);
+    }
+  }
+}
+
+TEST_F(FoilHashTableTest, FullBuckets) {
+  // All the entries fall into the same home bucket, so that the bucketized
+  // layout has to chain overflow buckets. Cover the sizes that fill the last
+  // bucket exactly and those that spill one entry into a new bucket.
+  for (const int num_entries : {6, 7, 8, 14, 15, 64, 99}) {
+    for (const HashTableLayout layout : kLayouts) {
+      hash_values_.clear();
+      for (hash_type i = 0; i < static_cast<hash_type>(num_entries); ++i) {
+        // The two distinct fingerprints per bucket interleave the duplicates.
+        hash_values_.emplace_back(((i % 2) + 1) << 24);
+      }
+      CreateTable(layout, 0);
+      CheckAllHashValues();
+      EXPECT_TRUE(ProbeAll(3u << 24).empty());
+    }
+  }
+}
+
+TEST_F(FoilHashTableTest, Overflow) {
+  // Every 4 keys share a home bucket of the bucketized layout, and some home
+  // buckets receive many more entries than others.
+  for (hash_type i = 0; i < 2000; ++i) {
+    const hash_type bucket = (i % 10 == 0 ? i : 0) & 0x3FF;
+    hash_values_.emplace_back(((i % 37) << 16) | bucket);
+  }
+  for (const HashTableLayout layout : kLayouts) {
+    CreateTable(layout, 0);
+    CheckAllHashValues();
+  }
+}
+
+TEST_F(FoilHashTableTest, ProbeBatch) {
+  // Duplicate keys with chains of different lengths, so that the lanes of a
+  // batch finish at different steps.
+  for (hash_type i = 0; i < 300; ++i) {
+    for (hash_type copy = 0; copy <= i % 9; ++copy) {
+      hash_values_.emplace_back(Hash(i * 31));
+    }
+  }
+  // Hash values that are in the table, mixed with some that are not, and
+  // repeated within a batch.
+  Vector<hash_type> probe_hash_values;
+  for (hash_type i = 0; i < 320; ++i) {
+    probe_hash_values.emplace_back(Hash((i % 5 == 0 ? i + 1 : i) * 31));
+    if (i % 7 == 0) {
+      probe_hash_values.emplace_back(Hash(i * 31));
+    }
+  }
+
+  for (const uint32_t radix_bits : {0u, 2u}) {
+    for (const HashTableLayout layout : kLayouts) {
+      CreateTable(layout, radix_bits);
+      CheckProbeBatch(probe_hash_values, false /* stop_at_match */);
+      CheckProbeBatch(probe_hash_values, true /* stop_at_match */);
+    }
+  }
+}
+
+TEST_F(FoilHashTableTest, ProbeBatchEmptyTable) {
+  Vector<hash_type> probe_hash_values;
+  for (hash_type i = 0; i < 64; ++i) {
+    probe_hash_values.emplace_back(i);
+  }
+  for (const HashTableLayout layout : kLayouts) {
+    table_.reset(new FoilHashTable(16, 0, layout));
+    table_->ProbeBatch(&probe_hash_values[0],
+                       [](int i, int position) -> bool {
+                         ADD_FAILURE() << "Visited position " << position << " in lane " << i;
+                         return false;
+                       });
+  }
+}
+
+}  // namespace quickfoil
@@ -71,18 +71,29 @@ class TableView {
 
   void set_hash_tables_at(int column_id,
                           Vector<FoilHashTable>&& hash_tables) {
-    DCHECK(hash_tables_[column_id].empty());
-    hash_tables_[column_id] = std::move(hash_tables);
+    DCHECK(hash_tables_[column_id] == nullptr);
+    hash_tables_[column_id] = std::make_shared<const Vector<FoilHashTable>>(std::move(hash_tables));
   }
 
   const Vector<FoilHashTable>& hash_tables_at(int column_id) const {
-    return hash_tables_[column_id];
+    static const Vector<FoilHashTable> kNoHashTables;
+    return hash_tables_[column_id] == nullptr ? kNoHashTables : *hash_tables_[column_id];
+  }
+
+  // Shares the partitions and the hash tables of <other> on the column
+  // <column_id>, which must have the same tuples in the same order as the
+  // column of this table.
+  void SharePartitionsAt(int column_id, const TableView& other) {
+    DCHECK(partitions_[column_id].empty());
+    DCHECK_EQ(num_tuples(), other.num_tuples());
+    partitions_[column_id] = other.partitions_[column_id];
+    hash_tables_[column_id] = other.hash_tables_[column_id];
   }
 
  private:
   Vector<ConstBufferPtr> columns_;
   Vector<Vector<ConstBufferPtr>> partitions_;
-  Vector<Vector<FoilHashTable>> hash_tables_;
+  Vector<std::shared_ptr<const Vector<FoilHashTable>>> hash_tables_;
 
   DISALLOW_COPY_AND_ASSIGN(TableView);
 };
@@ -0,0 +1,222 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "storage/TextFileLoader.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "memory/Buffer.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/ThreadPool.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+DEFINE_uint64(min_text_file_range_size,
+              1 << 20,
+              "The minimum number of bytes of a text data file parsed by one task.");
+
+namespace {
+
+typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+
+static_assert(std::is_integral<cpp_type>::value,
+              "The text file loader only parses integer values");
+
+inline const char* FindLineEnd(const char* begin, const char* end) {
+  const char* line_end = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+  return line_end == nullptr ? end : line_end;
+}
+
+inline bool IsDataLine(const char* line, const char* line_end) {
+  // An empty line may still have the carriage return of a CRLF line ending.
+  if (line != line_end && line_end[-1] == '\r') {
+    --line_end;
+  }
+  return line != line_end && *line != '#';
+}
+
+inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+[[noreturn]] void ReportMalformedLine(const char* line, const char* line_end) {
+  LOG(FATAL) << "Malformed line: " << std::string(line, line_end);
+  __builtin_unreachable();
+}
+
+// Parses the integer in [<begin>, <end>) that may be surrounded by spaces.
+inline cpp_type ParseValue(const char* begin,
+                           const char* end,
+                           const char* line,
+                           const char* line_end) {
+  while (begin != end && IsSpace(*begin)) {
+    ++begin;
+  }
+  while (end != begin && IsSpace(end[-1])) {
+    --end;
+  }
+  bool is_negative = false;
+  if (begin != end && (*begin == '-' || *begin == '+')) {
+    is_negative = (*begin == '-');
+    ++begin;
+  }
+  if (begin == end) {
+    ReportMalformedLine(line, line_end);
+  }
+
+  typedef typename std::make_unsigned<cpp_type>::type unsigned_type;
+  const unsigned_type max_magnitude =
+      static_cast<unsigned_type>(std::numeric_limits<cpp_type>::max()) + (is_negative ? 1 : 0);
+  unsigned_type magnitude = 0;
+  for (; begin != end; ++begin) {
+    const unsigned_type digit = static_cast<unsigned char>(*begin) - '0';
+    if (digit > 9 || magnitude > (max_magnitude - digit) / 10) {
+      ReportMalformedLine(line, line_end);
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  return is_negative ? static_cast<cpp_type>(-magnitude) : static_cast<cpp_type>(magnitude);
+}
+
+std::size_t CountDataLines(const char* begin, const char* end) {
+  std::size_t num_data_lines = 0;
+  while (begin < end) {
+    const char* line_end = FindLineEnd(begin, end);
+    if (IsDataLine(begin, line_end)) {
+      ++num_data_lines;
+    }
+    begin = line_end + 1;
+  }
+  return num_data_lines;
+}
+
+void ParseDataLines(const char* begin,
+                    const char* end,
+                    const Vector<bool>& is_skipped,
+                    cpp_type** destinations) {
+  while (begin < end) {
+    const char* line_end = FindLineEnd(begin, end);
+    if (IsDataLine(begin, line_end)) {
+      const char* field = begin;
+      int column_id = 0;
+      for (std::size_t i = 0; i < is_skipped.size(); ++i) {
+        const char* field_end =
+            static_cast<const char*>(std::memchr(field, '|', line_end - field));
+        if (i + 1 == is_skipped.size()) {
+          if (field_end != nullptr) {
+            ReportMalformedLine(begin, line_end);
+          }
+          field_end = line_end;
+        } else if (field_end == nullptr) {
+          ReportMalformedLine(begin, line_end);
+        }
+        if (!is_skipped[i]) {
+          *destinations[column_id]++ = ParseValue(field, field_end, begin, line_end);
+          ++column_id;
+        }
+        field = field_end + 1;
+      }
+    }
+    begin = line_end + 1;
+  }
+}
+
+}  // namespace
+
+void LoadTextFile(const std::string& file_path,
+                  const Vector<bool>& is_skipped,
+                  Vector<ConstBufferPtr>* columns) {
+  VLOG(2) << "Read data from " << file_path;
+  const int fd = open(file_path.c_str(), O_RDONLY);
+  CHECK(fd >= 0) << file_path;
+  struct stat file_stat;
+  CHECK_EQ(0, fstat(fd, &file_stat)) << file_path;
+  const std::size_t file_size = file_stat.st_size;
+
+  const char* data = nullptr;
+  if (file_size > 0) {
+    void* mapped_data = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    CHECK(mapped_data != MAP_FAILED) << "Failed to map " << file_path;
+    madvise(mapped_data, file_size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped_data);
+  }
+  close(fd);
+
+  // Splits the file into ranges of whole lines.
+  ThreadPool* thread_pool = ThreadPool::GetInstance();
+  const std::size_t num_ranges =
+      std::max<std::size_t>(
+          1,
+          std::min<std::size_t>(thread_pool->num_threads(),
+                                file_size / std::max<std::size_t>(1, FLAGS_min_text_file_range_size)));
+  Vector<const char*> range_boundaries(num_ranges + 1, data + file_size);
+  range_boundaries[0] = data;
+  for (std::size_t i = 1; i < num_ranges; ++i) {
+    const char* boundary = std::max(data + file_size * i / num_ranges, range_boundaries[i - 1]);
+    boundary = FindLineEnd(boundary, data + file_size);
+    range_boundaries[i] = std::min(boundary + 1, data + file_size);
+  }
+
+  Vector<std::size_t> range_offsets(num_ranges + 1, 0);
+  thread_pool->Run(num_ranges,
+                   [&](int range_id) {
+                     range_offsets[range_id + 1] =
+                         CountDataLines(range_boundaries[range_id],
+                                        range_boundaries[range_id + 1]);
+                   });
+  for (std::size_t i = 0; i < num_ranges; ++i) {
+    range_offsets[i + 1] += range_offsets[i];
+  }
+  const std::size_t num_lines = range_offsets[num_ranges];
+
+  Vector<BufferPtr> output_buffers;
+  for (bool is_column_skipped : is_skipped) {
+    if (!is_column_skipped) {
+      output_buffers.emplace_back(std::make_shared<Buffer>(num_lines * sizeof(cpp_type),
+                                                           num_lines));
+    }
+  }
+
+  thread_pool->Run(num_ranges,
+                   [&](int range_id) {
+                     Vector<cpp_type*> destinations;
+                     for (const BufferPtr& output_buffer : output_buffers) {
+                       destinations.emplace_back(
+                           output_buffer->mutable_as_type<cpp_type>() + range_offsets[range_id]);
+                     }
+                     ParseDataLines(range_boundaries[range_id],
+                                    range_boundaries[range_id + 1],
+                                    is_skipped,
+                                    destinations.data());
+                   });
+
+  if (file_size > 0) {
+    munmap(const_cast<char*>(data), file_size);
+  }
+
+  for (BufferPtr& output_buffer : output_buffers) {
+    columns->emplace_back(std::make_shared<const ConstBuffer>(output_buffer));
+  }
+
+  VLOG(2) << "Read " << num_lines << " rows from file " << file_path;
+}
+
+}  // namespace quickfoil
@@ -0,0 +1,37 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_STORAGE_TEXT_FILE_LOADER_HPP_
+#define QUICKFOIL_STORAGE_TEXT_FILE_LOADER_HPP_
+
+#include <string>
+
+#include "memory/Buffer.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+
+namespace quickfoil {
+
+DECLARE_uint64(min_text_file_range_size);
+
+// Loads a text data file with one fact per line and the arguments separated
+// by '|'. The lines may end with "\n" or "\r\n". Empty lines and lines
+// starting with '#' are ignored. Appends one column of values of
+// kQuickFoilDefaultDataType to <columns> for each argument i with
+// <is_skipped>[i] being false; the skipped arguments are not parsed.
+//
+// The file is mapped into memory and split into ranges of at least
+// FLAGS_min_text_file_range_size bytes at line boundaries, which are parsed in
+// parallel by the ThreadPool: the data lines of each range are counted first,
+// so that each range is then parsed in place into its own segment of the
+// output columns.
+void LoadTextFile(const std::string& file_path,
+                  const Vector<bool>& is_skipped,
+                  Vector<ConstBufferPtr>* columns);
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_STORAGE_TEXT_FILE_LOADER_HPP_ */
@@ -0,0 +1,155 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "storage/TextFileLoader.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include "memory/Buffer.hpp"
+#include "types/TypeID.hpp"
+#include "types/TypeTraits.hpp"
+#include "utility/Macros.hpp"
+#include "utility/ThreadPool.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class TextFileLoaderTest : public ::testing::Test {
+ protected:
+  typedef TypeTraits<kQuickFoilDefaultDataType>::cpp_type cpp_type;
+  typedef Vector<Vector<cpp_type>> column_values_type;
+
+  TextFileLoaderTest()
+      : file_path_(std::string("/tmp/quickfoil_TextFileLoaderTest_") + std::to_string(getpid()) +
+                   "_" + ::testing::UnitTest::GetInstance()->current_test_info()->name()) {
+    // Must be set before the first use of the shared thread pool.
+    FLAGS_num_threads = 4;
+  }
+
+  ~TextFileLoaderTest() {
+    FLAGS_min_text_file_range_size = 1 << 20;
+    std::remove(file_path_.c_str());
+  }
+
+  void WriteFile(const std::string& content) const {
+    std::ofstream out(file_path_, std::ios::binary | std::ios::trunc);
+    out << content;
+  }
+
+  // Loads the file split into as many ranges as there are threads, which
+  // start at arbitrary bytes of the file before being moved to line
+  // boundaries.
+  column_values_type LoadInParallel(const Vector<bool>& is_skipped) const {
+    FLAGS_min_text_file_range_size = 1;
+    return Load(is_skipped);
+  }
+
+  // Loads the file as a single range.
+  column_values_type LoadSerially(const Vector<bool>& is_skipped) const {
+    FLAGS_min_text_file_range_size = std::numeric_limits<std::uint64_t>::max();
+    return Load(is_skipped);
+  }
+
+  // Checks that the file loaded both serially and in parallel has the
+  // columns <expected_values> in row order.
+  void CheckLoad(const Vector<bool>& is_skipped,
+                 const column_values_type& expected_values) const {
+    EXPECT_EQ(expected_values, LoadSerially(is_skipped));
+    EXPECT_EQ(expected_values, LoadInParallel(is_skipped));
+  }
+
+  const std::string file_path_;
+
+ private:
+  column_values_type Load(const Vector<bool>& is_skipped) const {
+    Vector<ConstBufferPtr> columns;
+    LoadTextFile(file_path_, is_skipped, &columns);
+    column_values_type values;
+    for (const ConstBufferPtr& column : columns) {
+      values.emplace_back(column->as_type<cpp_type>(),
+                          column->as_type<cpp_type>() + column->num_tuples());
+    }
+    return values;
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(TextFileLoaderTest);
+};
+
+TEST_F(TextFileLoaderTest, EmptyFile) {
+  WriteFile("");
+  CheckLoad({false, false}, {{}, {}});
+
+  WriteFile("\n# comment\n\n");
+  CheckLoad({false, false}, {{}, {}});
+}
+
+TEST_F(TextFileLoaderTest, MissingTrailingNewline) {
+  WriteFile("1|2\n3|4");
+  CheckLoad({false, false}, {{1, 3}, {2, 4}});
+
+  WriteFile("5|6");
+  CheckLoad({false, false}, {{5}, {6}});
+}
+
+TEST_F(TextFileLoaderTest, CrlfLineEndings) {
+  WriteFile("1|2\r\n\r\n# comment\r\n3 | -4\r\n5|6");
+  CheckLoad({false, false}, {{1, 3, 5}, {2, -4, 6}});
+}
+
+TEST_F(TextFileLoaderTest, SkippedArguments) {
+  WriteFile("1|2|3\n4|x|6\n");
+  CheckLoad({false, true, false}, {{1, 4}, {3, 6}});
+  CheckLoad({true, true, false}, {{3, 6}});
+}
+
+TEST_F(TextFileLoaderTest, LineStraddlingRangeBoundaries) {
+  // The first line spans the starts of all the ranges but the first, which
+  // are moved to the same line boundary.
+  WriteFile("123456789|1\n2|3\n");
+  CheckLoad({false, false}, {{123456789, 2}, {1, 3}});
+}
+
+TEST_F(TextFileLoaderTest, ParallelMatchesSerial) {
+  // Lines of different lengths with comments, empty lines and both kinds of
+  // line endings, shifted by a comment of every length so that the range
+  // boundaries fall at every position in the lines.
+  std::string body;
+  column_values_type expected_values(3);
+  for (int i = 0; i < 200; ++i) {
+    const cpp_type first = i * 7919 % 100003;
+    const cpp_type second = -i;
+    const cpp_type third = i % 3 == 0 ? i : i * 1000;
+    body += std::to_string(first) + "|" + std::to_string(second) + "| " + std::to_string(third);
+    body += (i % 4 == 0 ? "\r\n" : "\n");
+    if (i % 9 == 0) {
+      body += "# comment " + std::to_string(i) + "\n";
+    }
+    if (i % 11 == 0) {
+      body += "\n";
+    }
+    expected_values[0].emplace_back(first);
+    expected_values[1].emplace_back(second);
+    expected_values[2].emplace_back(third);
+  }
+
+  for (int shift = 0; shift < 24; ++shift) {
+    const std::string content = "#" + std::string(shift, 'x') + "\n" + body;
+    WriteFile(content);
+    CheckLoad({false, false, false}, expected_values);
+    WriteFile(content.substr(0, content.size() - 1));
+    CheckLoad({false, false, false}, expected_values);
+  }
+}
+
+}  // namespace quickfoil
@@ -58,6 +58,7 @@ namespace quickfoil {
 
 class BitVectorBuilder;
 class BitVectorIterator;
+class BitVectorKernels;
 
 namespace third_party {
 namespace boost {
@@ -360,6 +361,7 @@ private:
 
     friend class ::quickfoil::BitVectorBuilder;
     friend class ::quickfoil::BitVectorIterator;
+    friend class ::quickfoil::BitVectorKernels;
 
     void m_zero_unused_bits();
     bool m_check_invariants() const;
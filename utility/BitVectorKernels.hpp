@@ -0,0 +1,232 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_UTILITY_BIT_VECTOR_KERNELS_HPP_
+#define QUICKFOIL_UTILITY_BIT_VECTOR_KERNELS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "schema/TypeDefs.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
+
+#include "glog/logging.h"
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace quickfoil {
+
+// Block-at-a-time kernels on the raw words of BitVectors, which avoid the
+// temporary BitVectors of the operators of BitVector. None of them allocates
+// memory once the output BitVectors have grown to the largest size seen.
+class BitVectorKernels {
+ public:
+  typedef BitVector::block_type block_type;
+
+  static_assert(sizeof(block_type) == sizeof(std::uint64_t),
+                "The blocks of a BitVector are not 64-bit words");
+
+  // Sets <result> to <left> & <right>, reusing the memory of <result>.
+  static void And(const BitVector& left,
+                  const BitVector& right,
+                  BitVector* result) {
+    DCHECK_EQ(left.size(), right.size());
+    result->resize(left.size());
+    const block_type* __restrict__ left_blocks = left.m_bits.data();
+    const block_type* __restrict__ right_blocks = right.m_bits.data();
+    block_type* __restrict__ result_blocks = result->m_bits.data();
+    const std::size_t num_blocks = left.m_bits.size();
+    std::size_t block_id = 0;
+#if defined(__AVX512F__)
+    for (; block_id + 8 <= num_blocks; block_id += 8) {
+      _mm512_storeu_si512(result_blocks + block_id,
+                          _mm512_and_si512(_mm512_loadu_si512(left_blocks + block_id),
+                                           _mm512_loadu_si512(right_blocks + block_id)));
+    }
+#elif defined(__AVX2__)
+    for (; block_id + 4 <= num_blocks; block_id += 4) {
+      _mm256_storeu_si256(
+          reinterpret_cast<__m256i*>(result_blocks + block_id),
+          _mm256_and_si256(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left_blocks + block_id)),
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right_blocks + block_id))));
+    }
+#endif
+    for (; block_id < num_blocks; ++block_id) {
+      result_blocks[block_id] = left_blocks[block_id] & right_blocks[block_id];
+    }
+  }
+
+  // Returns the number of the bits set in both <left> and <right>.
+  static std::size_t AndCount(const BitVector& left, const BitVector& right) {
+    DCHECK_EQ(left.size(), right.size());
+    const block_type* __restrict__ left_blocks = left.m_bits.data();
+    const block_type* __restrict__ right_blocks = right.m_bits.data();
+    const std::size_t num_blocks = left.m_bits.size();
+    std::size_t num_ones = 0;
+    std::size_t block_id = 0;
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    __m512i counts = _mm512_setzero_si512();
+    for (; block_id + 8 <= num_blocks; block_id += 8) {
+      counts = _mm512_add_epi64(
+          counts,
+          _mm512_popcnt_epi64(_mm512_and_si512(_mm512_loadu_si512(left_blocks + block_id),
+                                               _mm512_loadu_si512(right_blocks + block_id))));
+    }
+    num_ones = _mm512_reduce_add_epi64(counts);
+#endif
+    for (; block_id < num_blocks; ++block_id) {
+      num_ones += __builtin_popcountll(left_blocks[block_id] & right_blocks[block_id]);
+    }
+    return num_ones;
+  }
+
+  // Sets the i-th bit of <result> iff <values>[i] < <bound>, reusing the
+  // memory of <result>.
+  static void LessThan(const SelectionVector& values,
+                       size_type bound,
+                       BitVector* result) {
+    result->resize(values.size());
+    block_type* __restrict__ result_blocks = result->m_bits.data();
+    const size_type* __restrict__ value_it = values.data();
+    const std::size_t num_full_blocks = values.size() / BitVector::bits_per_block;
+#if defined(__AVX512F__)
+    const __m512i bound_vector = _mm512_set1_epi32(bound);
+#elif defined(__AVX2__)
+    const __m256i bound_vector = _mm256_set1_epi32(bound);
+#endif
+    for (std::size_t block_id = 0; block_id < num_full_blocks; ++block_id) {
+      block_type block = 0;
+#if defined(__AVX512F__)
+      for (unsigned bit = 0; bit < BitVector::bits_per_block; bit += 16) {
+        block |= static_cast<block_type>(
+            _mm512_cmplt_epi32_mask(_mm512_loadu_si512(value_it + bit), bound_vector)) << bit;
+      }
+#elif defined(__AVX2__)
+      for (unsigned bit = 0; bit < BitVector::bits_per_block; bit += 8) {
+        const __m256i values_vector =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(value_it + bit));
+        block |= static_cast<block_type>(static_cast<std::uint32_t>(_mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpgt_epi32(bound_vector, values_vector))))) << bit;
+      }
+#else
+      for (unsigned bit = 0; bit < BitVector::bits_per_block; ++bit) {
+        block |= static_cast<block_type>(value_it[bit] < bound) << bit;
+      }
+#endif
+      result_blocks[block_id] = block;
+      value_it += BitVector::bits_per_block;
+    }
+    const unsigned num_extra_bits = values.size() % BitVector::bits_per_block;
+    if (num_extra_bits > 0) {
+      block_type block = 0;
+      for (unsigned bit = 0; bit < num_extra_bits; ++bit) {
+        block |= static_cast<block_type>(value_it[bit] < bound) << bit;
+      }
+      result_blocks[num_full_blocks] = block;
+    }
+  }
+
+  // For every bit i set in <bit_vector> & <mask> (or <bit_vector> & ~<mask>
+  // if <invert_mask> is true; <mask> may be null to take <bit_vector> as it
+  // is), sets the bit <targets>[i] of <semi_bit_vector>. Fuses the AND, the
+  // count and the scatter into one pass over the blocks: adds the number of
+  // the bits i to <*num_ones> and the number of the newly set bits of
+  // <semi_bit_vector> to <*num_new_ones>.
+  template <bool invert_mask>
+  static void AndCountScatter(const BitVector& bit_vector,
+                              const BitVector* mask,
+                              const SelectionVector& targets,
+                              BitVector* semi_bit_vector,
+                              size_type* num_ones,
+                              size_type* num_new_ones) {
+    DCHECK_EQ(bit_vector.size(), targets.size());
+    DCHECK(mask == nullptr || mask->size() == bit_vector.size());
+    const block_type* __restrict__ blocks = bit_vector.m_bits.data();
+    const block_type* __restrict__ mask_blocks =
+        (mask == nullptr ? nullptr : mask->m_bits.data());
+    const size_type* __restrict__ target_ids = targets.data();
+    block_type* __restrict__ semi_blocks = semi_bit_vector->m_bits.data();
+    const std::size_t num_blocks = bit_vector.m_bits.size();
+
+    size_type local_num_ones = 0;
+    size_type local_num_new_ones = 0;
+    std::size_t block_id = 0;
+#if defined(__AVX512F__)
+    // Computes and counts eight blocks at once, and only goes through the
+    // bits of the non-empty ones.
+    constexpr std::size_t kNumSimdBlocks = 8;
+    alignas(64) block_type and_blocks[kNumSimdBlocks];
+    for (; block_id + kNumSimdBlocks <= num_blocks; block_id += kNumSimdBlocks) {
+      __m512i and_vector = _mm512_loadu_si512(blocks + block_id);
+      if (mask_blocks != nullptr) {
+        const __m512i mask_vector = _mm512_loadu_si512(mask_blocks + block_id);
+        and_vector = (invert_mask ? _mm512_andnot_si512(mask_vector, and_vector)
+                                  : _mm512_and_si512(and_vector, mask_vector));
+      }
+      __mmask8 non_empty = _mm512_test_epi64_mask(and_vector, and_vector);
+      if (non_empty == 0) {
+        continue;
+      }
+#if defined(__AVX512VPOPCNTDQ__)
+      local_num_ones += _mm512_reduce_add_epi64(_mm512_popcnt_epi64(and_vector));
+#endif
+      _mm512_store_si512(and_blocks, and_vector);
+      for (std::uint32_t lanes = non_empty; lanes != 0; lanes &= lanes - 1) {
+        const unsigned lane = __builtin_ctz(lanes);
+#if !defined(__AVX512VPOPCNTDQ__)
+        local_num_ones += __builtin_popcountll(and_blocks[lane]);
+#endif
+        ScatterBlock(and_blocks[lane],
+                     target_ids + (block_id + lane) * BitVector::bits_per_block,
+                     semi_blocks,
+                     &local_num_new_ones);
+      }
+    }
+#endif
+    for (; block_id < num_blocks; ++block_id) {
+      block_type block = blocks[block_id];
+      if (mask_blocks != nullptr) {
+        block &= (invert_mask ? ~mask_blocks[block_id] : mask_blocks[block_id]);
+      }
+      if (block == 0) {
+        continue;
+      }
+      local_num_ones += __builtin_popcountll(block);
+      ScatterBlock(block,
+                   target_ids + block_id * BitVector::bits_per_block,
+                   semi_blocks,
+                   &local_num_new_ones);
+    }
+    *num_ones += local_num_ones;
+    *num_new_ones += local_num_new_ones;
+  }
+
+ private:
+  static inline void ScatterBlock(block_type block,
+                                  const size_type* __restrict__ target_ids,
+                                  block_type* __restrict__ semi_blocks,
+                                  size_type* num_new_ones) {
+    do {
+      const size_type target_id = target_ids[__builtin_ctzll(block)];
+      block_type* semi_block = semi_blocks + target_id / BitVector::bits_per_block;
+      const block_type target_bit =
+          static_cast<block_type>(1) << (target_id % BitVector::bits_per_block);
+      *num_new_ones += ((*semi_block & target_bit) == 0);
+      *semi_block |= target_bit;
+      block &= block - 1;
+    } while (block != 0);
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(BitVectorKernels);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_UTILITY_BIT_VECTOR_KERNELS_HPP_ */
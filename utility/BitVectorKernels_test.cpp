@@ -0,0 +1,150 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "utility/BitVectorKernels.hpp"
+
+#include <cstddef>
+#include <random>
+
+#include "schema/TypeDefs.hpp"
+#include "utility/BitVector.hpp"
+#include "utility/Macros.hpp"
+#include "utility/SelectionVector.hpp"
+#include "utility/Vector.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+class BitVectorKernelsTest : public ::testing::Test {
+ protected:
+  BitVectorKernelsTest()
+      : generator_(17) {}
+
+  // The sizes around the boundaries of the blocks and of the SIMD loops.
+  static Vector<std::size_t> GetSizes() {
+    return {0, 63, 64, 65, 8 * 64 + 1};
+  }
+
+  // Returns a bit vector of <size> bits, where each 64-bit block is empty
+  // with a probability of 1/4 and the other bits are set with a probability
+  // of <density>.
+  BitVector CreateBitVector(std::size_t size, double density) {
+    std::bernoulli_distribution is_set(density);
+    std::bernoulli_distribution is_empty_block(0.25);
+    BitVector bit_vector(size);
+    for (std::size_t block_start = 0; block_start < size; block_start += 64) {
+      if (is_empty_block(generator_)) {
+        continue;
+      }
+      for (std::size_t i = block_start; i < size && i < block_start + 64; ++i) {
+        if (is_set(generator_)) {
+          bit_vector.set(i);
+        }
+      }
+    }
+    return bit_vector;
+  }
+
+  void FillSelectionVector(std::size_t size, size_type max_value, SelectionVector* values) {
+    std::uniform_int_distribution<size_type> value_distribution(0, max_value);
+    values->Reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      values->mutable_data()[i] = value_distribution(generator_);
+    }
+    values->set_size(size);
+  }
+
+  // Checks AndCountScatter<invert_mask>() against the BitVector operators.
+  template <bool invert_mask>
+  void CheckAndCountScatter(bool has_mask) {
+    constexpr std::size_t kSemiSize = 100;
+    for (const std::size_t size : GetSizes()) {
+      const BitVector bit_vector = CreateBitVector(size, 0.5);
+      const BitVector mask = CreateBitVector(size, 0.5);
+      SelectionVector targets;
+      FillSelectionVector(size, kSemiSize - 1, &targets);
+      BitVector semi_bit_vector = CreateBitVector(kSemiSize, 0.3);
+
+      BitVector expected_bits = bit_vector;
+      if (has_mask) {
+        expected_bits &= (invert_mask ? ~mask : mask);
+      }
+      BitVector expected_semi_bit_vector = semi_bit_vector;
+      for (std::size_t i = expected_bits.find_first(); i != BitVector::npos; i = expected_bits.find_next(i)) {
+        expected_semi_bit_vector.set(targets[i]);
+      }
+
+      // The counts are added to.
+      size_type num_ones = 3;
+      size_type num_new_ones = 5;
+      const size_type num_previous_ones = semi_bit_vector.count();
+      BitVectorKernels::AndCountScatter<invert_mask>(bit_vector,
+                                                     has_mask ? &mask : nullptr,
+                                                     targets,
+                                                     &semi_bit_vector,
+                                                     &num_ones,
+                                                     &num_new_ones);
+      EXPECT_EQ(3 + expected_bits.count(), num_ones) << size;
+      EXPECT_EQ(5 + expected_semi_bit_vector.count() - num_previous_ones, num_new_ones) << size;
+      EXPECT_TRUE(expected_semi_bit_vector == semi_bit_vector) << size;
+    }
+  }
+
+  std::mt19937 generator_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BitVectorKernelsTest);
+};
+
+TEST_F(BitVectorKernelsTest, And) {
+  // The result reuses the memory of a larger one.
+  BitVector result = CreateBitVector(16 * 64, 0.5);
+  for (const std::size_t size : GetSizes()) {
+    const BitVector left = CreateBitVector(size, 0.5);
+    const BitVector right = CreateBitVector(size, 0.7);
+    BitVectorKernels::And(left, right, &result);
+    EXPECT_TRUE((left & right) == result) << size;
+  }
+}
+
+TEST_F(BitVectorKernelsTest, AndCount) {
+  for (const std::size_t size : GetSizes()) {
+    for (const double density : {0.1, 0.5, 1.0}) {
+      const BitVector left = CreateBitVector(size, density);
+      const BitVector right = CreateBitVector(size, 0.6);
+      EXPECT_EQ((left & right).count(), BitVectorKernels::AndCount(left, right)) << size;
+    }
+  }
+}
+
+TEST_F(BitVectorKernelsTest, LessThan) {
+  BitVector result = CreateBitVector(16 * 64, 0.5);
+  for (const std::size_t size : GetSizes()) {
+    SelectionVector values;
+    FillSelectionVector(size, 200, &values);
+    BitVectorKernels::LessThan(values, 100, &result);
+
+    BitVector expected(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      expected[i] = values[i] < 100;
+    }
+    EXPECT_TRUE(expected == result) << size;
+  }
+}
+
+TEST_F(BitVectorKernelsTest, AndCountScatterWithoutMask) {
+  CheckAndCountScatter<false>(false);
+}
+
+TEST_F(BitVectorKernelsTest, AndCountScatterWithMask) {
+  CheckAndCountScatter<false>(true);
+}
+
+TEST_F(BitVectorKernelsTest, AndCountScatterWithInvertedMask) {
+  CheckAndCountScatter<true>(true);
+}
+
+}  // namespace quickfoil
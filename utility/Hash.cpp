@@ -0,0 +1,47 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "utility/Hash.hpp"
+
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+KeyHashFunction key_hash_function = KeyHashFunction::kMurmur;
+
+namespace {
+
+bool ValidateKeyHashFunction(const char* flagname, const std::string& value) {
+  if (value == "identity") {
+    key_hash_function = KeyHashFunction::kIdentity;
+  } else if (value == "multiplicative") {
+    key_hash_function = KeyHashFunction::kMultiplicative;
+  } else if (value == "murmur") {
+    key_hash_function = KeyHashFunction::kMurmur;
+  } else if (value == "crc32") {
+#ifndef __SSE4_2__
+    LOG(WARNING) << "CRC32 instructions are not available, use murmur instead";
+#endif
+    key_hash_function = KeyHashFunction::kCrc32;
+  } else {
+    LOG(ERROR) << "Invalid value for --" << flagname << ": " << value;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+DEFINE_string(key_hash_function,
+              "murmur",
+              "The hash function for the join keys used by the radix partitioning "
+              "and the hash tables: identity, multiplicative, murmur or crc32.");
+static const bool key_hash_function_validator_registered =
+    gflags::RegisterFlagValidator(&FLAGS_key_hash_function, &ValidateKeyHashFunction);
+
+}  // namespace quickfoil
@@ -6,17 +6,61 @@
 #ifndef QUICKFOIL_UTILITY_HASH_HPP_
 #define QUICKFOIL_UTILITY_HASH_HPP_
 
+#include <cstdint>
 #include <functional>
 
 #include "schema/TypeDefs.hpp"
 #include "utility/Vector.hpp"
 
+#include "folly/Range.h"
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
 namespace quickfoil {
 
 typedef uint32_t hash_type;
 
 #define HASH_BIT_MODULO(hash_value, mask, bits) (((hash_value) & mask) >> bits)
 
+// The functions that finalize the hash values of the join keys. The radix
+// partitioning and the hash tables use the lowest bits of the hash values,
+// which are badly skewed for encoded IDs without mixing.
+enum class KeyHashFunction {
+  kIdentity,
+  // Fibonacci hashing, with the bytes swapped to move the well-mixed high
+  // bits to the bottom.
+  kMultiplicative,
+  // The 32-bit finalizer of MurmurHash3.
+  kMurmur,
+  // The CRC32-C instruction of SSE4.2. Falls back to kMurmur without SSE4.2.
+  kCrc32
+};
+
+// Set by the flag --key_hash_function.
+extern KeyHashFunction key_hash_function;
+
+inline hash_type MixKeyHash(hash_type hash_value) {
+  switch (key_hash_function) {
+    case KeyHashFunction::kIdentity:
+      return hash_value;
+    case KeyHashFunction::kMultiplicative:
+      return __builtin_bswap32(hash_value * 0x9e3779b1u);
+#ifdef __SSE4_2__
+    case KeyHashFunction::kCrc32:
+      return _mm_crc32_u32(0, hash_value);
+#endif
+    default:
+      hash_value ^= hash_value >> 16;
+      hash_value *= 0x85ebca6bu;
+      hash_value ^= hash_value >> 13;
+      hash_value *= 0xc2b2ae35u;
+      hash_value ^= hash_value >> 16;
+      return hash_value;
+  }
+}
+
 template <class T>
 inline hash_type Hash(const T value) {
   return static_cast<hash_type>(std::hash<T>()(value));
@@ -32,6 +76,14 @@ inline hash_type Hash(const folly::StringPiece value) {
   return static_cast<hash_type>(value.hash());
 }
 
+// Hash of a join key. All the partitions and hash tables on join keys must
+// use this (or the multi-key Hash() below) to agree with each other.
+template <class T>
+inline hash_type HashKey(const T value) {
+  return MixKeyHash(Hash(value));
+}
+
+// Hash of a multi-column join key.
 template <int num_values, class T>
 typename std::enable_if<num_values < 6, hash_type>::type Hash(const Vector<const T*>& values,
                                                               size_type tid) {
@@ -41,7 +93,7 @@ typename std::enable_if<num_values < 6, hash_type>::type Hash(const Vector<const
   for (int i = 1; i < num_values; ++i) {
     seed = HashCombine(seed, values[i][tid]);
   }
-  return seed;
+  return MixKeyHash(seed);
 }
 
 template <int num_values, class T>
@@ -51,7 +103,7 @@ typename std::enable_if<num_values >= 6, hash_type>::type Hash(const Vector<cons
   for (int i = 1; i < static_cast<int>(values.size()); ++i) {
     seed = HashCombine(seed, values[i][tid]);
   }
-  return seed;
+  return MixKeyHash(seed);
 }
 
 template <int num_values, typename T>
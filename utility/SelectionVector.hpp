@@ -0,0 +1,111 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_UTILITY_SELECTION_VECTOR_HPP_
+#define QUICKFOIL_UTILITY_SELECTION_VECTOR_HPP_
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "memory/MemUtil.hpp"
+#include "schema/TypeDefs.hpp"
+#include "utility/Macros.hpp"
+
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+// A cacheline-aligned array of 32-bit tuple IDs or offsets with an explicit
+// capacity. Unlike Vector, the elements are written through mutable_data()
+// without any capacity check, so the writers must Reserve() an upper bound
+// on the number of the elements beforehand and set_size() afterwards.
+class SelectionVector {
+ public:
+  SelectionVector() {}
+
+  ~SelectionVector() {
+    free(data_);
+  }
+
+  // Makes the capacity at least <capacity>. Keeps the elements.
+  void Reserve(std::size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    // Grows at least geometrically, so that the chunks of a growing size only
+    // cause a logarithmic number of reallocations.
+    if (capacity < 2 * capacity_) {
+      capacity = 2 * capacity_;
+    }
+    size_type* new_data = static_cast<size_type*>(
+        cacheline_aligned_alloc(RoundUpToCacheLine(capacity * sizeof(size_type))));
+    CHECK(new_data != nullptr) << "Cannot allocate a selection vector of "
+                               << capacity << " elements";
+    if (size_ > 0) {
+      std::memcpy(new_data, data_, size_ * sizeof(size_type));
+    }
+    free(data_);
+    data_ = new_data;
+    capacity_ = capacity;
+  }
+
+  void clear() {
+    size_ = 0;
+  }
+
+  void set_size(std::size_t size) {
+    DCHECK_LE(size, capacity_);
+    size_ = size;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  std::size_t capacity() const {
+    return capacity_;
+  }
+
+  const size_type* data() const {
+    return data_;
+  }
+
+  size_type* mutable_data() {
+    return data_;
+  }
+
+  const size_type& operator[](std::size_t index) const {
+    DCHECK_LT(index, size_);
+    return data_[index];
+  }
+
+  const size_type* begin() const {
+    return data_;
+  }
+
+  const size_type* end() const {
+    return data_ + size_;
+  }
+
+ private:
+  static std::size_t RoundUpToCacheLine(std::size_t num_bytes) {
+    return (num_bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  }
+
+  size_type* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(SelectionVector);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_UTILITY_SELECTION_VECTOR_HPP_ */
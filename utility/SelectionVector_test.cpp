@@ -0,0 +1,56 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "utility/SelectionVector.hpp"
+
+#include <cstddef>
+
+#include "schema/TypeDefs.hpp"
+
+#include "gtest/gtest.h"
+
+namespace quickfoil {
+
+TEST(SelectionVectorTest, ReserveKeepsElements) {
+  SelectionVector selection_vector;
+  EXPECT_EQ(0u, selection_vector.capacity());
+  EXPECT_TRUE(selection_vector.empty());
+
+  // Fills the vector up to its capacity before each growth.
+  std::size_t size = 0;
+  for (const std::size_t capacity : {1, 3, 4, 100, 101, 1000}) {
+    selection_vector.Reserve(capacity);
+    EXPECT_LE(capacity, selection_vector.capacity());
+    ASSERT_EQ(size, selection_vector.size());
+    for (std::size_t i = 0; i < size; ++i) {
+      ASSERT_EQ(static_cast<size_type>(i * 7 + 1), selection_vector[i]) << i;
+    }
+    for (; size < selection_vector.capacity(); ++size) {
+      selection_vector.mutable_data()[size] = static_cast<size_type>(size * 7 + 1);
+    }
+    selection_vector.set_size(size);
+  }
+
+  // A smaller capacity keeps the memory.
+  const size_type* data = selection_vector.data();
+  const std::size_t capacity = selection_vector.capacity();
+  selection_vector.Reserve(10);
+  EXPECT_EQ(data, selection_vector.data());
+  EXPECT_EQ(capacity, selection_vector.capacity());
+
+  // Only the elements before the size are kept.
+  selection_vector.set_size(5);
+  selection_vector.Reserve(3 * capacity);
+  ASSERT_EQ(5u, selection_vector.size());
+  for (std::size_t i = 0; i < 5; ++i) {
+    EXPECT_EQ(static_cast<size_type>(i * 7 + 1), selection_vector[i]) << i;
+  }
+
+  selection_vector.clear();
+  EXPECT_TRUE(selection_vector.empty());
+  EXPECT_LE(3 * capacity, selection_vector.capacity());
+}
+
+}  // namespace quickfoil
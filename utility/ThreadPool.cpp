@@ -0,0 +1,111 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#include "utility/ThreadPool.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+namespace quickfoil {
+
+DEFINE_int32(num_threads,
+             1,
+             "The number of threads (including the main thread) used by the parallel operations.");
+
+namespace {
+
+// True on the workers, and on the thread calling Run() while it runs tasks.
+thread_local bool is_running_tasks = false;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads)
+    : next_task_id_(0) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Run(int num_tasks, const Task& task) {
+  if (workers_.empty() || num_tasks <= 1 || is_running_tasks) {
+    for (int task_id = 0; task_id < num_tasks; ++task_id) {
+      task(task_id);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    num_tasks_ = num_tasks;
+    num_active_workers_ = workers_.size();
+    next_task_id_.store(0);
+    ++generation_;
+  }
+  work_cv_.notify_all();
+
+  is_running_tasks = true;
+  RunTasks(task, num_tasks);
+  is_running_tasks = false;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return num_active_workers_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop() {
+  is_running_tasks = true;
+  std::uint64_t seen_generation = 0;
+  while (true) {
+    const Task* task;
+    int num_tasks;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this, seen_generation] {
+        return shutdown_ || generation_ != seen_generation;
+      });
+      if (shutdown_) {
+        return;
+      }
+      seen_generation = generation_;
+      task = task_;
+      num_tasks = num_tasks_;
+    }
+
+    RunTasks(*task, num_tasks);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_active_workers_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunTasks(const Task& task, int num_tasks) {
+  for (int task_id = next_task_id_.fetch_add(1);
+       task_id < num_tasks;
+       task_id = next_task_id_.fetch_add(1)) {
+    task(task_id);
+  }
+}
+
+}  // namespace quickfoil
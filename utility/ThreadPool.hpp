@@ -0,0 +1,78 @@
+/*
+ * This file copyright (c) 2015.
+ * All rights reserved.
+ */
+
+#ifndef QUICKFOIL_UTILITY_THREAD_POOL_HPP_
+#define QUICKFOIL_UTILITY_THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "utility/Macros.hpp"
+#include "utility/Vector.hpp"
+
+#include "gflags/gflags.h"
+
+namespace quickfoil {
+
+DECLARE_int32(num_threads);
+
+// A fixed-size pool of worker threads. The thread calling Run() also
+// participates in the execution, so a pool of N threads spawns N - 1 workers.
+class ThreadPool {
+ public:
+  typedef std::function<void(int)> Task;
+
+  explicit ThreadPool(int num_threads);
+
+  ~ThreadPool();
+
+  // The pool shared by all parallel operations, sized by FLAGS_num_threads.
+  static ThreadPool* GetInstance() {
+    static ThreadPool thread_pool(FLAGS_num_threads);
+    return &thread_pool;
+  }
+
+  inline int num_threads() const {
+    return workers_.size() + 1;
+  }
+
+  // Calls <task> with every ID in [0, num_tasks) and blocks until all of them
+  // finish. Tasks are handed out dynamically in increasing order of ID. A call
+  // issued from within a task runs all tasks on the calling thread.
+  void Run(int num_tasks, const Task& task);
+
+ private:
+  void WorkerLoop();
+
+  void RunTasks(const Task& task, int num_tasks);
+
+  Vector<std::thread> workers_;
+
+  // Serializes concurrent Run() calls from non-worker threads.
+  std::mutex run_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+
+  // The current job. Protected by <mutex_>.
+  const Task* task_ = nullptr;
+  int num_tasks_ = 0;
+  std::uint64_t generation_ = 0;
+  int num_active_workers_ = 0;
+  bool shutdown_ = false;
+
+  std::atomic<int> next_task_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace quickfoil
+
+#endif /* QUICKFOIL_UTILITY_THREAD_POOL_HPP_ */